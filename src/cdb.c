@@ -12,20 +12,139 @@ static const char cdb_c_rcsid[] = "$Id$";
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
 #include "define.h"
 #include "maps.h"
 #define cdb_c_
 #include "cdb.h"
 #include "cdb_byteswap.h"
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/*
+ *	points decoded at a time by draw_current_seg_cdb
+ */
+#define CDB_DRAW_BLOCK 256
+
 static cdb_seg_data *cdb_read_disk(cdb_class *this);
 static cdb_seg_data *cdb_read_memory(cdb_class *this);
+static cdb_seg_data *cdb_read_map(cdb_class *this);
+static cdb_seg_data *cdb_read_v2(cdb_class *this);
+static bool map_cdb(cdb_class *this);
+static const byte1 *raw_seg_data_cdb(cdb_class *this, bool *big_endian);
+static void free_rtree_cdb(cdb_class *this);
+static bool read_index_cdb(cdb_class *this);
+static bool read_index2_cdb(cdb_class *this);
+static void read_lod_cdb(cdb_class *this);
 
 const char *id_cdb(void)
 {
   return cdb_c_rcsid;
 }
 
+/*
+ *	version 2 values are least significant byte first
+ */
+static byte4 cdb2_get4(const byte1 *src)
+{
+  return (byte4)src[0] | (byte4)src[1] << 8
+    | (byte4)src[2] << 16 | (byte4)src[3] << 24;
+}
+
+static NSIDCint8 cdb2_get8(const byte1 *src)
+{
+  return (NSIDCint8)((NSIDCbyte8)cdb2_get4(src)
+		     | (NSIDCbyte8)cdb2_get4(src + 4) << 32);
+}
+
+static void cdb2_put4(byte1 *dst, byte4 value)
+{
+  dst[0] = (byte1)value;
+  dst[1] = (byte1)(value >> 8);
+  dst[2] = (byte1)(value >> 16);
+  dst[3] = (byte1)(value >> 24);
+}
+
+static void cdb2_put8(byte1 *dst, NSIDCint8 value)
+{
+  cdb2_put4(dst, (byte4)((NSIDCbyte8)value & 0xffffffffU));
+  cdb2_put4(dst + 4, (byte4)((NSIDCbyte8)value >> 32));
+}
+
+/*
+ *	CRC-32 (as zlib), half a byte at a time
+ */
+static byte4 cdb2_crc32(const byte1 *src, long size)
+{
+  static const byte4 table[16] =
+  { 0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC,
+    0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+    0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C,
+    0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C };
+  register byte4 crc = 0xFFFFFFFF;
+
+  while (size-- > 0)
+  { crc ^= *src++;
+    crc = table[crc & 15] ^ (crc >> 4);
+    crc = table[crc & 15] ^ (crc >> 4);
+  }
+  return ~crc;
+}
+
+/*
+ *	encode deltas as zigzag varints, out needs 6 bytes per pair,
+ *	returns number of bytes used
+ */
+static long cdb2_encode(const cdb_seg_data *data, int npts, byte1 *out)
+{
+  register byte1 *dst = out;
+  register byte4 zz;
+  register int ipt, value;
+
+  for (ipt = 0; ipt < 2*npts; ipt++)
+  { value = ipt & 1 ? data[ipt/2].dlon : data[ipt/2].dlat;
+    zz = value < 0 ? ((byte4)(-value) << 1) - 1 : (byte4)value << 1;
+    while (zz >= 0x80)
+    { *dst++ = (byte1)(zz | 0x80);
+      zz >>= 7;
+    }
+    *dst++ = (byte1)zz;
+  }
+  return dst - out;
+}
+
+/*
+ *	decode zigzag varints, returns FALSE unless exactly size
+ *	bytes hold npts pairs that fit in int2
+ */
+static bool cdb2_decode(const byte1 *src, long size, int npts,
+			cdb_seg_data *data)
+{
+  register const byte1 *end = src + size;
+  register byte4 zz;
+  register int ipt, shift, value;
+
+  for (ipt = 0; ipt < 2*npts; ipt++)
+  { zz = 0;
+    shift = 0;
+    do
+    { if (src >= end || shift > 14) return FALSE;
+      zz |= (byte4)(*src & 0x7f) << shift;
+      shift += 7;
+    } while (*src++ & 0x80);
+    value = zz & 1 ? -(int)(zz >> 1) - 1 : (int)(zz >> 1);
+    if (value < -32768 || value > 32767) return FALSE;
+    if (ipt & 1) data[ipt/2].dlon = (int2)value;
+    else data[ipt/2].dlat = (int2)value;
+  }
+  return src == end;
+}
+
 /*----------------------------------------------------------------------
  * new_cdb - create new cdb_class instance
  *
@@ -49,6 +168,17 @@ cdb_class *new_cdb(void)
   this->npoints = 0;
   this->is_loaded = FALSE;
   this->get_data = cdb_read_disk;
+  this->map = NULL;
+  this->map_size = 0;
+  this->rtree = NULL;
+  this->lod = NULL;
+  memset(this->lod_level, 0, sizeof(this->lod_level));
+  this->parent = NULL;
+  this->version = 1;
+  this->flags = 0;
+  this->index2 = NULL;
+  this->code_buffer = NULL;
+  this->code_buffer_size = 0;
 
   return this;
 }
@@ -66,10 +196,13 @@ cdb_class *new_cdb(void)
  *		separated list of paths in the environment
  *		variable PATHCDB
  *
+ *		regular files are mapped read-only and segment
+ *		data is decoded from the mapping on demand,
+ *		otherwise the file is read with stdio
+ *
  *--------------------------------------------------------------------*/
 cdb_class *init_cdb(const char *cdb_filename)
 {
-  register int ios;
   cdb_class *this;
 
 /*
@@ -93,78 +226,321 @@ cdb_class *init_cdb(const char *cdb_filename)
     return (cdb_class *)NULL;
   }
 
+  map_cdb(this);
+
+  if (!read_index_cdb(this))
+  { free_cdb(this);
+    return (cdb_class *)NULL;
+  }
+
+  read_lod_cdb(this);
+
+  return this;
+}
+
+/*----------------------------------------------------------------------
+ * read_index_cdb - read in file header and segment index
+ *		    allocate space for segment data buffer
+ *
+ *	input : this - pointer to cdb_class instance with open fp,
+ *		or with map set to the start of the file image
+ *
+ *	result: TRUE on success, FALSE on error
+ *
+ *--------------------------------------------------------------------*/
+static bool read_index_cdb(cdb_class *this)
+{
+  register int ios;
+
 /*
  *	read in cdb file header, byteswap it, and check magic number
  */
   this->header = (cdb_file_header *)calloc(1, sizeof(cdb_file_header));
   if (NULL == this->header) 
-  { perror("init_cdb"); free_cdb(this); return (cdb_class *)NULL; }
+  { perror("init_cdb"); return FALSE; }
+
+  if (NULL != this->map)
+  { if (this->map_size < CDB_FILE_HEADER_SIZE)
+    { fprintf(stderr,"init_cdb: <%s> is too short\n", this->filename);
+      return FALSE;
+    }
+    memcpy(this->header, this->map, CDB_FILE_HEADER_SIZE);
+  }
+  else if (fread(this->header, 1, CDB_FILE_HEADER_SIZE, this->fp)
+	   != CDB_FILE_HEADER_SIZE)
+  { perror(this->filename); return FALSE; }
 
-  if (fread(this->header, 1, CDB_FILE_HEADER_SIZE, this->fp)
-      != CDB_FILE_HEADER_SIZE)
-  { perror(cdb_filename); free_cdb(this); return (cdb_class *)NULL; }
+  if (CDB2_MAGIC_NUMBER == cdb2_get4((byte1 *)this->header))
+    return read_index2_cdb(this);
 
   cdb_byteswap_header(this->header);
 
   if (this->header->code_number != CDB_MAGIC_NUMBER)
   { fprintf(stderr,"<%s> is not a cdb file, code number 0x%08x != 0x%08x\n",
 	    this->filename, this->header->code_number, CDB_MAGIC_NUMBER);
-    free_cdb(this);
-    return (cdb_class *)NULL;
+    return FALSE;
   }
 
 /*
  *	allocate space for index and segment buffer
  */
   if (this->header->index_size == 0)
-  { free_cdb(this);
-    fprintf(stderr,"init_cdb: <%s> has no index\n", this->filename);
-    return (cdb_class *)NULL;
+  { fprintf(stderr,"init_cdb: <%s> has no index\n", this->filename);
+    return FALSE;
   }
-  if (this->header->index_size > CDB_MAX_BUFFER_SIZE)
-  { free_cdb(this);
-    fprintf(stderr,"init_cdb: %d bytes exceeds max index size of %d bytes\n",
+  if (NULL != this->map)
+  { if (this->header->index_addr < CDB_FILE_HEADER_SIZE
+	|| (long)this->header->index_addr + this->header->index_size
+	> this->map_size
+	|| this->header->max_seg_size > this->map_size)
+    { fprintf(stderr,"init_cdb: <%s> index extends past end of file\n",
+	      this->filename);
+      return FALSE;
+    }
+  }
+  else if (this->header->index_size > CDB_MAX_BUFFER_SIZE)
+  { fprintf(stderr,"init_cdb: %d bytes exceeds max index size of %d bytes\n",
 	    this->header->index_size, CDB_MAX_BUFFER_SIZE);
-    return (cdb_class *)NULL;
+    return FALSE;
   }
   this->index = (cdb_index_entry *) calloc(this->header->index_size, 1);
   if (NULL == this->index)
-  { perror("init_cdb"); free_cdb(this); return (cdb_class *)NULL; }
+  { perror("init_cdb"); return FALSE; }
 
   this->segment = this->index;
   this->seg_count = this->header->index_size/sizeof(cdb_index_entry);
   this->index_order = (cdb_index_sort)(this->header->index_order);
 
-  if (this->header->max_seg_size > CDB_MAX_BUFFER_SIZE)
-  { free_cdb(this);
-    fprintf(stderr,"init_cdb: %d bytes exceeds max segment size of %d bytes\n",
+  if (NULL == this->map && this->header->max_seg_size > CDB_MAX_BUFFER_SIZE)
+  { fprintf(stderr,"init_cdb: %d bytes exceeds max segment size of %d bytes\n",
 	    this->header->max_seg_size, CDB_MAX_BUFFER_SIZE);
-    return (cdb_class *)NULL;
+    return FALSE;
   }
   this->data_buffer = (cdb_seg_data *) calloc(this->header->max_seg_size, 1);
   if (NULL == this->data_buffer)
-  { perror("init_cdb"); free_cdb(this); return (cdb_class *)NULL; }
+  { perror("init_cdb"); return FALSE; }
 
   this->data_buffer_size = this->header->max_seg_size;
   this->data_ptr = this->data_buffer;
   this->npoints = 0;
 
 /*
- *	read in the index and byteswap it
+ *	read in the index (in disk order) and byteswap it
  */
-  fseek(this->fp, this->header->index_addr, SEEK_SET);
-  ios = fread(this->index, 1, this->header->index_size, this->fp);
-  if (ios != this->header->index_size)
+  if (NULL != this->map)
+  { memcpy(this->index, this->map + this->header->index_addr,
+	   (size_t)this->header->index_size);
+    this->get_data = cdb_read_map;
+    this->is_loaded = TRUE;
+    ios = this->header->index_size;
+  }
+  else
+  { fseek(this->fp, this->header->index_addr, SEEK_SET);
+    ios = fread(this->index, 1, this->header->index_size, this->fp);
+  }
+  if ((byte4)ios != this->header->index_size)
   { fprintf(stderr,"init_cdb: reading index, expected %d got %d bytes.\n",
 	    this->header->index_size, ios);
     perror(this->filename);
-    free_cdb(this);
-    return (cdb_class *) NULL;
+    return FALSE;
   }
 
   cdb_byteswap_index(this->index, this->seg_count);
 
-  return this;
+  return TRUE;
+}
+
+/*----------------------------------------------------------------------
+ * read_index2_cdb - read in version 2 file header and segment index
+ *
+ *	input : this - pointer to cdb_class instance with open fp
+ *		or map, and header allocated
+ *
+ *	result: TRUE on success, FALSE on error
+ *
+ *	effect: the header and index are set up as if read from a
+ *		version 1 file, with file addresses in index2
+ *
+ *--------------------------------------------------------------------*/
+static bool read_index2_cdb(cdb_class *this)
+{
+  byte1 head[CDB2_FILE_HEADER_SIZE], *raw, *entry;
+  NSIDCint8 index_size;
+  byte4 max_points;
+  int iseg;
+  cdb_index_entry *seg;
+
+  if (NULL != this->map)
+  { if (this->map_size < CDB2_FILE_HEADER_SIZE)
+    { fprintf(stderr,"init_cdb: <%s> is too short\n", this->filename);
+      return FALSE;
+    }
+    memcpy(head, this->map, CDB2_FILE_HEADER_SIZE);
+  }
+  else if (0 != fseek(this->fp, 0L, SEEK_SET)
+	   || fread(head, 1, CDB2_FILE_HEADER_SIZE, this->fp)
+	   != CDB2_FILE_HEADER_SIZE)
+  { perror(this->filename); return FALSE; }
+
+  this->version = cdb2_get4(head + 4);
+  if (2 != this->version)
+  { fprintf(stderr,"init_cdb: <%s> is cdb version %d, expected 2\n",
+	    this->filename, this->version);
+    return FALSE;
+  }
+  this->flags = cdb2_get4(head + 8);
+  this->index_addr = cdb2_get8(head + 16);
+  index_size = cdb2_get8(head + 24);
+  this->seg_count = cdb2_get4(head + 32);
+  max_points = cdb2_get4(head + 36);
+
+  if (this->seg_count <= 0
+      || index_size != (NSIDCint8)this->seg_count * CDB2_INDEX_ENTRY_SIZE)
+  { fprintf(stderr,"init_cdb: <%s> has no index\n", this->filename);
+    return FALSE;
+  }
+  if (NULL != this->map && (this->index_addr < CDB2_FILE_HEADER_SIZE
+			    || this->index_addr + index_size > this->map_size))
+  { fprintf(stderr,"init_cdb: <%s> index extends past end of file\n",
+	    this->filename);
+    return FALSE;
+  }
+
+/*
+ *	fill in the header as the rest of cdb expects it
+ */
+  this->header->code_number = CDB2_MAGIC_NUMBER;
+  this->header->index_addr = 0;
+  this->header->index_size = this->seg_count * sizeof(cdb_index_entry);
+  this->header->max_seg_size = max_points * sizeof(cdb_seg_data);
+  this->header->segment_rank = cdb2_get4(head + 40);
+  this->header->index_order = cdb2_get4(head + 44);
+  this->header->ilat_max = (int4)cdb2_get4(head + 48);
+  this->header->ilon_max = (int4)cdb2_get4(head + 52);
+  this->header->ilat_min = (int4)cdb2_get4(head + 56);
+  this->header->ilon_min = (int4)cdb2_get4(head + 60);
+  this->header->ilat_extent = (int4)cdb2_get4(head + 64);
+  this->header->ilon_extent = (int4)cdb2_get4(head + 68);
+  memcpy(this->header->text, head + 72, sizeof(this->header->text));
+  this->header->text[sizeof(this->header->text) - 1] = '\0';
+
+  this->index = (cdb_index_entry *)
+    calloc(this->seg_count, sizeof(cdb_index_entry));
+  this->index2 = (cdb2_index_entry *)
+    calloc(this->seg_count, sizeof(cdb2_index_entry));
+  this->data_buffer = (cdb_seg_data *)
+    calloc(max_points + 1, sizeof(cdb_seg_data));
+  if (NULL == this->index || NULL == this->index2 || NULL == this->data_buffer)
+  { perror("init_cdb"); return FALSE; }
+  this->data_buffer_size = (max_points + 1) * sizeof(cdb_seg_data);
+  this->data_ptr = this->data_buffer;
+  this->npoints = 0;
+  this->segment = this->index;
+  this->index_order = (cdb_index_sort)(this->header->index_order);
+
+/*
+ *	decode the index
+ */
+  if (NULL != this->map)
+    raw = this->map + this->index_addr;
+  else
+  { raw = (byte1 *)malloc((size_t)index_size);
+    if (NULL == raw) { perror("init_cdb"); return FALSE; }
+    if (0 != fseek(this->fp, (long)this->index_addr, SEEK_SET)
+	|| fread(raw, 1, (size_t)index_size, this->fp) != (size_t)index_size)
+    { fprintf(stderr,"init_cdb: error reading index.\n");
+      perror(this->filename);
+      free(raw);
+      return FALSE;
+    }
+  }
+
+  for (iseg = 0, seg = this->index, entry = raw; iseg < this->seg_count;
+       iseg++, seg++, entry += CDB2_INDEX_ENTRY_SIZE)
+  { seg->ID = cdb2_get4(entry);
+    seg->ilat0 = (int4)cdb2_get4(entry + 4);
+    seg->ilon0 = (int4)cdb2_get4(entry + 8);
+    seg->ilat_max = (int4)cdb2_get4(entry + 12);
+    seg->ilon_max = (int4)cdb2_get4(entry + 16);
+    seg->ilat_min = (int4)cdb2_get4(entry + 20);
+    seg->ilon_min = (int4)cdb2_get4(entry + 24);
+    seg->size = cdb2_get4(entry + 28) * sizeof(cdb_seg_data);
+    seg->addr = iseg + 1;
+    this->index2[iseg].addr = cdb2_get8(entry + 32);
+    this->index2[iseg].size = cdb2_get4(entry + 40);
+    this->index2[iseg].checksum = cdb2_get4(entry + 44);
+  }
+
+  if (NULL == this->map) free(raw);
+
+  this->get_data = cdb_read_v2;
+  this->is_loaded = (NULL != this->map);
+
+  return TRUE;
+}
+
+/*----------------------------------------------------------------------
+ * cdb_byteswap_lod_header - byte swap level of detail directory
+ *			     if necessary
+ *
+ *	input : lod - directory in disk or native order
+ *
+ *	output: lod - directory in the other order
+ *
+ *--------------------------------------------------------------------*/
+void cdb_byteswap_lod_header(cdb_lod_header *lod)
+{
+#ifdef LSB1ST
+  register int ilod;
+
+  SWAP4_IS(&(lod->code_number));
+  SWAP4_IS(&(lod->count));
+  for (ilod=0; ilod < CDB_MAX_LOD; ilod++)
+  { SWAP4_IS(&(lod->addr[ilod]));
+    SWAP4_IS(&(lod->tolerance[ilod]));
+  }
+#endif
+}
+
+/*----------------------------------------------------------------------
+ * read_lod_cdb - read level of detail directory if there is one
+ *
+ *	input : this - pointer to mapped cdb_class instance
+ *
+ *	effect: sets this->lod, levels that do not fit in the
+ *		file are dropped with a warning
+ *
+ *--------------------------------------------------------------------*/
+static void read_lod_cdb(cdb_class *this)
+{
+  register int ilod;
+  long addr;
+
+  if (NULL == this->map || 2 == this->version) return;
+  addr = (long)this->header->index_addr + this->header->index_size;
+  if (addr + CDB_LOD_HEADER_SIZE > this->map_size) return;
+
+  this->lod = (cdb_lod_header *)calloc(1, sizeof(cdb_lod_header));
+  if (NULL == this->lod) { perror("read_lod_cdb"); return; }
+  memcpy(this->lod, this->map + addr, CDB_LOD_HEADER_SIZE);
+  cdb_byteswap_lod_header(this->lod);
+
+  if (this->lod->code_number != CDB_LOD_MAGIC_NUMBER)
+  { free(this->lod);
+    this->lod = NULL;
+    return;
+  }
+
+  if (this->lod->count > CDB_MAX_LOD) this->lod->count = CDB_MAX_LOD;
+  for (ilod = 0; ilod < (int)this->lod->count; ilod++)
+  { if (this->lod->addr[ilod] < addr + CDB_LOD_HEADER_SIZE
+	|| this->lod->addr[ilod] + CDB_FILE_HEADER_SIZE > this->map_size)
+    { fprintf(stderr,"read_lod_cdb: <%s> level %d extends past end of file\n",
+	      this->filename, ilod+1);
+      this->lod->count = ilod;
+      break;
+    }
+  }
 }
 
 /*----------------------------------------------------------------------
@@ -175,15 +551,54 @@ cdb_class *init_cdb(const char *cdb_filename)
  *--------------------------------------------------------------------*/
 void free_cdb (cdb_class *this)
 {
+  register int ilod;
+
   if (this == NULL) return;
+  for (ilod = 0; ilod < CDB_MAX_LOD; ilod++) free_cdb(this->lod_level[ilod]);
+  if (this->lod != NULL) free(this->lod);
   if (this->filename != NULL) free(this->filename);
   if (this->fp != NULL) fclose(this->fp);
   if (this->header != NULL) free(this->header);
   if (this->index != NULL) free(this->index);
   if (this->data_buffer != NULL) free(this->data_buffer);
+  if (this->seg_lat != NULL) free(this->seg_lat);
+  if (this->seg_lon != NULL) free(this->seg_lon);
+  if (this->index2 != NULL) free(this->index2);
+  if (this->code_buffer != NULL) free(this->code_buffer);
+  if (this->map != NULL && this->parent == NULL) 
+    munmap(this->map, (size_t)this->map_size);
+  free_rtree_cdb(this);
   free(this);
 }
 
+/*----------------------------------------------------------------------
+ * map_cdb - map whole cdb file read-only
+ *
+ *	input : this - pointer to cdb_class instance with open fp
+ *
+ *	result: TRUE if this->map is set, FALSE for files that
+ *		can not be mapped (pipes, devices, mmap failure)
+ *
+ *--------------------------------------------------------------------*/
+static bool map_cdb(cdb_class *this)
+{
+  struct stat st;
+  void *map;
+
+  this->map = NULL;
+  this->map_size = 0;
+  if (0 != fstat(fileno(this->fp), &st)
+      || !S_ISREG(st.st_mode) || st.st_size <= 0) return FALSE;
+
+  map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED,
+	     fileno(this->fp), 0);
+  if (MAP_FAILED == map) return FALSE;
+
+  this->map = (byte1 *)map;
+  this->map_size = (long)st.st_size;
+  return TRUE;
+}
+
 /*----------------------------------------------------------------------
  * copy_of_cdb - copy a cdb_class instance
  *
@@ -215,6 +630,15 @@ cdb_class *copy_of_cdb(cdb_class *this)
 /*
  *	get a new file pointer
  */
+  if (this->parent == NULL) copy->map = NULL;
+  copy->rtree = NULL;
+  copy->seg_lat = copy->seg_lon = NULL;
+  copy->seg_size = 0;
+  copy->index2 = NULL;
+  copy->code_buffer = NULL;
+  copy->code_buffer_size = 0;
+  memset(copy->lod_level, 0, sizeof(copy->lod_level));
+  copy->lod = NULL;
   copy->fp = fopen(copy->filename, "r");
   if (copy->fp == NULL)
   { fprintf(stderr,"copy_of_cdb: unable to re-open file.\n");
@@ -223,6 +647,16 @@ cdb_class *copy_of_cdb(cdb_class *this)
     return NULL;
   }
 
+/*
+ *	map the file again, the copy shares the same pages
+ */
+  if (NULL != this->map && this->parent == NULL && !map_cdb(copy))
+  { fprintf(stderr,"copy_of_cdb: unable to re-map file.\n");
+    perror(copy->filename);
+    free_cdb(copy);
+    return NULL;
+  }
+
 /*
  *	get new storage area for header and index and copy verbatim
  */
@@ -237,6 +671,18 @@ cdb_class *copy_of_cdb(cdb_class *this)
 	 sizeof(cdb_file_header));
   memcpy((void *)copy->index, (const void *)this->index, 
 	 (size_t)this->header->index_size);
+  if (this->lod != NULL)
+  { copy->lod = (cdb_lod_header *)malloc(sizeof(cdb_lod_header));
+    if (copy->lod != NULL) *copy->lod = *this->lod;
+  }
+  if (this->index2 != NULL)
+  { copy->index2 = (cdb2_index_entry *)
+      malloc(this->seg_count * sizeof(cdb2_index_entry));
+    if (copy->index2 == NULL)
+    { perror("copy_of_cdb"); free_cdb(copy); return NULL; }
+    memcpy(copy->index2, this->index2,
+	   this->seg_count * sizeof(cdb2_index_entry));
+  }
 
 /*
  *	set current segment pointer
@@ -254,7 +700,15 @@ cdb_class *copy_of_cdb(cdb_class *this)
   }
   memcpy((void *)copy->data_buffer, (const void *)this->data_buffer, 
 	 (size_t)this->data_buffer_size);
-  copy->data_ptr = copy->data_buffer + (this->data_ptr - this->data_buffer);
+  if (NULL != this->map && NULL != this->data_ptr
+      && (byte1 *)this->data_ptr >= this->map
+      && (byte1 *)this->data_ptr < this->map + this->map_size)
+    copy->data_ptr = (cdb_seg_data *)
+      (copy->map + ((byte1 *)this->data_ptr - this->map));
+  else if (NULL == this->data_ptr)
+    copy->data_ptr = NULL;
+  else
+    copy->data_ptr = copy->data_buffer + (this->data_ptr - this->data_buffer);
 
 /*
  *	copy succeeded
@@ -267,11 +721,25 @@ cdb_class *copy_of_cdb(cdb_class *this)
  *
  *	input : this - pointer to cdb_class instance
  *
+ *	note  : a mapped file is already loaded, there is
+ *		nothing to read and no size limit
+ *
  *--------------------------------------------------------------------*/
 void load_all_seg_data_cdb(cdb_class *this)
 {
   register int ios;
 
+  if (2 == this->version)
+  { this->is_loaded = (NULL != this->map);
+    return;
+  }
+
+  if (NULL != this->map)
+  { this->is_loaded = TRUE;
+    this->get_data = cdb_read_map;
+    return;
+  }
+
   this->is_loaded = FALSE;
   this->get_data = cdb_read_disk;
 
@@ -364,7 +832,7 @@ static cdb_seg_data *cdb_read_disk(cdb_class *this)
  */
   fseek(this->fp, this->segment->addr, SEEK_SET);
   ios = fread(this->data_buffer, 1, this->segment->size, this->fp);
-  if (ios != this->segment->size)
+  if ((byte4)ios != this->segment->size)
   { fprintf(stderr,"load_current_seg_data_cdb: reading segment %d, expected %d got %d bytes.\n",
 	    this->segment->ID, this->segment->size, ios);
     perror(this->filename);
@@ -390,6 +858,120 @@ static cdb_seg_data *cdb_read_memory(cdb_class *this)
   return (cdb_seg_data *)offset;
 }
 
+/*
+ *	decode big-endian segment data into native order
+ */
+static void cdb_decode_data_buffer(cdb_seg_data *buffer, const byte1 *src,
+				   int npts)
+{
+  register int ipt;
+
+  for (ipt=0; ipt < npts; ipt++, src += 4)
+  { buffer[ipt].dlat = (int2)((src[0] << 8) | src[1]);
+    buffer[ipt].dlon = (int2)((src[2] << 8) | src[3]);
+  }
+}
+
+/*
+ *	find data in mapped file, decoding it into the data buffer
+ *	unless the disk format is already the native format
+ */
+static cdb_seg_data *cdb_read_map(cdb_class *this)
+{
+  register byte1 *offset;
+
+  if (this->segment->addr < CDB_FILE_HEADER_SIZE
+      || (long)this->segment->addr + this->segment->size > this->map_size)
+  { fprintf(stderr,"cdb_read_map: segment %d extends past end of <%s>.\n",
+	    this->segment->ID, this->filename);
+    return NULL;
+  }
+  offset = this->map + this->segment->addr;
+
+#ifndef LSB1ST
+  if (0 == this->segment->addr % sizeof(int2))
+    return (cdb_seg_data *)offset;
+#endif
+
+  if (this->segment->size > this->data_buffer_size)
+  { this->data_buffer = (cdb_seg_data *) realloc(this->data_buffer, 
+						 this->segment->size);
+    if (NULL == this->data_buffer) { return (cdb_seg_data *)NULL; }
+    this->data_buffer_size = this->segment->size;
+  }
+
+  cdb_decode_data_buffer(this->data_buffer, offset,
+			 this->segment->size/sizeof(cdb_seg_data));
+
+  return this->data_buffer;
+}
+
+/*
+ *	decode version 2 data, from the mapping or read from disk,
+ *	into the data buffer
+ */
+static cdb_seg_data *cdb_read_v2(cdb_class *this)
+{
+  cdb2_index_entry *where;
+  byte1 *code;
+  int npts;
+
+  if (this->segment->addr < 1 || this->segment->addr > (byte4)this->seg_count)
+  { fprintf(stderr,"cdb_read_v2: segment %d has no data in <%s>.\n",
+	    this->segment->ID, this->filename);
+    return NULL;
+  }
+  where = this->index2 + this->segment->addr - 1;
+  npts = this->segment->size/sizeof(cdb_seg_data);
+
+  if (this->segment->size > this->data_buffer_size)
+  { this->data_buffer = (cdb_seg_data *) realloc(this->data_buffer, 
+						 this->segment->size);
+    if (NULL == this->data_buffer) { return (cdb_seg_data *)NULL; }
+    this->data_buffer_size = this->segment->size;
+  }
+
+  if (NULL != this->map)
+  { if (where->addr < CDB2_FILE_HEADER_SIZE
+	|| where->addr + where->size > this->map_size)
+    { fprintf(stderr,"cdb_read_v2: segment %d extends past end of <%s>.\n",
+	      this->segment->ID, this->filename);
+      return NULL;
+    }
+    code = this->map + where->addr;
+  }
+  else
+  { if (where->size > this->code_buffer_size)
+    { this->code_buffer = (byte1 *)realloc(this->code_buffer, where->size);
+      if (NULL == this->code_buffer) { return (cdb_seg_data *)NULL; }
+      this->code_buffer_size = where->size;
+    }
+    code = this->code_buffer;
+    if (0 != fseek(this->fp, (long)where->addr, SEEK_SET)
+	|| fread(code, 1, where->size, this->fp) != where->size)
+    { fprintf(stderr,"cdb_read_v2: reading segment %d, expected %d bytes.\n",
+	      this->segment->ID, where->size);
+      perror(this->filename);
+      return NULL;
+    }
+  }
+
+  if ((this->flags & CDB2_CHECKSUM)
+      && cdb2_crc32(code, where->size) != where->checksum)
+  { fprintf(stderr,"cdb_read_v2: segment %d checksum error in <%s>.\n",
+	    this->segment->ID, this->filename);
+    return NULL;
+  }
+
+  if (!cdb2_decode(code, where->size, npts, this->data_buffer))
+  { fprintf(stderr,"cdb_read_v2: segment %d data is corrupt in <%s>.\n",
+	    this->segment->ID, this->filename);
+    return NULL;
+  }
+
+  return this->data_buffer;
+}
+
 /*
  *	load_current_seg_data_cdb method
  */
@@ -401,97 +983,269 @@ cdb_seg_data *load_current_seg_data_cdb(cdb_class *this)
 }
 
 /*----------------------------------------------------------------------
- * get_current_seg_cdb - retrieve current segment data points
+ * raw_seg_data_cdb - find current segment data without copying it
  *
  *	input : this - pointer to cdb_class instance
  *		this->segment points to current segment
- *		max_pts = size of lat,lon arrays
  *
- *	output: lat,lon - data points
+ *	output: big_endian - TRUE if the data are still in file order
  *
- *	result: N > 0 = number of points in lat,lon arrays
- *		0 = error reading data
- *		N < 0 = max_pts is too small, need -N points
+ *	result: pointer to npoints dlat,dlon pairs or NULL on error
+ *
+ *	note  : mapped version 1 data are used in place, everything
+ *		else is loaded by load_current_seg_data_cdb, in which
+ *		case data_ptr is set as usual, otherwise it is NULL
  *
  *--------------------------------------------------------------------*/
-int get_current_seg_cdb(cdb_class *this, double *lat, double *lon, int max_pts)
+static const byte1 *raw_seg_data_cdb(cdb_class *this, bool *big_endian)
 {
-  register cdb_seg_data *data;
-  register int ipt;
-  register double clat, clon;
-
-/*
- *	read segment point data
- */
-  data = load_current_seg_data_cdb(this);
-  if (data == NULL) return 0;
-
-/*
- *	check size of array
- */
-  if (max_pts < this->npoints+1) return -(this->npoints+1);
-
-/*
- *	convert delta data to lat,lon positions
- */
-  clat = this->segment->ilat0 * CDB_LAT_SCALE;
-  clon = this->segment->ilon0 * CDB_LON_SCALE;
-  lat[0] = clat;
-  lon[0] = clon;
-
-  for (ipt = 1; ipt <= this->npoints; data++, ipt++)
-  { clat += data->dlat * CDB_LAT_SCALE;
-    clon += data->dlon * CDB_LON_SCALE;
-    lat[ipt] = clat;
-    lon[ipt] = clon;
+  if (cdb_read_map == this->get_data)
+  { if (this->segment->addr < CDB_FILE_HEADER_SIZE
+	|| (long)this->segment->addr + this->segment->size > this->map_size)
+    { fprintf(stderr,"raw_seg_data_cdb: segment %d extends past end of <%s>.\n",
+	      this->segment->ID, this->filename);
+      return NULL;
+    }
+    this->data_ptr = NULL;
+    this->npoints = this->segment->size/sizeof(cdb_seg_data);
+    *big_endian = TRUE;
+    return this->map + this->segment->addr;
   }
 
-  return this->npoints+1;
+  *big_endian = FALSE;
+  return (const byte1 *)load_current_seg_data_cdb(this);
 }
 
 /*----------------------------------------------------------------------
- * draw_current_seg_cdb - draw current segment
+ * decode_seg_data_cdb - convert delta data to lat,lon positions
  *
- *	input : this - pointer to cdb_class instance
- *		this->segment points to current segment
- *              move_pu - move pen up function (returns TRUE on error)
- *              draw_pd - draw pen down function (returns TRUE on error)
+ *	input : data - npts dlat,dlon pairs
+ *		npts - number of pairs
+ *		big_endian - TRUE for pairs in file order (version 1),
+ *			     FALSE for native cdb_seg_data
+ *		ilat0,ilon0 - segment start point
  *
- *	result: 0 = normal successful completion
- *		-1 = error occurred
+ *	output: lat,lon - npts+1 positions, starting with ilat0,ilon0
+ *
+ *	note  : the deltas are summed as integers, then scaled, which
+ *		is exact because the scale is a power of two, with SSE2
+ *		little-endian machines do four points at a time, swapping
+ *		bytes as they go
+ *
+ *--------------------------------------------------------------------*/
+void decode_seg_data_cdb(const byte1 *data, int npts, bool big_endian,
+			 int4 ilat0, int4 ilon0, double *lat, double *lon)
+{
+  register int ipt;
+  register int4 clat, clon;
+  const cdb_seg_data *pair;
+#if defined(__SSE2__) && defined(LSB1ST)
+  __m128i v, dlat, dlon, last_lat, last_lon;
+  __m128d lat_scale, lon_scale;
+#endif
+
+  lat[0] = ilat0 * CDB_LAT_SCALE;
+  lon[0] = ilon0 * CDB_LON_SCALE;
+  ++lat;
+  ++lon;
+  ipt = 0;
+
+#if defined(__SSE2__) && defined(LSB1ST)
+  last_lat = _mm_set1_epi32(ilat0);
+  last_lon = _mm_set1_epi32(ilon0);
+  lat_scale = _mm_set1_pd(CDB_LAT_SCALE);
+  lon_scale = _mm_set1_pd(CDB_LON_SCALE);
+
+  for (; ipt + 4 <= npts; ipt += 4, data += 4*sizeof(cdb_seg_data))
+  { v = _mm_loadu_si128((const __m128i *)data);
+    if (big_endian) v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+
+/*
+ *	sign extend each int2 to int4, then running sums
+ */
+    dlat = _mm_srai_epi32(_mm_slli_epi32(v, 16), 16);
+    dlon = _mm_srai_epi32(v, 16);
+    dlat = _mm_add_epi32(dlat, _mm_slli_si128(dlat, 4));
+    dlon = _mm_add_epi32(dlon, _mm_slli_si128(dlon, 4));
+    dlat = _mm_add_epi32(dlat, _mm_slli_si128(dlat, 8));
+    dlon = _mm_add_epi32(dlon, _mm_slli_si128(dlon, 8));
+    dlat = _mm_add_epi32(dlat, last_lat);
+    dlon = _mm_add_epi32(dlon, last_lon);
+    last_lat = _mm_shuffle_epi32(dlat, 0xff);
+    last_lon = _mm_shuffle_epi32(dlon, 0xff);
+
+    _mm_storeu_pd(lat + ipt, _mm_mul_pd(_mm_cvtepi32_pd(dlat), lat_scale));
+    _mm_storeu_pd(lat + ipt + 2, 
+		  _mm_mul_pd(_mm_cvtepi32_pd(_mm_unpackhi_epi64(dlat, dlat)),
+			     lat_scale));
+    _mm_storeu_pd(lon + ipt, _mm_mul_pd(_mm_cvtepi32_pd(dlon), lon_scale));
+    _mm_storeu_pd(lon + ipt + 2, 
+		  _mm_mul_pd(_mm_cvtepi32_pd(_mm_unpackhi_epi64(dlon, dlon)),
+			     lon_scale));
+  }
+  clat = _mm_cvtsi128_si32(last_lat);
+  clon = _mm_cvtsi128_si32(last_lon);
+#else
+  clat = ilat0;
+  clon = ilon0;
+#endif
+
+/*
+ *	remaining points
+ */
+  if (big_endian)
+  { for (; ipt < npts; ipt++, data += sizeof(cdb_seg_data))
+    { clat += (int2)((data[0] << 8) | data[1]);
+      clon += (int2)((data[2] << 8) | data[3]);
+      lat[ipt] = clat * CDB_LAT_SCALE;
+      lon[ipt] = clon * CDB_LON_SCALE;
+    }
+  }
+  else
+  { for (pair = (const cdb_seg_data *)data; ipt < npts; ipt++, pair++)
+    { clat += pair->dlat;
+      clon += pair->dlon;
+      lat[ipt] = clat * CDB_LAT_SCALE;
+      lon[ipt] = clon * CDB_LON_SCALE;
+    }
+  }
+}
+
+/*----------------------------------------------------------------------
+ * get_current_seg_cdb - retrieve current segment data points
+ *
+ *	input : this - pointer to cdb_class instance
+ *		this->segment points to current segment
+ *		max_pts = size of lat,lon arrays
+ *
+ *	output: lat,lon - data points
+ *
+ *	result: N > 0 = number of points in lat,lon arrays
+ *		0 = error reading data
+ *		N < 0 = max_pts is too small, need -N points
+ *
+ *--------------------------------------------------------------------*/
+int get_current_seg_cdb(cdb_class *this, double *lat, double *lon, int max_pts)
+{
+  const byte1 *data;
+  bool big_endian;
+
+/*
+ *	find segment point data
+ */
+  data = raw_seg_data_cdb(this, &big_endian);
+  if (data == NULL) return 0;
+
+/*
+ *	check size of array
+ */
+  if (max_pts < this->npoints+1) return -(this->npoints+1);
+
+/*
+ *	convert delta data to lat,lon positions
+ */
+  decode_seg_data_cdb(data, this->npoints, big_endian,
+		      this->segment->ilat0, this->segment->ilon0, lat, lon);
+
+  return this->npoints+1;
+}
+
+/*----------------------------------------------------------------------
+ * draw_current_seg_cdb - draw current segment
+ *
+ *	input : this - pointer to cdb_class instance
+ *		this->segment points to current segment
+ *              move_pu - move pen up function (returns TRUE on error)
+ *              draw_pd - draw pen down function (returns TRUE on error)
+ *
+ *	result: 0 = normal successful completion
+ *		-1 = error occurred
  *
  *--------------------------------------------------------------------*/
 int draw_current_seg_cdb(cdb_class *this,
 			 int (*move_pu)(double lat, double lon), 
 			 int (*draw_pd)(double lat, double lon))
 {
-  register int ipt;
-  register cdb_seg_data *data;
-  register double lat, lon;
+  register int ipt, iblock, nblock;
+  const byte1 *data;
+  bool big_endian;
+  int4 ilat, ilon;
+  double lat[CDB_DRAW_BLOCK+1], lon[CDB_DRAW_BLOCK+1];
 
 /*
- *	read segment point data
+ *	find segment point data
  */
-  data = load_current_seg_data_cdb(this);
+  data = raw_seg_data_cdb(this, &big_endian);
   if (data == NULL) return -1;
 
 /*
  *	call move pen up function for the current segment
  */
-  lat = this->segment->ilat0 * CDB_LAT_SCALE;
-  lon = this->segment->ilon0 * CDB_LON_SCALE;
-  if (move_pu != NULL) if (move_pu(lat, lon)) return -1;
+  ilat = this->segment->ilat0;
+  ilon = this->segment->ilon0;
+  if (move_pu != NULL) 
+    if (move_pu(ilat * CDB_LAT_SCALE, ilon * CDB_LON_SCALE)) return -1;
 
 /*
- *	call draw pen down for each point
+ *	call draw pen down for each point, decoding a block at a time
  */
   if (draw_pd != NULL)
-  {  for (ipt = 0; ipt < this->npoints; data++, ipt++)
-     { lat += data->dlat * CDB_LAT_SCALE;
-       lon += data->dlon * CDB_LON_SCALE;
-       if (draw_pd(lat, lon)) return -1;
-     }
-   }
+  { for (iblock = 0; iblock < this->npoints; iblock += nblock)
+    { nblock = this->npoints - iblock;
+      if (nblock > CDB_DRAW_BLOCK) nblock = CDB_DRAW_BLOCK;
+      decode_seg_data_cdb(data + iblock*sizeof(cdb_seg_data), nblock,
+			  big_endian, ilat, ilon, lat, lon);
+      for (ipt = 1; ipt <= nblock; ipt++)
+	if (draw_pd(lat[ipt], lon[ipt])) return -1;
+      ilat = (int4)(lat[nblock] / CDB_LAT_SCALE); /* exact */
+      ilon = (int4)(lon[nblock] / CDB_LON_SCALE);
+    }
+  }
+
+  return 0;
+}
+
+/*----------------------------------------------------------------------
+ * draw_current_seg_polyline_cdb - draw current segment as a polyline
+ *
+ *	input : this - pointer to cdb_class instance
+ *		this->segment points to current segment
+ *              polyline - polyline function, called once with the
+ *			number of points and the decoded lat,lon arrays
+ *			(returns TRUE on error)
+ *
+ *	result: 0 = normal successful completion
+ *		-1 = error occurred
+ *
+ *	note  : the arrays belong to this and are only valid until
+ *		the next call, the polyline function may modify them
+ *
+ *--------------------------------------------------------------------*/
+int draw_current_seg_polyline_cdb(cdb_class *this,
+				  int (*polyline)(int npts, 
+						  double *lat, double *lon))
+{
+  int npts, new_size;
+  double *new_lat, *new_lon;
+
+  npts = get_current_seg_cdb(this, this->seg_lat, this->seg_lon, 
+			     this->seg_size);
+  if (npts < 0)
+  { new_size = -npts;
+    new_lat = (double *)realloc(this->seg_lat, new_size * sizeof(double));
+    if (new_lat != NULL) this->seg_lat = new_lat;
+    new_lon = (double *)realloc(this->seg_lon, new_size * sizeof(double));
+    if (new_lon != NULL) this->seg_lon = new_lon;
+    if (new_lat == NULL || new_lon == NULL)
+    { perror("draw_current_seg_polyline_cdb"); return -1; }
+    this->seg_size = new_size;
+    npts = get_current_seg_cdb(this, this->seg_lat, this->seg_lon, 
+			       this->seg_size);
+  }
+  if (npts <= 0) return -1;
+
+  if (polyline != NULL) if (polyline(npts, this->seg_lat, this->seg_lon)) 
+    return -1;
 
   return 0;
 }
@@ -529,14 +1283,27 @@ void list_cdb(cdb_class *this, int verbose)
   printf("// %d segments of rank %d, sorted in %s order\n", this->seg_count, 
 	 this->header->segment_rank, 
 	 cdb_list_printable(this->header->index_order));
-  printf("// %d index bytes at %d\n", this->header->index_size, 
-	 this->header->index_addr);
+  if (2 == this->version)
+    printf("// version 2, %ld index bytes at %lld%s\n",
+	   (long)this->seg_count * CDB2_INDEX_ENTRY_SIZE,
+	   (long long)this->index_addr,
+	   this->flags & CDB2_CHECKSUM ? ", checksummed" : "");
+  else
+    printf("// %d index bytes at %d\n", this->header->index_size, 
+	   this->header->index_addr);
   printf("// index currently sorted in %s order\n", 
 	 cdb_list_printable(this->index_order));
   printf("// max data segment size = %d bytes\n", this->header->max_seg_size);
   printf("// maximum extent in latitude = %5.3f, longitude = %5.3f.\n", 
 	 this->header->ilat_extent*CDB_LAT_SCALE,
 	 this->header->ilon_extent*CDB_LON_SCALE);
+  if (NULL != this->lod && this->lod->count > 0)
+  { printf("// %d level%s of detail thinned to", this->lod->count,
+	   this->lod->count == 1 ? "" : "s");
+    for (i = 0; i < (int)this->lod->count; i++)
+      printf(" %.3f", this->lod->tolerance[i]*0.001);
+    printf(" km\n");
+  }
 
 /*
  *	list segment index entries
@@ -548,12 +1315,15 @@ void list_cdb(cdb_class *this, int verbose)
     printf("//  ID     lat    lon      min    max     min     max      npts     address\n");
     printf("// -----  ------ -------  ------ ------  ------- -------  -------  ----------\n");
     for (i=1, seg=this->index; i <= this->seg_count; i++, seg++) 
-    { printf("// %5d  %6.2f %7.2f  %6.2f %6.2f  %7.2f %7.2f  %7d  %10d\n", 
+    { printf("// %5d  %6.2f %7.2f  %6.2f %6.2f  %7.2f %7.2f  %7d  %10lld\n", 
 	     seg->ID,
 	     seg->ilat0*CDB_LAT_SCALE, seg->ilon0*CDB_LAT_SCALE,
 	     seg->ilat_min*CDB_LAT_SCALE, seg->ilat_max*CDB_LON_SCALE,
 	     seg->ilon_min*CDB_LAT_SCALE, seg->ilon_max*CDB_LON_SCALE,
-	     seg->size/sizeof(cdb_seg_data), seg->addr);
+	     seg->size/sizeof(cdb_seg_data),
+	     2 == this->version && seg->addr >= 1 
+	     && seg->addr <= (byte4)this->seg_count
+	     ? (long long)this->index2[seg->addr-1].addr : (long long)seg->addr);
     }
   }
 }
@@ -646,6 +1416,11 @@ void sort_index_cdb(cdb_class *this, cdb_index_sort order)
 
   this->index_order = order;
 
+/*
+ *	box query tree refers to index positions
+ */
+  free_rtree_cdb(this);
+
 }
 
 /*----------------------------------------------------------------------
@@ -932,3 +1707,941 @@ int draw_cdb(cdb_class *this, double start, double stop, cdb_index_sort order,
 
   return 0;
 }
+
+/*----------------------------------------------------------------------
+ * find_box_cdb - find all segments whose bounds intersect a box
+ *
+ *	input : this - pointer to cdb_class instance
+ *		south, north - latitude bounds
+ *		west, east - longitude bounds, if west > east
+ *			the box crosses 180, if west == east
+ *			all longitudes are included
+ *		max_found - size of found array
+ *
+ *	output: found - pointers to index entries in index order
+ *
+ *	result: number of segments found, 0 for an empty cdb,
+ *		or -(number found) if more than max_found
+ *		in which case found is filled with the first max_found
+ *
+ *	note  : the first call builds an R-tree over the segment
+ *		bounds, each query then takes logarithmic time in
+ *		the number of segments. The index is not sorted
+ *		or otherwise changed.
+ *
+ *--------------------------------------------------------------------*/
+
+/*
+ *	sort keys for packing, twice the center of a box
+ */
+static int cdb_rtree_lon_center(cdb_rtree_node *node1, cdb_rtree_node *node2)
+{
+  int4 key1 = node1->ilon_min + node1->ilon_max;
+  int4 key2 = node2->ilon_min + node2->ilon_max;
+
+  if (key1 != key2) return key1 < key2 ? -1 : 1;
+  return node1->first - node2->first;
+}
+
+static int cdb_rtree_lat_center(cdb_rtree_node *node1, cdb_rtree_node *node2)
+{
+  int4 key1 = node1->ilat_min + node1->ilat_max;
+  int4 key2 = node2->ilat_min + node2->ilat_max;
+
+  if (key1 != key2) return key1 < key2 ? -1 : 1;
+  return node1->first - node2->first;
+}
+
+/*
+ *	sort-tile-recursive packing of one tree level
+ *	reorders in[] so each parent's children are contiguous,
+ *	parent first is relative to the start of in[]
+ */
+static int cdb_rtree_pack(cdb_rtree_node *in, int count, cdb_rtree_node *out)
+{
+  int ii, jj, num_parents, num_slices, slice_size, num_out;
+  cdb_rtree_node *parent;
+
+  num_parents = (count + CDB_RTREE_FANOUT - 1) / CDB_RTREE_FANOUT;
+  num_slices = (int)ceil(sqrt((double)num_parents));
+  slice_size = num_slices * CDB_RTREE_FANOUT;
+
+  qsort(in, count, sizeof(cdb_rtree_node), 
+	(int (*)(const void *, const void *))cdb_rtree_lon_center);
+  for (ii = 0; ii < count; ii += slice_size)
+    qsort(in + ii, count - ii < slice_size ? count - ii : slice_size,
+	  sizeof(cdb_rtree_node),
+	  (int (*)(const void *, const void *))cdb_rtree_lat_center);
+
+  for (num_out = 0, ii = 0; ii < count; ii += CDB_RTREE_FANOUT, num_out++)
+  { parent = out + num_out;
+    *parent = in[ii];
+    parent->first = ii;
+    parent->count = count - ii < CDB_RTREE_FANOUT 
+      ? count - ii : CDB_RTREE_FANOUT;
+    for (jj = ii + 1; jj < ii + parent->count; jj++)
+    { if (in[jj].ilat_min < parent->ilat_min) parent->ilat_min = in[jj].ilat_min;
+      if (in[jj].ilat_max > parent->ilat_max) parent->ilat_max = in[jj].ilat_max;
+      if (in[jj].ilon_min < parent->ilon_min) parent->ilon_min = in[jj].ilon_min;
+      if (in[jj].ilon_max > parent->ilon_max) parent->ilon_max = in[jj].ilon_max;
+    }
+  }
+
+  return num_out;
+}
+
+/*
+ *	build tree over the current index order
+ */
+static cdb_rtree *build_rtree_cdb(cdb_class *this)
+{
+  int ii, count, total, base;
+  cdb_rtree *tree;
+  cdb_rtree_node *leaf_box;
+  cdb_index_entry *seg;
+
+  for (total = 0, count = this->seg_count; ; )
+  { count = (count + CDB_RTREE_FANOUT - 1) / CDB_RTREE_FANOUT;
+    total += count;
+    if (count <= 1) break;
+  }
+
+  tree = (cdb_rtree *)calloc(1, sizeof(cdb_rtree));
+  leaf_box = (cdb_rtree_node *)calloc(this->seg_count, sizeof(cdb_rtree_node));
+  if (tree) tree->node = (cdb_rtree_node *)calloc(total, sizeof(cdb_rtree_node));
+  if (tree) tree->item = (int *)calloc(this->seg_count, sizeof(int));
+  if (!tree || !leaf_box || !tree->node || !tree->item)
+  { perror("build_rtree_cdb");
+    if (tree) { free(tree->node); free(tree->item); free(tree); }
+    free(leaf_box);
+    return NULL;
+  }
+
+/*
+ *	leaf level, one box per segment
+ */
+  for (ii = 0, seg = this->index; ii < this->seg_count; ii++, seg++)
+  { leaf_box[ii].ilat_min = seg->ilat_min;
+    leaf_box[ii].ilat_max = seg->ilat_max;
+    leaf_box[ii].ilon_min = seg->ilon_min;
+    leaf_box[ii].ilon_max = seg->ilon_max;
+    leaf_box[ii].first = ii;
+    leaf_box[ii].count = 0;
+  }
+  tree->leaf_count = cdb_rtree_pack(leaf_box, this->seg_count, tree->node);
+  for (ii = 0; ii < this->seg_count; ii++) tree->item[ii] = leaf_box[ii].first;
+  free(leaf_box);
+
+/*
+ *	pack each level into the next until one node is left
+ */
+  base = 0;
+  count = tree->leaf_count;
+  while (count > 1)
+  { ii = cdb_rtree_pack(tree->node + base, count, tree->node + base + count);
+    for (total = base + count; total < base + count + ii; total++)
+      tree->node[total].first += base;
+    base += count;
+    count = ii;
+  }
+  tree->node_count = base + count;
+
+  return tree;
+}
+
+static void free_rtree_cdb(cdb_class *this)
+{
+  if (this->rtree == NULL) return;
+  free(this->rtree->node);
+  free(this->rtree->item);
+  free(this->rtree);
+  this->rtree = NULL;
+}
+
+/*
+ *	longitude intervals intersect, allowing for wrap around
+ */
+#define CDB_ILON_TURN ((int4)(360/CDB_LON_SCALE))
+
+static int cdb_lon_overlap(int4 lon_min, int4 lon_max, int4 west, int4 east)
+{
+  return (lon_max >= west && lon_min <= east)
+    || (lon_max >= west - CDB_ILON_TURN && lon_min <= east - CDB_ILON_TURN)
+    || (lon_max >= west + CDB_ILON_TURN && lon_min <= east + CDB_ILON_TURN);
+}
+
+static int cdb_compare_position(int *pos1, int *pos2)
+{
+  return *pos1 - *pos2;
+}
+
+/*
+ *	find method
+ */
+int find_box_cdb(cdb_class *this, double south, double north,
+		 double west, double east,
+		 cdb_index_entry **found, int max_found)
+{
+  int stack[CDB_RTREE_FANOUT*32];
+  int *position;
+  int top, ii, num_found, all_lon;
+  int4 ilat_south, ilat_north, ilon_west, ilon_east;
+  cdb_rtree_node *node;
+  cdb_index_entry *seg;
+
+/*
+ *	no segments, no tree
+ */
+  if (this->seg_count <= 0) return 0;
+
+  if (this->rtree == NULL)
+  { this->rtree = build_rtree_cdb(this);
+    if (this->rtree == NULL) return 0;
+  }
+
+/*
+ *	set up query box in file units
+ */
+  ilat_south = (int4)floor(south/CDB_LAT_SCALE);
+  ilat_north = (int4)ceil(north/CDB_LAT_SCALE);
+  all_lon = (east - west >= 360 || east - west <= -360);
+  normalize_lon_cdb(west);
+  normalize_lon_cdb(east);
+  if (west == east) all_lon = TRUE;
+  if (east < west) east += 360;
+  ilon_west = (int4)floor(west/CDB_LON_SCALE);
+  ilon_east = (int4)ceil(east/CDB_LON_SCALE);
+
+  position = (int *)malloc(this->seg_count * sizeof(int));
+  if (position == NULL) { perror("find_box_cdb"); return 0; }
+
+/*
+ *	depth first search from the root
+ */
+  num_found = 0;
+  top = 0;
+  stack[top++] = this->rtree->node_count - 1;
+  while (top > 0)
+  { node = this->rtree->node + stack[--top];
+    if (node->ilat_max < ilat_south || node->ilat_min > ilat_north) continue;
+    if (!all_lon && !cdb_lon_overlap(node->ilon_min, node->ilon_max,
+				     ilon_west, ilon_east)) continue;
+
+    if (node - this->rtree->node < this->rtree->leaf_count)
+    { for (ii = node->first; ii < node->first + node->count; ii++)
+      { seg = this->index + this->rtree->item[ii];
+	if (seg->ilat_max < ilat_south || seg->ilat_min > ilat_north) continue;
+	if (!all_lon && !cdb_lon_overlap(seg->ilon_min, seg->ilon_max,
+					 ilon_west, ilon_east)) continue;
+	position[num_found++] = this->rtree->item[ii];
+      }
+    }
+    else
+    { for (ii = node->first + node->count - 1; ii >= node->first; ii--)
+	stack[top++] = ii;
+    }
+  }
+
+/*
+ *	return entries in index order
+ */
+  qsort(position, num_found, sizeof(int), 
+	(int (*)(const void *, const void *))cdb_compare_position);
+  for (ii = 0; ii < num_found && ii < max_found; ii++)
+    found[ii] = this->index + position[ii];
+  free(position);
+
+  return num_found <= max_found ? num_found : -num_found;
+}
+
+/*----------------------------------------------------------------------
+ * draw_box_cdb - draw all segments intersecting a box
+ *
+ *	input : this - pointer to cdb_class instance
+ *		south, north, west, east - bounds, as for find_box_cdb
+ *		tolerance - acceptable error in kilometers, usually
+ *			about the size of an output cell, 0 draws
+ *			the full resolution data
+ *              move_pu - move pen up function (returns TRUE on error)
+ *              draw_pd - draw pen down function (returns TRUE on error)
+ *
+ *	result: 0 = success, -1 = error
+ *
+ *	effect: calls draw_current_seg_cdb for each segment found
+ *		in the level of detail picked by select_lod_cdb,
+ *		in index order, unlike draw_cdb the index is not sorted
+ *
+ *--------------------------------------------------------------------*/
+static int draw_found_cdb(cdb_class *this, double south, double north,
+			  double west, double east, double tolerance,
+			  int (*move_pu)(double lat, double lon), 
+			  int (*draw_pd)(double lat, double lon),
+			  int (*polyline)(int npts, double *lat, double *lon))
+{
+  int ii, num_found, status;
+  cdb_index_entry **found;
+
+  this = select_lod_cdb(this, tolerance);
+  if (this->seg_count <= 0) return 0;
+
+  found = (cdb_index_entry **)malloc(this->seg_count 
+				     * sizeof(cdb_index_entry *));
+  if (found == NULL) { perror("draw_box_cdb"); return -1; }
+
+  num_found = find_box_cdb(this, south, north, west, east, 
+			   found, this->seg_count);
+
+  for (ii = 0; ii < num_found; ii++)
+  { set_current_seg_cdb(this, found[ii]);
+    if (polyline != NULL)
+      status = draw_current_seg_polyline_cdb(this, polyline);
+    else
+      status = draw_current_seg_cdb(this, move_pu, draw_pd);
+    if (status) { free(found); return -1; }
+  }
+
+  free(found);
+  return 0;
+}
+
+int draw_box_cdb(cdb_class *this, double south, double north,
+		 double west, double east, double tolerance,
+		 int (*move_pu)(double lat, double lon), 
+		 int (*draw_pd)(double lat, double lon))
+{
+  return draw_found_cdb(this, south, north, west, east, tolerance,
+			move_pu, draw_pd, NULL);
+}
+
+/*----------------------------------------------------------------------
+ * draw_box_polyline_cdb - draw all segments intersecting a box
+ *			   as polylines
+ *
+ *	input : this - pointer to cdb_class instance
+ *		south, north, west, east, tolerance - as for draw_box_cdb
+ *              polyline - polyline function (returns TRUE on error)
+ *
+ *	result: 0 = success, -1 = error
+ *
+ *	effect: calls draw_current_seg_polyline_cdb for each segment
+ *		found, in the same order as draw_box_cdb
+ *
+ *--------------------------------------------------------------------*/
+int draw_box_polyline_cdb(cdb_class *this, double south, double north,
+			  double west, double east, double tolerance,
+			  int (*polyline)(int npts, double *lat, double *lon))
+{
+  return draw_found_cdb(this, south, north, west, east, tolerance,
+			NULL, NULL, polyline);
+}
+
+/*----------------------------------------------------------------------
+ * select_lod_cdb - pick level of detail for a given tolerance
+ *
+ *	input : this - pointer to cdb_class instance
+ *		tolerance - acceptable error in kilometers
+ *
+ *	result: the coarsest level of detail thinned to no more
+ *		than tolerance, or this if there is none
+ *
+ *	note  : each level is a cdb_class instance sharing the
+ *		mapping of this, it is set up on first use and
+ *		freed along with this
+ *
+ *--------------------------------------------------------------------*/
+static cdb_class *init_lod_level_cdb(cdb_class *this, int ilod)
+{
+  cdb_class *level;
+
+  level = new_cdb();
+  if (NULL == level) return NULL;
+  level->parent = this;
+  level->filename = strdup(this->filename);
+  level->map = this->map + this->lod->addr[ilod];
+  level->map_size = this->map_size - this->lod->addr[ilod];
+  if (NULL == level->filename || !read_index_cdb(level))
+  { fprintf(stderr,"select_lod_cdb: <%s> level %d unusable\n",
+	    this->filename, ilod+1);
+    free_cdb(level);
+    return NULL;
+  }
+
+  return level;
+}
+
+cdb_class *select_lod_cdb(cdb_class *this, double tolerance)
+{
+  register int ilod, best;
+
+  if (NULL == this->lod) return this;
+
+  for (best = -1, ilod = 0; ilod < (int)this->lod->count; ilod++)
+  { if (this->lod->tolerance[ilod] > tolerance*1000) continue;
+    if (best < 0 || this->lod->tolerance[ilod] > this->lod->tolerance[best])
+      best = ilod;
+  }
+  if (best < 0) return this;
+
+  if (NULL == this->lod_level[best])
+  { this->lod_level[best] = init_lod_level_cdb(this, best);
+    if (NULL == this->lod_level[best])
+    { this->lod->count = best;
+      return select_lod_cdb(this, tolerance);
+    }
+  }
+
+  return this->lod_level[best];
+}
+
+/*----------------------------------------------------------------------
+ * write_cdb - write a copy of a cdb file
+ *
+ *	input : this - pointer to cdb_class instance
+ *		filename - new file
+ *		version - 1 or 2, file format to write
+ *		flags - CDB2_CHECKSUM to checksum version 2 data
+ *
+ *	result: 0 = success, -1 = error
+ *
+ *	note  : segments are written in the current index order,
+ *		every segment is copied exactly, levels of detail
+ *		are not copied. Version 1 files must be less than
+ *		4 GB.
+ *
+ *--------------------------------------------------------------------*/
+int write_cdb(cdb_class *this, const char *filename, int version, int flags)
+{
+  FILE *fp = NULL;
+  int iseg, npts, max_points = 0, status = -1;
+  long code_size;
+  NSIDCint8 addr, limit;
+  cdb_seg_data *data, *swapped = NULL;
+  cdb_index_entry *seg, *index = NULL;
+  cdb_file_header header;
+  byte1 head[CDB2_FILE_HEADER_SIZE], *entry, *index2 = NULL, *code = NULL;
+
+  if (1 != version && 2 != version)
+  { fprintf(stderr,"write_cdb: can not write cdb version %d\n", version);
+    return -1;
+  }
+
+  fp = fopen(filename, "w");
+  if (NULL == fp) { perror(filename); return -1; }
+
+  if (1 == version)
+  { index = (cdb_index_entry *)calloc(this->seg_count, 
+				       sizeof(cdb_index_entry));
+    swapped = (cdb_seg_data *)malloc(this->header->max_seg_size + 1);
+    if (NULL == index || NULL == swapped) 
+    { perror("write_cdb"); goto cleanup; }
+    addr = CDB_FILE_HEADER_SIZE;
+    limit = 0xffffffffU;
+  }
+  else
+  { index2 = (byte1 *)calloc(this->seg_count, CDB2_INDEX_ENTRY_SIZE);
+    code = (byte1 *)malloc(6 * (this->header->max_seg_size 
+				/ sizeof(cdb_seg_data)) + 1);
+    if (NULL == index2 || NULL == code) 
+    { perror("write_cdb"); goto cleanup; }
+    addr = CDB2_FILE_HEADER_SIZE;
+    limit = ((NSIDCbyte8)1 << 62);
+  }
+
+/*
+ *	reserve space for the header
+ */
+  memset(head, 0, sizeof(head));
+  if (fwrite(head, 1, version == 1 ? CDB_FILE_HEADER_SIZE 
+	     : CDB2_FILE_HEADER_SIZE, fp) != (version == 1
+	     ? CDB_FILE_HEADER_SIZE : CDB2_FILE_HEADER_SIZE))
+  { perror(filename); goto cleanup; }
+
+/*
+ *	copy each segment
+ */
+  for (iseg = 0, seg = this->index; iseg < this->seg_count; iseg++, seg++)
+  { this->segment = seg;
+    data = load_current_seg_data_cdb(this);
+    if (NULL == data) goto cleanup;
+    npts = this->npoints;
+    if (npts > max_points) max_points = npts;
+
+    if (1 == version)
+    { index[iseg] = *seg;
+      index[iseg].addr = (byte4)addr;
+      memcpy(swapped, data, npts * sizeof(cdb_seg_data));
+      cdb_byteswap_data_buffer(swapped, npts);
+      if (fwrite(swapped, sizeof(cdb_seg_data), npts, fp) != (size_t)npts)
+      { perror(filename); goto cleanup; }
+      addr += npts * sizeof(cdb_seg_data);
+    }
+    else
+    { code_size = cdb2_encode(data, npts, code);
+
+/*
+ *	keep segments within a block or starting on one
+ */
+      while (code_size > 0 
+	     && (code_size > CDB2_BLOCK_SIZE 
+		 ? addr % CDB2_BLOCK_SIZE != 0
+		 : addr / CDB2_BLOCK_SIZE 
+		 != (addr + code_size - 1) / CDB2_BLOCK_SIZE))
+      { if (EOF == putc(0, fp)) { perror(filename); goto cleanup; }
+	++addr;
+      }
+
+      entry = index2 + (long)iseg * CDB2_INDEX_ENTRY_SIZE;
+      cdb2_put4(entry, seg->ID);
+      cdb2_put4(entry + 4, (byte4)seg->ilat0);
+      cdb2_put4(entry + 8, (byte4)seg->ilon0);
+      cdb2_put4(entry + 12, (byte4)seg->ilat_max);
+      cdb2_put4(entry + 16, (byte4)seg->ilon_max);
+      cdb2_put4(entry + 20, (byte4)seg->ilat_min);
+      cdb2_put4(entry + 24, (byte4)seg->ilon_min);
+      cdb2_put4(entry + 28, (byte4)npts);
+      cdb2_put8(entry + 32, addr);
+      cdb2_put4(entry + 40, (byte4)code_size);
+      cdb2_put4(entry + 44, flags & CDB2_CHECKSUM 
+		? cdb2_crc32(code, code_size) : 0);
+      if (fwrite(code, 1, code_size, fp) != (size_t)code_size)
+      { perror(filename); goto cleanup; }
+      addr += code_size;
+    }
+
+    if (addr > limit)
+    { fprintf(stderr,"write_cdb: <%s> is too big for cdb version %d\n",
+	      filename, version);
+      goto cleanup;
+    }
+  }
+
+/*
+ *	write index then go back and write header
+ */
+  if (1 == version)
+  { header = *this->header;
+    header.code_number = CDB_MAGIC_NUMBER;
+    header.index_addr = (byte4)addr;
+    header.index_size = this->seg_count * sizeof(cdb_index_entry);
+    header.max_seg_size = max_points * sizeof(cdb_seg_data);
+    header.index_order = this->index_order;
+    if (addr + header.index_size > limit)
+    { fprintf(stderr,"write_cdb: <%s> is too big for cdb version 1\n",
+	      filename);
+      goto cleanup;
+    }
+    cdb_byteswap_index(index, this->seg_count);
+    if (fwrite(index, sizeof(cdb_index_entry), this->seg_count, fp)
+	!= (size_t)this->seg_count)
+    { perror(filename); goto cleanup; }
+    cdb_byteswap_header(&header);
+    if (0 != fseek(fp, 0L, SEEK_SET)
+	|| fwrite(&header, 1, CDB_FILE_HEADER_SIZE, fp) != CDB_FILE_HEADER_SIZE)
+    { perror(filename); goto cleanup; }
+  }
+  else
+  { if (fwrite(index2, CDB2_INDEX_ENTRY_SIZE, this->seg_count, fp)
+	!= (size_t)this->seg_count)
+    { perror(filename); goto cleanup; }
+    cdb2_put4(head, CDB2_MAGIC_NUMBER);
+    cdb2_put4(head + 4, 2);
+    cdb2_put4(head + 8, flags & CDB2_CHECKSUM);
+    cdb2_put4(head + 12, CDB2_BLOCK_SIZE);
+    cdb2_put8(head + 16, addr);
+    cdb2_put8(head + 24, (NSIDCint8)this->seg_count * CDB2_INDEX_ENTRY_SIZE);
+    cdb2_put4(head + 32, this->seg_count);
+    cdb2_put4(head + 36, max_points);
+    cdb2_put4(head + 40, this->header->segment_rank);
+    cdb2_put4(head + 44, this->index_order);
+    cdb2_put4(head + 48, (byte4)this->header->ilat_max);
+    cdb2_put4(head + 52, (byte4)this->header->ilon_max);
+    cdb2_put4(head + 56, (byte4)this->header->ilat_min);
+    cdb2_put4(head + 60, (byte4)this->header->ilon_min);
+    cdb2_put4(head + 64, (byte4)this->header->ilat_extent);
+    cdb2_put4(head + 68, (byte4)this->header->ilon_extent);
+    memcpy(head + 72, this->header->text, sizeof(this->header->text));
+    if (0 != fseek(fp, 0L, SEEK_SET)
+	|| fwrite(head, 1, CDB2_FILE_HEADER_SIZE, fp) != CDB2_FILE_HEADER_SIZE)
+    { perror(filename); goto cleanup; }
+  }
+
+  status = 0;
+
+ cleanup:
+  if (NULL != fp && 0 != fclose(fp)) { perror(filename); status = -1; }
+  if (index) free(index);
+  if (swapped) free(swapped);
+  if (index2) free(index2);
+  if (code) free(code);
+  reset_current_seg_cdb(this);
+  return status;
+}
+
+#ifdef CDBTEST
+#define usage "usage: cdbtest [cdb_file]"
+/*------------------------------------------------------------------------
+ * cdbtest - regression test cdb routines
+ *
+ *	without a cdb_file a random version 1 file is written first.
+ *	Each segment of a version 1 file is checked against a plain
+ *	stdio read of the file, then the file is copied to versions
+ *	1 and 2 and every segment of the copies is checked against
+ *	the original. Box queries on each are checked against a
+ *	linear scan of the index, and an empty cdb must find nothing.
+ *	Any difference is reported and the exit status is failure.
+ *------------------------------------------------------------------------*/
+#define CDBTEST_SEGMENTS 500
+#define CDBTEST_MAX_DELTAS 300
+#define CDBTEST_DELTA 300
+#define CDBTEST_BOXES 2000
+
+static int random_int(int lo, int hi)
+{
+  return lo + (int)((hi - lo + 1.0) * (rand() / (RAND_MAX + 1.0)));
+}
+
+/*
+ *	version 1 file of random walk segments
+ */
+static bool write_random_cdb(const char *filename)
+{
+  FILE *fp;
+  int iseg, ipt, npts, clat, clon;
+  long addr;
+  cdb_file_header header;
+  cdb_index_entry index[CDBTEST_SEGMENTS], *seg;
+  cdb_seg_data data[CDBTEST_MAX_DELTAS];
+
+  fp = fopen(filename, "w");
+  if (NULL == fp) { perror(filename); return FALSE; }
+
+  memset(&header, 0, sizeof(header));
+  if (fwrite(&header, 1, CDB_FILE_HEADER_SIZE, fp) != CDB_FILE_HEADER_SIZE)
+  { perror(filename); fclose(fp); return FALSE; }
+
+  addr = CDB_FILE_HEADER_SIZE;
+  for (iseg = 0, seg = index; iseg < CDBTEST_SEGMENTS; iseg++, seg++)
+  { clat = random_int(-80*1024, 80*1024);
+    clon = random_int(-179*1024, 179*1024);
+    npts = random_int(1, CDBTEST_MAX_DELTAS);
+    seg->ID = iseg + 1;
+    seg->ilat0 = seg->ilat_min = seg->ilat_max = clat;
+    seg->ilon0 = seg->ilon_min = seg->ilon_max = clon;
+    for (ipt = 0; ipt < npts; ipt++)
+    { data[ipt].dlat = random_int(-CDBTEST_DELTA, CDBTEST_DELTA);
+      data[ipt].dlon = random_int(-CDBTEST_DELTA, CDBTEST_DELTA);
+      if (clat + data[ipt].dlat > 90*1024 || clat + data[ipt].dlat < -90*1024)
+	data[ipt].dlat = -data[ipt].dlat;
+      clat += data[ipt].dlat;
+      clon += data[ipt].dlon;
+      if (clat > seg->ilat_max) seg->ilat_max = clat;
+      if (clat < seg->ilat_min) seg->ilat_min = clat;
+      if (clon > seg->ilon_max) seg->ilon_max = clon;
+      if (clon < seg->ilon_min) seg->ilon_min = clon;
+    }
+    seg->addr = addr;
+    seg->size = npts * sizeof(cdb_seg_data);
+    if (seg->size > header.max_seg_size) header.max_seg_size = seg->size;
+    addr += seg->size;
+    cdb_byteswap_data_buffer(data, npts);
+    if (fwrite(data, sizeof(cdb_seg_data), npts, fp) != (size_t)npts)
+    { perror(filename); fclose(fp); return FALSE; }
+  }
+
+  header.code_number = CDB_MAGIC_NUMBER;
+  header.index_addr = addr;
+  header.index_size = sizeof(index);
+  header.segment_rank = 1;
+  header.index_order = CDB_INDEX_NO_ORDER;
+  header.ilat_max = 90*1024;
+  header.ilon_max = 180*1024;
+  header.ilat_min = -90*1024;
+  header.ilon_min = -180*1024;
+  strcpy(header.text, "cdbtest");
+  cdb_byteswap_index(index, CDBTEST_SEGMENTS);
+  cdb_byteswap_header(&header);
+  if (fwrite(index, sizeof(cdb_index_entry), CDBTEST_SEGMENTS, fp)
+      != CDBTEST_SEGMENTS
+      || 0 != fseek(fp, 0L, SEEK_SET)
+      || fwrite(&header, 1, CDB_FILE_HEADER_SIZE, fp) != CDB_FILE_HEADER_SIZE)
+  { perror(filename); fclose(fp); return FALSE; }
+
+  if (0 != fclose(fp)) { perror(filename); return FALSE; }
+  return TRUE;
+}
+
+/*
+ *	points of the current segment, NULL on error
+ */
+static double *current_points(cdb_class *this, int *npts)
+{
+  static double *lat = NULL, *lon = NULL;
+  static int max_pts = 0;
+  double *points;
+  int ipt;
+
+  while ((*npts = get_current_seg_cdb(this, lat, lon, max_pts)) < 0)
+  { max_pts = -*npts;
+    lat = (double *)realloc(lat, max_pts * sizeof(double));
+    lon = (double *)realloc(lon, max_pts * sizeof(double));
+    if (NULL == lat || NULL == lon) { perror("cdbtest"); exit(ABORT); }
+  }
+  if (0 == *npts) return NULL;
+
+  points = (double *)malloc(2 * *npts * sizeof(double));
+  if (NULL == points) { perror("cdbtest"); exit(ABORT); }
+  for (ipt = 0; ipt < *npts; ipt++)
+  { points[2*ipt] = lat[ipt];
+    points[2*ipt+1] = lon[ipt];
+  }
+  return points;
+}
+
+/*
+ *	compare each segment to a stdio read of a version 1 file
+ */
+static int check_stdio_cdb(cdb_class *this)
+{
+  FILE *fp;
+  int iseg, ipt, npts, clat, clon, errors = 0;
+  double *points;
+  cdb_index_entry *seg;
+  cdb_seg_data *data;
+
+  fp = fopen(this->filename, "r");
+  data = (cdb_seg_data *)malloc(this->header->max_seg_size + 1);
+  if (NULL == fp || NULL == data) { perror("cdbtest"); exit(ABORT); }
+
+  for (iseg = 0, seg = this->index; iseg < this->seg_count; iseg++, seg++)
+  { if (0 != fseek(fp, seg->addr, SEEK_SET)
+	|| fread(data, 1, seg->size, fp) != seg->size)
+    { perror(this->filename); exit(ABORT); }
+    cdb_byteswap_data_buffer(data, seg->size/sizeof(cdb_seg_data));
+
+    set_current_seg_cdb(this, seg);
+    points = current_points(this, &npts);
+    if (NULL == points || npts != (int)(seg->size/sizeof(cdb_seg_data)) + 1)
+    { fprintf(stderr,"cdbtest: segment %d has %d points, expected %d\n",
+	      seg->ID, npts, (int)(seg->size/sizeof(cdb_seg_data)) + 1);
+      ++errors;
+      if (points) free(points);
+      continue;
+    }
+
+    clat = seg->ilat0;
+    clon = seg->ilon0;
+    for (ipt = 0; ipt < npts; ipt++)
+    { if (ipt > 0)
+      { clat += data[ipt-1].dlat;
+	clon += data[ipt-1].dlon;
+      }
+      if (points[2*ipt] != clat*CDB_LAT_SCALE
+	  || points[2*ipt+1] != clon*CDB_LON_SCALE)
+      { fprintf(stderr,"cdbtest: segment %d point %d differs from stdio\n",
+		seg->ID, ipt);
+	++errors;
+	break;
+      }
+    }
+    free(points);
+  }
+
+  fclose(fp);
+  free(data);
+  reset_current_seg_cdb(this);
+  return errors;
+}
+
+/*
+ *	compare index entries and points of a copy to the original
+ */
+static int compare_cdb(cdb_class *this, cdb_class *copy)
+{
+  int iseg, npts, copy_npts, errors = 0;
+  double *points, *copy_points;
+  cdb_index_entry *seg, *copy_seg;
+
+  if (copy->seg_count != this->seg_count)
+  { fprintf(stderr,"cdbtest: <%s> has %d segments, expected %d\n",
+	    copy->filename, copy->seg_count, this->seg_count);
+    return 1;
+  }
+
+  for (iseg = 0, seg = this->index, copy_seg = copy->index;
+       iseg < this->seg_count; iseg++, seg++, copy_seg++)
+  { if (seg->ID != copy_seg->ID
+	|| seg->ilat0 != copy_seg->ilat0 || seg->ilon0 != copy_seg->ilon0
+	|| seg->ilat_max != copy_seg->ilat_max
+	|| seg->ilon_max != copy_seg->ilon_max
+	|| seg->ilat_min != copy_seg->ilat_min
+	|| seg->ilon_min != copy_seg->ilon_min)
+    { fprintf(stderr,"cdbtest: <%s> segment %d index entry differs\n",
+	      copy->filename, seg->ID);
+      ++errors;
+      continue;
+    }
+
+    set_current_seg_cdb(this, seg);
+    points = current_points(this, &npts);
+    set_current_seg_cdb(copy, copy_seg);
+    copy_points = current_points(copy, &copy_npts);
+    if (NULL == points || NULL == copy_points || npts != copy_npts
+	|| 0 != memcmp(points, copy_points, 2 * npts * sizeof(double)))
+    { fprintf(stderr,"cdbtest: <%s> segment %d points differ\n",
+	      copy->filename, seg->ID);
+      ++errors;
+    }
+    if (points) free(points);
+    if (copy_points) free(copy_points);
+  }
+
+  reset_current_seg_cdb(this);
+  reset_current_seg_cdb(copy);
+  return errors;
+}
+
+/*
+ *	segments found by a linear scan, in index order
+ */
+static int scan_box(cdb_class *this, int4 south, int4 north,
+		    int4 west, int4 east, cdb_index_entry **found)
+{
+  int iseg, shift, num_found = 0;
+  int4 turn = (int4)(360/CDB_LON_SCALE);
+  cdb_index_entry *seg;
+
+  for (iseg = 0, seg = this->index; iseg < this->seg_count; iseg++, seg++)
+  { if (seg->ilat_max < south || seg->ilat_min > north) continue;
+    if (west != east)
+    { for (shift = -1; shift <= 1; shift++)
+	if (seg->ilon_max >= west + shift*turn 
+	    && seg->ilon_min <= east + shift*turn) break;
+      if (shift > 1) continue;
+    }
+    found[num_found++] = seg;
+  }
+  return num_found;
+}
+
+/*
+ *	compare find_box_cdb to a linear scan for random boxes on
+ *	the cdb unit grid, some crossing 180 and some all around
+ */
+static int check_boxes(cdb_class *this)
+{
+  int ibox, num_found, num_scan, errors = 0;
+  int4 south, north, west, east, swap;
+  cdb_index_entry **found, **scan;
+
+  found = (cdb_index_entry **)malloc((this->seg_count + 1)
+				     * sizeof(cdb_index_entry *));
+  scan = (cdb_index_entry **)malloc((this->seg_count + 1)
+				    * sizeof(cdb_index_entry *));
+  if (NULL == found || NULL == scan) { perror("cdbtest"); exit(ABORT); }
+
+  for (ibox = 0; ibox < CDBTEST_BOXES; ibox++)
+  { south = random_int(-90*1024, 90*1024);
+    north = random_int(-90*1024, 90*1024);
+    if (north < south) { swap = north; north = south; south = swap; }
+    west = random_int(-180*1024, 180*1024);
+    east = 0 == ibox % 10 ? west : random_int(-180*1024, 180*1024);
+
+    num_found = find_box_cdb(this, south*CDB_LAT_SCALE, north*CDB_LAT_SCALE,
+			     west*CDB_LON_SCALE, east*CDB_LON_SCALE,
+			     found, this->seg_count + 1);
+    if (east < west) east += (int4)(360/CDB_LON_SCALE);
+    num_scan = scan_box(this, south, north, west, east, scan);
+    if (num_found != num_scan 
+	|| 0 != memcmp(found, scan, num_scan * sizeof(cdb_index_entry *)))
+    { fprintf(stderr,"cdbtest: <%s> box %d found %d segments, "
+	      "linear scan %d\n", this->filename, ibox, num_found, num_scan);
+      ++errors;
+    }
+    else if (num_scan > 0
+	     && find_box_cdb(this, south*CDB_LAT_SCALE, north*CDB_LAT_SCALE,
+			     west*CDB_LON_SCALE, east*CDB_LON_SCALE,
+			     found, num_scan - 1) != -num_scan)
+    { fprintf(stderr,"cdbtest: <%s> box %d short array not reported\n",
+	      this->filename, ibox);
+      ++errors;
+    }
+  }
+
+  free(found);
+  free(scan);
+  return errors;
+}
+
+static int no_draw(double lat, double lon)
+{
+  fprintf(stderr,"cdbtest: empty cdb drew %f,%f\n", lat, lon);
+  return TRUE;
+}
+
+/*
+ *	an empty cdb finds and draws nothing
+ */
+static int check_empty(void)
+{
+  int errors = 0;
+  cdb_index_entry *found[1];
+  cdb_class *this;
+
+  this = new_cdb();
+  if (NULL == this) exit(ABORT);
+
+  if (0 != find_box_cdb(this, -90, 90, -180, 180, found, 1))
+  { fprintf(stderr,"cdbtest: empty cdb found segments\n");
+    ++errors;
+  }
+  if (0 != draw_box_cdb(this, -90, 90, 0, 0, 0, no_draw, no_draw))
+  { fprintf(stderr,"cdbtest: empty cdb draw failed\n");
+    ++errors;
+  }
+
+  free_cdb(this);
+  return errors;
+}
+
+int main(int argc, char *argv[])
+{
+  char *filename = "cdbtest.tmp";
+  char *copy_name[2] = { "cdbtest1.tmp", "cdbtest2.tmp" };
+  int version, errors = 0;
+  cdb_class *this, *copy;
+
+  if (argc > 2) error_exit(usage);
+  if (argc == 2) filename = argv[1];
+  else if (!write_random_cdb(filename)) error_exit(usage);
+
+  this = init_cdb(filename);
+  if (NULL == this) error_exit(usage);
+
+  if (1 == this->version) errors += check_stdio_cdb(this);
+  errors += check_boxes(this);
+  errors += check_empty();
+
+  for (version = 1; version <= 2; version++)
+  { if (0 != write_cdb(this, copy_name[version-1], version, 
+		       2 == version ? CDB2_CHECKSUM : 0)) 
+      error_exit("cdbtest: write_cdb failed");
+    copy = init_cdb(copy_name[version-1]);
+    if (NULL == copy) error_exit("cdbtest: can't read copy");
+    if (copy->version != version)
+    { fprintf(stderr,"cdbtest: <%s> read as version %d\n",
+	      copy_name[version-1], copy->version);
+      ++errors;
+    }
+    errors += compare_cdb(this, copy);
+    errors += check_boxes(copy);
+    free_cdb(copy);
+    remove(copy_name[version-1]);
+  }
+
+  fprintf(stderr,"%d segments, %d errors\n", this->seg_count, errors);
+  free_cdb(this);
+  if (argc < 2) remove(filename);
+
+  return errors > 0 ? ABORT : 0;
+}
+#endif
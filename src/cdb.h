@@ -30,6 +30,35 @@ const char cdb_h_rcsid[] = "$Id$";
  * All disk data is stored with most significant byte first (big-endian).
  * For machines which require least significant byte first (little-endian,
  * Intel, VAX) compile cdb.c with -DLSB1ST
+ *
+ * Regular files are mapped read-only into memory, so all segment data
+ * is available without reading it in and processes using the same file
+ * share one copy in the page cache. Segment data is decoded from the
+ * mapping a segment at a time as it is accessed. CDB_MAX_BUFFER_SIZE
+ * only applies to files that can not be mapped.
+ *
+ * A file may also carry pre-thinned levels of detail (see cdb_edit -L).
+ * A level of detail directory follows the index, and each level is a
+ * complete cdb file image (header, data and index) embedded further on,
+ * with addresses relative to the start of the image. Readers that do not
+ * know about levels of detail ignore everything after the index. Levels
+ * of detail are only available when the file is mapped.
+ *
+ * Version 2 files (see cdb_edit -C) hold the same segments more compactly.
+ * All values are stored least significant byte first. The header is
+ * CDB2_FILE_HEADER_SIZE bytes and each index entry CDB2_INDEX_ENTRY_SIZE.
+ * Addresses are 8 bytes, so files are not limited to 4 GB. Each
+ * segment's dlat,dlon pairs are zigzag varints, 7 bits per byte, low
+ * bits first, with the high bit set on all but the last byte. No
+ * segment crosses a block_size boundary unless it is bigger than a
+ * block, then it starts on one, so a segment is one aligned read. If
+ * the CDB2_CHECKSUM flag is set each index entry has the CRC-32 of
+ * its segment data, checked as the data is decoded.
+ * init_cdb opens either version. For version 2 files the index entry
+ * addr is 1 + the segment's position in index2, which holds the file
+ * address, size and checksum, and size is the decoded size so
+ * size/sizeof(cdb_seg_data) is still the number of deltas.
+ * Version 2 files do not carry levels of detail.
  *::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::::*/
 
 /*
@@ -41,6 +70,14 @@ const char cdb_h_rcsid[] = "$Id$";
 #define CDB_LAT_SCALE (1./1024)
 #define CDB_LON_SCALE (1./1024)
 #define CDB_MAX_BUFFER_SIZE (25*1024*1024)
+#define CDB_LOD_MAGIC_NUMBER 0x2E6C6F64
+#define CDB_LOD_HEADER_SIZE 72L
+#define CDB_MAX_LOD 8
+#define CDB2_MAGIC_NUMBER 0x32626463	/* "cdb2" least significant first */
+#define CDB2_FILE_HEADER_SIZE 128L
+#define CDB2_INDEX_ENTRY_SIZE 48L
+#define CDB2_BLOCK_SIZE 4096
+#define CDB2_CHECKSUM 1			/* header flag */
 
 typedef enum
 { CDB_INDEX_NO_ORDER=0,
@@ -81,6 +118,18 @@ typedef struct
   char text[32];	/* null terminated description of file */
 } cdb_file_header;
 
+/*
+ *	level of detail directory, follows the index
+ */
+
+typedef struct
+{
+  byte4 code_number;		/* identifies level of detail directory */
+  byte4 count;			/* number of levels of detail */
+  byte4 addr[CDB_MAX_LOD];	/* byte offset of each embedded cdb image */
+  byte4 tolerance[CDB_MAX_LOD];	/* thinning tolerance in meters */
+} cdb_lod_header;
+
 /*
  *	segment index entry
  */
@@ -95,6 +144,17 @@ typedef struct
   byte4 size;	/* size of segment data in bytes */
 } cdb_index_entry;
 
+/*
+ *	version 2 segment data location
+ */
+
+typedef struct
+{
+  NSIDCint8 addr;	/* byte offset of encoded segment data */
+  byte4 size;		/* size of encoded segment data in bytes */
+  byte4 checksum;	/* CRC-32 of encoded data if CDB2_CHECKSUM */
+} cdb2_index_entry;
+
 /*
  *	segment data pair
  */
@@ -105,12 +165,40 @@ typedef struct
   int2  dlon;
 } cdb_seg_data;
 
+/*
+ *	R-tree over segment bounding boxes
+ *
+ *	Built in memory on the first box query by sort-tile-recursive
+ *	packing, CDB_RTREE_FANOUT children per node. Leaf nodes come first
+ *	in node[] and refer to item[], a list of positions in the index.
+ *	Internal nodes refer to their children in node[]. The root is the
+ *	last node. Sorting the index discards the tree.
+ */
+
+#define CDB_RTREE_FANOUT 16
+
+typedef struct
+{
+  int4 ilat_min, ilat_max;	/* bounds of everything below this node */
+  int4 ilon_min, ilon_max;
+  int first;			/* first child in node[] or item[] */
+  int count;			/* number of children */
+} cdb_rtree_node;
+
+typedef struct
+{
+  cdb_rtree_node *node;
+  int node_count;
+  int leaf_count;		/* node[0..leaf_count-1] are leaves */
+  int *item;			/* index positions referred to by leaves */
+} cdb_rtree;
+
 
 /*
  * class definition
  */
 
-typedef struct
+typedef struct cdb_class_
 {
   char *filename;
   FILE *fp;
@@ -125,6 +213,20 @@ typedef struct
   int npoints;			/* number of data points in current segment */
   int is_loaded;		/* if TRUE all data is loaded in memory */
   cdb_seg_data *(*get_data)();	/* read segment data function */
+  byte1 *map;			/* whole file mapped read-only or NULL */
+  long map_size;		/* size of mapping in bytes */
+  cdb_rtree *rtree;		/* box query tree or NULL if not built */
+  cdb_lod_header *lod;		/* level of detail directory or NULL */
+  struct cdb_class_ *lod_level[CDB_MAX_LOD]; /* opened on first use */
+  struct cdb_class_ *parent;	/* file a level of detail belongs to */
+  double *seg_lat, *seg_lon;	/* decoded segment for polyline callbacks */
+  int seg_size;			/* size of seg_lat,seg_lon arrays */
+  int version;			/* file format version, 1 or 2 */
+  int flags;			/* version 2 header flags */
+  NSIDCint8 index_addr;		/* version 2 byte offset of index */
+  cdb2_index_entry *index2;	/* version 2 segment data locations */
+  byte1 *code_buffer;		/* version 2 encoded data read from disk */
+  long code_buffer_size;
 } cdb_class;
 
 /*
@@ -195,10 +297,14 @@ void free_cdb(cdb_class *this);
 cdb_class *copy_of_cdb(cdb_class *this);
 void load_all_seg_data_cdb(cdb_class *this);
 cdb_seg_data *load_current_seg_data_cdb(cdb_class *this);
+void decode_seg_data_cdb(const byte1 *data, int npts, bool big_endian,
+			 int4 ilat0, int4 ilon0, double *lat, double *lon);
 int get_current_seg_cdb(cdb_class *this,
 			double *lat, double *lon, int max_pts);
 int draw_current_seg_cdb(cdb_class *this, int (*move_pu)(double,double),
 			 int (*draw_pd)(double,double));
+int draw_current_seg_polyline_cdb(cdb_class *this,
+				  int (*polyline)(int,double *,double *));
 void list_cdb(cdb_class *this, int verbose);
 void sort_index_cdb(cdb_class *this, cdb_index_sort order);
 cdb_index_entry *find_segment_cdb(cdb_class *this, double key_value);
@@ -208,5 +314,17 @@ int segment_bounds_test_cdb(cdb_class *this, double south, double north,
 			    double west, double east);
 int draw_cdb(cdb_class *this, double start, double stop, cdb_index_sort order,
 	     int (*move_pu)(double,double), int (*draw_pd)(double,double));
+int find_box_cdb(cdb_class *this, double south, double north,
+		 double west, double east,
+		 cdb_index_entry **found, int max_found);
+int draw_box_cdb(cdb_class *this, double south, double north,
+		 double west, double east, double tolerance,
+		 int (*move_pu)(double,double), int (*draw_pd)(double,double));
+int draw_box_polyline_cdb(cdb_class *this, double south, double north,
+			  double west, double east, double tolerance,
+			  int (*polyline)(int,double *,double *));
+cdb_class *select_lod_cdb(cdb_class *this, double tolerance);
+void cdb_byteswap_lod_header(cdb_lod_header *lod);
+int write_cdb(cdb_class *this, const char *filename, int version, int flags);
 
 #endif
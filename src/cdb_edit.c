@@ -27,11 +27,19 @@ static const char cdb_edit_c_rcsid[] = "$Id$";
 #include "define.h"
 #include "cdb.h"
 #include "mapx.h"
+#include "grids.h"
+#include "keyval.h"
+#include "simplify.h"
 #include "cdb_byteswap.h"
 
 #define SQ(x) x*x
+#define round_cdb(x) ((int)floor((x)+.5))	/* nint truncates negatives */
 #define MPP_FILENAME "cdb_edit.mpp"
 #define MAX_SEGMENT_POINTS 100000      /* maximum number of points in any joined segment */
+#define ENDPOINT_MARGIN 1.5		/* endpoint search radius safety factor */
+#define ENDPOINT_MIN_SCALE 0.125	/* below this map scale search every segment */
+#define ENDPOINT_REMOVED -2		/* endpoint next when not in the hash */
+#define SIMPLIFY_BATCH_POINTS 1048576	/* points decoded per simplify batch */
 
 typedef enum 
 { JOIN_NO_METHOD=0,
@@ -41,6 +49,16 @@ typedef enum
   JOIN_END_TO_END,
 } cdb_edit_join_method;
 
+/*
+ *	segment endpoint in the join hash, cell ix,iy,iz of the earth
+ *	centered x,y,z position, entries 2n and 2n+1 are the start and
+ *	end of source segment n
+ */
+typedef struct
+{ int ix, iy, iz;
+  int next;			/* next entry in the bucket or -1 */
+} cdb_edit_endpoint;
+
 
 /*------------------------------------------------------------------------
  * globals
@@ -64,22 +82,43 @@ static int verbose = FALSE;
 static int very_verbose = FALSE;
 static int very_very_verbose = FALSE;
 static double thin = 0.01;
+static int lod_count = 0;
+static double lod_thin[CDB_MAX_LOD];
 static double north = 90.0, south = -90.0, east = 180.0, west = -180.0;
 static char label[32] = "created by cdb_edit";  
 static double current_x_start, current_y_start;
 static double current_x_end, current_y_end;
+static double pen_lat, pen_lon;
+static double *seg_lat = NULL, *seg_lon = NULL;
+static int seg_size = 0;
+static cdb_edit_endpoint *endpoint = NULL;
+static int *endpoint_bucket = NULL;
+static unsigned endpoint_mask = 0;
+static double endpoint_cell;		/* hash cell size and search radius */
+static int *endpoint_hits = NULL;	/* segments found by near_endpoints */
+static grid_class *grid = NULL;
+static int simplify_method = 0;
+static double simplify_tolerance = 0;
+static int convert_version = 0;
+static int convert_flags = 0;
   
 /*------------------------------------------------------------------------
  * function prototypes
  *------------------------------------------------------------------------*/
 int move_pu(double, double);
 int draw_pd(double, double);
+int draw_polyline(int, double *, double *);
+static int add_point(double, double);
+static void recenter_map(double, double);
 void write_segment_data(int);
 int parallels_min(cdb_index_entry *, cdb_index_entry *);
 int meridians_min(cdb_index_entry *, cdb_index_entry *);
 int parallels_max(cdb_index_entry *, cdb_index_entry *);
 int meridians_max(cdb_index_entry *, cdb_index_entry *);
 void thin_current_segment(void);
+static void simplify_segments(void);
+static void simplify_segment(simplify_class *, int, double *, double *,
+			     double *, double *, int *);
 void copy_current_segment(void);
 void thin_map(void);
 void reverse_current_segment(void);
@@ -87,14 +126,24 @@ void join_map(void);
 void append_candidate(int, double *, double *, double *, double *);
 void clip_and_concat_files(int, char **, double, double, double, double);
 cdb_index_entry *find_best_candidate(cdb_edit_join_method *);
+static void check_candidate(cdb_index_entry *, double *, cdb_index_entry **,
+			    cdb_edit_join_method *);
+static void build_endpoint_hash(void);
+static void remove_endpoints(int);
+static int near_endpoints(void);
+static void free_endpoint_hash(void);
 void finish_new_file();
+void write_lod_levels(char *);
+void append_lod_levels(char **);
 
 /*------------------------------------------------------------------------
  * usage
  *------------------------------------------------------------------------*/
 #define usage "\n"\
  "usage: cdb_edit [-tj thin -n north -s south -e east -w west\n"\
- "                 -h label -pqlmv] new_cdb_file source_cdb_file ...\n"\
+ "                 -h label -L lod_thin -g gpd_file -DW pixels\n"\
+ "                 -C version -Kpqlmv]\n"\
+ "                 new_cdb_file source_cdb_file ...\n"\
  "\n"\
  " input : source_cdb_file - file(s) to edit (may be more than one)\n"\
  "\n"\
@@ -109,6 +158,19 @@ void finish_new_file();
  "         e east - eastern lon bound (default 180)\n"\
  "         w west - western lon bound (default -180)\n"\
  "         h label - specify header label text (31 chars max)\n"\
+ "         L lod_thin - also store a level of detail thinned to\n"\
+ "                lod_thin kilometers (may be repeated, up to 8)\n"\
+ "         g gpd_file - grid for -D or -W\n"\
+ "         D pixels - instead of -t thinning, simplify each segment\n"\
+ "                (Douglas-Peucker) to within pixels of the original\n"\
+ "                in the grid, segments are still joined with -j\n"\
+ "         W pixels - instead of -t thinning, simplify each segment\n"\
+ "                (Visvalingam-Whyatt) dropping points whose effective\n"\
+ "                area is less than pixels squared in the grid\n"\
+ "         C version - only convert source_cdb_file to cdb file\n"\
+ "                format version 1 or 2, no other edits are done and\n"\
+ "                levels of detail are dropped\n"\
+ "         K - store a checksum of each segment, only with -C 2\n"\
  "         p parallels_min - sort index by lat_min (cancels -m, -q, -l)\n"\
  "         q parallels_max - sort index by lat_max (cancels -m, -l, -p)\n"\
  "         l meridians_min - sort index by lon_min (cancels -p, -q, -m)\n"\
@@ -179,11 +241,45 @@ main(int argc, char *argv[])
 	argc--; argv++;
 	strncpy(label, *argv, 31);
 	break;
+      case 'L':
+	argc--; argv++;
+	if (argc <= 0 || lod_count >= CDB_MAX_LOD
+	    || sscanf(*argv,"%lf", &lod_thin[lod_count]) != 1) 
+	  error_exit(usage);
+	lod_count++;
+	break;
       case 'j':
 	argc--; argv++;
 	if (argc <= 0 || sscanf(*argv,"%lf", &thin) != 1) error_exit(usage);
 	join = TRUE;
 	break;
+      case 'g':
+	argc--; argv++;
+	if (argc <= 0) error_exit(usage);
+	grid = init_grid(*argv);
+	if (NULL == grid) exit(ABORT);
+	break;
+      case 'D':
+	argc--; argv++;
+	if (argc <= 0 || sscanf(*argv,"%lf", &simplify_tolerance) != 1)
+	  error_exit(usage);
+	simplify_method = simplify_DOUGLAS_PEUCKER;
+	break;
+      case 'W':
+	argc--; argv++;
+	if (argc <= 0 || sscanf(*argv,"%lf", &simplify_tolerance) != 1)
+	  error_exit(usage);
+	simplify_method = simplify_VISVALINGAM;
+	break;
+      case 'C':
+	argc--; argv++;
+	if (argc <= 0 || sscanf(*argv,"%d", &convert_version) != 1
+	    || (1 != convert_version && 2 != convert_version))
+	  error_exit(usage);
+	break;
+      case 'K':
+	convert_flags |= CDB2_CHECKSUM;
+	break;
       default:
 	fprintf(stderr, "invalid option %c\n", *option);
 	error_exit(usage);
@@ -195,8 +291,35 @@ main(int argc, char *argv[])
  *	get new filename
  */
   if (argc < 2) error_exit(usage);
+  if (simplify_method && NULL == grid)
+  { fprintf(stderr,"cdb_edit: -D and -W need a grid (-g gpd_file)\n");
+    error_exit(usage);
+  }
+  if ((convert_flags & CDB2_CHECKSUM) && 2 != convert_version)
+  { fprintf(stderr,"cdb_edit: -K needs -C 2\n");
+    error_exit(usage);
+  }
   new_filename = strdup(*argv);
   
+/*
+ *	format conversion only
+ */
+  if (convert_version)
+  { if (argc != 2) error_exit(usage);
+    source = init_cdb(argv[1]);
+    if (NULL == source) exit(ABORT);
+    if (NULL != source->lod)
+      fprintf(stderr,"cdb_edit: levels of detail in %s not converted\n",
+	      argv[1]);
+    if (verbose) 
+      fprintf(stderr,">converting: %s to %s version %d\n",
+	      argv[1], new_filename, convert_version);
+    if (0 != write_cdb(source, new_filename, convert_version, convert_flags))
+      exit(ABORT);
+    free_cdb(source);
+    exit(EXIT_SUCCESS);
+  }
+
   sprintf(temp, "cc_%s", new_filename);
   cc_filename = strdup(temp);
   
@@ -220,6 +343,11 @@ main(int argc, char *argv[])
     exit(ABORT);
   }
   map->scale = thin/3;
+/*
+ *	reinit_mapx only recomputes the map origin from center lat,lon
+ *	when x0,y0 are unset, so clear them each time the map changes
+ */
+  map->x0 = map->y0 = KEYVAL_UNINITIALIZED;
   reinit_mapx(map);
   if(very_verbose) 
     fprintf(stderr, ">>initialized map\n"); 
@@ -284,6 +412,8 @@ main(int argc, char *argv[])
   }
  
   finish_new_file();
+
+  if (lod_count > 0) write_lod_levels(join ? joined_filename : cc_filename);
    
   sprintf(command, "cdb_list %s", new_filename);
   if(verbose) system(command);
@@ -292,7 +422,6 @@ main(int argc, char *argv[])
   free(map);
   free_cdb(dest);
   free_cdb(source);
-  free(label);
 
 /*
  *  remove temporary files
@@ -354,27 +483,17 @@ main(int argc, char *argv[])
  *	start a new segment
  */
   dest->index[dest->seg_count].ID = dest->seg_count;
-  dest->index[dest->seg_count].ilat0 = nint(lat/CDB_LAT_SCALE);
+  dest->index[dest->seg_count].ilat0 = round_cdb(lat/CDB_LAT_SCALE);
   nlon = lon;
   NORMALIZE(nlon);
-  dest->index[dest->seg_count].ilon0 = nint(nlon/CDB_LON_SCALE);
+  dest->index[dest->seg_count].ilon0 = round_cdb(nlon/CDB_LON_SCALE);
   dest->index[dest->seg_count].ilat_max = dest->index[dest->seg_count].ilat0;
   dest->index[dest->seg_count].ilon_max = dest->index[dest->seg_count].ilon0;
   dest->index[dest->seg_count].ilat_min = dest->index[dest->seg_count].ilat0;
   dest->index[dest->seg_count].ilon_min = dest->index[dest->seg_count].ilon0;
 
-/*
- * recenter map
- */
-
-  map->center_lat = lat;
-  map->center_lon = nlon;
-  map->lat0 = lat;
-  map->lon0 = nlon;
-  reinit_mapx(map);
   dest->npoints = 0;
-  if (very_very_verbose)fprintf(stderr,">>> recentered map to %lf %lf.\n",
-				map->lat0,  map->lon0);
+  recenter_map(lat, nlon);
   return 0;
   }
 
@@ -391,9 +510,72 @@ main(int argc, char *argv[])
  *         -1 if fatal error occurs (unabel to allocate enough memory)
  *------------------------------------------------------------------------*/
 int draw_pd(double lat, double lon)
+{
+  if (add_point(lat, lon)) return -1;
+  recenter_map(pen_lat, pen_lon);
+  return 0;
+}
+
+
+/*------------------------------------------------------------------------
+ * draw_polyline - draw a whole segment
+ *
+ *  input: npts - number of points
+ *         lat, lon - points of the segment
+ *
+ * result: same as move_pu to the first point then draw_pd to each of
+ *         the rest, but the map is only recentered once, on the last
+ *         point, since nothing projects in between.
+ *
+ * return: 0 on success
+ *         -1 if fatal error occurs (unabel to allocate enough memory)
+ *------------------------------------------------------------------------*/
+int draw_polyline(int npts, double *lat, double *lon)
+{
+  register int ipt;
+
+  if (npts < 1) return 0;
+  if (move_pu(lat[0], lon[0])) return -1;
+  for (ipt = 1; ipt < npts; ipt++)
+    if (add_point(lat[ipt], lon[ipt])) return -1;
+  if (npts > 1) recenter_map(pen_lat, pen_lon);
+  return 0;
+}
+
+
+/*------------------------------------------------------------------------
+ * recenter_map - center the working map on a point
+ *
+ *  input: lat, lon - new map center
+ *------------------------------------------------------------------------*/
+static void recenter_map(double lat, double lon)
+{
+  map->center_lat = lat;
+  map->center_lon = lon;
+  map->lat0 = lat;
+  map->lon0 = lon;
+  map->x0 = map->y0 = KEYVAL_UNINITIALIZED;
+  reinit_mapx(map);
+  if (very_very_verbose)fprintf(stderr,">>> recentered map to %lf %lf.\n",
+				lat, lon);
+}
+
+
+/*------------------------------------------------------------------------
+ * add_point - put the next point of the segment in the data buffer
+ *
+ *  input: lat, lon - position of next point.
+ *
+ * result: pen_lat, pen_lon are set to the point as stored,
+ *         the map is not recentered.
+ *
+ * return: 0 on success
+ *         -1 if fatal error occurs (unabel to allocate enough memory)
+ *------------------------------------------------------------------------*/
+static int add_point(double lat, double lon)
 {
   register int ilat, ilon;
-  static double lat1,lon1;
+  static int ilat1, ilon1;
   auto double lat3,lon3;
 
 /*
@@ -406,7 +588,7 @@ int draw_pd(double lat, double lon)
     			
     if(NULL == dest->data_buffer)
     {
-      fprintf(stderr,"draw_pd: Unable to allocate %d data points\n", 
+      fprintf(stderr,"add_point: Unable to allocate %d data points\n", 
 	      max_data_points);
       return -1;
     }
@@ -419,9 +601,10 @@ int draw_pd(double lat, double lon)
  */
   if (0 == dest->npoints)
   {
-    lat1 = dest->index[dest->seg_count].ilat0 * CDB_LAT_SCALE;
-    lon1 = dest->index[dest->seg_count].ilon0 * CDB_LON_SCALE;
-    if (very_verbose)fprintf(stderr,">>new segment: %lf %lf.\n",lat1,lon1);
+    ilat1 = dest->index[dest->seg_count].ilat0;
+    ilon1 = dest->index[dest->seg_count].ilon0;
+    if (very_verbose)fprintf(stderr,">>new segment: %lf %lf.\n",
+			     ilat1 * CDB_LAT_SCALE, ilon1 * CDB_LON_SCALE);
   }
 
 /*
@@ -437,19 +620,20 @@ int draw_pd(double lat, double lon)
   if(lon3 > 180.0) lon3 = 180.0;
   if(lon3 < -180.0) lon3 = -180.0;
 
-  lat1 = lat3 - lat1;
-  lon1 = lon3 - lon1;
-  lat1 = lat1/CDB_LAT_SCALE;
-  lon1 = lon1/CDB_LON_SCALE;
+/*
+ * Deltas are taken between rounded positions so rounding errors
+ * do not accumulate along the segment.
+ */
+  ilat = round_cdb(lat3/CDB_LAT_SCALE);
+  ilon = round_cdb(lon3/CDB_LON_SCALE);
 
-  dest->data_buffer[dest->npoints].dlat = nint(lat1);
-  dest->data_buffer[dest->npoints].dlon = nint(lon1);
-  
-  ilat = nint(lat3/CDB_LAT_SCALE);
-  ilon = nint(lon3/CDB_LON_SCALE);
+  dest->data_buffer[dest->npoints].dlat = ilat - ilat1;
+  dest->data_buffer[dest->npoints].dlon = ilon - ilon1;
    
-  lat1 = lat3;
-  lon1 = lon3;
+  ilat1 = ilat;
+  ilon1 = ilon;
+  pen_lat = lat3;
+  pen_lon = lon3;
   ++dest->npoints;
    
 /*
@@ -471,17 +655,6 @@ int draw_pd(double lat, double lon)
   if (dest->index[dest->seg_count].ilon_min > ilon)
     dest->index[dest->seg_count].ilon_min = ilon;
 
-/*
- * recenter map
- */
-  map->center_lat = lat1;
-  map->center_lon = lon1;
-  map->lat0 = lat1;
-  map->lon0 = lon1;
-  reinit_mapx(map);
-  if (very_very_verbose)fprintf(stderr,">>> recentered map to %lf %lf.\n",
-				lat1, lon1);
-
   return 0;
 }
 
@@ -576,6 +749,13 @@ void thin_map()
  *	step thru segment dictionary entries
  */
 
+  if (simplify_method)
+  { simplify_segments();
+    if(verbose)
+      list_cdb(source, very_very_verbose); 
+    return;
+  }
+
   for (iseg = 0, reset_current_seg_cdb(source); 
        iseg < source->seg_count; iseg++, next_segment_cdb(source))
   {
@@ -594,6 +774,143 @@ void thin_map()
 }
 
   
+/*------------------------------------------------------------------------
+ * simplify_segments - simplify every source segment in the grid
+ *
+ * result: segments are decoded a batch at a time, projected and
+ *         simplified in parallel when compiled with OpenMP, then
+ *         the kept points are drawn in segment order
+ *------------------------------------------------------------------------*/ 
+
+static void simplify_segments(void)
+{
+  static double *lat = NULL, *lon = NULL, *x = NULL, *y = NULL;
+  static int *keep = NULL, *first = NULL;
+  static int max_points = 0, max_segments = 0;
+  int iseg0, nseg, npts, iseg, ipt, nkept, total_in = 0, total_out = 0;
+  bool ok = TRUE;
+
+  for (iseg0 = 0; iseg0 < source->seg_count; iseg0 += nseg)
+  {
+
+/*
+ *    decode a batch of segments
+ */
+    for (nseg = 0, npts = 0; iseg0 + nseg < source->seg_count
+	   && (0 == nseg || npts < SIMPLIFY_BATCH_POINTS); nseg++)
+    { if (nseg + 2 > max_segments)
+      { max_segments = 2 * max_segments + 1024;
+	first = (int *)realloc(first, max_segments * sizeof(int));
+	if (NULL == first)
+	{ fprintf(stderr,"simplify_segments: Unable to allocate %d segments\n",
+		  max_segments);
+	  exit(ABORT);
+	}
+      }
+      first[nseg] = npts;
+
+      source->segment = source->index + iseg0 + nseg;
+      while ((ipt = get_current_seg_cdb(source, lat + npts, lon + npts,
+					max_points - npts)) < 0)
+      { max_points = 2 * (npts - ipt);
+	lat = (double *)realloc(lat, max_points * sizeof(double));
+	lon = (double *)realloc(lon, max_points * sizeof(double));
+	x = (double *)realloc(x, max_points * sizeof(double));
+	y = (double *)realloc(y, max_points * sizeof(double));
+	keep = (int *)realloc(keep, max_points * sizeof(int));
+	if (NULL == lat || NULL == lon || NULL == x || NULL == y
+	    || NULL == keep)
+	{ fprintf(stderr,"simplify_segments: Unable to allocate %d points\n",
+		  max_points);
+	  exit(ABORT);
+	}
+      }
+      npts += ipt;
+    }
+    first[nseg] = npts;
+
+/*
+ *    project and simplify, one simplify_class per thread
+ */
+#ifdef _OPENMP
+#pragma omp parallel
+#endif
+    { simplify_class *simplify;
+
+      simplify = init_simplify(simplify_method, simplify_tolerance);
+      if (NULL == simplify) ok = FALSE;
+
+#ifdef _OPENMP
+#pragma omp for schedule(dynamic)
+#endif
+      for (iseg = 0; iseg < nseg; iseg++)
+      { if (NULL == simplify) continue;
+	simplify_segment(simplify, first[iseg+1] - first[iseg],
+			 lat + first[iseg], lon + first[iseg],
+			 x + first[iseg], y + first[iseg], keep + first[iseg]);
+      }
+
+      free_simplify(simplify);
+    }
+    if (!ok) exit(ABORT);
+
+/*
+ *    draw the kept points in order
+ */
+    for (iseg = 0; iseg < nseg; iseg++)
+    { if (first[iseg+1] == first[iseg]) continue;
+      for (ipt = first[iseg], nkept = 0; ipt < first[iseg+1]; ipt++)
+      { if (!keep[ipt]) continue;
+	lat[first[iseg] + nkept] = lat[ipt];
+	lon[first[iseg] + nkept] = lon[ipt];
+	++nkept;
+      }
+      draw_polyline(nkept, lat + first[iseg], lon + first[iseg]);
+      total_in += first[iseg+1] - first[iseg];
+      total_out += nkept;
+    }
+  }
+
+  if (verbose) fprintf(stderr,"> simplified %d points to %d.\n",
+		       total_in, total_out);
+}
+
+  
+/*------------------------------------------------------------------------
+ * simplify_segment - pick the points of one segment to keep
+ *
+ *  input: simplify - this thread's simplify_class
+ *         npts - number of points
+ *         lat, lon - the segment
+ *         x, y - work space
+ *
+ * output: keep - TRUE for each point kept, points that do not project
+ *            are kept and the segment is simplified between them
+ *------------------------------------------------------------------------*/ 
+
+static void simplify_segment(simplify_class *simplify, int npts,
+			     double *lat, double *lon,
+			     double *x, double *y, int *keep)
+{
+  int ipt, iend;
+  double u, v;
+
+  for (ipt = 0; ipt < npts; ipt++)
+  { keep[ipt] = 0 != forward_mapx(grid->mapx, lat[ipt], lon[ipt], &u, &v);
+    x[ipt] = u * grid->cols_per_map_unit;
+    y[ipt] = -v * grid->rows_per_map_unit;
+  }
+
+  for (ipt = 0; ipt < npts; ipt = iend + 1)
+  { if (keep[ipt]) { iend = ipt; continue; }
+    for (iend = ipt; iend + 1 < npts && !keep[iend + 1]; iend++);
+    if (simplify_polyline(simplify, iend - ipt + 1,
+			  x + ipt, y + ipt, keep + ipt) < 0)
+      for (; ipt <= iend; ipt++) keep[ipt] = TRUE;
+  }
+}
+
+  
 /*------------------------------------------------------------------------
  * thin_current_segment - check each stroke of the current segment
  *                        and thin to one stroke per 'thin' kilometers
@@ -653,8 +970,15 @@ void thin_current_segment()
     { lat -= (double)source->data_ptr->dlat*CDB_LAT_SCALE;
       lon -= (double)source->data_ptr->dlon*CDB_LON_SCALE;
       draw_pd(lat, lon);
-      x1 = x2;
-      y1 = y2;
+
+/*
+ *    draw_pd recentered the map on this point
+ */
+      forward_mapx(map, lat, lon, &x1, &y1);
+      x1 = nint(x1);
+      y1 = nint(y1);
+      x2 = x1;
+      y2 = y1;
       source->data_ptr--;
       idata--;
       ipoints++;
@@ -684,6 +1008,9 @@ void thin_current_segment()
 
 /*------------------------------------------------------------------------
  * copy_current_segment - copy each stroke of the current segment
+ *
+ * result: the loaded source segment is decoded into seg_lat, seg_lon
+ *         and drawn with draw_polyline
  *------------------------------------------------------------------------*/ 
 
  void copy_current_segment()
@@ -691,18 +1018,32 @@ void thin_current_segment()
   int idata;
   double lat = 0.0, lon = 0.0;
   
+  if (source->npoints + 1 > seg_size)
+  { seg_size = source->npoints + 1;
+    seg_lat = (double *)realloc(seg_lat, seg_size * sizeof(double));
+    seg_lon = (double *)realloc(seg_lon, seg_size * sizeof(double));
+    if (NULL == seg_lat || NULL == seg_lon)
+    { fprintf(stderr,"copy_current_segment: Unable to allocate %d points\n",
+	      seg_size);
+      exit(ABORT);
+    }
+  }
+
   lat = (double)source->segment->ilat0*CDB_LAT_SCALE;
   lon = (double)source->segment->ilon0*CDB_LON_SCALE;
-  
-  move_pu(lat, lon);
+  seg_lat[0] = lat;
+  seg_lon[0] = lon;
    
   for (idata = 1; idata <= source->npoints; 
        idata++, source->data_ptr++)
   {
     lat += (double)source->data_ptr->dlat*CDB_LAT_SCALE;
     lon += (double)source->data_ptr->dlon*CDB_LON_SCALE;
-    draw_pd(lat, lon);
+    seg_lat[idata] = lat;
+    seg_lon[idata] = lon;
   }
+
+  draw_polyline(source->npoints + 1, seg_lat, seg_lon);
 }
 
   
@@ -750,15 +1091,16 @@ void thin_current_segment()
  *     Read segment data back into current segment in reverse order
  */
 
-  dest->index[dest->seg_count].ilat0 = nint(lat[dest->npoints] / CDB_LAT_SCALE);
-  dest->index[dest->seg_count].ilon0 = nint(lon[dest->npoints] / CDB_LON_SCALE);
+  dest->index[dest->seg_count].ilat0 = round_cdb(lat[dest->npoints] / CDB_LAT_SCALE);
+  dest->index[dest->seg_count].ilon0 = round_cdb(lon[dest->npoints] / CDB_LON_SCALE);
 
   for(ipoints = dest->npoints - 1, dest->npoints = 0; 
       ipoints >= 0; ipoints--)
   {
-    draw_pd(lat[ipoints], lon[ipoints]);
+    add_point(lat[ipoints], lon[ipoints]);
       
   }
+  if (dest->npoints > 0) recenter_map(pen_lat, pen_lon);
   
   return;
 }
@@ -896,10 +1238,10 @@ void finish_new_file()
 			       compare == parallels_max ? CDB_INDEX_LAT_MAX :
 			       compare == meridians_max ? CDB_INDEX_LON_MAX :
 			       CDB_INDEX_SEG_ID);
-  dest->header->ilat_max = nint(north/CDB_LAT_SCALE);
-  dest->header->ilon_max = nint(east/CDB_LON_SCALE);
-  dest->header->ilat_min = nint(south/CDB_LAT_SCALE);
-  dest->header->ilon_min = nint(west/CDB_LON_SCALE);
+  dest->header->ilat_max = round_cdb(north/CDB_LAT_SCALE);
+  dest->header->ilon_max = round_cdb(east/CDB_LON_SCALE);
+  dest->header->ilat_min = round_cdb(south/CDB_LAT_SCALE);
+  dest->header->ilon_min = round_cdb(west/CDB_LON_SCALE);
   if (verbose) fprintf(stderr,">max segment size %d bytes.\n", 
 		       dest->header->max_seg_size);
 
@@ -953,7 +1295,7 @@ void finish_new_file()
 {
   double current_start_lat, current_start_lon;
   double current_end_lat, current_end_lon;
-  int ipoints, ios;
+  int ios;
   cdb_edit_join_method join_method = JOIN_NO_METHOD;
   cdb_index_entry *best_candidate = NULL;
   
@@ -980,6 +1322,12 @@ void finish_new_file()
   if (source->header->segment_rank > dest->header->segment_rank)
     dest->header->segment_rank = source->header->segment_rank;
 
+/*
+ *	hash segment endpoints so candidates are found without
+ *	checking every later segment
+ */
+  build_endpoint_hash();
+
 /*
  *	step thru segment dictionary entries
  */
@@ -994,27 +1342,18 @@ void finish_new_file()
     current_segment = source->segment;
     if((byte4)NULL == current_segment->addr)
       continue;
+    remove_endpoints(current_segment - source->index);
 
 /*
  *   Get start and end of current segment
  */
     load_current_seg_data_cdb(source);
+    copy_current_segment();
 
-    current_start_lat = (double)source->segment->ilat0 * CDB_LAT_SCALE;
-    current_start_lon = (double)source->segment->ilon0 * CDB_LON_SCALE;
-    
-    move_pu(current_start_lat, current_start_lon);
-    
-    current_end_lat = current_start_lat;
-    current_end_lon = current_start_lon;
-    
-    for(ipoints = 0; ipoints < source->npoints;
-	ipoints++, source->data_ptr++)
-    {
-      current_end_lat += (double) source->data_ptr->dlat * CDB_LAT_SCALE;
-      current_end_lon += (double) source->data_ptr->dlon * CDB_LON_SCALE;
-      draw_pd(current_end_lat, current_end_lon);
-    }
+    current_start_lat = seg_lat[0];
+    current_start_lon = seg_lon[0];
+    current_end_lat = seg_lat[source->npoints];
+    current_end_lon = seg_lon[source->npoints];
 
 /*
  *    Get start and end coordinates
@@ -1081,6 +1420,7 @@ void finish_new_file()
 	fprintf(stderr, "fatal error : join method not set.");
 	exit(ABORT);
       }                                         /* end case */
+      remove_endpoints(best_candidate - source->index);
 
 /*
  *     try to find another candidate
@@ -1111,6 +1451,7 @@ void finish_new_file()
   if (dest->npoints > 0) write_segment_data(dest->seg_count);
   
   finish_new_file();
+  free_endpoint_hash();
   
   return;
 }
@@ -1164,8 +1505,9 @@ void append_candidate(int reverse_candidate,
   
     for(ipoints = source->npoints; ipoints >= 0; ipoints--)
     {
-      draw_pd(lat[ipoints], lon[ipoints]);
+      add_point(lat[ipoints], lon[ipoints]);
     }
+    recenter_map(pen_lat, pen_lon);
    
     forward_mapx(map, lat[0], lon[0], current_x_end, current_y_end);
     temp_lat = dest->index[dest->seg_count].ilat0 * CDB_LAT_SCALE;
@@ -1177,8 +1519,9 @@ void append_candidate(int reverse_candidate,
   {
     for(ipoints = 0; ipoints <= source->npoints; ipoints++)
     {
-      draw_pd(lat[ipoints], lon[ipoints]);
+      add_point(lat[ipoints], lon[ipoints]);
     }
+    recenter_map(pen_lat, pen_lon);
    
     forward_mapx(map, lat[source->npoints], 
 		 lon[source->npoints], current_x_end, current_y_end);
@@ -1205,145 +1548,497 @@ void append_candidate(int reverse_candidate,
 
 cdb_index_entry *find_best_candidate(cdb_edit_join_method *join_method)
 {
-  int ipoints;
-  double temp_distance, distance = 100;
-  double candidate_start_lat, candidate_start_lon;
-  double candidate_end_lat, candidate_end_lon;
-  double candidate_x_start, candidate_y_start;
-  double candidate_x_end, candidate_y_end;
-  double temp_x, temp_y;
+  int icandidate, ncandidates, current_pos;
+  double distance = 100;
   cdb_index_entry *best_candidate = NULL;
   cdb_index_entry *candidate_segment = NULL;
   
   if (very_very_verbose) fprintf(stderr,">>> Searching candidates.\n");
    
-  candidate_segment = source->segment;
+  current_pos = current_segment - source->index;
   best_candidate = NULL;
 
-  for(next_segment_cdb(source);
-      candidate_segment < last_segment_cdb(source); 
-      next_segment_cdb(source))
-  {                                        /* begin find best candidate loop */
-    
-    candidate_segment = source->segment;
+/*
+ *	the hash only holds segments after the current one which have
+ *	not been joined yet, check them in index order so ties are
+ *	broken the same way as a scan of every later segment
+ */
+  ncandidates = near_endpoints();
+  if (ncandidates >= 0)
+  { for (icandidate = 0; icandidate < ncandidates; icandidate++)
+    { candidate_segment = source->index + endpoint_hits[icandidate];
+      if (candidate_segment - source->index <= current_pos) continue;
+      check_candidate(candidate_segment, &distance,
+		      &best_candidate, join_method);
+    }
+    return(best_candidate);
+  }
+
+/*
+ *	the search window is too large to hash, check every later segment
+ */
+  for(candidate_segment = current_segment + 1;
+      candidate_segment <= last_segment_cdb(source);
+      candidate_segment++)
+    check_candidate(candidate_segment, &distance,
+		    &best_candidate, join_method);
+
+  return(best_candidate);  
+}
+
+
+/*---------------------------------------------------------------------------
+ *  check_candidate - see if a segment is a better candidate for joining
+ *
+ *  input: candidate_segment - source segment to check
+ *         distance - distance to the best candidate so far
+ *         best_candidate - best candidate so far
+ *         join_method - join method of the best candidate so far
+ *
+ * output: distance, best_candidate, join_method - updated if candidate
+ *            is a better candidate
+ *-------------------------------------------------------------------------------*/
+
+static void check_candidate(cdb_index_entry *candidate_segment,
+			    double *distance, cdb_index_entry **best_candidate,
+			    cdb_edit_join_method *join_method)
+{
+  int ipoints;
+  double temp_distance;
+  double candidate_start_lat, candidate_start_lon;
+  double candidate_end_lat, candidate_end_lon;
+  double candidate_x_start, candidate_y_start;
+  double candidate_x_end, candidate_y_end;
+  double temp_x, temp_y;
+
+  source->segment = candidate_segment;
 
 /*
  *   Don't try to join a segment which has already been joined
  */  
   
-    if((byte4)NULL == candidate_segment->addr)
-    {
-      if (very_very_verbose) 
-	fprintf(stderr,">>>Segment %d has already been joined.\n",
-		source->segment->ID);
-      continue;
-    }
+  if((byte4)NULL == candidate_segment->addr)
+  {
+    if (very_very_verbose) 
+      fprintf(stderr,">>>Segment %d has already been joined.\n",
+	      source->segment->ID);
+    return;
+  }
 
 /*
  *    Don't create a segment which crosses 180
  */  
-    if(180 < fabs(current_segment->ilon_max - candidate_segment->ilon_min) * CDB_LON_SCALE)
-      continue;
+  if(180 < fabs(current_segment->ilon_max - candidate_segment->ilon_min) * CDB_LON_SCALE)
+    return;
 
 /*
  *  don't create a segment which is too long
  */
-    load_current_seg_data_cdb(source);
-    if(MAX_SEGMENT_POINTS < dest->npoints + source->npoints)
-      continue;
+  load_current_seg_data_cdb(source);
+  if(MAX_SEGMENT_POINTS < dest->npoints + source->npoints)
+    return;
 
 /*
  *   Set up for fine checks
  */
  
-    if (very_very_verbose) fprintf(stderr,"Checking candidate %d. \n", 
-				   source->segment->ID);
-    
-    candidate_start_lat = (double)source->segment->ilat0 * CDB_LAT_SCALE;
-    candidate_start_lon = (double)source->segment->ilon0 * CDB_LON_SCALE;
-    
-    if(!within_mapx(map, candidate_start_lat, candidate_start_lon)) continue;
+  if (very_very_verbose) fprintf(stderr,"Checking candidate %d. \n", 
+				 source->segment->ID);
+  
+  candidate_start_lat = (double)source->segment->ilat0 * CDB_LAT_SCALE;
+  candidate_start_lon = (double)source->segment->ilon0 * CDB_LON_SCALE;
+  
+  if(!within_mapx(map, candidate_start_lat, candidate_start_lon)) return;
 
-    candidate_end_lat = candidate_start_lat;
-    candidate_end_lon = candidate_start_lon;
-    
-    for(ipoints = 0; ipoints < source->npoints;
-	ipoints++, source->data_ptr++)
-    {
-      candidate_end_lat += (double) source->data_ptr->dlat * CDB_LAT_SCALE;
-      candidate_end_lon += (double) source->data_ptr->dlon * CDB_LON_SCALE;
-    }
-    
-    forward_mapx(map, candidate_start_lat, candidate_start_lon, 
-		 &candidate_x_start, &candidate_y_start);   
-    forward_mapx(map, candidate_end_lat, candidate_end_lon, 
-		 &candidate_x_end, &candidate_y_end);
-    
+  candidate_end_lat = candidate_start_lat;
+  candidate_end_lon = candidate_start_lon;
+  
+  for(ipoints = 0; ipoints < source->npoints;
+      ipoints++, source->data_ptr++)
+  {
+    candidate_end_lat += (double) source->data_ptr->dlat * CDB_LAT_SCALE;
+    candidate_end_lon += (double) source->data_ptr->dlon * CDB_LON_SCALE;
+  }
+  
+  forward_mapx(map, candidate_start_lat, candidate_start_lon, 
+	       &candidate_x_start, &candidate_y_start);   
+  forward_mapx(map, candidate_end_lat, candidate_end_lon, 
+	       &candidate_x_end, &candidate_y_end);
+  
 /*
  *    See if this candidate is a good one.
  *    If so do fine checks to see if it is the best candidate so far.   
  */
-    
-    if(fabs(current_x_start - candidate_x_start) <= 2 &&
-       fabs(current_y_start - candidate_y_start) <= 2 )
+  
+  if(fabs(current_x_start - candidate_x_start) <= 2 &&
+     fabs(current_y_start - candidate_y_start) <= 2 )
+  {
+    temp_x = current_x_start - candidate_x_start;
+    temp_y = current_y_start - candidate_y_start;
+    temp_distance = sqrt(SQ(temp_x) + SQ(temp_y));
+    if(temp_distance < *distance)
     {
-      temp_x = current_x_start - candidate_x_start;
-      temp_y = current_y_start - candidate_y_start;
-      temp_distance = sqrt(SQ(temp_x) + SQ(temp_y));
-      if(temp_distance < distance)
-      {
-	*join_method = JOIN_START_TO_START;
-	distance = temp_distance;
-	best_candidate = candidate_segment;
-      }
+      *join_method = JOIN_START_TO_START;
+      *distance = temp_distance;
+      *best_candidate = candidate_segment;
     }
-    
-    if(fabs(current_x_start - candidate_x_end) <= 2 &&
-       fabs(current_y_start - candidate_y_end) <= 2 )
+  }
+  
+  if(fabs(current_x_start - candidate_x_end) <= 2 &&
+     fabs(current_y_start - candidate_y_end) <= 2 )
+  {
+    temp_x = current_x_start - candidate_x_end;
+    temp_y = current_y_start - candidate_y_end;
+    temp_distance = sqrt(SQ(temp_x) + SQ(temp_y));
+    if(temp_distance < *distance)
     {
-      temp_x = current_x_start - candidate_x_end;
-      temp_y = current_y_start - candidate_y_end;
-      temp_distance = sqrt(SQ(temp_x) + SQ(temp_y));
-      if(temp_distance < distance)
-      {
-	*join_method = JOIN_START_TO_END;
-	distance = temp_distance;
-	best_candidate = candidate_segment;
-      }
+      *join_method = JOIN_START_TO_END;
+      *distance = temp_distance;
+      *best_candidate = candidate_segment;
     }
-    
-    if(fabs(current_x_end - candidate_x_start) <= 2 &&
-       fabs(current_y_end - candidate_y_start) <= 2 )
+  }
+  
+  if(fabs(current_x_end - candidate_x_start) <= 2 &&
+     fabs(current_y_end - candidate_y_start) <= 2 )
+  {
+    temp_x = current_x_end - candidate_x_start;
+    temp_y = current_y_end - candidate_y_start;
+    temp_distance = sqrt(SQ(temp_x) + SQ(temp_y));
+    if(temp_distance < *distance)
     {
-      temp_x = current_x_end - candidate_x_start;
-      temp_y = current_y_end - candidate_y_start;
-      temp_distance = sqrt(SQ(temp_x) + SQ(temp_y));
-      if(temp_distance < distance)
-      {
-	*join_method = JOIN_END_TO_START;
-	distance = temp_distance;
-	best_candidate = candidate_segment;
-      }
+      *join_method = JOIN_END_TO_START;
+      *distance = temp_distance;
+      *best_candidate = candidate_segment;
     }
-    
-    if(fabs(current_x_end - candidate_x_end) <= 2 &&
-       fabs(current_y_end - candidate_y_end) <= 2 )
+  }
+  
+  if(fabs(current_x_end - candidate_x_end) <= 2 &&
+     fabs(current_y_end - candidate_y_end) <= 2 )
+  {
+    temp_x = current_x_end - candidate_x_end;
+    temp_y = current_y_end - candidate_y_end;
+    temp_distance = sqrt(SQ(temp_x) + SQ(temp_y));
+    if(temp_distance < *distance)
     {
-      temp_x = current_x_end - candidate_x_end;
-      temp_y = current_y_end - candidate_y_end;
-      temp_distance = sqrt(SQ(temp_x) + SQ(temp_y));
-      if(temp_distance < distance)
-      {
-	*join_method = JOIN_END_TO_END;
-	distance = temp_distance;
-	best_candidate = candidate_segment;
+      *join_method = JOIN_END_TO_END;
+      *distance = temp_distance;
+      *best_candidate = candidate_segment;
+    }
+  }    
+}
+
+
+/*------------------------------------------------------------------------
+ * endpoint hash - start and end points of the source segments still
+ *            waiting to be joined, hashed by earth centered x,y,z cell
+ *
+ *	the join window is +/-2 units of the azimuthal equal area map,
+ *	units are map->scale km at the center and never smaller than
+ *	cos(c/2) times that at c radians from the center, so a search
+ *	radius of 2*sqrt(2)*scale/cos(c/2) on the sphere finds every
+ *	endpoint which can pass the checks in check_candidate
+ *------------------------------------------------------------------------*/
+
+static void endpoint_xyz(double lat, double lon, double xyz[3])
+{ double Re = map->equatorial_radius;
+
+  lat = RADIANS(lat);
+  lon = RADIANS(lon);
+  xyz[0] = Re * cos(lat) * cos(lon);
+  xyz[1] = Re * cos(lat) * sin(lon);
+  xyz[2] = Re * sin(lat);
+}
+
+static unsigned endpoint_hash(int ix, int iy, int iz)
+{ return ((unsigned)ix * 73856093u ^ (unsigned)iy * 19349663u
+	  ^ (unsigned)iz * 83492791u) & endpoint_mask;
+}
+
+static void insert_endpoint(int iend, double lat, double lon)
+{ double xyz[3];
+  unsigned ibucket;
+  cdb_edit_endpoint *this = endpoint + iend;
+
+  endpoint_xyz(lat, lon, xyz);
+  this->ix = (int)floor(xyz[0] / endpoint_cell);
+  this->iy = (int)floor(xyz[1] / endpoint_cell);
+  this->iz = (int)floor(xyz[2] / endpoint_cell);
+  ibucket = endpoint_hash(this->ix, this->iy, this->iz);
+  this->next = endpoint_bucket[ibucket];
+  endpoint_bucket[ibucket] = iend;
+}
+
+/*------------------------------------------------------------------------
+ * build_endpoint_hash - hash the endpoints of every unjoined source segment
+ *------------------------------------------------------------------------*/
+static void build_endpoint_hash(void)
+{ int iseg, ipoints, nbuckets;
+  double lat, lon;
+
+  endpoint_cell = ENDPOINT_MARGIN * 2 * sqrt(2.) * map->scale;
+
+  for (nbuckets = 1; nbuckets < 2 * source->seg_count; nbuckets <<= 1);
+  endpoint_mask = nbuckets - 1;
+  endpoint = (cdb_edit_endpoint *)
+    malloc(2 * source->seg_count * sizeof(cdb_edit_endpoint) + 1);
+  endpoint_bucket = (int *)malloc(nbuckets * sizeof(int));
+  endpoint_hits = (int *)malloc(4 * source->seg_count * sizeof(int) + 1);
+  if (NULL == endpoint || NULL == endpoint_bucket || NULL == endpoint_hits)
+  { fprintf(stderr,"cdb_edit: unable to allocate endpoint hash for %d segments\n",
+	    source->seg_count);
+    exit(ABORT);
+  }
+  for (ipoints = 0; ipoints < nbuckets; ipoints++)
+    endpoint_bucket[ipoints] = -1;
+
+  for (iseg = 0; iseg < source->seg_count; iseg++)
+  { endpoint[2*iseg].next = endpoint[2*iseg+1].next = ENDPOINT_REMOVED;
+    source->segment = source->index + iseg;
+    if (0 == source->segment->addr) continue;
+
+    load_current_seg_data_cdb(source);
+    lat = (double)source->segment->ilat0 * CDB_LAT_SCALE;
+    lon = (double)source->segment->ilon0 * CDB_LON_SCALE;
+    insert_endpoint(2*iseg, lat, lon);
+    for (ipoints = 0; ipoints < source->npoints;
+	 ipoints++, source->data_ptr++)
+    { lat += (double) source->data_ptr->dlat * CDB_LAT_SCALE;
+      lon += (double) source->data_ptr->dlon * CDB_LON_SCALE;
+    }
+    insert_endpoint(2*iseg+1, lat, lon);
+  }
+
+  if (very_verbose) fprintf(stderr,">>hashed %d endpoints, %lf km cells.\n",
+			    2 * source->seg_count, endpoint_cell);
+}
+
+/*------------------------------------------------------------------------
+ * remove_endpoints - take a source segment out of the endpoint hash
+ *
+ *  input: iseg - position of the segment in the source index
+ *------------------------------------------------------------------------*/
+static void remove_endpoints(int iseg)
+{ int iend, *link;
+  cdb_edit_endpoint *this;
+
+  for (iend = 2*iseg; iend <= 2*iseg+1; iend++)
+  { this = endpoint + iend;
+    if (ENDPOINT_REMOVED == this->next) continue;
+    link = endpoint_bucket + endpoint_hash(this->ix, this->iy, this->iz);
+    while (*link != iend) link = &endpoint[*link].next;
+    *link = this->next;
+    this->next = ENDPOINT_REMOVED;
+  }
+}
+
+static int compare_hits(const void *a, const void *b)
+{ return *(const int *)a - *(const int *)b;
+}
+
+/*------------------------------------------------------------------------
+ * near_endpoints - find segments with an endpoint near the current
+ *            segment's start or end
+ *
+ * result: endpoint_hits - source index positions in increasing order
+ *
+ * return: number of segments found
+ *         -1 if the search window is too large to hash
+ *------------------------------------------------------------------------*/
+static int near_endpoints(void)
+{ int iend, nhits, ihit, ncells, ix, iy, iz, ix0, iy0, iz0, ientry;
+  double u[2], v[2], lat, lon, uu, vv, xyz[3], center[3];
+  double cos_c, scale;
+  cdb_edit_endpoint *this;
+
+  u[0] = current_x_start; v[0] = current_y_start;
+  u[1] = current_x_end; v[1] = current_y_end;
+  endpoint_xyz(map->lat0, map->lon0, center);
+
+  nhits = 0;
+  for (iend = 0; iend < 2; iend++)
+  { 
+/*
+ *	recover the point the checks compare against
+ */
+    if (0 != inverse_mapx(map, u[iend], v[iend], &lat, &lon)) return -1;
+    if (0 != forward_mapx(map, lat, lon, &uu, &vv)) return -1;
+    if (fabs(uu - u[iend]) > 1e-3 || fabs(vv - v[iend]) > 1e-3) return -1;
+
+    endpoint_xyz(lat, lon, xyz);
+    cos_c = (xyz[0]*center[0] + xyz[1]*center[1] + xyz[2]*center[2])
+      / SQ(map->equatorial_radius);
+    scale = sqrt((1 + cos_c) / 2);
+    if (scale < ENDPOINT_MIN_SCALE) return -1;
+    ncells = (int)ceil(1 / scale);
+
+    ix0 = (int)floor(xyz[0] / endpoint_cell);
+    iy0 = (int)floor(xyz[1] / endpoint_cell);
+    iz0 = (int)floor(xyz[2] / endpoint_cell);
+    for (ix = ix0 - ncells; ix <= ix0 + ncells; ix++)
+    { for (iy = iy0 - ncells; iy <= iy0 + ncells; iy++)
+      { for (iz = iz0 - ncells; iz <= iz0 + ncells; iz++)
+	{ for (ientry = endpoint_bucket[endpoint_hash(ix, iy, iz)];
+	       ientry >= 0; ientry = this->next)
+	  { this = endpoint + ientry;
+	    if (this->ix == ix && this->iy == iy && this->iz == iz)
+	      endpoint_hits[nhits++] = ientry / 2;
+	  }
+	}
       }
-    }    
-  }                          /** end find best candidate loop  **/
-  return(best_candidate);  
+    }
+  }
+
+/*
+ *	sort into index order and drop duplicates
+ */
+  qsort(endpoint_hits, nhits, sizeof(int), compare_hits);
+  for (ihit = 0, iend = 0; ihit < nhits; ihit++)
+    if (0 == iend || endpoint_hits[ihit] != endpoint_hits[iend-1])
+      endpoint_hits[iend++] = endpoint_hits[ihit];
+
+  return iend;
+}
+
+/*------------------------------------------------------------------------
+ * free_endpoint_hash - release the endpoint hash
+ *------------------------------------------------------------------------*/
+static void free_endpoint_hash(void)
+{ free(endpoint); endpoint = NULL;
+  free(endpoint_bucket); endpoint_bucket = NULL;
+  free(endpoint_hits); endpoint_hits = NULL;
 }
 
 
+/*------------------------------------------------------------------------
+ * write_lod_levels - thin source again for each level of detail
+ *
+ *  input: thin_filename - clipped (and joined) source file
+ *
+ * result: each level is written to a temporary lod<n>_ file then
+ *         appended to the new file
+ *------------------------------------------------------------------------*/ 
+
+void write_lod_levels(char *thin_filename)
+{
+  int ilod;
+  char *base_filename = new_filename;
+  char *lod_filename[CDB_MAX_LOD];
+
+/*
+ *	levels of detail are thinned in kilometers, not simplified
+ *	in the grid
+ */
+  simplify_method = 0;
+
+  for (ilod = 0; ilod < lod_count; ilod++)
+  {
+    sprintf(temp, "lod%d_%s", ilod+1, base_filename);
+    lod_filename[ilod] = strdup(temp);
+    new_filename = lod_filename[ilod];
 
+    source = init_cdb(thin_filename);
+    if(source == NULL) { perror(thin_filename); exit(ABORT); }
 
+    thin = lod_thin[ilod];
+    map->scale = thin/3;
+    map->x0 = map->y0 = KEYVAL_UNINITIALIZED;
+    reinit_mapx(map);
 
+    if (verbose) fprintf(stderr,">thinning level of detail %d to %lf km...\n", 
+			 ilod+1, thin);
+    thin_map();
+    if (dest->npoints > 0) write_segment_data(dest->seg_count);
+    if (do_sort)
+      qsort(dest->index, dest->seg_count, sizeof(cdb_index_entry), compare);
+
+/*
+ *	each level opens its own source, make sure it is released
+ *	before the next (finish_new_file normally frees it already)
+ */
+    finish_new_file();
+    if (NULL != source) { free_cdb(source); source = NULL; }
+  }
+
+  new_filename = base_filename;
+  append_lod_levels(lod_filename);
+
+  for (ilod = 0; ilod < lod_count; ilod++)
+  { remove(lod_filename[ilod]);
+    free(lod_filename[ilod]);
+  }
+}
+
+
+/*------------------------------------------------------------------------
+ * append_lod_levels - add level of detail directory and levels
+ *
+ *  input: lod_filename - finished cdb file for each level
+ *
+ * result: the directory is written just after the index of the new
+ *         file, followed by a copy of each level file
+ *------------------------------------------------------------------------*/ 
+
+void append_lod_levels(char **lod_filename)
+{
+  int ilod, ios;
+  FILE *lod_file;
+  cdb_file_header header;
+  cdb_lod_header lod;
+  byte1 buffer[65536];
+
+  new_file = fopen(new_filename, "r+");
+  if (NULL == new_file) { perror(new_filename); exit(ABORT); }
+  if (fread(&header, 1, CDB_FILE_HEADER_SIZE, new_file) != CDB_FILE_HEADER_SIZE)
+  { perror(new_filename); exit(ABORT); }
+  cdb_byteswap_header(&header);
+
+/*
+ *	reserve space for directory
+ */
+  memset(&lod, 0, sizeof(lod));
+  lod.code_number = CDB_LOD_MAGIC_NUMBER;
+  lod.count = lod_count;
+  fseek(new_file, (long)header.index_addr + header.index_size, SEEK_SET);
+  if (fwrite(&lod, 1, CDB_LOD_HEADER_SIZE, new_file) != CDB_LOD_HEADER_SIZE)
+  { fprintf(stderr,"cdb_edit: error writing level of detail directory.\n");
+    perror(new_filename);
+    exit(ABORT);
+  }
+
+/*
+ *	copy levels
+ */
+  for (ilod = 0; ilod < lod_count; ilod++)
+  {
+    lod.addr[ilod] = ftell(new_file);
+    lod.tolerance[ilod] = nint(lod_thin[ilod]*1000);
+    lod_file = fopen(lod_filename[ilod], "r");
+    if (NULL == lod_file) { perror(lod_filename[ilod]); exit(ABORT); }
+    while ((ios = fread(buffer, 1, sizeof(buffer), lod_file)) > 0)
+    { if (fwrite(buffer, 1, (size_t)ios, new_file) != (size_t)ios)
+      { fprintf(stderr,"cdb_edit: error writing level of detail %d.\n", 
+		ilod+1);
+	perror(new_filename);
+	exit(ABORT);
+      }
+    }
+    fclose(lod_file);
+    if (verbose) fprintf(stderr,">appended level of detail %d at %d.\n", 
+			 ilod+1, lod.addr[ilod]);
+  }
+
+/*
+ *	output directory
+ */
+  cdb_byteswap_lod_header(&lod);
+  fseek(new_file, (long)header.index_addr + header.index_size, SEEK_SET);
+  ios = fwrite(&lod, 1, CDB_LOD_HEADER_SIZE, new_file);
+  if (ios != CDB_LOD_HEADER_SIZE)
+  { fprintf(stderr,"cdb_edit: error writing level of detail directory.\n");
+    perror(new_filename);
+    exit(ABORT);
+  }
+
+  fclose(new_file);
+  new_file = NULL;
+}
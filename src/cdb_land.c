@@ -0,0 +1,177 @@
+/*========================================================================
+ * cdb_land - land or sea at a list of points from a coastline database
+ *
+ * National Snow & Ice Data Center, University of Colorado, Boulder
+ * Copyright (C) 2026 University of Colorado
+ *========================================================================*/
+static const char cdb_land_c_rcsid[] = "$Id$";
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "define.h"
+#include "cdb.h"
+#include "point_io.h"
+#include "land.h"
+
+#define usage "\n"\
+  "usage: cdb_land [-vbE -d cdb_file -c cell_size -P npts] [points_file]\n"\
+  "\n"\
+  " input : points_file - list of locations one lat/lon pair per line\n"\
+  "                       (default stdin)\n"\
+  "\n"\
+  " output: > stdout - list of 'lat lon flag' for each input point,\n"\
+  "                    flag is 1 on land, 0 on sea\n"\
+  "\n"\
+  " option: d cdb_filename - specify coastline database\n"\
+  "                          default is global.cdb\n"\
+  "                          join segments first with cdb_edit -j,\n"\
+  "                          only closed segments are used\n"\
+  "         c cell_size - index grid cell size in degrees\n"\
+  "                       (default depends on the number of edges)\n"\
+  "         P npts - read up to npts points at a time (default 65536)\n"\
+  "         b - binary input and output, each input point is a\n"\
+  "             float64 lat and float64 lon, the output is one byte\n"\
+  "             flag per point in the same order\n"\
+  "         E - binary input points are big-endian (default is native)\n"\
+  "         v - verbose\n"\
+  "\n"
+
+#define CDB_DEFAULT "global.cdb"
+
+int main(int argc, char *argv[])
+{ int i, npts, batch_size, point_flags, verbose, status;
+  int total_points, total_land;
+  double cell_size, *lat, *lon;
+  byte1 *on_land;
+  char *option, *cdb_filename, *points_filename;
+  cdb_class *cdb = NULL;
+  land_class *land = NULL;
+  point_io_class *points = NULL;
+
+/*
+ *	set defaults
+ */
+  status = EXIT_FAILURE;
+  verbose = 0;
+  point_flags = 0;
+  batch_size = 65536;
+  cell_size = 0;
+  cdb_filename = strdup(CDB_DEFAULT);
+  lat = lon = NULL;
+  on_land = NULL;
+
+/*
+ *	get command line options
+ */
+  while (--argc > 0 && (*++argv)[0] == '-')
+  { for (option = argv[0]+1; *option != '\0'; option++)
+    { switch (*option)
+      { case 'd':
+	  ++argv; --argc;
+	  if (argc <= 0) error_exit(usage);
+	  cdb_filename = strdup(*argv);
+	  break;
+	case 'c':
+	  ++argv; --argc;
+	  if (argc <= 0 || sscanf(*argv, "%lf", &cell_size) != 1)
+	    error_exit(usage);
+	  break;
+	case 'P':
+	  ++argv; --argc;
+	  if (argc <= 0 || sscanf(*argv, "%d", &batch_size) != 1
+	      || batch_size < 1)
+	    error_exit(usage);
+	  break;
+	case 'b':
+	  point_flags |= point_io_BINARY;
+	  break;
+	case 'E':
+	  point_flags |= point_io_BIG_ENDIAN;
+	  break;
+	case 'v':
+	  ++verbose;
+	  break;
+	case 'V':
+	  fprintf(stderr,"%s\n", cdb_land_c_rcsid);
+	  break;
+	default:
+	  fprintf(stderr, "invalid option %c\n", *option);
+	  error_exit(usage);
+      }
+    }
+  }
+
+/*
+ *	process command line arguments
+ */
+  if (argc > 1) error_exit(usage);
+  points_filename = argc > 0 ? *argv : NULL;
+
+  cdb = init_cdb(cdb_filename);
+  if (!cdb)
+  { fprintf(stderr,"cdb_land: error openning coastline database\n");
+    goto cleanup;
+  }
+
+  land = init_land(cell_size);
+  if (!land) goto cleanup;
+  if (add_cdb_land(land, cdb)) goto cleanup;
+  if (index_land(land)) goto cleanup;
+  if (verbose)
+  { fprintf(stderr,"> %d rings (%d around a pole), %d not closed\n",
+	    land->num_rings, land->num_polar, land->num_open);
+    fprintf(stderr,"> %d edges, %dx%d grid of %.4f degree cells, "
+	    "%d edge entries\n", land->num_edges, land->cols, land->rows,
+	    land->cell * CDB_LAT_SCALE, land->first[land->cols*land->rows]);
+  }
+  free_cdb(cdb);
+  cdb = NULL;
+
+  points = init_point_io(points_filename, point_flags);
+  if (!points) goto cleanup;
+
+  lat = (double *)malloc(batch_size * sizeof(double));
+  lon = (double *)malloc(batch_size * sizeof(double));
+  on_land = (byte1 *)malloc(batch_size * sizeof(byte1));
+  if (!lat || !lon || !on_land) { perror("cdb_land"); goto cleanup; }
+
+/*
+ *	answer a batch of points at a time
+ */
+  total_points = total_land = 0;
+  while ((npts = read_points_io(points, batch_size, lat, lon, NULL)) > 0)
+  { i = query_land(land, npts, lat, lon, on_land);
+    if (i < 0) goto cleanup;
+    total_land += i;
+    total_points += npts;
+
+    if (point_flags & point_io_BINARY)
+      fwrite(on_land, sizeof(byte1), npts, stdout);
+    else
+    { for (i = 0; i < npts; i++)
+	printf("%f %f %d\n", lat[i], lon[i], on_land[i]);
+    }
+    if (ferror(stdout))
+    { perror("writing to stdout");
+      goto cleanup;
+    }
+  }
+  if (verbose) fprintf(stderr,"> %d points, %d on land\n",
+		       total_points, total_land);
+  status = EXIT_SUCCESS;
+
+/*
+ *	clean up
+ */
+ cleanup:
+  if (lat) free(lat);
+  if (lon) free(lon);
+  if (on_land) free(on_land);
+  close_point_io(points);
+  free_land(land);
+  free_cdb(cdb);
+
+  exit(status);
+}
@@ -0,0 +1,208 @@
+/*========================================================================
+ * cdb_raster - scan convert a coastline database into a grid
+ *
+ * National Snow & Ice Data Center, University of Colorado, Boulder
+ * Copyright (C) 2026 University of Colorado
+ *========================================================================*/
+static const char cdb_raster_c_rcsid[] = "$Id$";
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "define.h"
+#include "grids.h"
+#include "grid_io.h"
+#include "cdb.h"
+#include "raster.h"
+
+#define usage "\n"\
+  "usage: cdb_raster [-vawcubslf -d cdb_file -t tolerance -L line_value\n"\
+  "                   -F fill_value -B background] gpd_file data_file\n"\
+  "\n"\
+  " input : gpd_file - grid parameters definition\n"\
+  "\n"\
+  " output: data_file - gridded data file (flat file by rows)\n"\
+  "\n"\
+  " option: d cdb_filename - specify coastline database\n"\
+  "                          default is global.cdb\n"\
+  "         t tolerance - pick the coarsest level of detail in the\n"\
+  "                       coastline database thinned to no more than\n"\
+  "                       tolerance kilometers, 0 = full resolution\n"\
+  "                       (default is the grid cell size)\n"\
+  "         L line_value - draw segments with line_value\n"\
+  "                        (default 1 if -F is not given)\n"\
+  "         F fill_value - fill closed segments with fill_value\n"\
+  "                        (join segments first with cdb_edit -j)\n"\
+  "         B background - value of all other cells (default 0)\n"\
+  "         a - anti-alias lines, cells near a line get a mix of\n"\
+  "             line_value and the value beneath\n"\
+  "         c - coverage fill, cells get a mix of fill_value and\n"\
+  "             background in proportion to the area filled\n"\
+  "         w - fill by non-zero winding number (default even-odd)\n"\
+  "         u - unsigned data\n"\
+  "         b - 1 byte data (default)\n"\
+  "         s - short (2 bytes per sample)\n"\
+  "         l - long (4 bytes)\n"\
+  "         f - single precision floating point (4 bytes)\n"\
+  "         v - verbose\n"\
+  "\n"
+
+#define CDB_DEFAULT "global.cdb"
+
+int main(int argc, char *argv[])
+{ int flags, verbose, datum_size, ncells, status;
+  bool signed_data, real_data;
+  double tolerance, line_value, fill_value, background;
+  char *option, *cdb_filename;
+  grid_class *grid = NULL;
+  cdb_class *cdb = NULL;
+  raster_class *raster = NULL;
+  grid_io_class *data = NULL;
+
+/*
+ *	set defaults
+ */
+  status = EXIT_FAILURE;
+  flags = 0;
+  verbose = 0;
+  datum_size = 1;
+  signed_data = TRUE;
+  real_data = FALSE;
+  tolerance = -1;
+  line_value = 1;
+  fill_value = 1;
+  background = 0;
+  cdb_filename = strdup(CDB_DEFAULT);
+
+/*
+ *	get command line options
+ */
+  while (--argc > 0 && (*++argv)[0] == '-')
+  { for (option = argv[0]+1; *option != '\0'; option++)
+    { switch (*option)
+      { case 'd':
+	  ++argv; --argc;
+	  if (argc <= 0) error_exit(usage);
+	  cdb_filename = strdup(*argv);
+	  break;
+	case 't':
+	  ++argv; --argc;
+	  if (argc <= 0 || sscanf(*argv, "%lf", &tolerance) != 1)
+	    error_exit(usage);
+	  break;
+	case 'L':
+	  ++argv; --argc;
+	  if (argc <= 0 || sscanf(*argv, "%lf", &line_value) != 1)
+	    error_exit(usage);
+	  flags |= raster_LINES;
+	  break;
+	case 'F':
+	  ++argv; --argc;
+	  if (argc <= 0 || sscanf(*argv, "%lf", &fill_value) != 1)
+	    error_exit(usage);
+	  flags |= raster_FILL;
+	  break;
+	case 'B':
+	  ++argv; --argc;
+	  if (argc <= 0 || sscanf(*argv, "%lf", &background) != 1)
+	    error_exit(usage);
+	  break;
+	case 'a':
+	  flags |= raster_ANTIALIAS;
+	  break;
+	case 'c':
+	  flags |= raster_COVERAGE;
+	  break;
+	case 'w':
+	  flags |= raster_WINDING;
+	  break;
+	case 'b':
+	  datum_size = 1;
+	  break;
+	case 's':
+	  datum_size = 2;
+	  break;
+	case 'l':
+	  datum_size = 4;
+	  break;
+	case 'f':
+	  datum_size = 4;
+	  real_data = TRUE;
+	  break;
+	case 'u':
+	  signed_data = FALSE;
+	  break;
+	case 'v':
+	  ++verbose;
+	  break;
+	case 'V':
+	  fprintf(stderr,"%s\n", cdb_raster_c_rcsid);
+	  break;
+	default:
+	  fprintf(stderr, "invalid option %c\n", *option);
+	  error_exit(usage);
+      }
+    }
+  }
+  if (!(flags & (raster_LINES | raster_FILL))) flags |= raster_LINES;
+
+/*
+ *	process command line arguments
+ */
+  if (argc != 2) error_exit(usage);
+
+  grid = init_grid(*argv);
+  if (!grid) goto cleanup;
+  if (verbose) fprintf(stderr,"> .gpd file %s\n> .mpp file %s\n",
+		       grid->gpd_filename, grid->mapx->mpp_filename);
+  ++argv; --argc;
+
+  cdb = init_cdb(cdb_filename);
+  if (!cdb)
+  { fprintf(stderr,"cdb_raster: error openning coastline database\n");
+    goto cleanup;
+  }
+
+/*
+ *	default tolerance is the grid cell size in kilometers
+ */
+  if (tolerance < 0) tolerance = grid_cell_size_km(grid);
+
+  raster = init_raster(grid, flags);
+  if (!raster) goto cleanup;
+  if (verbose && raster->period > 0)
+    fprintf(stderr,"> cylindrical grid, %.2f columns around\n",
+	    raster->period);
+
+  if (add_cdb_raster(raster, cdb, tolerance)) goto cleanup;
+  if (verbose)
+  { fprintf(stderr,"> %d segments, %d line segments, %d fill edges\n",
+	    raster->num_polylines, raster->num_lines, raster->num_edges);
+    if (flags & raster_FILL)
+      fprintf(stderr,"> %d filled, %d not closed, %d not projectable\n",
+	      raster->num_rings, raster->num_open, raster->num_skipped);
+  }
+
+  data = init_grid_io(grid->cols, grid->rows, datum_size,
+		      signed_data, real_data, grid_io_WRITE, *argv);
+  if (!data) goto cleanup;
+  if (verbose) fprintf(stderr,"> data file %s, %dx%d\n",
+		       data->filename, data->width, data->height);
+
+  ncells = render_raster(raster, data, background, fill_value, line_value);
+  if (ncells < 0) goto cleanup;
+  if (verbose) fprintf(stderr,"> %d cells drawn\n", ncells);
+  status = EXIT_SUCCESS;
+
+/*
+ *	clean up
+ */
+ cleanup:
+  close_grid_io(data);
+  free_raster(raster);
+  free_cdb(cdb);
+  close_grid(grid);
+
+  exit(status);
+}
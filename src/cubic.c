@@ -0,0 +1,272 @@
+/*========================================================================
+ * cubic - cubic convolution interpolation kernels
+ *
+ *	The 4x4 cubic convolution stencil is separable, so the weights
+ *	are computed once per point as two 1-D vectors (columns and
+ *	rows). Each row of the window is reduced with its column weights
+ *	and the row results are combined with the row weights.
+ *
+ *	Points whose window lies entirely inside the grid take a fast
+ *	path with no bounds checks. Points near the edge take a masked
+ *	path that skips taps outside the grid, as the original regrid
+ *	and ungrid did. The window starts at floor(r) - 1, so for r or
+ *	s in [-0.5,0) it is the one around the point, not one to the
+ *	right as with the original (int) truncation.
+ *
+ * National Snow & Ice Data Center, University of Colorado, Boulder
+ * Copyright (C) 2026 University of Colorado
+ *========================================================================*/
+static const char cubic_c_rcsid[] = "$Id$";
+
+#include "define.h"
+#define cubic_c_
+#include "cubic.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+const char *id_cubic(void)
+{
+  return cubic_c_rcsid;
+}
+
+/*------------------------------------------------------------------------
+ * weights_cubic - 1-D cubic convolution weights
+ *
+ *	input : d - fractional offset from the second tap (0 <= d < 1),
+ *		    i.e. x - floor(x), not x - (int)x which is negative
+ *		    for x < 0
+ *
+ *	output: w - weights for taps at -1, 0, +1, +2
+ *
+ *------------------------------------------------------------------------*/
+void weights_cubic(double d, double w[4])
+{
+  w[0] = -d*(1-d)*(1-d);
+  w[1] = (1 - 2*d*d + d*d*d);
+  w[2] = d*(1 + d - d*d);
+  w[3] = -d*d*(1-d);
+}
+
+/*------------------------------------------------------------------------
+ * valid_tap - apply mask tests to a single sample
+ *------------------------------------------------------------------------*/
+static bool valid_tap(float value, cubic_mask *mask)
+{
+  if (!mask) return TRUE;
+  if (mask->ignore_fill && mask->fill == value) return FALSE;
+  if (mask->max_set && mask->max_value < value) return FALSE;
+  if (mask->min_set && mask->min_value > value) return FALSE;
+  return TRUE;
+}
+
+/*------------------------------------------------------------------------
+ * dot4_cubic - weighted sum of four consecutive samples
+ *
+ *	input : v - first of four samples
+ *		w - column weights
+ *		mask - validity tests (may be NULL)
+ *
+ *	output: vsum - sum of weight*value over valid samples
+ *		wsum - sum of weights over valid samples
+ *
+ *	result: number of valid samples
+ *
+ *------------------------------------------------------------------------*/
+#ifdef __SSE2__
+static int dot4_cubic(float *v, double w[4], cubic_mask *mask,
+		      double *vsum, double *wsum)
+{ __m128 x, ok;
+  __m128i oki;
+  __m128d xlo, xhi, wlo, whi, vs, ws;
+  double out[2];
+  int bits;
+
+  x = _mm_loadu_ps(v);
+  ok = _mm_castsi128_ps(_mm_set1_epi32(-1));
+  if (mask)
+  { if (mask->ignore_fill)
+      ok = _mm_and_ps(ok, _mm_cmpneq_ps(x, _mm_set1_ps(mask->fill)));
+    if (mask->max_set)
+      ok = _mm_and_ps(ok, _mm_cmpngt_ps(x, _mm_set1_ps(mask->max_value)));
+    if (mask->min_set)
+      ok = _mm_and_ps(ok, _mm_cmpnlt_ps(x, _mm_set1_ps(mask->min_value)));
+  }
+  bits = _mm_movemask_ps(ok);
+
+/*
+ *	zero rejected samples so that e.g. Inf fill values
+ *	do not poison the sum, then widen to double
+ */
+  x = _mm_and_ps(x, ok);
+  xlo = _mm_cvtps_pd(x);
+  xhi = _mm_cvtps_pd(_mm_movehl_ps(x, x));
+
+  oki = _mm_castps_si128(ok);
+  wlo = _mm_and_pd(_mm_loadu_pd(w),
+		   _mm_castsi128_pd(_mm_unpacklo_epi32(oki, oki)));
+  whi = _mm_and_pd(_mm_loadu_pd(w + 2),
+		   _mm_castsi128_pd(_mm_unpackhi_epi32(oki, oki)));
+
+  vs = _mm_add_pd(_mm_mul_pd(wlo, xlo), _mm_mul_pd(whi, xhi));
+  ws = _mm_add_pd(wlo, whi);
+
+  _mm_storeu_pd(out, vs);
+  *vsum = out[0] + out[1];
+  _mm_storeu_pd(out, ws);
+  *wsum = out[0] + out[1];
+
+  return (bits & 1) + ((bits >> 1) & 1) + ((bits >> 2) & 1) + ((bits >> 3) & 1);
+}
+#else
+static int dot4_cubic(float *v, double w[4], cubic_mask *mask,
+		      double *vsum, double *wsum)
+{ int k, n;
+  double vs, ws;
+
+  vs = ws = 0;
+  n = 0;
+  for (k = 0; k < 4; k++)
+  { if (!valid_tap(v[k], mask)) continue;
+    vs += w[k]*v[k];
+    ws += w[k];
+    ++n;
+  }
+  *vsum = vs;
+  *wsum = ws;
+  return n;
+}
+#endif
+
+/*------------------------------------------------------------------------
+ * sum_cubic - weighted sums over the 4x4 cubic convolution window
+ *
+ *	input : data - grid data matrix
+ *		rows, cols - grid dimensions
+ *		r, s - column, row coordinates within grid
+ *		mask - validity tests (may be NULL)
+ *
+ *	output: value_sum - sum of weight*value over valid samples
+ *		weight_sum - sum of weights over valid samples
+ *
+ *	result: number of valid samples
+ *
+ *	note: the sums are returned unnormalized so that callers
+ *	      can accumulate them (e.g. regrid -z preload)
+ *
+ *------------------------------------------------------------------------*/
+int sum_cubic(float **data, int rows, int cols, double r, double s,
+	      cubic_mask *mask, double *value_sum, double *weight_sum)
+{ int k, col0, row0, col, row, npts;
+  double ccr[4], ccs[4], vs, ws, vsum, wsum;
+
+  col0 = (int)floor(r);
+  row0 = (int)floor(s);
+  weights_cubic(r - col0, ccr);
+  weights_cubic(s - row0, ccs);
+  --col0;
+  --row0;
+
+  vsum = wsum = 0;
+  npts = 0;
+
+  if (col0 >= 0 && col0 + 3 < cols && row0 >= 0 && row0 + 3 < rows)
+  {
+/*
+ *	interior - whole window on the grid
+ */
+    for (k = 0; k < 4; k++)
+    { npts += dot4_cubic(data[row0 + k] + col0, ccr, mask, &vs, &ws);
+      vsum += ccs[k]*vs;
+      wsum += ccs[k]*ws;
+    }
+  }
+  else
+  {
+/*
+ *	edge - skip taps that fall off the grid
+ */
+    for (k = 0, row = row0; k < 4; k++, row++)
+    { if (row < 0 || row >= rows) continue;
+      vs = ws = 0;
+      for (col = col0; col <= col0 + 3; col++)
+      { if (col < 0 || col >= cols) continue;
+	if (!valid_tap(data[row][col], mask)) continue;
+	vs += ccr[col - col0]*data[row][col];
+	ws += ccr[col - col0];
+	++npts;
+      }
+      vsum += ccs[k]*vs;
+      wsum += ccs[k]*ws;
+    }
+  }
+
+  *value_sum = vsum;
+  *weight_sum = wsum;
+  return npts;
+}
+
+/*------------------------------------------------------------------------
+ * eval_cubic - cubic convolution interpolation at a single point
+ *
+ *	input : data - grid data matrix
+ *		rows, cols - grid dimensions
+ *		r, s - column, row coordinates within grid
+ *		mask - validity tests (may be NULL)
+ *		fill_value - result if no valid samples
+ *
+ *	output: value - interpolated value
+ *
+ *	result: number of valid samples
+ *
+ *------------------------------------------------------------------------*/
+int eval_cubic(float **data, int rows, int cols, double r, double s,
+	       cubic_mask *mask, float fill_value, float *value)
+{ int npts;
+  double value_sum, weight_sum;
+
+  npts = sum_cubic(data, rows, cols, r, s, mask, &value_sum, &weight_sum);
+
+  if (npts > 0)
+  { *value = value_sum;
+    if (weight_sum != 0) *value /= weight_sum;
+  }
+  else
+  { *value = fill_value;
+  }
+
+  return npts;
+}
+
+/*------------------------------------------------------------------------
+ * eval_cubic_array - cubic convolution interpolation at many points
+ *
+ *	input : data - grid data matrix
+ *		rows, cols - grid dimensions
+ *		npts - number of points
+ *		r, s - column, row coordinates of each point
+ *		mask - validity tests (may be NULL)
+ *		fill_value - result for points with no valid samples
+ *
+ *	output: value - interpolated value for each point
+ *		nsamples - number of valid samples for each point
+ *			   (may be NULL)
+ *
+ *	result: number of points with at least one valid sample
+ *
+ *------------------------------------------------------------------------*/
+int eval_cubic_array(float **data, int rows, int cols, int npts,
+		     double *r, double *s, cubic_mask *mask,
+		     float fill_value, float *value, int *nsamples)
+{ int i, n, nvalid;
+
+  nvalid = 0;
+  for (i = 0; i < npts; i++)
+  { n = eval_cubic(data, rows, cols, r[i], s[i], mask, fill_value, value+i);
+    if (nsamples) nsamples[i] = n;
+    if (n > 0) ++nvalid;
+  }
+
+  return nvalid;
+}
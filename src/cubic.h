@@ -0,0 +1,41 @@
+/*========================================================================
+ * cubic - cubic convolution interpolation kernels
+ *
+ * National Snow & Ice Data Center, University of Colorado, Boulder
+ * Copyright (C) 2026 University of Colorado
+ *========================================================================*/
+#ifndef cubic_h_
+#define cubic_h_
+
+#include "define.h"
+
+#ifdef cubic_c_
+const char cubic_h_rcsid[] = "$Id$";
+#endif
+
+/*
+ *	sample validity tests applied to each of the 16 taps
+ *	a tap is skipped if any enabled test rejects it
+ */
+typedef struct
+{ bool ignore_fill;	/* skip samples equal to fill */
+  float fill;
+  bool min_set;		/* skip samples less than min_value */
+  float min_value;
+  bool max_set;		/* skip samples greater than max_value */
+  float max_value;
+} cubic_mask;
+
+void weights_cubic(double d, double w[4]);
+
+int sum_cubic(float **data, int rows, int cols, double r, double s,
+	      cubic_mask *mask, double *value_sum, double *weight_sum);
+
+int eval_cubic(float **data, int rows, int cols, double r, double s,
+	       cubic_mask *mask, float fill_value, float *value);
+
+int eval_cubic_array(float **data, int rows, int cols, int npts,
+		     double *r, double *s, cubic_mask *mask,
+		     float fill_value, float *value, int *nsamples);
+
+#endif
@@ -362,6 +362,148 @@ bool put_element_grid_io(grid_io_class *this, int row, int col, double value)
   return TRUE;
 }
 
+/*------------------------------------------------------------------------
+ * get_row_grid_io - return an entire row of the grid
+ *
+ *	input : this - grid_io_class
+ *		row - grid row
+ *
+ *	output: values - width grid elements
+ *
+ *	result: TRUE iff success
+ *
+ *	note  : the type conversion is selected once per row rather
+ *		than once per element as in get_element_grid_io
+ *
+ *------------------------------------------------------------------------*/
+bool get_row_grid_io(grid_io_class *this, int row, double *values)
+{ int col;
+  bool success;
+  byte1 *bufp;
+
+  if (row < 0 || row >= this->height) return FALSE;
+
+  if (row < this->start_row || row > this->final_row)
+  { success = exchange_row_buffer(this, row);
+    if (!success) return FALSE;
+  }
+
+  bufp = this->data[row - this->start_row];
+
+  if (!this->real_data) {
+    switch (this->datum_size * (this->signed_data ? -1 : 1)) {
+    case -1: 
+      for (col = 0; col < this->width; col++)
+	values[col] = (double) ((int1 *)bufp)[col];
+      break;
+    case -2: 
+      for (col = 0; col < this->width; col++)
+	values[col] = (double) ((int2 *)bufp)[col];
+      break;
+    case -4: 
+      for (col = 0; col < this->width; col++)
+	values[col] = (double) ((int4 *)bufp)[col];
+      break;
+    case  1: 
+      for (col = 0; col < this->width; col++)
+	values[col] = (double) ((byte1 *)bufp)[col];
+      break;
+    case  2: 
+      for (col = 0; col < this->width; col++)
+	values[col] = (double) ((byte2 *)bufp)[col];
+      break;
+    case  4: 
+      for (col = 0; col < this->width; col++)
+	values[col] = (double) ((byte4 *)bufp)[col];
+      break;
+    default: assert(NEVER); /* should never execute */
+    }
+  } 
+  else {
+    switch (this->datum_size) {
+    case  4: 
+      for (col = 0; col < this->width; col++)
+	values[col] = (double) ((float *)bufp)[col];
+      break;
+    case  8: 
+      memcpy(values, bufp, this->width*sizeof(double));
+      break;
+    default: assert(NEVER); /* should never execute */
+    }
+  }
+
+  return TRUE;
+}
+
+/*------------------------------------------------------------------------
+ * put_row_grid_io - store an entire row of the grid
+ *
+ *	input : this - grid_io_class
+ *		row - grid row
+ *		values - width grid elements
+ *
+ *	result: TRUE iff success
+ *
+ *------------------------------------------------------------------------*/
+bool put_row_grid_io(grid_io_class *this, int row, double *values)
+{ int col;
+  bool success;
+  byte1 *bufp;
+
+  if (row < 0 || row >= this->height) return FALSE;
+
+  if (row < this->start_row || row > this->final_row)
+  { success = exchange_row_buffer(this, row);
+    if (!success) return FALSE;
+  }
+
+  bufp = this->data[row - this->start_row];
+
+  if (!this->real_data) {
+    switch (this->datum_size * (this->signed_data ? -1 : 1)) {
+    case -1: 
+      for (col = 0; col < this->width; col++)
+	((int1 *)bufp)[col] = values[col];
+      break;
+    case -2: 
+      for (col = 0; col < this->width; col++)
+	((int2 *)bufp)[col] = values[col];
+      break;
+    case -4: 
+      for (col = 0; col < this->width; col++)
+	((int4 *)bufp)[col] = values[col];
+      break;
+    case  1: 
+      for (col = 0; col < this->width; col++)
+	((byte1 *)bufp)[col] = values[col];
+      break;
+    case  2: 
+      for (col = 0; col < this->width; col++)
+	((byte2 *)bufp)[col] = values[col];
+      break;
+    case  4: 
+      for (col = 0; col < this->width; col++)
+	((byte4 *)bufp)[col] = values[col];
+      break;
+    default: assert(NEVER); /* should never execute */
+    }
+  }
+  else {
+    switch (this->datum_size) {
+    case  4: 
+      for (col = 0; col < this->width; col++)
+	((float *)bufp)[col] = values[col];
+      break;
+    case  8: 
+      memcpy(bufp, values, this->width*sizeof(double));
+      break;
+    default: assert(NEVER); /* should never execute */
+    }
+  }
+
+  return TRUE;
+}
+
 /*------------------------------------------------------------------------
  * exchange_row_buffer - update current grid data buffer
  *
@@ -44,6 +44,10 @@ bool get_element_grid_io(grid_io_class *this, int row, int col, double *value);
 
 bool put_element_grid_io(grid_io_class *this, int row, int col, double value);
 
+bool get_row_grid_io(grid_io_class *this, int row, double *values);
+
+bool put_row_grid_io(grid_io_class *this, int row, double *values);
+
 void close_grid_io(grid_io_class *this);
 
 #endif
@@ -10,6 +10,7 @@ static const char grids_c_rcsid[] = "$Id$";
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <math.h>
 #include "define.h"
 #include "keyval.h"
 #include "mapx.h"
@@ -394,6 +395,89 @@ int inverse_grid (grid_class *this,
   return within_mapx(this->mapx, *lat, *lon);
 }
 
+/*------------------------------------------------------------------------
+ * forward_grid_array - forward grid transformation of many points
+ *
+ *	input : this - pointer to grid data structure (returned by init_grid)
+ *		npts - number of points
+ *		lat,lon - geographic coordinates in decimal degrees
+ *
+ *	output: r,s - grid coordinates
+ *		status - forward_grid result for each point
+ *
+ *	result: number of points on the grid
+ *
+ *	note: points are projected in parallel when compiled with OpenMP
+ *
+ *------------------------------------------------------------------------*/
+int forward_grid_array(grid_class *this, int npts,
+		       double *lat, double *lon, double *r, double *s,
+		       int *status)
+{
+  int i, ngood = 0;
+
+#ifdef _OPENMP
+#pragma omp parallel for reduction(+:ngood) if (npts >= GRID_ARRAY_PARALLEL_MIN)
+#endif
+  for (i = 0; i < npts; i++)
+  { status[i] = forward_grid(this, lat[i], lon[i], &r[i], &s[i]);
+    if (status[i]) ++ngood;
+  }
+
+  return ngood;
+}
+
+/*------------------------------------------------------------------------
+ * forward_grid_polyline - project a polyline and clip it to the grid
+ *
+ *	input : this - pointer to grid data structure (returned by init_grid)
+ *		npts - number of points
+ *		lat,lon - polyline vertices in decimal degrees
+ *
+ *	output: r,s - grid coordinates of each vertex
+ *		keep - TRUE for each vertex that is on the grid and
+ *			within the map bounds, the vector from vertex
+ *			i-1 to vertex i is drawn when keep[i] is set
+ *
+ *	result: number of vectors kept
+ *
+ *	note: this is the test mapenum has always applied to each
+ *	      draw_pd call, vectors are not cut at the grid edge
+ *
+ *------------------------------------------------------------------------*/
+int forward_grid_polyline(grid_class *this, int npts,
+			  double *lat, double *lon, double *r, double *s,
+			  int *keep)
+{
+  int i, nkeep = 0;
+
+#ifdef _OPENMP
+#pragma omp parallel for reduction(+:nkeep) if (npts >= GRID_ARRAY_PARALLEL_MIN)
+#endif
+  for (i = 0; i < npts; i++)
+  { keep[i] = forward_grid(this, lat[i], lon[i], &r[i], &s[i])
+      && within_mapx(this->mapx, lat[i], lon[i]);
+    if (keep[i] && i > 0) ++nkeep;
+  }
+
+  return nkeep;
+}
+
+/*------------------------------------------------------------------------
+ * grid_cell_size_km - nominal width of a grid cell
+ *
+ *	input : this - pointer to grid data structure (returned by init_grid)
+ *
+ *	result: cell width in kilometers on the map's reference sphere,
+ *		e.g. a default thinning tolerance for coastlines
+ *
+ *------------------------------------------------------------------------*/
+double grid_cell_size_km(grid_class *this)
+{
+  return this->mapx->scale / fabs(this->cols_per_map_unit)
+    * mapx_Re_km / this->mapx->equatorial_radius;
+}
+
 #ifdef GTEST
 /*------------------------------------------------------------------------
  * gtest - interactive test grid routines
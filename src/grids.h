@@ -31,6 +31,12 @@ GLOBAL int grid_verbose;
  * useful macros
  */
 
+/*
+ * smallest array forward_grid_array projects in parallel, below
+ * this the thread start up costs more than it saves
+ */
+#define GRID_ARRAY_PARALLEL_MIN 1024
+
 /*
  * grid parameters structure
  */
@@ -54,5 +60,12 @@ int forward_grid(grid_class *this,
 		 double lat, double lon, double *r, double *s);
 int inverse_grid(grid_class *this,
 		 double r, double s, double *lat, double *lon);
+int forward_grid_array(grid_class *this, int npts,
+		       double *lat, double *lon, double *r, double *s,
+		       int *status);
+int forward_grid_polyline(grid_class *this, int npts,
+			  double *lat, double *lon, double *r, double *s,
+			  int *keep);
+double grid_cell_size_km(grid_class *this);
 
 #endif
@@ -13,16 +13,27 @@ static const char irregrid_c_rcsid[] = "$Id$";
 #include "mapx.h"
 #include "grids.h"
 #include "maps.h"
+#include "point_io.h"
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 #define usage									\
 "$Revision$\n"								\
-"usage: irregrid [-wcdnv -i value -k kernel\n"					\
+"usage: irregrid [-wcdnvbEg -i value -k kernel -m max_pts -q subcells\n"					\
 " -p value -r value -z beta_file -o outputfile\n"				\
 " -t total_pts_file]  from_data to.gpd \n"					\
 "\n"										\
 " input : from_data - original ASCII data file (lat lon value)\n"		\
+"                     or \"-\" to read from stdin\n"				\
 "         to.gpd    - new grid parameters definition file\n"			\
-"         [to_data] - if -z option then use as initial values\n"		\
 "\n"										\
 " output: grid values (float) by row to stdout or optional outputfile\n"	\
 "\n"										\
@@ -34,10 +45,25 @@ static const char irregrid_c_rcsid[] = "$Id$";
 "         r - specify the search radius (units: grid cells, default: 0.)\n"	\
 "         i value - ignore fill value.  Output is filled with this value\n"	\
 "                   If not specified, then filled with zero.\n"			\
-"         z beta_file - not yet implemented! save/restore intermediate\n"	\
-"                       results\n"						\
+"         z beta_file - save/restore intermediate results. If beta_file\n"	\
+"                       exists, the new points are added to the sums\n"	\
+"                       it holds, then the updated sums are saved back\n"	\
+"                       to it before normalizing. Not with -m or -gn,\n"	\
+"                       the nearest points of each run don't add up.\n"	\
 "         t total_pts_file - name of file to write number of input\n"		\
 "                            data points contributing to each grid cell\n"	\
+"         b - binary from_data, each record is float64 lat, float64 lon,\n"	\
+"             float32 value (20 bytes, no padding)\n"			\
+"         E - binary from_data is big-endian (default is native)\n"		\
+"         g - gather mode: bin the input points, then find the points\n"	\
+"             near each output cell (parallel with OpenMP). With -n, or\n"	\
+"             -w and -m, a radius of 0 means no limit.\n"			\
+"         m max_pts - gather mode using at most the max_pts nearest\n"	\
+"                     input points for each output cell\n"			\
+"         q subcells - Cressman only: quantize input positions to\n"	\
+"                      1/subcells of a grid cell and apply precomputed\n"	\
+"                      weight stencils (faster, weights approximate)\n"	\
+"                      Not with -g or -m.\n"				\
 "         v - verbose (can be repeated)\n"					\
 "\n"										\
 "\n"
@@ -46,19 +72,92 @@ static const char irregrid_c_rcsid[] = "$Id$";
  *
  * This is a routine to grid irregularly spaced data.  Details XXXX
  *
- * The -z beta_file option XXXX
+ * The -z beta_file option keeps the accumulators (to_data, to_data_beta
+ * and to_data_num_pts) from one run to the next, so that data can be
+ * added a file at a time and re-normalized. The beta file is a fixed
+ * header (beta_header) followed by the three arrays by row, in native
+ * byte order. It is mapped copy-on-write on restore and replaced
+ * atomically on save. The header records every setting that changes
+ * the sums, and a restore with different settings is refused.
  *
  *------------------------------------------------------------------------*/
 
 #define VV_INTERVAL 30
-#define MAXLINELENGTH 1000
 #define IMPOSSIBLY_LARGE 9e9;
+#define CRESSMAN_MAX_HALF_WIDTH 256
+
+/*
+ *	most memory the -q stencils may take, subcells^2 stencils of
+ *	(2*half_width+1)^2 weights each
+ */
+#ifndef CRESSMAN_STENCIL_MAX_BYTES
+#define CRESSMAN_STENCIL_MAX_BYTES (256.*1024*1024)
+#endif
+
+/*
+ *	flags for the output grids, see matrix_aligned
+ */
+#define MATRIX_FLAGS (matrix_ZERO|matrix_PAD|matrix_HUGEPAGE|matrix_FIRST_TOUCH)
+
+#define BETA_MAGIC "irregrid beta\n"
+#define BETA_VERSION 2
+#define BETA_BYTE_ORDER 0x01020304
+
+typedef struct {
+  char magic[16];
+  int version;
+  int byte_order;
+  int rows, cols;
+  int method;			/* 'c', 'd', 'w' or 'n' */
+  float fill;
+  double shell_radius;
+  double inv_dist_power;
+  int gather;			/* -g */
+  int max_gather_pts;		/* -m, 0 for all */
+  int stencil_subcells;		/* -q as used, 0 for exact weights */
+  char reserved[12];
+} beta_header;
+
+/*
+ * gather mode input points, ordered by bucket after build_point_hash,
+ * bucket b holds points start[b] .. start[b+1]-1
+ */
+typedef struct {
+  int npts, max_pts;
+  double *r, *s;
+  float *value;
+  int *order;			/* position in the input */
+  double x0, y0, size;
+  int nbx, nby;
+  int *start;
+} point_hash;
+
+typedef struct {
+  int n, max;
+  int *point;
+  int *order;
+  double *dist;
+} neighbor_list;
 
 static float fill;
 static int fill_specified, verbose, preload_data, min_in_pts;
 static double shell_radius;
 static double inv_dist_power;
 
+/*
+ * precomputed Cressman weights for -q, one stencil per quantized
+ * sub-cell offset, each (2*half_width+1) rows with a contiguous span
+ * of nonzero weights per row
+ */
+typedef struct {
+  int first[2*CRESSMAN_MAX_HALF_WIDTH+1];
+  int last[2*CRESSMAN_MAX_HALF_WIDTH+1];
+  double *weight;
+} cressman_stencil;
+
+static int stencil_subcells, stencil_half_width;
+static cressman_stencil *stencils;
+
 /* 
  * weighted_average is a pointer to one the various weighted average
  * routines (whose prototypes follow...
@@ -88,6 +187,29 @@ static int near_neighbor(double,double,double,double,float,int *,
 			 grid_class *,float **,float **,int **);
 static int normalize_near_neighbor(grid_class *,float **, float **, int **);
 
+static void init_cressman_stencils(int);
+static int cressman_stencil_point(double, double, float, grid_class *,
+				  float **, float **, int **);
+static void stencil_span(float *, float *, int *, double *, int, float);
+static int method_code(void);
+static bool restore_beta(char *, grid_class *, bool, int,
+			 float ***, float ***, int ***);
+static void save_beta(char *, grid_class *, bool, int,
+		      float **, float **, int **);
+static void init_beta_header(beta_header *, grid_class *, bool, int);
+
+static bool add_gather_point(point_hash *, double, double, float);
+static int build_point_hash(point_hash *, grid_class *, double);
+static double gather_reach(double, int);
+static void add_neighbor(neighbor_list *, int, int, int, double);
+static void gather_bucket(point_hash *, int, int, int, double, int, int,
+			  neighbor_list *);
+static void gather_points(point_hash *, int, int, double, int, int,
+			  neighbor_list *);
+static int compare_neighbor_order(const void *, const void *);
+static int gather_grid(point_hash *, grid_class *, int,
+		       float **, float **, int **);
+
 main(int argc, char *argv[]) { 
   int i, status;
   double from_lat, from_lon;
@@ -99,20 +221,24 @@ main(int argc, char *argv[]) {
   grid_class *to_grid;
   int **to_data_num_pts;
   char *option;
-  char input_line[MAXLINELENGTH];
   char from_filename[FILENAME_MAX], to_filename[FILENAME_MAX];
   char npts_filename[FILENAME_MAX];
   bool algo_specified;
   char *algo_string;
   char beta_filename[FILENAME_MAX];
-  FILE *from_file, *to_file, *beta_file, *npts_file;
+  FILE *to_file, *npts_file;
+  point_io_class *from_points;
+  int point_flags;
+  bool gather;
+  int max_gather_pts;
+  point_hash hash;
   int lines_processed;
 
 /*
  * set defaults
  */
   to_file = stdout;
-  beta_file = NULL;
+  beta_filename[0] = '\0';
   npts_file = NULL;
   preload_data = FALSE;
   algo_specified = FALSE;
@@ -125,11 +251,15 @@ main(int argc, char *argv[]) {
   shell_radius = 0.;
   inv_dist_power = 2.;
   algo_string = "Cressman weighting";
+  point_flags = point_io_VALUE;
+  gather = FALSE;
+  max_gather_pts = 0;
+  memset(&hash, 0, sizeof(hash));
 
 /* 
  *	get command line options
  */
-  while (--argc > 0 && (*++argv)[0] == '-')
+  while (--argc > 0 && (*++argv)[0] == '-' && (*argv)[1] != '\0')
   { for (option = argv[0]+1; *option != '\0'; option++)
     { switch (*option)
       { case 'w':
@@ -173,22 +303,12 @@ main(int argc, char *argv[]) {
   	  ++argv; --argc;
 	  if (sscanf(*argv, "%s", to_filename) != 1) error_exit(usage);
 	  strcpy(to_filename, *argv);
-	  to_file = fopen(to_filename, preload_data ? "r+" : "w");
+	  to_file = fopen(to_filename, "w");
 	  if (!to_file) { perror(to_filename); exit(ABORT); }
 	  break;
 	case 'z':
 	  ++argv; --argc;
-	  fprintf(stderr," Input beta file option not yet implemented.\n");
-	  error_exit(usage);
-	  /* but someday it will, so leave the rest of this code here... */
 	  strcpy(beta_filename, *argv);
-	  preload_data = TRUE;
-	  beta_file = fopen(beta_filename, "r+");
-	  if (!beta_file)
-	  { preload_data = FALSE;
-	    beta_file = fopen(beta_filename, "w");
-	    if (!beta_file) { perror(beta_filename); error_exit(usage); }
-	  }
 	  break;
 	case 't':
 	  ++argv; --argc;
@@ -201,6 +321,26 @@ main(int argc, char *argv[]) {
 	  if (sscanf(*argv, "%f", &fill) != 1) error_exit(usage);
 	  fill_specified = TRUE;
 	  break;
+	case 'b':
+	  point_flags |= point_io_BINARY;
+	  break;
+	case 'E':
+	  point_flags |= point_io_BIG_ENDIAN;
+	  break;
+	case 'g':
+	  gather = TRUE;
+	  break;
+	case 'q':
+	  ++argv; --argc;
+	  if (sscanf(*argv, "%d", &stencil_subcells) != 1) error_exit(usage);
+	  if (stencil_subcells < 1) error_exit(usage);
+	  break;
+	case 'm':
+	  ++argv; --argc;
+	  if (sscanf(*argv, "%d", &max_gather_pts) != 1) error_exit(usage);
+	  if (max_gather_pts < 1) error_exit(usage);
+	  gather = TRUE;
+	  break;
 	case 'v':
 	  ++verbose;
 	  break;
@@ -214,14 +354,33 @@ main(int argc, char *argv[]) {
     }
   }
 
+/*
+ *	the nearest points to a cell in one run are not its nearest
+ *	over all runs, so those sums can't be carried over
+ */
+  if (beta_filename[0] && gather
+      && (max_gather_pts > 0 || weighted_average == near_neighbor)) {
+    fprintf(stderr,"irregrid: -z can't be used with -m or -gn\n");
+    error_exit(usage);
+  }
+
+/*
+ *	stencils are applied as points are scattered, gather mode
+ *	weighs each point against each cell exactly
+ */
+  if (stencil_subcells > 0 && gather) {
+    fprintf(stderr,"irregrid: -q can't be used with -g or -m\n");
+    error_exit(usage);
+  }
+
 /*
  *	get command line arguments
  */
   if (argc != 2) error_exit(usage);
   
   strcpy(from_filename, *argv);
-  from_file = fopen(from_filename, "r");
-  if (!from_file) { perror(from_filename); exit(ABORT); }
+  from_points = init_point_io(from_filename, point_flags);
+  if (!from_points) exit(ABORT);
   ++argv; --argc;
   
   to_grid = init_grid(*argv);
@@ -247,27 +406,44 @@ main(int argc, char *argv[]) {
       fprintf(stderr,"> Fill value:\t\t%7.2f\n",fill);
     }
     fprintf(stderr,"> Shell radius:\t\t%5.2f\n",shell_radius);
+    if (gather) {
+      if (max_gather_pts > 0)
+	fprintf(stderr,"> Gather:\t\tmax %d points\n", max_gather_pts);
+      else
+	fprintf(stderr,"> Gather:\t\tall points\n");
+    }
   }
 
 /*
- *	allocate storage for  to_data grids
+ *	restore intermediate results or allocate and initialize
+ *	storage for  to_data grids
  */
-  to_data = (float **)matrix(to_grid->rows, to_grid->cols,
-			      sizeof(float), TRUE);
-  if (!to_data) { exit(ABORT); }
+  if (beta_filename[0])
+    preload_data = restore_beta(beta_filename, to_grid, gather,
+				max_gather_pts, &to_data,
+				&to_data_beta, &to_data_num_pts);
 
-  to_data_beta = (float **)matrix(to_grid->rows, to_grid->cols,
-			      sizeof(float), TRUE);
-  if (!to_data_beta) { exit(ABORT); }
+  if (preload_data) {
+    if (verbose) fprintf(stderr,"> Restored:\t\t%s\n", beta_filename);
+  } else {
+    to_data = (float **)matrix_aligned(to_grid->rows, to_grid->cols,
+				       sizeof(float), MATRIX_FLAGS);
+    if (!to_data) { exit(ABORT); }
 
-  to_data_num_pts = (int **)matrix(to_grid->rows, to_grid->cols,
-			      sizeof(int), TRUE);
-  if (!to_data_num_pts) { exit(ABORT); }
+    to_data_beta = (float **)matrix_aligned(to_grid->rows, to_grid->cols,
+					    sizeof(float), MATRIX_FLAGS);
+    if (!to_data_beta) { exit(ABORT); }
+
+    to_data_num_pts = (int **)matrix_aligned(to_grid->rows, to_grid->cols,
+					     sizeof(int), MATRIX_FLAGS);
+    if (!to_data_num_pts) { exit(ABORT); }
 
 /*
  *	initialize output grids
  */
- init_grids(to_grid,to_data,to_data_beta);
+    init_grids(to_grid,to_data,to_data_beta);
+  }
+
 /*
  *	given shell radius, calculate a comfortable grid point range to
  *	encompass it.  for now radius units are grid points
@@ -275,16 +451,22 @@ main(int argc, char *argv[]) {
   r_width = (int)(2.*shell_radius);
   s_width = (int)(2.*shell_radius);
 
+  if (stencil_subcells > 0 && weighted_average == cressman && !gather) {
+    init_cressman_stencils(stencil_subcells);
+    if (verbose) fprintf(stderr,"> Stencils:\t\t%d x %d sub-cells\n",
+			 stencil_subcells, stencil_subcells);
+  }
+
 /*
- *	read location and data values from from_file one line at a time...
+ *	read location and data values from from_data one point at a time...
  */
   lines_processed = 0;
-  while (fgets(input_line, MAXLINELENGTH, from_file) != NULL) {
-    if (feof(from_file)) break;
+  while ((status = read_point_io(from_points,
+				 &from_lat, &from_lon, &from_dat)) != 0) {
     lines_processed++;
-    status = sscanf(input_line,"%lf%lf%f",&from_lat,&from_lon,&from_dat);
-    if (3!=status) {
+    if (status < 0) {
       fprintf(stderr,"> Problem reading data at line %i\n",lines_processed);
+      continue;
     }
 
     if (!within_mapx(to_grid->mapx, from_lat, from_lon)) continue;
@@ -299,6 +481,12 @@ main(int argc, char *argv[]) {
  *      don't bother testing the forward_grid return status... 
  */
     forward_grid(to_grid, from_lat, from_lon, &from_r, &from_s);
+
+    if (gather) {
+      if (from_dat != fill && !add_gather_point(&hash, from_r, from_s, from_dat))
+	error_exit("irregrid: ABORTING");
+      continue;
+    }
     
     nearest_r = (int)(from_r + 0.5);
     nearest_s = (int)(from_s + 0.5);
@@ -317,7 +505,25 @@ main(int argc, char *argv[]) {
 			  to_data_beta,to_data_num_pts);
     }
   }  /* End of loop over input lat/lons */
-  fclose(from_file);
+  close_point_io(from_points);
+
+/*
+ *	gather mode fills the accumulators in one pass over the grid
+ */
+  if (gather) {
+    status = gather_grid(&hash, to_grid, max_gather_pts,
+			 to_data, to_data_beta, to_data_num_pts);
+    if (verbose) fprintf(stderr,"> %d cells gathered\n", status);
+  }
+
+/*
+ *	save intermediate results
+ */
+  if (beta_filename[0]) {
+    save_beta(beta_filename, to_grid, gather, max_gather_pts,
+	      to_data, to_data_beta, to_data_num_pts);
+    if (verbose) fprintf(stderr,"> Saved:\t\t%s\n", beta_filename);
+  }
 
 /*
  *	normalize result
@@ -403,6 +609,10 @@ int cressman(double from_r,double from_s,double from_lat, double from_lon,
   double weight;
   int npts=0;
 
+  if (stencils)
+    return cressman_stencil_point(from_r, from_s, from_dat, to_grid,
+				  to_data, to_data_beta, to_data_num_pts);
+
 /*
  *	find the distance from each grid location within the shell range
  *	of r and s (the from_location).  
@@ -786,3 +996,819 @@ int normalize_near_neighbor(grid_class *to_grid,float **to_data,
 {
   return TRUE;
 }
+
+/*------------------------------------------------------------------------
+ * Gather mode.
+ *
+ * Instead of scattering each input point into the cells around it, the
+ * projected input points are binned into a uniform grid of buckets and
+ * each output cell gathers the points near it. Cells are independent,
+ * so the rows are done in parallel when compiled with OpenMP. A bound
+ * on the number of points per cell (max_pts) turns the search into a
+ * k nearest query that expands ring by ring and stops as soon as no
+ * closer point can exist, so sparse data on a fine grid need no huge
+ * shell radius.
+ *
+ * The gathered points are applied in input order with the same weights
+ * as the scatter routines, then the usual normalize routine is used.
+ *------------------------------------------------------------------------*/
+
+/*------------------------------------------------------------------------
+ * add_gather_point - save a projected input point for gather mode
+ *
+ *	input : from_r, from_s - location in output grid coordinates
+ *              from_dat - data value
+ *
+ *	output: hash - point added (hash->npts incremented)
+ *
+ *	result: TRUE iff success
+ *
+ *------------------------------------------------------------------------*/
+static bool add_gather_point(point_hash *hash, double from_r, double from_s,
+			     float from_dat)
+{ int max;
+
+  if (hash->npts >= hash->max_pts) {
+    max = hash->max_pts > 0 ? 2*hash->max_pts : 4096;
+    hash->r = (double *)realloc(hash->r, max*sizeof(double));
+    hash->s = (double *)realloc(hash->s, max*sizeof(double));
+    hash->value = (float *)realloc(hash->value, max*sizeof(float));
+    if (!hash->r || !hash->s || !hash->value) {
+      perror("add_gather_point");
+      return FALSE;
+    }
+    hash->max_pts = max;
+  }
+
+  hash->r[hash->npts] = from_r;
+  hash->s[hash->npts] = from_s;
+  hash->value[hash->npts] = from_dat;
+  ++hash->npts;
+
+  return TRUE;
+}
+
+/*------------------------------------------------------------------------
+ * build_point_hash - bin the saved points into buckets
+ *
+ *	input : hash - saved points
+ *              to_grid - output grid
+ *              reach - how far from the grid a point can still
+ *                      contribute (grid cells), < 0 if unlimited
+ *
+ *	output: hash - points reordered by bucket, bucket index built
+ *
+ *	result: number of points kept
+ *
+ *	note: bucket size is chosen for about two points per bucket
+ *
+ *------------------------------------------------------------------------*/
+static int build_point_hash(point_hash *hash, grid_class *to_grid,
+			    double reach)
+{ int i, b, bx, by, nkept, nbuckets;
+  double xmin, xmax, ymin, ymax, area;
+  int *bucket, *next;
+  double *r, *s;
+  float *value;
+
+  xmin = ymin = 1e30;
+  xmax = ymax = -1e30;
+  for (i = 0; i < hash->npts; i++) {
+    if (reach >= 0
+	&& (hash->r[i] < -reach || hash->r[i] > to_grid->cols - 1 + reach
+	    || hash->s[i] < -reach || hash->s[i] > to_grid->rows - 1 + reach))
+      continue;
+    if (hash->r[i] < xmin) xmin = hash->r[i];
+    if (hash->r[i] > xmax) xmax = hash->r[i];
+    if (hash->s[i] < ymin) ymin = hash->s[i];
+    if (hash->s[i] > ymax) ymax = hash->s[i];
+  }
+  if (xmin > xmax) { xmin = xmax = ymin = ymax = 0; }
+
+  area = (xmax - xmin + 1)*(ymax - ymin + 1);
+  hash->size = sqrt(2*area/(hash->npts > 0 ? hash->npts : 1));
+  if (hash->size < 1) hash->size = 1;
+  hash->x0 = xmin;
+  hash->y0 = ymin;
+  hash->nbx = (int)((xmax - xmin)/hash->size) + 1;
+  hash->nby = (int)((ymax - ymin)/hash->size) + 1;
+  nbuckets = hash->nbx*hash->nby;
+
+  hash->start = (int *)calloc(nbuckets + 1, sizeof(int));
+  hash->order = (int *)calloc(hash->npts + 1, sizeof(int));
+  bucket = (int *)calloc(hash->npts + 1, sizeof(int));
+  next = (int *)calloc(nbuckets + 1, sizeof(int));
+  r = (double *)calloc(hash->npts + 1, sizeof(double));
+  s = (double *)calloc(hash->npts + 1, sizeof(double));
+  value = (float *)calloc(hash->npts + 1, sizeof(float));
+  if (!hash->start || !hash->order || !bucket || !next
+      || !r || !s || !value) {
+    perror("build_point_hash");
+    error_exit("irregrid: ABORTING");
+  }
+
+/*
+ *	counting sort by bucket, points keep their input order
+ *	within each bucket
+ */
+  for (i = 0; i < hash->npts; i++) {
+    bx = (int)floor((hash->r[i] - hash->x0)/hash->size);
+    by = (int)floor((hash->s[i] - hash->y0)/hash->size);
+    if (bx < 0 || bx >= hash->nbx || by < 0 || by >= hash->nby) {
+      bucket[i] = -1;
+      continue;
+    }
+    bucket[i] = by*hash->nbx + bx;
+    ++hash->start[bucket[i] + 1];
+  }
+  for (b = 0; b < nbuckets; b++) {
+    hash->start[b + 1] += hash->start[b];
+    next[b] = hash->start[b];
+  }
+  nkept = hash->start[nbuckets];
+
+  for (i = 0; i < hash->npts; i++) {
+    if (bucket[i] < 0) continue;
+    b = next[bucket[i]]++;
+    r[b] = hash->r[i];
+    s[b] = hash->s[i];
+    value[b] = hash->value[i];
+    hash->order[b] = i;
+  }
+
+  free(hash->r); free(hash->s); free(hash->value);
+  hash->r = r;
+  hash->s = s;
+  hash->value = value;
+  hash->npts = nkept;
+  free(bucket);
+  free(next);
+
+  return nkept;
+}
+
+/*------------------------------------------------------------------------
+ * gather_reach - farthest a contributing point can be from its cell
+ *
+ *	note: the nearest cell is found by truncating r + 0.5 as in
+ *	      the scatter loop, which rounds toward zero for negative
+ *	      coordinates, hence the extra cell for half_width
+ *
+ *------------------------------------------------------------------------*/
+static double gather_reach(double radius, int half_width)
+{
+  return half_width >= 0 ? half_width + 1.5 : radius;
+}
+
+/*------------------------------------------------------------------------
+ * add_neighbor - insert a point into a neighbor list
+ *
+ *	note: with max_pts > 0 the list is kept sorted by distance
+ *	      (ties broken by later input first) and truncated
+ *
+ *------------------------------------------------------------------------*/
+static void add_neighbor(neighbor_list *list, int max_pts,
+			 int point, int order, double dist)
+{ int i, max;
+
+  if (max_pts <= 0) {
+    if (list->n >= list->max) {
+      max = list->max > 0 ? 2*list->max : 64;
+      list->point = (int *)realloc(list->point, max*sizeof(int));
+      list->order = (int *)realloc(list->order, max*sizeof(int));
+      list->dist = (double *)realloc(list->dist, max*sizeof(double));
+      if (!list->point || !list->order || !list->dist) {
+	perror("add_neighbor");
+	error_exit("irregrid: ABORTING");
+      }
+      list->max = max;
+    }
+    list->point[list->n] = point;
+    list->order[list->n] = order;
+    list->dist[list->n] = dist;
+    ++list->n;
+    return;
+  }
+
+  if (list->n == max_pts
+      && (dist > list->dist[max_pts-1]
+	  || (dist == list->dist[max_pts-1] && order < list->order[max_pts-1])))
+    return;
+
+  i = list->n < max_pts ? list->n++ : max_pts - 1;
+  for (; i > 0; i--) {
+    if (list->dist[i-1] < dist
+	|| (list->dist[i-1] == dist && list->order[i-1] > order))
+      break;
+    list->point[i] = list->point[i-1];
+    list->order[i] = list->order[i-1];
+    list->dist[i] = list->dist[i-1];
+  }
+  list->point[i] = point;
+  list->order[i] = order;
+  list->dist[i] = dist;
+}
+
+/*------------------------------------------------------------------------
+ * gather_bucket - test the points in one bucket against a cell
+ *------------------------------------------------------------------------*/
+static void gather_bucket(point_hash *hash, int b, int col, int row,
+			  double radius, int half_width, int max_pts,
+			  neighbor_list *list)
+{ int k;
+  double dr, ds, dist;
+
+  for (k = hash->start[b]; k < hash->start[b+1]; k++) {
+    if (half_width >= 0) {
+      if (abs(col - (int)(hash->r[k] + 0.5)) > half_width
+	  || abs(row - (int)(hash->s[k] + 0.5)) > half_width)
+	continue;
+    }
+    dr = hash->r[k] - col;
+    ds = hash->s[k] - row;
+    dist = sqrt(dr*dr + ds*ds);
+    if (half_width < 0 && radius >= 0 && dist > radius) continue;
+    add_neighbor(list, max_pts, k, hash->order[k], dist);
+  }
+}
+
+/*------------------------------------------------------------------------
+ * gather_points - find the input points that contribute to a cell
+ *
+ *	input : hash - bucketed input points
+ *              col, row - output cell
+ *              radius - search radius, < 0 for unlimited
+ *              half_width - if >= 0 use points whose nearest cell is
+ *                           within half_width instead of radius
+ *              max_pts - if > 0 keep only the max_pts nearest
+ *
+ *	output: list - contributing points
+ *
+ *------------------------------------------------------------------------*/
+static void gather_points(point_hash *hash, int col, int row,
+			  double radius, int half_width, int max_pts,
+			  neighbor_list *list)
+{ int bx, by, i, j, d, d0, bx0, bx1, by0, by1;
+  double reach, gap_x, gap_y, lower;
+
+  list->n = 0;
+  if (hash->npts <= 0) return;
+
+  reach = gather_reach(radius, half_width);
+
+/*
+ *	everything within reach
+ */
+  if (max_pts <= 0) {
+    bx0 = (int)floor((col - reach - hash->x0)/hash->size);
+    bx1 = (int)floor((col + reach - hash->x0)/hash->size);
+    by0 = (int)floor((row - reach - hash->y0)/hash->size);
+    by1 = (int)floor((row + reach - hash->y0)/hash->size);
+    if (bx0 < 0) bx0 = 0;
+    if (by0 < 0) by0 = 0;
+    if (bx1 >= hash->nbx) bx1 = hash->nbx - 1;
+    if (by1 >= hash->nby) by1 = hash->nby - 1;
+    for (j = by0; j <= by1; j++)
+      for (i = bx0; i <= bx1; i++)
+	gather_bucket(hash, j*hash->nbx + i, col, row,
+		      radius, half_width, max_pts, list);
+    return;
+  }
+
+/*
+ *	nearest max_pts, ring by ring outward from the cell's bucket
+ */
+  bx = (int)floor((col - hash->x0)/hash->size);
+  by = (int)floor((row - hash->y0)/hash->size);
+  d0 = 0;
+  if (-bx > d0) d0 = -bx;
+  if (bx - (hash->nbx - 1) > d0) d0 = bx - (hash->nbx - 1);
+  if (-by > d0) d0 = -by;
+  if (by - (hash->nby - 1) > d0) d0 = by - (hash->nby - 1);
+
+  for (d = d0; ; d++) {
+
+/*
+ *	done once the previous rings covered every bucket
+ */
+    if (d > 0 && bx - d + 1 <= 0 && bx + d - 1 >= hash->nbx - 1
+	&& by - d + 1 <= 0 && by + d - 1 >= hash->nby - 1)
+      break;
+
+/*
+ *	closest any point in this ring can be
+ */
+    if (d > 0) {
+      gap_x = col - (hash->x0 + (bx - d + 1)*hash->size);
+      if (hash->x0 + (bx + d)*hash->size - col < gap_x)
+	gap_x = hash->x0 + (bx + d)*hash->size - col;
+      gap_y = row - (hash->y0 + (by - d + 1)*hash->size);
+      if (hash->y0 + (by + d)*hash->size - row < gap_y)
+	gap_y = hash->y0 + (by + d)*hash->size - row;
+      lower = gap_x < gap_y ? gap_x : gap_y;
+      if (lower < 0) lower = 0;
+      if (reach >= 0 && lower > reach) break;
+      if (list->n == max_pts && lower > list->dist[max_pts-1]) break;
+    }
+
+    for (j = by - d; j <= by + d; j++) {
+      if (j < 0 || j >= hash->nby) continue;
+      if (j == by - d || j == by + d) {
+	for (i = bx - d; i <= bx + d; i++) {
+	  if (i < 0 || i >= hash->nbx) continue;
+	  gather_bucket(hash, j*hash->nbx + i, col, row,
+			radius, half_width, max_pts, list);
+	}
+      } else {
+	if (bx - d >= 0 && bx - d < hash->nbx)
+	  gather_bucket(hash, j*hash->nbx + bx - d, col, row,
+			radius, half_width, max_pts, list);
+	if (d > 0 && bx + d >= 0 && bx + d < hash->nbx)
+	  gather_bucket(hash, j*hash->nbx + bx + d, col, row,
+			radius, half_width, max_pts, list);
+      }
+    }
+  }
+}
+
+/*------------------------------------------------------------------------
+ * compare_neighbor_order - sort neighbors by input order
+ *------------------------------------------------------------------------*/
+static int compare_neighbor_order(const void *a, const void *b)
+{ const int *ia = (const int *)a, *ib = (const int *)b;
+
+  return ia[1] < ib[1] ? -1 : ia[1] > ib[1] ? 1 : 0;
+}
+
+/*------------------------------------------------------------------------
+ * gather_grid - fill the output accumulators from the bucketed points
+ *
+ *	input : hash - bucketed input points
+ *              to_grid - output grid
+ *              max_pts - if > 0 use at most max_pts nearest per cell
+ *
+ *	output: to_data, to_data_beta, to_data_num_pts - accumulated
+ *              exactly as the scatter routine would, ready for
+ *              normalize_result
+ *
+ *	result: number of cells with at least one point
+ *
+ *------------------------------------------------------------------------*/
+static int gather_grid(point_hash *hash, grid_class *to_grid, int max_pts,
+		       float **to_data, float **to_data_beta,
+		       int **to_data_num_pts)
+{ int row, ncells = 0;
+  double radius;
+  int half_width;
+
+/*
+ *	search limits that match the scatter routines
+ */
+  half_width = -1;
+  radius = shell_radius;
+  if (weighted_average == drop_in_bucket) {
+    half_width = (int)(2.*shell_radius);
+  } else if (weighted_average == near_neighbor) {
+    if (shell_radius <= 0) radius = -1;
+    max_pts = 1;
+  } else if (weighted_average == inv_dist) {
+    if (shell_radius <= 0 && max_pts > 0) radius = -1;
+  }
+
+  build_point_hash(hash, to_grid, gather_reach(radius, half_width));
+
+#ifdef _OPENMP
+#pragma omp parallel reduction(+:ncells)
+#endif
+  { int col, k, *pair;
+    double weight, dist;
+    neighbor_list list;
+
+    memset(&list, 0, sizeof(list));
+    if (max_pts > 0) {
+      list.point = (int *)calloc(max_pts, sizeof(int));
+      list.order = (int *)calloc(max_pts, sizeof(int));
+      list.dist = (double *)calloc(max_pts, sizeof(double));
+      list.max = max_pts;
+    }
+    pair = NULL;
+
+#ifdef _OPENMP
+#pragma omp for schedule(dynamic)
+#endif
+    for (row = 0; row < to_grid->rows; row++) {
+      for (col = 0; col < to_grid->cols; col++) {
+	gather_points(hash, col, row, radius, half_width, max_pts, &list);
+	if (0 == list.n) continue;
+	++ncells;
+
+	if (weighted_average == near_neighbor) {
+	  if (list.dist[0] <= to_data_beta[row][col]) {
+	    to_data[row][col] = hash->value[list.point[0]];
+	    to_data_beta[row][col] = list.dist[0];
+	  }
+	  continue;
+	}
+
+/*
+ *	apply in input order so the float sums round the same way
+ *	they do when scattering
+ */
+	pair = (int *)realloc(pair, 2*list.n*sizeof(int));
+	if (!pair) {
+	  perror("gather_grid");
+	  error_exit("irregrid: ABORTING");
+	}
+	for (k = 0; k < list.n; k++) {
+	  pair[2*k] = k;
+	  pair[2*k+1] = list.order[k];
+	}
+	qsort(pair, list.n, 2*sizeof(int), compare_neighbor_order);
+
+	for (k = 0; k < list.n; k++) {
+	  float value = hash->value[list.point[pair[2*k]]];
+	  dist = list.dist[pair[2*k]];
+	  if (weighted_average == drop_in_bucket) {
+	    to_data[row][col] += value;
+	  } else if (weighted_average == cressman) {
+	    weight = (shell_radius * shell_radius - dist * dist)
+	      /(shell_radius * shell_radius + dist * dist);
+	    to_data[row][col] += value * weight;
+	    to_data_beta[row][col] += weight;
+	  } else {
+	    weight = pow(dist,inv_dist_power);
+	    weight = weight > 0 ? 1/weight : fill;
+	    to_data[row][col] += value * weight;
+	    to_data_beta[row][col] += weight;
+	  }
+	  to_data_num_pts[row][col]++;
+	}
+      }
+    }
+
+    free(pair);
+    free(list.point); free(list.order); free(list.dist);
+  }
+
+  return ncells;
+}
+
+/*------------------------------------------------------------------------
+ * method_code - letter for the current weighting method
+ *------------------------------------------------------------------------*/
+static int method_code(void)
+{
+  if (weighted_average == cressman) return 'c';
+  if (weighted_average == drop_in_bucket) return 'd';
+  if (weighted_average == inv_dist) return 'w';
+  return 'n';
+}
+
+/*------------------------------------------------------------------------
+ * restore_beta - map intermediate results saved by an earlier run
+ *
+ *	input : beta_filename - name of beta file
+ *              to_grid - output grid
+ *              gather, max_gather_pts - gather mode settings
+ *
+ *	output: to_data, to_data_beta, to_data_num_pts - accumulators,
+ *              row pointers into a private (copy-on-write) mapping
+ *
+ *	result: TRUE if restored, FALSE if beta_filename does not exist
+ *
+ *	note: any other problem, or a beta file made with a different
+ *	      grid, method, radius, power, fill value, gather mode or
+ *	      -q stencils, is fatal
+ *
+ *------------------------------------------------------------------------*/
+static bool restore_beta(char *beta_filename, grid_class *to_grid,
+			 bool gather, int max_gather_pts,
+			 float ***to_data, float ***to_data_beta,
+			 int ***to_data_num_pts)
+{ int fd, row;
+  struct stat st;
+  size_t cells, size;
+  byte1 *map;
+  beta_header *header, expect;
+  float *data, *beta;
+  int *num_pts;
+
+  fd = open(beta_filename, O_RDONLY);
+  if (fd < 0) {
+    if (ENOENT == errno) return FALSE;
+    perror(beta_filename);
+    error_exit("irregrid: ABORTING");
+  }
+
+  cells = (size_t)to_grid->rows*to_grid->cols;
+  size = sizeof(beta_header) + cells*(2*sizeof(float) + sizeof(int));
+  if (fstat(fd, &st) != 0 || (size_t)st.st_size != size) {
+    fprintf(stderr,"irregrid: %s is not a beta file for %s\n",
+	    beta_filename, to_grid->gpd_filename);
+    error_exit("irregrid: ABORTING");
+  }
+
+  map = (byte1 *)mmap(NULL, size, PROT_READ|PROT_WRITE, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (MAP_FAILED == (void *)map) {
+    perror(beta_filename);
+    error_exit("irregrid: ABORTING");
+  }
+
+  header = (beta_header *)map;
+  if (memcmp(header->magic, BETA_MAGIC, sizeof(BETA_MAGIC)) != 0
+      || BETA_VERSION != header->version) {
+    fprintf(stderr,"irregrid: %s is not a version %d beta file\n",
+	    beta_filename, BETA_VERSION);
+    error_exit("irregrid: ABORTING");
+  }
+  if (BETA_BYTE_ORDER != header->byte_order) {
+    fprintf(stderr,"irregrid: %s was written with the other byte order\n",
+	    beta_filename);
+    error_exit("irregrid: ABORTING");
+  }
+  init_beta_header(&expect, to_grid, gather, max_gather_pts);
+  if (header->rows != expect.rows || header->cols != expect.cols
+      || header->method != expect.method
+      || header->shell_radius != expect.shell_radius
+      || header->fill != expect.fill
+      || ('w' == header->method
+	  && header->inv_dist_power != expect.inv_dist_power)) {
+    fprintf(stderr,"irregrid: %s was made with a different grid size,\n"
+	    "method (%c), radius (%g), power (%g) or fill value (%g)\n",
+	    beta_filename, header->method, header->shell_radius,
+	    header->inv_dist_power, header->fill);
+    error_exit("irregrid: ABORTING");
+  }
+  if (header->gather != expect.gather
+      || header->max_gather_pts != expect.max_gather_pts
+      || header->stencil_subcells != expect.stencil_subcells) {
+    fprintf(stderr,"irregrid: %s was made with a different gather mode\n"
+	    "(%s, max %d points) or sub-cells (%d)\n",
+	    beta_filename, header->gather ? "on" : "off",
+	    header->max_gather_pts, header->stencil_subcells);
+    error_exit("irregrid: ABORTING");
+  }
+
+  data = (float *)(map + sizeof(beta_header));
+  beta = data + cells;
+  num_pts = (int *)(beta + cells);
+
+  *to_data = (float **)calloc(to_grid->rows, sizeof(float *));
+  *to_data_beta = (float **)calloc(to_grid->rows, sizeof(float *));
+  *to_data_num_pts = (int **)calloc(to_grid->rows, sizeof(int *));
+  if (!*to_data || !*to_data_beta || !*to_data_num_pts) {
+    perror("restore_beta");
+    error_exit("irregrid: ABORTING");
+  }
+  for (row = 0; row < to_grid->rows; row++) {
+    (*to_data)[row] = data + (size_t)row*to_grid->cols;
+    (*to_data_beta)[row] = beta + (size_t)row*to_grid->cols;
+    (*to_data_num_pts)[row] = num_pts + (size_t)row*to_grid->cols;
+  }
+
+  return TRUE;
+}
+
+/*------------------------------------------------------------------------
+ * save_beta - save intermediate results for a later run
+ *
+ *	input : beta_filename - name of beta file
+ *              to_grid - output grid
+ *              gather, max_gather_pts - gather mode settings
+ *              to_data, to_data_beta, to_data_num_pts - accumulators
+ *              (before normalization)
+ *
+ *	note: the file is written under a temporary name and renamed
+ *	      so an interrupted run leaves the old state intact
+ *
+ *------------------------------------------------------------------------*/
+static void save_beta(char *beta_filename, grid_class *to_grid,
+		      bool gather, int max_gather_pts,
+		      float **to_data, float **to_data_beta,
+		      int **to_data_num_pts)
+{ int row, status;
+  char tmp_filename[FILENAME_MAX+8];
+  beta_header header;
+  FILE *beta_file;
+
+  init_beta_header(&header, to_grid, gather, max_gather_pts);
+
+  sprintf(tmp_filename, "%s.tmp", beta_filename);
+  beta_file = fopen(tmp_filename, "wb");
+  if (!beta_file) {
+    perror(tmp_filename);
+    error_exit("irregrid: ABORTING");
+  }
+
+  status = (1 == fwrite(&header, sizeof(header), 1, beta_file));
+  for (row = 0; status && row < to_grid->rows; row++)
+    status = (to_grid->cols == fwrite(to_data[row], sizeof(float),
+				      to_grid->cols, beta_file));
+  for (row = 0; status && row < to_grid->rows; row++)
+    status = (to_grid->cols == fwrite(to_data_beta[row], sizeof(float),
+				      to_grid->cols, beta_file));
+  for (row = 0; status && row < to_grid->rows; row++)
+    status = (to_grid->cols == fwrite(to_data_num_pts[row], sizeof(int),
+				      to_grid->cols, beta_file));
+  if (0 != fclose(beta_file)) status = FALSE;
+
+  if (!status || 0 != rename(tmp_filename, beta_filename)) {
+    perror(beta_filename);
+    unlink(tmp_filename);
+    error_exit("irregrid: error writing beta file: ABORTING\n");
+  }
+}
+
+/*------------------------------------------------------------------------
+ * init_beta_header - beta file header for the current settings
+ *
+ *	input : to_grid - output grid
+ *              gather, max_gather_pts - gather mode settings
+ *
+ *	output: header - filled in, reserved bytes zero
+ *
+ *	note: -q stencils are recorded only when they are used, i.e.
+ *	      Cressman without gather mode
+ *
+ *------------------------------------------------------------------------*/
+static void init_beta_header(beta_header *header, grid_class *to_grid,
+			     bool gather, int max_gather_pts)
+{
+  memset(header, 0, sizeof(beta_header));
+  memcpy(header->magic, BETA_MAGIC, sizeof(BETA_MAGIC));
+  header->version = BETA_VERSION;
+  header->byte_order = BETA_BYTE_ORDER;
+  header->rows = to_grid->rows;
+  header->cols = to_grid->cols;
+  header->method = method_code();
+  header->fill = fill;
+  header->shell_radius = shell_radius;
+  header->inv_dist_power = inv_dist_power;
+  header->gather = gather;
+  header->max_gather_pts = gather ? max_gather_pts : 0;
+  header->stencil_subcells =
+    (weighted_average == cressman && !gather) ? stencil_subcells : 0;
+}
+
+/*------------------------------------------------------------------------
+ * init_cressman_stencils - precompute Cressman weights for -q
+ *
+ *	input : subcells - number of quantized offsets per grid cell
+ *		in each direction
+ *
+ *	note: the stencil for offset (qr, qs) holds the weights for a
+ *	      point at ((qr + 0.5)/subcells - 0.5, (qs + 0.5)/subcells - 0.5)
+ *	      from its nearest cell, zero outside shell_radius
+ *
+ *------------------------------------------------------------------------*/
+static void init_cressman_stencils(int subcells)
+{ int qr, qs, i, j, n, w;
+  double fr, fs, dr, ds, d2, r2, bytes;
+  cressman_stencil *stencil;
+
+  w = (int)(shell_radius + 0.5);
+  if (w > CRESSMAN_MAX_HALF_WIDTH)
+    error_exit("irregrid: shell radius too large for -q");
+  n = 2*w + 1;
+  r2 = shell_radius * shell_radius;
+
+  bytes = (double)subcells*subcells
+    * ((double)n*n*sizeof(double) + sizeof(cressman_stencil));
+  if (bytes > CRESSMAN_STENCIL_MAX_BYTES) {
+    fprintf(stderr,"irregrid: -q %d with radius %g needs %.0f MB of "
+	    "stencils, limit is %.0f MB\n", subcells, shell_radius,
+	    bytes/(1024*1024), CRESSMAN_STENCIL_MAX_BYTES/(1024*1024));
+    error_exit("irregrid: use a smaller -q: ABORTING");
+  }
+
+  stencils = (cressman_stencil *)calloc(subcells*subcells,
+					sizeof(cressman_stencil));
+  if (!stencils) { perror("init_cressman_stencils"); exit(ABORT); }
+
+  for (qs = 0; qs < subcells; qs++) {
+    fs = (qs + 0.5)/subcells - 0.5;
+    for (qr = 0; qr < subcells; qr++) {
+      fr = (qr + 0.5)/subcells - 0.5;
+      stencil = &stencils[qs*subcells + qr];
+      stencil->weight = (double *)calloc(n*n, sizeof(double));
+      if (!stencil->weight) { perror("init_cressman_stencils"); exit(ABORT); }
+
+      for (j = 0; j < n; j++) {
+	ds = j - w - fs;
+	stencil->first[j] = n;
+	stencil->last[j] = -1;
+	for (i = 0; i < n; i++) {
+	  dr = i - w - fr;
+	  d2 = dr*dr + ds*ds;
+	  if (d2 > r2) continue;
+	  if (i < stencil->first[j]) stencil->first[j] = i;
+	  stencil->last[j] = i;
+	  stencil->weight[j*n + i] = (r2 - d2)/(r2 + d2);
+	}
+      }
+    }
+  }
+
+  stencil_subcells = subcells;
+  stencil_half_width = w;
+}
+
+/*------------------------------------------------------------------------
+ * cressman_stencil_point - add one input point using a stencil
+ *
+ *	input : from_r, from_s - input data location
+ *              from_dat - data value
+ *
+ *	output: to_data, to_data_beta, to_data_num_pts - as cressman
+ *
+ *	result: number of grid cells updated
+ *
+ *------------------------------------------------------------------------*/
+static int cressman_stencil_point(double from_r, double from_s,
+				  float from_dat, grid_class *to_grid,
+				  float **to_data, float **to_data_beta,
+				  int **to_data_num_pts)
+{ int base_r, base_s, qr, qs, j, row, c0, c1, n, w, npts;
+  cressman_stencil *stencil;
+
+  w = stencil_half_width;
+  n = 2*w + 1;
+
+  base_r = (int)floor(from_r + 0.5);
+  base_s = (int)floor(from_s + 0.5);
+  qr = (int)floor((from_r - base_r + 0.5)*stencil_subcells);
+  qs = (int)floor((from_s - base_s + 0.5)*stencil_subcells);
+  if (qr < 0) qr = 0;
+  if (qr >= stencil_subcells) qr = stencil_subcells - 1;
+  if (qs < 0) qs = 0;
+  if (qs >= stencil_subcells) qs = stencil_subcells - 1;
+  stencil = &stencils[qs*stencil_subcells + qr];
+
+  npts = 0;
+  for (j = 0; j < n; j++) {
+    row = base_s - w + j;
+    if (row < 0 || row >= to_grid->rows) continue;
+    c0 = base_r - w + stencil->first[j];
+    c1 = base_r - w + stencil->last[j];
+    if (c0 < 0) c0 = 0;
+    if (c1 >= to_grid->cols) c1 = to_grid->cols - 1;
+    if (c0 > c1) continue;
+    stencil_span(to_data[row] + c0, to_data_beta[row] + c0,
+		 to_data_num_pts[row] + c0,
+		 stencil->weight + j*n + c0 - (base_r - w),
+		 c1 - c0 + 1, from_dat);
+    npts += c1 - c0 + 1;
+  }
+
+  return npts;
+}
+
+/*------------------------------------------------------------------------
+ * stencil_span - accumulate one row span of a stencil
+ *
+ *	input : weight - stencil weights for the span
+ *              n - span length
+ *              value - data value
+ *
+ *	output: data, beta, num - accumulators for the span
+ *
+ *	note: sums are formed in double and stored as float, exactly
+ *	      as the scalar += in cressman
+ *
+ *------------------------------------------------------------------------*/
+static void stencil_span(float *data, float *beta, int *num,
+			 double *weight, int n, float value)
+{ int k;
+#ifdef __SSE2__
+  __m128d v, w, d, b;
+  __m128i ones;
+
+  v = _mm_set1_pd(value);
+  for (k = 0; k + 2 <= n; k += 2) {
+    w = _mm_loadu_pd(weight + k);
+    d = _mm_cvtps_pd(_mm_castsi128_ps(_mm_loadl_epi64((__m128i *)(data + k))));
+    b = _mm_cvtps_pd(_mm_castsi128_ps(_mm_loadl_epi64((__m128i *)(beta + k))));
+    d = _mm_add_pd(d, _mm_mul_pd(v, w));
+    b = _mm_add_pd(b, w);
+    _mm_storel_epi64((__m128i *)(data + k), _mm_castps_si128(_mm_cvtpd_ps(d)));
+    _mm_storel_epi64((__m128i *)(beta + k), _mm_castps_si128(_mm_cvtpd_ps(b)));
+  }
+  for (; k < n; k++) {
+    data[k] += value * weight[k];
+    beta[k] += weight[k];
+  }
+
+  ones = _mm_set1_epi32(1);
+  for (k = 0; k + 4 <= n; k += 4)
+    _mm_storeu_si128((__m128i *)(num + k),
+		     _mm_add_epi32(_mm_loadu_si128((__m128i *)(num + k)), ones));
+  for (; k < n; k++) ++num[k];
+#else
+  for (k = 0; k < n; k++) {
+    data[k] += value * weight[k];
+    beta[k] += weight[k];
+    ++num[k];
+  }
+#endif
+}
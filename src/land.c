@@ -0,0 +1,705 @@
+/*======================================================================
+ * land - point in polygon queries on closed coastline segments
+ *
+ *	closed segments become rings, a point is on land if it lies
+ *	inside an odd number of rings (so lakes and islands in lakes
+ *	work), rings are straight lines in latitude,longitude
+ *
+ *	the rings' edges are bucketed into a latitude,longitude grid
+ *	and the inside flag of every cell's south east corner is found
+ *	once with a scan along each row, a query then only tests the
+ *	edges of its own cell on a path from the point east to the
+ *	cell's east side and south to the corner
+ *
+ *	vertices are integers and query points are rounded to
+ *	1/(1024*land_SUBUNITS) degree, all tests are exact integer
+ *	arithmetic, points are nudged infinitesimally north, then east,
+ *	so no path passes through a vertex and points exactly on an
+ *	edge still get a consistent answer
+ *
+ * National Snow & Ice Data Center, University of Colorado, Boulder
+ * Copyright (C) 2026 University of Colorado
+ *======================================================================*/
+static const char land_c_rcsid[]="$Id$";
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "define.h"
+#include "cdb.h"
+#define land_c_
+#include "land.h"
+
+const char *id_land(void)
+{
+  return land_c_rcsid;
+}
+
+/*
+ *	degrees in cdb units
+ */
+#define land_DEGREES(d) ((int4)((d) / CDB_LAT_SCALE))
+
+/*
+ *	cell size limits for the default in cdb units
+ */
+#define land_MIN_CELL land_DEGREES(1./64)
+#define land_MAX_CELL land_DEGREES(10.)
+
+static int4 to_units(double degrees)
+{
+  return (int4)floor(degrees / CDB_LAT_SCALE + 0.5);
+}
+
+static NSIDCint8 to_subunits(double degrees)
+{
+  return (NSIDCint8)floor(degrees / CDB_LAT_SCALE * land_SUBUNITS + 0.5);
+}
+
+static NSIDCint8 floor_div(NSIDCint8 a, NSIDCint8 b)
+{
+  return a >= 0 ? a / b : -((-a + b - 1) / b);
+}
+
+/*------------------------------------------------------------------------
+ * init_land - create new land_class
+ *
+ *	input : cell_size - grid cell size in degrees, 0 picks a size
+ *			    that gives about land_EDGES_PER_CELL
+ *
+ *	result: new land_class or NULL
+ *
+ *------------------------------------------------------------------------*/
+land_class *init_land(double cell_size)
+{ land_class *this;
+
+  this = (land_class *)calloc(1, sizeof(land_class));
+  if (!this) { perror("init_land"); return NULL; }
+  this->cell_size = cell_size > 0 ? cell_size : 0;
+  return this;
+}
+
+/*------------------------------------------------------------------------
+ * free_land - release resources allocated by init_land
+ *------------------------------------------------------------------------*/
+static void free_index_land(land_class *this)
+{
+  if (this->first) free(this->first);
+  if (this->list) free(this->list);
+  if (this->corner) free(this->corner);
+  this->first = this->list = NULL;
+  this->corner = NULL;
+  this->indexed = FALSE;
+}
+
+void free_land(land_class *this)
+{
+  if (!this) return;
+  free_index_land(this);
+  if (this->edge) free(this->edge);
+  free(this);
+}
+
+static bool add_edge(land_class *this, int4 x0, int4 y0, int4 x1, int4 y1)
+{ land_edge *e;
+
+  if (x0 == x1 && y0 == y1) return TRUE;
+
+  if (this->num_edges >= this->max_edges)
+  { this->max_edges = 2 * this->max_edges + 1024;
+    this->edge = (land_edge *)realloc(this->edge,
+				      this->max_edges * sizeof(land_edge));
+    if (!this->edge) { perror("add_polyline_land"); return FALSE; }
+  }
+
+  e = this->edge + this->num_edges++;
+  e->x0 = x0; e->y0 = y0;
+  e->x1 = x1; e->y1 = y1;
+  return TRUE;
+}
+
+/*------------------------------------------------------------------------
+ * add_polyline_land - add a ring
+ *
+ *	input : this - land_class
+ *		npts - number of points
+ *		lat,lon - points in degrees, rounded to cdb units
+ *
+ *	result: 0 = success, -1 = error
+ *
+ *	note  : polylines that are not closed, first point == last point
+ *		or 360 degrees of longitude away, are counted and skipped,
+ *		a ring around a pole is closed off along the pole on
+ *		the side of its average latitude
+ *
+ *------------------------------------------------------------------------*/
+int add_polyline_land(land_class *this, int npts, double *lat, double *lon)
+{ int i, start;
+  int4 x, y, x_first, y_first, x_prev, dx, xmin, shift, y_pole;
+  int4 half = land_DEGREES(180), full = land_DEGREES(360);
+  double sum_lat;
+  land_edge *e;
+
+  if (npts <= 3) { ++this->num_open; return 0; }
+
+/*
+ *	unwrap longitude so the ring is continuous
+ */
+  start = this->num_edges;
+  x = x_first = x_prev = to_units(lon[0]);
+  y = y_first = to_units(lat[0]);
+  xmin = x;
+  sum_lat = lat[0];
+  for (i = 1; i < npts; i++)
+  { dx = to_units(lon[i]) - x_prev;
+    x_prev += dx;
+    if (dx > half) dx -= full;
+    else if (dx < -half) dx += full;
+    if (!add_edge(this, x, y, x + dx, to_units(lat[i]))) return -1;
+    x += dx;
+    y = to_units(lat[i]);
+    if (x < xmin) xmin = x;
+    sum_lat += lat[i];
+  }
+
+  if (y != y_first || (x != x_first && abs(x - x_first) != full))
+  { this->num_edges = start;
+    ++this->num_open;
+    return 0;
+  }
+
+  if (x != x_first)
+  { y_pole = land_DEGREES(sum_lat > 0 ? 90 : -90);
+    if (!add_edge(this, x, y, x, y_pole)
+	|| !add_edge(this, x, y_pole, x_first, y_pole)
+	|| !add_edge(this, x_first, y_pole, x_first, y_first)) return -1;
+    ++this->num_polar;
+  }
+
+/*
+ *	move the west end into [-180,180)
+ */
+  shift = (int4)floor_div(xmin + half, full) * full;
+  if (shift != 0)
+  { for (e = this->edge + start; e < this->edge + this->num_edges; e++)
+    { e->x0 -= shift;
+      e->x1 -= shift;
+    }
+  }
+
+  ++this->num_rings;
+  this->indexed = FALSE;
+  return 0;
+}
+
+/*------------------------------------------------------------------------
+ * add_cdb_land - add all closed segments of a coastline database
+ *
+ *	input : this - land_class
+ *		cdb - coastline database, join segments first with
+ *		      cdb_edit -j so that coastlines are closed
+ *
+ *	result: 0 = success, -1 = error
+ *
+ *------------------------------------------------------------------------*/
+int add_cdb_land(land_class *this, cdb_class *cdb)
+{ int iseg, npts, max_pts, status;
+  double *lat, *lon;
+
+  max_pts = 1024;
+  lat = (double *)malloc(max_pts * sizeof(double));
+  lon = (double *)malloc(max_pts * sizeof(double));
+  if (!lat || !lon) { perror("add_cdb_land"); return -1; }
+
+  status = 0;
+  for (iseg = 0, reset_current_seg_cdb(cdb);
+       iseg < cdb->seg_count; iseg++, next_segment_cdb(cdb))
+  { while ((npts = get_current_seg_cdb(cdb, lat, lon, max_pts)) < 0)
+    { max_pts = -npts;
+      lat = (double *)realloc(lat, max_pts * sizeof(double));
+      lon = (double *)realloc(lon, max_pts * sizeof(double));
+      if (!lat || !lon) { perror("add_cdb_land"); return -1; }
+    }
+    if (0 == npts) { status = -1; break; }
+    if (add_polyline_land(this, npts, lat, lon)) { status = -1; break; }
+  }
+
+  free(lat);
+  free(lon);
+  return status;
+}
+
+/*------------------------------------------------------------------------
+ * orient - which side of an edge a point is on
+ *
+ *	input : e - edge
+ *		x,y - point in subunits, nudged north then east
+ *
+ *	result: 1 = left of the edge, -1 = right, never on the edge
+ *
+ *------------------------------------------------------------------------*/
+static int orient(land_edge *e, NSIDCint8 x, NSIDCint8 y)
+{ NSIDCint8 ex = e->x1 - e->x0, ey = e->y1 - e->y0, d;
+
+  d = ex * (y - (NSIDCint8)e->y0 * land_SUBUNITS)
+    - ey * (x - (NSIDCint8)e->x0 * land_SUBUNITS);
+  if (d != 0) return d > 0 ? 1 : -1;
+  if (ex != 0) return ex > 0 ? 1 : -1;
+  return ey > 0 ? -1 : 1;
+}
+
+/*------------------------------------------------------------------------
+ * cross_row - parity of edges crossing a path east along a row
+ *
+ *	input : this - land_class
+ *		list, count - edges to test
+ *		xa, xb - path from xa to xb, xa <= xb, in subunits
+ *		y - latitude of the path in subunits
+ *
+ *	result: 1 if an odd number of edges cross the path, else 0
+ *
+ *------------------------------------------------------------------------*/
+static int cross_row(land_class *this, int *list, int count,
+		     NSIDCint8 xa, NSIDCint8 xb, NSIDCint8 y)
+{ int i, parity = 0;
+  NSIDCint8 x0, x1;
+  land_edge *e;
+
+  for (i = 0; i < count; i++)
+  { e = this->edge + list[i];
+    if (((NSIDCint8)e->y0 * land_SUBUNITS <= y)
+	== ((NSIDCint8)e->y1 * land_SUBUNITS <= y)) continue;
+    x0 = (NSIDCint8)(e->x0 < e->x1 ? e->x0 : e->x1) * land_SUBUNITS;
+    x1 = (NSIDCint8)(e->x0 < e->x1 ? e->x1 : e->x0) * land_SUBUNITS;
+    if (x1 <= xa || x0 > xb) continue;
+    if ((x0 > xa && x1 <= xb) || orient(e, xa, y) != orient(e, xb, y))
+      parity ^= 1;
+  }
+  return parity;
+}
+
+/*------------------------------------------------------------------------
+ * cross_col - parity of edges crossing a path north along a column
+ *
+ *	input : this - land_class
+ *		list, count - edges to test
+ *		x - longitude of the path in subunits
+ *		ya, yb - path from ya to yb, ya <= yb, in subunits
+ *
+ *	result: 1 if an odd number of edges cross the path, else 0
+ *
+ *------------------------------------------------------------------------*/
+static int cross_col(land_class *this, int *list, int count,
+		     NSIDCint8 x, NSIDCint8 ya, NSIDCint8 yb)
+{ int i, parity = 0;
+  NSIDCint8 y0, y1;
+  land_edge *e;
+
+  for (i = 0; i < count; i++)
+  { e = this->edge + list[i];
+    if (((NSIDCint8)e->x0 * land_SUBUNITS <= x)
+	== ((NSIDCint8)e->x1 * land_SUBUNITS <= x)) continue;
+    y0 = (NSIDCint8)(e->y0 < e->y1 ? e->y0 : e->y1) * land_SUBUNITS;
+    y1 = (NSIDCint8)(e->y0 < e->y1 ? e->y1 : e->y0) * land_SUBUNITS;
+    if (y1 <= ya || y0 > yb) continue;
+    if ((y0 > ya && y1 <= yb) || orient(e, x, ya) != orient(e, x, yb))
+      parity ^= 1;
+  }
+  return parity;
+}
+
+/*------------------------------------------------------------------------
+ * index_land - bucket the edges into the grid and find corner flags
+ *
+ *	input : this - land_class
+ *
+ *	result: 0 = success, -1 = error
+ *
+ *	note  : called by query_land when rings have been added,
+ *		call it before using point_on_land from several threads
+ *
+ *------------------------------------------------------------------------*/
+int index_land(land_class *this)
+{ int i, r, c, r0, r1, c0, c1, pass, ncells;
+  int4 xmax, ymin, ymax;
+  double area;
+  land_edge *e;
+
+  free_index_land(this);
+
+/*
+ *	grid covers every ring from 180 W, 90 S
+ */
+  this->west = land_DEGREES(-180);
+  this->south = land_DEGREES(-90);
+  xmax = land_DEGREES(180);
+  ymax = land_DEGREES(90);
+  for (e = this->edge; e < this->edge + this->num_edges; e++)
+  { if (e->x0 > xmax) xmax = e->x0;
+    if (e->x1 > xmax) xmax = e->x1;
+    if (e->y0 > ymax) ymax = e->y0;
+    if (e->y1 > ymax) ymax = e->y1;
+    if (e->y0 < this->south) this->south = e->y0;
+    if (e->y1 < this->south) this->south = e->y1;
+  }
+
+  if (this->cell_size > 0)
+    this->cell = to_units(this->cell_size);
+  else
+  { area = (double)land_DEGREES(360) * land_DEGREES(180);
+    this->cell = (int4)sqrt(area * land_EDGES_PER_CELL
+			    / (this->num_edges + 1));
+    if (this->cell < land_MIN_CELL) this->cell = land_MIN_CELL;
+    if (this->cell > land_MAX_CELL) this->cell = land_MAX_CELL;
+  }
+  if (this->cell < 1) this->cell = 1;
+
+  this->cols = (int)((xmax - this->west + this->cell - 1) / this->cell);
+  this->rows = (int)((ymax - this->south + this->cell - 1) / this->cell);
+  if (this->cols < 1) this->cols = 1;
+  if (this->rows < 1) this->rows = 1;
+  ncells = this->cols * this->rows;
+
+/*
+ *	list each edge in every cell whose tests might need it, cells
+ *	whose closed box its bounding box overlaps, less the row whose
+ *	south side it only touches from below (two passes, count then fill)
+ */
+  this->first = (int *)calloc(ncells + 1, sizeof(int));
+  this->corner = (byte1 *)calloc(ncells, sizeof(byte1));
+  if (!this->first || !this->corner) { perror("index_land"); return -1; }
+
+  for (pass = 0; pass < 2; pass++)
+  { for (i = 0; i < this->num_edges; i++)
+    { e = this->edge + i;
+      ymin = e->y0 < e->y1 ? e->y0 : e->y1;
+      ymax = e->y0 < e->y1 ? e->y1 : e->y0;
+      r0 = (int)floor_div(ymin - this->south, this->cell);
+      r1 = (int)floor_div(ymax - this->south - 1, this->cell);
+      c0 = (int)floor_div((e->x0 < e->x1 ? e->x0 : e->x1)
+			  - this->west - 1, this->cell);
+      c1 = (int)floor_div((e->x0 < e->x1 ? e->x1 : e->x0)
+			  - this->west - 1, this->cell);
+      if (r0 < 0) r0 = 0;
+      if (r1 >= this->rows) r1 = this->rows - 1;
+      if (c0 < 0) c0 = 0;
+      if (c1 >= this->cols) c1 = this->cols - 1;
+      for (r = r0; r <= r1; r++)
+      { for (c = c0; c <= c1; c++)
+	{ if (0 == pass) ++this->first[r*this->cols + c + 1];
+	  else this->list[this->first[r*this->cols + c]++] = i;
+	}
+      }
+    }
+    if (0 == pass)
+    { for (i = 0; i < ncells; i++) this->first[i+1] += this->first[i];
+      this->list = (int *)malloc((this->first[ncells] + 1) * sizeof(int));
+      if (!this->list) { perror("index_land"); return -1; }
+    }
+    else
+    { for (i = ncells; i > 0; i--) this->first[i] = this->first[i-1];
+      this->first[0] = 0;
+    }
+  }
+
+/*
+ *	east of the grid is outside every ring, walk each row's south
+ *	side west, one cell at a time
+ */
+#ifdef _OPENMP
+#pragma omp parallel for private(c, i) schedule(dynamic)
+#endif
+  for (r = 0; r < this->rows; r++)
+  { NSIDCint8 y, xa, xb;
+
+    y = (NSIDCint8)(this->south + r * this->cell) * land_SUBUNITS;
+    i = r*this->cols + this->cols - 1;
+    this->corner[i] = 0;
+    for (c = this->cols - 2; c >= 0; c--, i--)
+    { xa = (NSIDCint8)(this->west + (c+1) * this->cell) * land_SUBUNITS;
+      xb = xa + (NSIDCint8)this->cell * land_SUBUNITS;
+      this->corner[i-1] = this->corner[i]
+	^ cross_row(this, this->list + this->first[i],
+		    this->first[i+1] - this->first[i], xa, xb, y);
+    }
+  }
+
+  this->indexed = TRUE;
+  return 0;
+}
+
+/*
+ *	inside flag of a point in subunits
+ */
+static int inside(land_class *this, NSIDCint8 x, NSIDCint8 y)
+{ NSIDCint8 cell, xe, ys;
+  int r, c, i, count;
+  int *list;
+
+  cell = (NSIDCint8)this->cell * land_SUBUNITS;
+  r = (int)floor_div(y - (NSIDCint8)this->south * land_SUBUNITS, cell);
+  c = (int)floor_div(x - (NSIDCint8)this->west * land_SUBUNITS, cell);
+  if (r < 0 || r >= this->rows || c < 0 || c >= this->cols) return 0;
+
+  i = r*this->cols + c;
+  count = this->first[i+1] - this->first[i];
+  if (0 == count) return this->corner[i];
+
+  list = this->list + this->first[i];
+  xe = (NSIDCint8)this->west * land_SUBUNITS + (c+1) * cell;
+  ys = (NSIDCint8)this->south * land_SUBUNITS + r * cell;
+  return this->corner[i]
+    ^ cross_row(this, list, count, x, xe, y)
+    ^ cross_col(this, list, count, xe, ys, y);
+}
+
+/*------------------------------------------------------------------------
+ * point_on_land - test one point
+ *
+ *	input : this - land_class
+ *		lat,lon - point in degrees
+ *
+ *	result: TRUE iff the point is inside an odd number of rings
+ *
+ *------------------------------------------------------------------------*/
+bool point_on_land(land_class *this, double lat, double lon)
+{ NSIDCint8 x, y;
+
+  if (!this->indexed && index_land(this)) return FALSE;
+
+  normalize_lon_cdb(lon);
+  if (lon >= 180) lon -= 360;
+  x = to_subunits(lon);
+  y = to_subunits(lat);
+
+/*
+ *	rings lie in [-180,540), each at most once around
+ */
+  return inside(this, x, y)
+    ^ inside(this, x + (NSIDCint8)land_DEGREES(360) * land_SUBUNITS, y);
+}
+
+/*------------------------------------------------------------------------
+ * query_land - test a batch of points
+ *
+ *	input : this - land_class
+ *		npts - number of points
+ *		lat,lon - points in degrees
+ *
+ *	output: on_land - 1 for each point on land, else 0
+ *
+ *	result: number of points on land, -1 on error
+ *
+ *------------------------------------------------------------------------*/
+int query_land(land_class *this, int npts, double *lat, double *lon,
+	       byte1 *on_land)
+{ int i, count;
+
+  if (!this->indexed && index_land(this)) return -1;
+
+  count = 0;
+#ifdef _OPENMP
+#pragma omp parallel for reduction(+:count) schedule(static, 4096)
+#endif
+  for (i = 0; i < npts; i++)
+  { on_land[i] = point_on_land(this, lat[i], lon[i]) ? 1 : 0;
+    count += on_land[i];
+  }
+
+  return count;
+}
+
+#ifdef LANDTEST
+/*------------------------------------------------------------------------
+ * landtest - regression test point in polygon queries
+ *
+ *	random overlapping rings are added in two small patches, one
+ *	across 180, and point_on_land is checked against a crossing
+ *	count over every edge, nudged north then east the same way, at
+ *	every vertex, edge midpoint, one subunit around each vertex and
+ *	at random points, for several cell sizes. query_land is checked
+ *	against point_on_land. Any difference is reported and the exit
+ *	status is failure.
+ *------------------------------------------------------------------------*/
+#define LANDTEST_RINGS 60
+#define LANDTEST_MAX_VERTICES 10
+#define LANDTEST_RANDOM_POINTS 20000
+
+static int random_int(int lo, int hi)
+{
+  return lo + (int)((hi - lo + 1.0) * (rand() / (RAND_MAX + 1.0)));
+}
+
+/*
+ *	parity of edges crossing a ray east from x,y in subunits, rings
+ *	as added, not wrapped
+ */
+static int crossings(land_edge *edge, int num_edges, NSIDCint8 x, NSIDCint8 y)
+{ int i, parity = 0;
+  NSIDCint8 x0, y0, x1, y1, d;
+
+  for (i = 0; i < num_edges; i++)
+  { x0 = (NSIDCint8)edge[i].x0 * land_SUBUNITS;
+    y0 = (NSIDCint8)edge[i].y0 * land_SUBUNITS;
+    x1 = (NSIDCint8)edge[i].x1 * land_SUBUNITS;
+    y1 = (NSIDCint8)edge[i].y1 * land_SUBUNITS;
+    if ((y0 > y) == (y1 > y)) continue;
+    if (x < x0 && x < x1) { parity ^= 1; continue; }
+    if (x > x0 && x > x1) continue;
+
+/*
+ *	d has the sign of x less the edge at y, on the edge the nudge
+ *	decides, left of edges running north east or south west
+ */
+    d = (x - x0) * (y1 - y0) - (x1 - x0) * (y - y0);
+    if (y1 < y0) d = -d;
+    if (d < 0 || (0 == d && (x1 - x0) * (y1 - y0) > 0)) parity ^= 1;
+  }
+  return parity;
+}
+
+static int reference(land_edge *edge, int num_edges, NSIDCint8 x, NSIDCint8 y)
+{ NSIDCint8 turn = (NSIDCint8)land_DEGREES(360) * land_SUBUNITS;
+
+  return crossings(edge, num_edges, x - turn, y)
+    ^ crossings(edge, num_edges, x, y)
+    ^ crossings(edge, num_edges, x + turn, y);
+}
+
+/*
+ *	test one point given in subunits
+ */
+static int check_point(land_class *this, land_edge *edge, int num_edges,
+		       NSIDCint8 x, NSIDCint8 y)
+{ double lat, lon;
+  int expected;
+
+  lat = (double)y * CDB_LAT_SCALE / land_SUBUNITS;
+  lon = (double)x * CDB_LON_SCALE / land_SUBUNITS;
+  normalize_lon_cdb(lon);
+  expected = reference(edge, num_edges, x, y);
+  if ((point_on_land(this, lat, lon) ? 1 : 0) == expected) return 0;
+
+  fprintf(stderr,"landtest: cell %g lat %.12f lon %.12f expected %d\n",
+	  this->cell_size, lat, lon, expected);
+  return 1;
+}
+
+int main(void)
+{ static double patch_lat[2] = { 45, -30 }, patch_lon[2] = { 10, 180 };
+  static double cell_size[4] = { 0, 1./16, 0.25, 3 };
+  double lat[LANDTEST_MAX_VERTICES+1], lon[LANDTEST_MAX_VERTICES+1];
+  double angle[LANDTEST_MAX_VERTICES], radius, swap;
+  double *qlat, *qlon;
+  byte1 *on_land;
+  int ip, ir, ic, iv, nv, i, j, dx, dy, size, num_edges, npts, count;
+  int errors = 0;
+  int4 patch_x, patch_y;
+  NSIDCint8 x, y, x0, y0;
+  land_edge *edge;
+  land_class *this;
+
+  qlat = (double *)malloc(LANDTEST_RANDOM_POINTS * sizeof(double));
+  qlon = (double *)malloc(LANDTEST_RANDOM_POINTS * sizeof(double));
+  on_land = (byte1 *)malloc(LANDTEST_RANDOM_POINTS);
+  if (!qlat || !qlon || !on_land) { perror("landtest"); exit(ABORT); }
+
+  for (ic = 0; ic < 4; ic++)
+  { srand(1);
+    this = init_land(cell_size[ic]);
+    if (!this) exit(ABORT);
+
+/*
+ *	star shaped rings, half a few cdb units across and half up to
+ *	most of a degree so edges span cells, self intersecting when
+ *	angles repeat, each closed by repeating its first vertex
+ */
+    for (ip = 0; ip < 2; ip++)
+    { patch_x = land_DEGREES(patch_lon[ip]);
+      patch_y = land_DEGREES(patch_lat[ip]);
+      for (ir = 0; ir < LANDTEST_RINGS; ir++)
+      { nv = random_int(3, LANDTEST_MAX_VERTICES);
+	for (iv = 0; iv < nv; iv++) angle[iv] = rand() * 2*PI / RAND_MAX;
+	for (i = 1; i < nv; i++)
+	  for (j = i; j > 0 && angle[j-1] > angle[j]; j--)
+	  { swap = angle[j]; angle[j] = angle[j-1]; angle[j-1] = swap; }
+	size = ir % 2 ? 8 : 400;
+	x0 = patch_x + random_int(-size/2, size/2);
+	y0 = patch_y + random_int(-size/2, size/2);
+	for (iv = 0; iv < nv; iv++)
+	{ radius = random_int(1, size);
+	  lat[iv] = (y0 + floor(radius * sin(angle[iv]) + 0.5)) * CDB_LAT_SCALE;
+	  lon[iv] = (x0 + floor(radius * cos(angle[iv]) + 0.5)) * CDB_LON_SCALE;
+	}
+	lat[nv] = lat[0];
+	lon[nv] = lon[0];
+	if (add_polyline_land(this, nv+1, lat, lon)) exit(ABORT);
+      }
+    }
+
+/*
+ *	copy the edges for the reference, every vertex is the start of
+ *	an edge
+ */
+    num_edges = this->num_edges;
+    edge = (land_edge *)malloc(num_edges * sizeof(land_edge));
+    if (!edge) { perror("landtest"); exit(ABORT); }
+    memcpy(edge, this->edge, num_edges * sizeof(land_edge));
+
+    for (i = 0; i < num_edges; i++)
+    { x = (NSIDCint8)edge[i].x0 * land_SUBUNITS;
+      y = (NSIDCint8)edge[i].y0 * land_SUBUNITS;
+      for (dx = -1; dx <= 1; dx++)
+	for (dy = -1; dy <= 1; dy++)
+	  errors += check_point(this, edge, num_edges, x + dx, y + dy);
+      x = ((NSIDCint8)edge[i].x0 + edge[i].x1) * (land_SUBUNITS/2);
+      y = ((NSIDCint8)edge[i].y0 + edge[i].y1) * (land_SUBUNITS/2);
+      errors += check_point(this, edge, num_edges, x, y);
+    }
+
+    for (ip = 0; ip < 2; ip++)
+    { patch_x = land_DEGREES(patch_lon[ip]);
+      patch_y = land_DEGREES(patch_lat[ip]);
+      for (i = 0; i < LANDTEST_RANDOM_POINTS; i++)
+      { size = i % 2 ? 16 : 800;
+	x = ((NSIDCint8)patch_x - size/2) * land_SUBUNITS
+	  + (NSIDCint8)random_int(0, size) * land_SUBUNITS 
+	  + random_int(0, land_SUBUNITS - 1);
+	y = ((NSIDCint8)patch_y - size/2) * land_SUBUNITS
+	  + (NSIDCint8)random_int(0, size) * land_SUBUNITS
+	  + random_int(0, land_SUBUNITS - 1);
+	errors += check_point(this, edge, num_edges, x, y);
+	qlat[i] = (double)y * CDB_LAT_SCALE / land_SUBUNITS;
+	qlon[i] = (double)x * CDB_LON_SCALE / land_SUBUNITS;
+	normalize_lon_cdb(qlon[i]);
+      }
+
+      npts = LANDTEST_RANDOM_POINTS;
+      count = query_land(this, npts, qlat, qlon, on_land);
+      for (i = 0; i < npts; i++)
+      { if (on_land[i] != (point_on_land(this, qlat[i], qlon[i]) ? 1 : 0))
+	{ fprintf(stderr,"landtest: query_land differs at %d\n", i);
+	  ++errors;
+	}
+	count -= on_land[i];
+      }
+      if (0 != count)
+      { fprintf(stderr,"landtest: query_land count is off by %d\n", count);
+	++errors;
+      }
+    }
+
+    fprintf(stderr,"cell %g: %d rings, %d edges, %d by %d cells\n",
+	    cell_size[ic], this->num_rings, num_edges, this->cols, this->rows);
+    free(edge);
+    free_land(this);
+  }
+
+  free(qlat);
+  free(qlon);
+  free(on_land);
+  fprintf(stderr,"%d errors\n", errors);
+  return errors > 0 ? ABORT : 0;
+}
+#endif
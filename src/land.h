@@ -0,0 +1,67 @@
+/*======================================================================
+ * land - point in polygon queries on closed coastline segments
+ *
+ * National Snow & Ice Data Center, University of Colorado, Boulder
+ * Copyright (C) 2026 University of Colorado
+ *======================================================================*/
+#ifndef land_h_
+#define land_h_
+
+#include "define.h"
+#include "cdb.h"
+
+#ifdef land_c_
+const char land_h_rcsid[]="$Id$";
+#endif
+
+/*
+ *	ring vertices are kept in cdb units (1/1024 degree) and query
+ *	points in 1/(1024*land_SUBUNITS) degree, so every test is done
+ *	in exact integer arithmetic
+ */
+#define land_SUBUNITS (1<<20)
+
+/*
+ *	default grid cell size aims for this many edges per cell
+ */
+#define land_EDGES_PER_CELL 2
+
+/*
+ *	ring edge in cdb units, x is longitude unwrapped so each ring
+ *	is continuous and its west end lies in [-180,180)
+ */
+typedef struct
+{ int4 x0, y0, x1, y1;
+} land_edge;
+
+typedef struct
+{ double cell_size;		/* requested cell size in degrees or 0 */
+  land_edge *edge;		/* edges of all rings */
+  int num_edges, max_edges;
+  int num_rings;		/* closed polylines added */
+  int num_polar;		/* rings closed around a pole */
+  int num_open;			/* polylines skipped, ends don't match */
+  bool indexed;			/* grid is up to date with the edges */
+  int4 west, south;		/* grid origin in cdb units */
+  int4 cell;			/* grid cell size in cdb units */
+  int cols, rows;
+  int *first, *list;		/* cell i edges list[first[i]..first[i+1]-1] */
+  byte1 *corner;		/* inside flag at south east corner of cell */
+} land_class;
+
+land_class *init_land(double cell_size);
+
+int add_polyline_land(land_class *this, int npts, double *lat, double *lon);
+
+int add_cdb_land(land_class *this, cdb_class *cdb);
+
+int index_land(land_class *this);
+
+bool point_on_land(land_class *this, double lat, double lon);
+
+int query_land(land_class *this, int npts, double *lat, double *lon,
+	       byte1 *on_land);
+
+void free_land(land_class *this);
+
+#endif
@@ -10,13 +10,15 @@ static const char mapenum_c_rcsid[] = "$Id$";
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <math.h>
 #include "define.h"
 #include "maps.h"
 #include "grids.h"
 #include "cdb.h"
 
 #define usage "\n"\
-  "usage: mapenum [-d cdb_file -s map_style -g grat_style] gpd_file\n"\
+  "usage: mapenum [-d cdb_file -s map_style -g grat_style -t tolerance]\n"\
+  "               gpd_file\n"\
   "\n"\
   " input : gpd_file - grid parameters definition\n"\
   "\n"\
@@ -26,7 +28,11 @@ static const char mapenum_c_rcsid[] = "$Id$";
   " option: d cdb_filename - specify coastline database\n"\
   "                          default is global.cdb\n"\
   "         s map_style - specify style (default 0)\n"\
-  "         g grat_style - specify graticule style (default none)\n"
+  "         g grat_style - specify graticule style (default none)\n"\
+  "         t tolerance - pick the coarsest level of detail in the\n"\
+  "                       coastline database thinned to no more than\n"\
+  "                       tolerance kilometers, 0 = full resolution\n"\
+  "                       (default is the grid cell size)\n"
 
 #define CDB_DEFAULT "global.cdb"
 #define MAP_STYLE_DEFAULT 0
@@ -35,11 +41,11 @@ static const char mapenum_c_rcsid[] = "$Id$";
 static grid_class *grid;
 static cdb_class *cdb;
 static int pen_style = MAP_STYLE_DEFAULT;
-static int move_pu(double,double);
-static int draw_pd(double,double);
+static int polyline(int,double *,double *);
 
 int main(int argc, char *argv[])
 { int map_style, grat_style, do_grat;
+  double tolerance;
   char *option, *gpd_filename, *cdb_filename;
 
 /*
@@ -48,6 +54,7 @@ int main(int argc, char *argv[])
   map_style=MAP_STYLE_DEFAULT;
   grat_style=GRAT_STYLE_DEFAULT;
   do_grat = FALSE;
+  tolerance = -1;
   cdb_filename = strdup(CDB_DEFAULT);
 
 /*
@@ -75,6 +82,11 @@ int main(int argc, char *argv[])
 	    --argv; ++argc;
 	  }
 	  break;
+	case 't':
+	  ++argv; --argc;
+	  if (argc <= 0 || sscanf(*argv, "%lf", &tolerance) != 1)
+	    error_exit(usage);
+	  break;
 	case 'V':
 	  fprintf(stderr,"%s\n", mapenum_c_rcsid);
 	  break;
@@ -98,47 +110,56 @@ int main(int argc, char *argv[])
   cdb = init_cdb(cdb_filename);
   if (cdb == NULL) error_exit("mapenum: error openning coastline database");
 
+/*
+ *	default tolerance is the grid cell size in kilometers
+ */
+  if (tolerance < 0) tolerance = grid_cell_size_km(grid);
+
   pen_style = map_style;
-  draw_cdb(cdb, grid->mapx->west, grid->mapx->east, 
-	   CDB_INDEX_LON_MIN, move_pu, draw_pd);
+  draw_box_polyline_cdb(cdb, grid->mapx->south, grid->mapx->north,
+			grid->mapx->west, grid->mapx->east, tolerance,
+			polyline);
 
   if (do_grat)
   { pen_style = grat_style;
-    draw_graticule(grid->mapx, move_pu, draw_pd, NULL);
+    if (draw_graticule_polyline(grid->mapx, polyline, NULL))
+      error_exit("mapenum: error drawing graticule");
   }
 
   exit(EXIT_SUCCESS);
 }
 
-static double pen_x1, pen_y1, pen_x2, pen_y2;
+static double *pen_x, *pen_y;
+static int *pen_keep;
+static int pen_size = 0;
 
 /*------------------------------------------------------------------------
- * move_pu
+ * polyline - project a polyline and list the vectors on the map
  *
- *	input : lat, lon
+ *	input : npts - number of vertices
+ *		lat, lon - vertices
  *
  *------------------------------------------------------------------------*/
-static int move_pu(double lat, double lon)
-{
-  (void) forward_grid(grid, lat, lon, &pen_x1, &pen_y1);
-  return 0;
-}
+static int polyline(int npts, double *lat, double *lon)
+{ int i;
+
+  if (npts > pen_size)
+  { pen_x = (double *)realloc(pen_x, npts * sizeof(double));
+    pen_y = (double *)realloc(pen_y, npts * sizeof(double));
+    pen_keep = (int *)realloc(pen_keep, npts * sizeof(int));
+    if (pen_x == NULL || pen_y == NULL || pen_keep == NULL)
+    { perror("mapenum"); error_exit("mapenum: out of memory"); }
+    pen_size = npts;
+  }
 
-/*------------------------------------------------------------------------
- * draw_pd
- *
- *	input : lat, lon
- *
- *------------------------------------------------------------------------*/
-static int draw_pd(double lat, double lon)
-{ int on_grid;
+  if (forward_grid_polyline(grid, npts, lat, lon, 
+			    pen_x, pen_y, pen_keep) == 0) return 0;
 
-  on_grid = forward_grid(grid, lat, lon, &pen_x2, &pen_y2);
-  if (on_grid && within_mapx(grid->mapx, lat, lon))
-  { printf("%d %lf %lf %lf %lf\n", pen_style, pen_x1, pen_y1, pen_x2, pen_y2);
+  for (i = 1; i < npts; i++)
+  { if (pen_keep[i])
+      printf("%d %lf %lf %lf %lf\n", pen_style, 
+	     pen_x[i-1], pen_y[i-1], pen_x[i], pen_y[i]);
   }
-  pen_x1 = pen_x2;
-  pen_y1 = pen_y2;
 
   return 0;
 }
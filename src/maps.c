@@ -30,6 +30,8 @@ const char *id_maps(void)
  *		draw_pd - draw pen down function
  *		label - print label function or NULL
  *
+ *	note  : with NULL move_pu and draw_pd only labels are drawn
+ *
  *------------------------------------------------------------------------*/
 void draw_graticule(mapx_class *mapx, int (*move_pu)(double lat, double lon),
 		    int (*draw_pd)(double lat, double lon),
@@ -42,7 +44,7 @@ void draw_graticule(mapx_class *mapx, int (*move_pu)(double lat, double lon),
 /*
  *	draw parallels
  */
-  if (mapx->lat_interval > 0)
+  if (mapx->lat_interval > 0 && move_pu != NULL && draw_pd != NULL)
   { for (lat = mapx->south; lat <= mapx->north; lat += mapx->lat_interval)
     { move_pu(lat, (double)mapx->west);
       for (lon = mapx->west+1; lon < east; lon++)
@@ -54,7 +56,7 @@ void draw_graticule(mapx_class *mapx, int (*move_pu)(double lat, double lon),
 /*
  *	draw meridians
  */
-  if (mapx->lon_interval > 0)
+  if (mapx->lon_interval > 0 && move_pu != NULL && draw_pd != NULL)
   { for (lon = mapx->west; lon <= east; lon += mapx->lon_interval)
     { move_pu((double)mapx->south, lon);
       for (lat = mapx->south+1; lat < mapx->north; lat++)
@@ -89,6 +91,73 @@ void draw_graticule(mapx_class *mapx, int (*move_pu)(double lat, double lon),
   }
 }
 
+/*------------------------------------------------------------------------
+ * draw_graticule_polyline - draw grid of lat,lon lines as polylines
+ *
+ *	input : mapx - map definition
+ *		polyline - polyline function, called once per parallel
+ *			or meridian with the same points draw_graticule
+ *			would pass to move_pu and draw_pd
+ *		label - print label function or NULL
+ *
+ *	result: 0 = success, -1 = error (including any non-zero
+ *		return from polyline, which stops the drawing)
+ *
+ *------------------------------------------------------------------------*/
+int draw_graticule_polyline(mapx_class *mapx, 
+			    int (*polyline)(int npts, double *lat, double *lon),
+			    int (*label)(char *string, double lat, double lon))
+{ double lat, lon, east, *lat_line, *lon_line;
+  int npts, max_pts;
+  
+  east = mapx->map_stradles_180 ? mapx->east+360 : mapx->east;
+
+  max_pts = (int)(east - mapx->west) + 3;
+  if (max_pts < (int)(mapx->north - mapx->south) + 3)
+    max_pts = (int)(mapx->north - mapx->south) + 3;
+  if (max_pts < 2) max_pts = 2;
+  lat_line = (double *)malloc(2 * max_pts * sizeof(double));
+  if (lat_line == NULL) { perror("draw_graticule_polyline"); return -1; }
+  lon_line = lat_line + max_pts;
+  
+/*
+ *	draw parallels
+ */
+  if (mapx->lat_interval > 0)
+  { for (lat = mapx->south; lat <= mapx->north; lat += mapx->lat_interval)
+    { npts = 0;
+      lat_line[npts] = lat; lon_line[npts++] = mapx->west;
+      for (lon = mapx->west+1; lon < east; lon++)
+      { lat_line[npts] = lat; lon_line[npts++] = lon; }
+      lat_line[npts] = lat; lon_line[npts++] = east;
+      if (polyline(npts, lat_line, lon_line)) { free(lat_line); return -1; }
+    }
+  }
+
+/*
+ *	draw meridians
+ */
+  if (mapx->lon_interval > 0)
+  { for (lon = mapx->west; lon <= east; lon += mapx->lon_interval)
+    { npts = 0;
+      lat_line[npts] = mapx->south; lon_line[npts++] = lon;
+      for (lat = mapx->south+1; lat < mapx->north; lat++)
+      { lat_line[npts] = lat; lon_line[npts++] = lon; }
+      lat_line[npts] = mapx->north; lon_line[npts++] = lon;
+      if (polyline(npts, lat_line, lon_line)) { free(lat_line); return -1; }
+    }
+  }
+
+  free(lat_line);
+
+/*
+ *	labels are the same either way
+ */
+  if (label != NULL) draw_graticule(mapx, NULL, NULL, label);
+
+  return 0;
+}
+
 /*----------------------------------------------------------------------
  * arc_length - returns arc length from lat1,lon1 to lat2,lon2
  *		in same units as specified Earth radius
@@ -39,6 +39,10 @@ void draw_graticule(mapx_class *mapx, int (*move_pu)(double lat, double lon),
 		    int (*draw_pd)(double lat, double lon),
 		    int (*label)(char *string, double lat, double lon));
 
+int draw_graticule_polyline(mapx_class *mapx, 
+			    int (*polyline)(int npts, double *lat, double *lon),
+			    int (*label)(char *string, double lat, double lon));
+
 double arc_length(double lat1, double lon1, double lat2, double lon2,
 		  double Re);
 
@@ -11,6 +11,7 @@ static const char matrix_c_rcsid[] = "$Id$";
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
+#include <sys/mman.h>
 #include "define.h"
 #define matrix_c_
 #include "matrix.h"
@@ -75,3 +76,138 @@ void **matrix(int rows, int cols, int bytes, int zero)
 
   return(matrix_ptr);
 }
+
+/*
+ *	kept in front of the row pointers of matrix_aligned
+ */
+typedef struct
+{ void *base;			/* start of the allocation */
+  size_t size;			/* bytes allocated */
+  bool mapped;			/* from mmap, else posix_memalign */
+} matrix_block;
+
+#define matrix_BLOCK_SIZE \
+  ((sizeof(matrix_block) + matrix_ALIGN - 1) / matrix_ALIGN * matrix_ALIGN)
+
+/*
+ *	try for huge pages, returns NULL if mmap fails
+ */
+static void *map_hugepages(size_t size)
+{ void *base;
+
+#ifdef MAP_HUGETLB
+  base = mmap(NULL, size, PROT_READ|PROT_WRITE,
+	      MAP_PRIVATE|MAP_ANONYMOUS|MAP_HUGETLB, -1, 0);
+  if (MAP_FAILED != base) return base;
+#endif
+
+  base = mmap(NULL, size, PROT_READ|PROT_WRITE,
+	      MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+  if (MAP_FAILED == base) return NULL;
+#ifdef MADV_HUGEPAGE
+  madvise(base, size, MADV_HUGEPAGE);
+#endif
+  return base;
+}
+
+/*------------------------------------------------------------------------
+ * matrix_aligned - allocate 2-D matrix with aligned rows
+ *
+ *	input : rows - number of rows
+ *		cols - number of columns
+ *		bytes - number of bytes per entry
+ *		flags - any of matrix_ZERO, matrix_PAD, matrix_HUGEPAGE,
+ *			matrix_FIRST_TOUCH (see matrix.h)
+ *
+ *	result: pointer to column of pointers to rows
+ *		i.e. matrix is accessed as matrix_ptr[row][col]
+ *
+ *	note: Every row starts on a matrix_ALIGN byte boundary, so rows
+ *	      are only contiguous when cols*bytes is a multiple of
+ *	      matrix_ALIGN and there is no padding. Read and write the
+ *	      data a row at a time. Resources must be de-allocated with
+ *	      free_matrix_aligned.
+ *
+ *------------------------------------------------------------------------*/
+void **matrix_aligned(int rows, int cols, int bytes, int flags)
+{
+  register int irow;
+  void *base;
+  char *block_ptr, **row_ptr;
+  size_t row_size, row_ptr_size, size;
+  matrix_block *block;
+  bool mapped;
+
+/*
+ *	header, row pointers and each row start on matrix_ALIGN bytes
+ */
+  row_size = (size_t)cols*bytes;
+  row_size = (row_size + matrix_ALIGN - 1) / matrix_ALIGN * matrix_ALIGN;
+  if ((flags & matrix_PAD) && row_size > 0
+      && 0 == row_size % matrix_PAD_SPAN)
+    row_size += matrix_ALIGN;
+  row_ptr_size = (size_t)rows * sizeof(void *);
+  row_ptr_size = (row_ptr_size + matrix_ALIGN - 1)
+    / matrix_ALIGN * matrix_ALIGN;
+  size = matrix_BLOCK_SIZE + row_ptr_size + rows*row_size;
+
+/*
+ *	anonymous maps come zero filled
+ */
+  base = NULL;
+  mapped = FALSE;
+  if ((flags & matrix_HUGEPAGE) && size >= matrix_HUGEPAGE_MIN)
+  { size = (size + matrix_HUGEPAGE_SIZE - 1)
+      / matrix_HUGEPAGE_SIZE * matrix_HUGEPAGE_SIZE;
+    base = map_hugepages(size);
+    mapped = (NULL != base);
+  }
+  if (NULL == base && 0 != posix_memalign(&base, matrix_ALIGN, size))
+  { perror("matrix_aligned"); return(NULL); }
+
+  block = (matrix_block *)base;
+  block->base = base;
+  block->size = size;
+  block->mapped = mapped;
+
+/*
+ *	assign row pointers
+ */
+  row_ptr = (char **)((char *)base + matrix_BLOCK_SIZE);
+  block_ptr = (char *)row_ptr + row_ptr_size;
+  for (irow = 0; irow < rows; irow++)
+  { row_ptr[irow] = block_ptr;
+    block_ptr += row_size;
+  }
+
+/*
+ *	clear data area, the first write to a page decides where it lives
+ */
+  if (flags & matrix_FIRST_TOUCH)
+  {
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+    for (irow = 0; irow < rows; irow++)
+      memset(row_ptr[irow], 0, row_size);
+  }
+  else if ((flags & matrix_ZERO) && !mapped && rows > 0)
+    memset(row_ptr[0], 0, rows*row_size);
+
+  return((void **)row_ptr);
+}
+
+/*------------------------------------------------------------------------
+ * free_matrix_aligned - release matrix from matrix_aligned
+ *------------------------------------------------------------------------*/
+void free_matrix_aligned(void **matrix_ptr)
+{
+  matrix_block *block;
+
+  if (NULL == matrix_ptr) return;
+  block = (matrix_block *)((char *)matrix_ptr - matrix_BLOCK_SIZE);
+  if (block->mapped)
+    munmap(block->base, block->size);
+  else
+    free(block->base);
+}
@@ -12,8 +12,35 @@
 const char matrix_h_rcsid[] = "$Id$";
 #endif
 
+/*
+ *	flags, matrix() only uses matrix_ZERO
+ *
+ *	matrix_ZERO - zero fill entries
+ *	matrix_PAD - pad rows whose length is a multiple of
+ *		matrix_PAD_SPAN bytes so that walking down a column
+ *		doesn't land in the same few cache sets every row
+ *	matrix_HUGEPAGE - back matrices of matrix_HUGEPAGE_MIN bytes
+ *		or more with huge pages, reserved ones (MAP_HUGETLB)
+ *		if the system has them, else transparent ones
+ *		(MADV_HUGEPAGE)
+ *	matrix_FIRST_TOUCH - zero rows in parallel with a static
+ *		schedule, so each page is placed in the memory of the
+ *		thread that will later work on those rows
+ */
 #define matrix_ZERO 1
+#define matrix_PAD 2
+#define matrix_HUGEPAGE 4
+#define matrix_FIRST_TOUCH 8
+
+#define matrix_ALIGN 64
+#define matrix_PAD_SPAN 1024
+#define matrix_HUGEPAGE_SIZE (2*1024*1024)
+#define matrix_HUGEPAGE_MIN (16*matrix_HUGEPAGE_SIZE)
 
 void **matrix(int rows, int cols, int bytes, int zero);
 
+void **matrix_aligned(int rows, int cols, int bytes, int flags);
+
+void free_matrix_aligned(void **matrix_ptr);
+
 #endif
@@ -8,6 +8,10 @@
  *	2 dimensional model : t = [b](r,s) 
  *
  *	solve P([rdata],[sdata])*[b] = [tdata] for [b] by least squares
+ *
+ *	init_pmodel solves with all of the points in memory at once,
+ *	init_fit_pmodel, add_fit_pmodel, solve_fit_pmodel take the
+ *	points in chunks of any size for fits to millions of points
  *	  
  * 2-Aug-1990 K.Knowles knowlesk@kryos.colorado.edu 303-492-0644
  * National Snow & Ice Data Center, University of Colorado, Boulder
@@ -17,6 +21,7 @@ static const char pmodel_c_rcsid[] = "$Id$";
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <math.h>
 #include <float.h>
 #include "define.h"
@@ -102,6 +107,149 @@ double eval_pmodel(Polynomial *P, double r, double s)
   return HUGE_VAL;
 }
 
+/*----------------------------------------------------------------------
+ * eval_pmodel_array - evaluate polynomial at many points
+ *
+ *	input : P - polynomial model
+ *		npts - number of points
+ *		r,s - points to evaluate at (s may be NULL for dim == 1)
+ *
+ *	output: t - polynomial evaluated at each point
+ *
+ *	note: points are evaluated in parallel when compiled with OpenMP
+ *
+ *----------------------------------------------------------------------*/
+void eval_pmodel_array(Polynomial *P, int npts, double *r, double *s,
+		       double *t)
+{ int ipt;
+
+#ifdef _OPENMP
+#pragma omp parallel for if (npts >= pmodel_ARRAY_PARALLEL_MIN)
+#endif
+  for (ipt = 0; ipt < npts; ipt++)
+  { t[ipt] = eval_pmodel(P, r[ipt], P->dim == 2 ? s[ipt] : 0.0);
+  }
+}
+
+/*----------------------------------------------------------------------
+ * eval_pmodel_grid - evaluate polynomial on a grid of points
+ *
+ *	input : P - polynomial model
+ *		cols - number of columns
+ *		r - r coord. of each column
+ *		rows - number of rows
+ *		s - s coord. of each row (ignored for dim == 1)
+ *
+ *	output: t - t[row][col] is the polynomial at r[col],s[row]
+ *
+ *	result: 0 = success, -1 = error
+ *
+ *	note: s is constant along a row so the polynomial is first
+ *	      collapsed to a polynomial in r for each row, each point
+ *	      then costs order+1 multiply-adds. Results agree with
+ *	      eval_pmodel to rounding. Rows are evaluated in parallel
+ *	      when compiled with OpenMP.
+ *
+ *----------------------------------------------------------------------*/
+int eval_pmodel_grid(Polynomial *P, int cols, double *r, int rows, double *s,
+		     double **t)
+{ int row, col, i, j, n, k, ncoef;
+  double sum, *a, *b;
+
+  if (rows <= 0 || cols <= 0) return 0;
+
+  n = P->order + 1;
+
+  if (P->dim == 1)
+  { eval_pmodel_array(P, cols, r, NULL, t[0]);
+    for (row = 1; row < rows; row++)
+    { memcpy(t[row], t[0], cols * sizeof(double));
+    }
+    return 0;
+  }
+
+/*
+ *	a[row][i] is the coefficient of r^i along each row
+ */
+  a = (double *)malloc((size_t)rows * n * sizeof(double));
+  if (NULL == a) { perror("pmodel"); return -1; }
+
+  for (row = 0; row < rows; row++)
+  { b = a + (size_t)row * n;
+    for (i = 0; i < n; i++)
+    { ncoef = P->tcode ? n - i : n;
+      sum = 0.0;
+      for (j = ncoef - 1; j >= 0; j--)
+      { k = P->tcode ? j*n - j*(j-1)/2 + i : j*n + i;
+	sum = s[row]*sum + P->coef[k];
+      }
+      b[i] = sum;
+    }
+  }
+
+#ifdef _OPENMP
+#pragma omp parallel for private(col, i, b, sum) \
+  if ((double)rows * cols >= pmodel_ARRAY_PARALLEL_MIN)
+#endif
+  for (row = 0; row < rows; row++)
+  { b = a + (size_t)row * n;
+    for (col = 0; col < cols; col++)
+    { sum = b[n-1];
+      for (i = n-2; i >= 0; i--)
+	sum = r[col]*sum + b[i];
+      t[row][col] = sum;
+    }
+  }
+
+  free(a);
+  return 0;
+}
+
+/*----------------------------------------------------------------------
+ * nvars_pmodel - number of coefficients of a polynomial model
+ *----------------------------------------------------------------------*/
+static int nvars_pmodel(int dim, int order, int tcode)
+{
+  if (dim == 1)
+    return order + 1;
+  else
+    return tcode == 0 
+      ? (order + 1) * (order + 1)
+	: (order + 1) * (order + 2) / 2;
+}
+
+/*----------------------------------------------------------------------
+ * design_row - one row of the design matrix
+ *
+ *	input : dim, order, tcode - polynomial model shape
+ *		r,s - coords. of the data point (s unused for dim == 1)
+ *
+ *	output: x - value of each term, in coefficient order
+ *
+ *----------------------------------------------------------------------*/
+static void design_row(int dim, int order, int tcode,
+		       double r, double s, double *x)
+{ int i, j, k, m, n;
+
+  if (dim == 1)
+  { for (k = 0; k <= order; k++)
+    { x[k] = ipow(r, k);
+    }
+  }
+  else if (dim == 2)
+  { m = order + 1;
+    n = m;
+    k = 0;
+    for (j = 0; j < m; j++)
+    { for (i=0; i < n; i++)
+      { x[k] = ipow(r,i) * ipow(s,j);
+	k++;
+      }
+      n -= tcode;
+    }
+  }
+}
+
 /*----------------------------------------------------------------------
  * design_matrix - get design matrix for polynomial model
  *
@@ -121,17 +269,10 @@ double eval_pmodel(Polynomial *P, double r, double s)
  *----------------------------------------------------------------------*/
 static double **design_matrix(Polynomial *P, int npts, 
 			      double *rdata, double *sdata)
-{ int i, ipt, j, k, m, n, nvars;
+{ int ipt, nvars;
   double **M = NULL;
   
-  if (P->dim == 1)
-  { nvars = P->order + 1;
-  }
-  else if (P->dim == 2)
-  { nvars = P->tcode == 0 
-      ? (P->order + 1) * (P->order + 1)
-        : (P->order + 1) * (P->order + 2) / 2;
-  }
+  nvars = nvars_pmodel(P->dim, P->order, P->tcode);
   
   if (npts <= nvars)
   { fprintf(stderr,"pmodel: not enough data to support model\n"
@@ -142,31 +283,59 @@ static double **design_matrix(Polynomial *P, int npts,
   M = (double **)matrix(npts, nvars, sizeof(double), TRUE);
   if (NULL == M) { perror("pmodel"); return NULL; }
   
-  if (P->dim == 1)
-  { for (ipt = 0; ipt < npts; ipt++)
-    { for (k = 0; k <= P->order; k++)
-      { M[ipt][k] = ipow(rdata[ipt], k);
-      }
-    }
-  }
-  else if (P->dim == 2)
-  { m = P->order + 1;
-    for (ipt = 0; ipt < npts; ipt++)
-    { n = m;
-      k = 0;
-      for (j = 0; j < m; j++)
-      { for (i=0; i < n; i++)
-	{ M[ipt][k] = ipow(rdata[ipt],i) * ipow(sdata[ipt],j);
-	  k++;
-	}
-	n -= P->tcode;
-      }
-    }
+  for (ipt = 0; ipt < npts; ipt++)
+  { design_row(P->dim, P->order, P->tcode,
+	       rdata[ipt], P->dim == 2 ? sdata[ipt] : 0.0, M[ipt]);
   }
 
   return M;
 }
 
+/*----------------------------------------------------------------------
+ * svd_solve - least squares solution by singular value decomposition
+ *
+ *	input : M - m x n matrix, destroyed
+ *		m, n - size of M
+ *		t - right hand side (m)
+ *
+ *	output: coef - solution (n)
+ *
+ *	result: 0 = success, -1 = error
+ *
+ *	notes : singular values that are negligible compared to the
+ *		largest are zeroed so rank deficient models still solve
+ *
+ *----------------------------------------------------------------------*/
+static int svd_solve(double **M, int m, int n, double *t, double *coef)
+{ int j, status;
+  double *sval = NULL, **v = NULL;
+  double max_sval, thresh;
+
+  v = (double **)matrix(n, n, sizeof(double), TRUE);
+  if (NULL == v) return -1;
+  
+  sval = (double *)calloc(n, sizeof(double));
+  if (NULL == sval) { free(v); return -1; }
+  
+  status = -1;
+  if (svdecomp(M, m, n, sval, v) == 0)
+  { max_sval = 0.0;
+    for (j = 0; j < n; j++)
+    { if (sval[j] > max_sval) max_sval = sval[j];
+    }
+    thresh = n * DBL_EPSILON * max_sval;
+    for (j = 0; j < n; j++)
+    { if (sval[j] < thresh) sval[j] = 0.0;
+    }
+  
+    if (svdsolve(M, sval, v, m, n, t, coef) == 0) status = 0;
+  }
+  
+  free(v);
+  free(sval);
+  return status;
+}
+
 /*----------------------------------------------------------------------
  * init_pmodel - solve for polynomial coefficients
  *
@@ -187,9 +356,8 @@ static double **design_matrix(Polynomial *P, int npts,
  *----------------------------------------------------------------------*/
 Polynomial *init_pmodel(int dim, int order, int tcode, int npts,
 			double *rdata, double *sdata, double *tdata)
-{ int j, nvars;
-  double *sval = NULL, **v = NULL, **M = NULL;
-  double max_sval, thresh;
+{ int nvars;
+  double **M = NULL;
   Polynomial *P = NULL;
   
   if (dim != 1 && dim != 2)
@@ -208,14 +376,7 @@ Polynomial *init_pmodel(int dim, int order, int tcode, int npts,
   P->tcode = tcode;
   P->coef = NULL;
 
-  if (P->dim == 1)
-  { nvars = P->order + 1;
-  }
-  else if (P->dim == 2)
-  { nvars = P->tcode == 0 
-      ? (P->order + 1) * (P->order + 1)
-	: (P->order + 1) * (P->order + 2) / 2;
-  }
+  nvars = nvars_pmodel(P->dim, P->order, P->tcode);
   
   P->coef = (double *)calloc(nvars, sizeof(double));
   if (NULL == P->coef) { perror("pmodel"); free_pmodel(P); return NULL; }
@@ -223,31 +384,229 @@ Polynomial *init_pmodel(int dim, int order, int tcode, int npts,
   M = design_matrix(P, npts, rdata, sdata);
   if (NULL == M) { free_pmodel(P); return NULL; }
   
-  v = (double **)matrix(nvars, nvars, sizeof(double), TRUE);
-  if (NULL == v) { free_pmodel(P); free(M); return NULL; }
-  
-  sval = (double *)calloc(nvars, sizeof(double));
-  if (NULL == sval) { free_pmodel(P); free(M); free(v); return NULL; }
+  if (svd_solve(M, npts, nvars, tdata, P->coef) != 0)
+  { free_pmodel(P); free(M); return NULL; }
   
-  if (svdecomp(M, npts, nvars, sval, v) != 0)
-  { free_pmodel(P); free(M); free(v); free(sval); return NULL; }
+  free(M);
   
-  max_sval = 0.0;
-  for (j = 0; j < nvars; j++)
-  { if (sval[j] > max_sval) max_sval = sval[j];
+  return P;
+}
+
+/*----------------------------------------------------------------------
+ * init_fit_pmodel - start a streaming least squares fit
+ *
+ *	input : dim - dimension (1 or 2)
+ *		order - highest power term (e.g. 2 = quadratic, 3 = cubic)
+ *		tcode - 0 = full rank, 1 = triangular (see eval_pmodel)
+ *
+ *	result: empty fit or NULL on error, add points with
+ *		add_fit_pmodel then call solve_fit_pmodel
+ *
+ *----------------------------------------------------------------------*/
+PolynomialFit *init_fit_pmodel(int dim, int order, int tcode)
+{ PolynomialFit *F = NULL;
+
+  if (dim != 1 && dim != 2)
+  { fprintf(stderr,"pmodel: dimension must be 1 or 2, not %d\n", dim);
+    return NULL;
   }
-  thresh = nvars * DBL_EPSILON * max_sval;
-  for (j = 0; j < nvars; j++)
-  { if (sval[j] < thresh) sval[j] = 0.0;
+  if (tcode != 0 && tcode != 1)
+  { fprintf(stderr,"pmodel: tcode must be 0 or 1, not %d\n", tcode);
+    return NULL;
   }
-  
-  if (svdsolve(M, sval, v, npts, nvars, tdata, P->coef) != 0)
-  { free_pmodel(P); free(M); free(v); free(sval); return NULL; }
-  
-  free(v);
-  free(sval);
+
+  F = (PolynomialFit *)calloc(1, sizeof(PolynomialFit));
+  if (NULL == F) { perror("pmodel"); return NULL; }
+  F->dim = dim;
+  F->order = order;
+  F->tcode = tcode;
+  F->nvars = nvars_pmodel(dim, order, tcode);
+
+  F->R = (double **)matrix(F->nvars, F->nvars + 1, sizeof(double), TRUE);
+  F->block_R = (double **)matrix(pmodel_FIT_BLOCKS * F->nvars, F->nvars + 1,
+				 sizeof(double), TRUE);
+  F->block_x = (double **)matrix(pmodel_FIT_BLOCKS, F->nvars + 1,
+				 sizeof(double), TRUE);
+  F->block_SSE = (double *)calloc(pmodel_FIT_BLOCKS, sizeof(double));
+  if (NULL == F->R || NULL == F->block_R || NULL == F->block_x
+      || NULL == F->block_SSE)
+  { perror("pmodel"); free_fit_pmodel(F); return NULL; }
+
+  return F;
+}
+
+/*----------------------------------------------------------------------
+ * free_fit_pmodel - free streaming least squares fit
+ *----------------------------------------------------------------------*/
+void free_fit_pmodel(PolynomialFit *F)
+{
+  if (NULL == F) return;
+  if (NULL != F->R) free(F->R);
+  if (NULL != F->block_R) free(F->block_R);
+  if (NULL != F->block_x) free(F->block_x);
+  if (NULL != F->block_SSE) free(F->block_SSE);
+  free(F);
+}
+
+/*----------------------------------------------------------------------
+ * givens_row - rotate one row into an upper triangular factor
+ *
+ *	input : R - n x n+1 upper triangular factor, last column data
+ *		n - number of variables
+ *		x - row to add (n+1), last entry is the data value,
+ *		    destroyed
+ *
+ *	output: R - updated factor
+ *		SSE - incremented by the part of the data value the
+ *		      factor can't account for
+ *
+ *----------------------------------------------------------------------*/
+static void givens_row(double **R, int n, double *x, double *SSE)
+{ int j, k;
+  double a, b, h, c, s, u;
+
+  for (k = 0; k < n; k++)
+  { if (0 == x[k]) continue;
+
+/*
+ *	a zero diagonal means the whole row of R is still empty
+ */
+    if (0 == R[k][k])
+    { for (j = k; j <= n; j++) R[k][j] = x[j];
+      return;
+    }
+
+    a = R[k][k];
+    b = x[k];
+    h = sqrt(a*a + b*b);
+    c = a / h;
+    s = b / h;
+    R[k][k] = h;
+    for (j = k+1; j <= n; j++)
+    { u = R[k][j];
+      R[k][j] = c*u + s*x[j];
+      x[j] = c*x[j] - s*u;
+    }
+  }
+  *SSE += x[n]*x[n];
+}
+
+/*----------------------------------------------------------------------
+ * add_fit_pmodel - add data points to a streaming least squares fit
+ *
+ *	input : F - fit from init_fit_pmodel
+ *		npts - number of data points, any number per call
+ *		rdata,sdata - coords. of the data points
+ *			(sdata = NULL for dim == 1)
+ *		tdata - values at data points
+ *
+ *	output: F - updated with the points, F->SSE is the sum squared
+ *		    error of the least squares fit so far
+ *
+ *	result: 0 = success, -1 = error
+ *
+ *	notes : blocks of points are rotated into partial factors in
+ *		parallel when compiled with OpenMP, the partial factors
+ *		are then merged in block order
+ *
+ *----------------------------------------------------------------------*/
+int add_fit_pmodel(PolynomialFit *F, int npts,
+		   double *rdata, double *sdata, double *tdata)
+{ int ipt0, nwave, nblocks, iblock, k, j, n = F->nvars;
+  double *x;
+
+  for (ipt0 = 0; ipt0 < npts; ipt0 += nwave)
+  { nwave = npts - ipt0;
+    if (nwave > pmodel_FIT_BLOCKS * pmodel_FIT_BLOCK_POINTS)
+      nwave = pmodel_FIT_BLOCKS * pmodel_FIT_BLOCK_POINTS;
+    nblocks = (nwave + pmodel_FIT_BLOCK_POINTS - 1) / pmodel_FIT_BLOCK_POINTS;
+
+#ifdef _OPENMP
+#pragma omp parallel for private(k, j) schedule(dynamic)
+#endif
+    for (iblock = 0; iblock < nblocks; iblock++)
+    { int ipt, last;
+      double **R = F->block_R + iblock*n, *xb = F->block_x[iblock];
+
+      for (k = 0; k < n; k++)
+      { for (j = 0; j <= n; j++) R[k][j] = 0;
+      }
+      F->block_SSE[iblock] = 0;
+
+      ipt = ipt0 + iblock*pmodel_FIT_BLOCK_POINTS;
+      last = ipt + pmodel_FIT_BLOCK_POINTS;
+      if (last > ipt0 + nwave) last = ipt0 + nwave;
+      for (; ipt < last; ipt++)
+      { design_row(F->dim, F->order, F->tcode, rdata[ipt],
+		   F->dim == 2 ? sdata[ipt] : 0.0, xb);
+	xb[n] = tdata[ipt];
+	givens_row(R, n, xb, F->block_SSE + iblock);
+      }
+    }
+
+/*
+ *	merge the partial factors row by row
+ */
+    x = F->block_x[0];
+    for (iblock = 0; iblock < nblocks; iblock++)
+    { F->SSE += F->block_SSE[iblock];
+      for (k = 0; k < n; k++)
+      { for (j = 0; j <= n; j++) x[j] = F->block_R[iblock*n + k][j];
+	givens_row(F->R, n, x, &F->SSE);
+      }
+    }
+  }
+
+  F->npts += npts;
+  return 0;
+}
+
+/*----------------------------------------------------------------------
+ * solve_fit_pmodel - solve a streaming fit for polynomial coefficients
+ *
+ *	input : F - fit with points added by add_fit_pmodel
+ *
+ *	result: polynomial model or NULL on error, F is unchanged so
+ *		more points can be added and solved for again
+ *
+ *	notes : the factor is solved by singular value decomposition
+ *		the same way as init_pmodel, the coefficients agree
+ *		with init_pmodel on the same points to rounding
+ *
+ *----------------------------------------------------------------------*/
+Polynomial *solve_fit_pmodel(PolynomialFit *F)
+{ int j, k, n = F->nvars;
+  double **M = NULL, *t = NULL;
+  Polynomial *P = NULL;
+
+  if (F->npts <= n)
+  { fprintf(stderr,"pmodel: not enough data to support model\n"
+	    "        need at least %d points\n", n+1);
+    return NULL;
+  }
+
+  P = (Polynomial *)calloc(1, sizeof(Polynomial));
+  if (NULL == P) { perror("pmodel"); return NULL; }
+  P->dim = F->dim;
+  P->order = F->order;
+  P->tcode = F->tcode;
+  P->coef = (double *)calloc(n, sizeof(double));
+  if (NULL == P->coef) { perror("pmodel"); free_pmodel(P); return NULL; }
+
+  M = (double **)matrix(n, n, sizeof(double), FALSE);
+  t = (double *)calloc(n, sizeof(double));
+  if (NULL == M || NULL == t)
+  { perror("pmodel"); free_pmodel(P); free(M); free(t); return NULL; }
+  for (k = 0; k < n; k++)
+  { for (j = 0; j < n; j++) M[k][j] = F->R[k][j];
+    t[k] = F->R[k][n];
+  }
+
+  if (svd_solve(M, n, n, t, P->coef) != 0)
+  { free_pmodel(P); P = NULL; }
+
   free(M);
-  
+  free(t);
   return P;
 }
 
@@ -22,13 +22,59 @@ typedef struct
   double *coef;	/* coefficients */
 } Polynomial;
 
+/*
+ *	smallest array eval_pmodel_array evaluates in parallel, below
+ *	this the thread start up costs more than it saves
+ */
+#define pmodel_ARRAY_PARALLEL_MIN 16384
+
+/*
+ *	streaming least squares fit, points are rotated into an upper
+ *	triangular factor as they arrive (Givens QR) so memory depends
+ *	only on the number of coefficients, not the number of points
+ *
+ *	points are taken in blocks of pmodel_FIT_BLOCK_POINTS, up to
+ *	pmodel_FIT_BLOCKS blocks are reduced in parallel then merged in
+ *	order, so the result doesn't depend on the number of threads
+ */
+#define pmodel_FIT_BLOCK_POINTS 8192
+#define pmodel_FIT_BLOCKS 64
+
+typedef struct
+{ int dim;	/* dimension	*/
+  int order;	/* size		*/
+  int tcode;	/* shape	*/
+  int nvars;	/* number of coefficients */
+  long npts;	/* points added so far */
+  double **R;	/* nvars x nvars+1 factor, last column is rotated data */
+  double SSE;	/* sum squared error of the least squares fit */
+  double **block_R;	/* pmodel_FIT_BLOCKS factors, nvars rows each */
+  double **block_x;	/* design row of each block */
+  double *block_SSE;
+} PolynomialFit;
+
 Polynomial *init_pmodel(int dim, int order, int tcode, int npts,
                         double *rdata, double *sdata, double *tdata);
 
+PolynomialFit *init_fit_pmodel(int dim, int order, int tcode);
+
+int add_fit_pmodel(PolynomialFit *F, int npts,
+		   double *rdata, double *sdata, double *tdata);
+
+Polynomial *solve_fit_pmodel(PolynomialFit *F);
+
+void free_fit_pmodel(PolynomialFit *F);
+
 void free_pmodel(Polynomial *P);
 
 double eval_pmodel(Polynomial *P, double r, double s);
 
+void eval_pmodel_array(Polynomial *P, int npts, double *r, double *s,
+		       double *t);
+
+int eval_pmodel_grid(Polynomial *P, int cols, double *r, int rows, double *s,
+		     double **t);
+
 void test_pmodel(Polynomial *P, int npts, 
 		 double *rdata, double *sdata, double *tdata,
 		 double *SSE, double *R2);
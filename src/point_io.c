@@ -0,0 +1,437 @@
+/*======================================================================
+ * point_io - point list input
+ *
+ *	Reads lat lon [value] point lists either as ASCII lines or as
+ *	fixed size binary records (see point_io.h). Regular files,
+ *	including a redirected stdin, are mapped into memory and parsed
+ *	in place. Pipes and terminals are read as data arrives, so an
+ *	interactive caller gets each line answered. ASCII numbers are
+ *	converted by a locale independent parser which is correctly
+ *	rounded for up to 15 significant digits and falls back to
+ *	strtod for anything longer.
+ *
+ * National Snow & Ice Data Center, University of Colorado, Boulder
+ * Copyright (C) 2026 University of Colorado
+ *======================================================================*/
+static const char point_io_c_rcsid[]="$Id$";
+
+#include "define.h"
+#define point_io_c_
+#include "point_io.h"
+#include <unistd.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+#ifndef POINT_IO_BUFFER_SIZE
+#define POINT_IO_BUFFER_SIZE (1024*1024)
+#endif
+
+static bool next_line(point_io_class *this, const char **line,
+		      const char **end);
+static byte1 *next_record(point_io_class *this);
+static void get_field(void *field, byte1 *bufp, int size, int flags);
+
+const char *id_point_io(void)
+{
+  return point_io_c_rcsid;
+}
+
+/*------------------------------------------------------------------------
+ * init_point_io - open a point list
+ *
+ *	input : filename - name of file to read, NULL or "-" for stdin
+ *		flags - point_io_BINARY, point_io_BIG_ENDIAN, point_io_VALUE
+ *
+ *	result: new point_io_class pointer or NULL on failure
+ *
+ *------------------------------------------------------------------------*/
+point_io_class *init_point_io(char *filename, int flags)
+{ point_io_class *this;
+  struct stat st;
+  long offset;
+  void *map;
+
+  this = (point_io_class *)calloc(1, sizeof(point_io_class));
+  if (!this) { perror("init_point_io"); return NULL; }
+
+  this->flags = flags;
+  this->record_size = 2*sizeof(double)
+    + ((flags & point_io_VALUE) ? sizeof(float) : 0);
+
+  if (!filename || streq(filename, "-"))
+  { this->fp = stdin;
+    this->filename = strdup("stdin");
+  }
+  else
+  { this->fp = fopen(filename, "rb");
+    this->filename = strdup(filename);
+  }
+  if (!this->fp) { perror(filename); close_point_io(this); return NULL; }
+
+/*
+ *	map regular files, otherwise fall back to buffered reads,
+ *	stdin redirected from a file is mapped from where it is
+ *	positioned now
+ */
+  if (0 == fstat(fileno(this->fp), &st) && S_ISREG(st.st_mode))
+  { offset = ftell(this->fp);
+    if (offset >= 0 && st.st_size > offset)
+    { map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE,
+		 fileno(this->fp), 0);
+      if (MAP_FAILED != map)
+      { this->map = (byte1 *)map;
+	this->map_size = st.st_size;
+	this->pos = offset;
+#ifdef MADV_SEQUENTIAL
+	madvise(map, st.st_size, MADV_SEQUENTIAL);
+#endif
+	return this;
+      }
+    }
+  }
+
+  this->buf_size = POINT_IO_BUFFER_SIZE;
+  this->buf = (byte1 *)malloc(this->buf_size);
+  if (!this->buf) { perror("init_point_io"); close_point_io(this); return NULL; }
+
+  return this;
+}
+
+/*------------------------------------------------------------------------
+ * close_point_io - release resources allocated by init_point_io
+ *------------------------------------------------------------------------*/
+void close_point_io(point_io_class *this)
+{
+  if (!this) return;
+  if (this->map) munmap(this->map, this->map_size);
+  if (this->buf) free(this->buf);
+  if (this->fp && this->fp != stdin) fclose(this->fp);
+  if (this->filename) free(this->filename);
+  free(this);
+}
+
+/*------------------------------------------------------------------------
+ * read_point_io - read the next point
+ *
+ *	input : this - point_io_class
+ *
+ *	output: lat, lon - location
+ *		value - data value (may be NULL unless point_io_VALUE is set)
+ *
+ *	result: 1 if a point was read, 0 at end of input,
+ *		-1 if an ASCII line could not be parsed
+ *
+ *------------------------------------------------------------------------*/
+int read_point_io(point_io_class *this,
+		  double *lat, double *lon, float *value)
+{ const char *cp, *end;
+  double dvalue;
+  byte1 *bufp;
+
+  if (this->flags & point_io_BINARY)
+  { bufp = next_record(this);
+    if (!bufp) return 0;
+    ++this->line_num;
+    get_field(lat, bufp, sizeof(double), this->flags);
+    get_field(lon, bufp + sizeof(double), sizeof(double), this->flags);
+    if (this->flags & point_io_VALUE)
+      get_field(value, bufp + 2*sizeof(double), sizeof(float), this->flags);
+    return 1;
+  }
+
+  if (!next_line(this, &cp, &end)) return 0;
+  ++this->line_num;
+
+  if (!parse_double_point_io(&cp, end, lat)) return -1;
+  if (!parse_double_point_io(&cp, end, lon)) return -1;
+  if (this->flags & point_io_VALUE)
+  { if (!parse_double_point_io(&cp, end, &dvalue)) return -1;
+    *value = dvalue;
+  }
+
+  return 1;
+}
+
+/*------------------------------------------------------------------------
+ * read_points_io - read up to max_points points
+ *
+ *	input : this - point_io_class
+ *		max_points - size of output arrays
+ *
+ *	output: lat, lon - locations
+ *		value - data values (may be NULL unless point_io_VALUE)
+ *
+ *	result: number of points read, 0 at end of input
+ *
+ *	note: ASCII lines that can not be parsed are reported and skipped
+ *
+ *------------------------------------------------------------------------*/
+int read_points_io(point_io_class *this, int max_points,
+		   double *lat, double *lon, float *value)
+{ int npts, status;
+  float dummy;
+
+  for (npts = 0; npts < max_points; )
+  { status = read_point_io(this, &lat[npts], &lon[npts],
+			   value ? &value[npts] : &dummy);
+    if (0 == status) break;
+    if (status < 0)
+    { fprintf(stderr, "%s: error reading point at line %d\n",
+	      this->filename, this->line_num);
+      continue;
+    }
+    ++npts;
+  }
+
+  return npts;
+}
+
+/*------------------------------------------------------------------------
+ * parse_double_point_io - convert the next number in a line
+ *
+ *	input : cp - start of text
+ *		end - end of line
+ *
+ *	output: cp - just past the number
+ *		value - converted number
+ *
+ *	result: TRUE iff a number was found
+ *
+ *	note: leading blanks, tabs and commas are skipped. The decimal
+ *	      point is always '.' regardless of locale.
+ *
+ *------------------------------------------------------------------------*/
+static const double pow10_table[] =
+{ 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10,
+  1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20,
+  1e21, 1e22 };
+
+bool parse_double_point_io(const char **cp, const char *end, double *value)
+{ const char *p = *cp, *start;
+  bool negative = FALSE, exp_negative = FALSE, exact = TRUE;
+  NSIDCbyte8 mantissa = 0;
+  int ndigits = 0, exponent = 0, exp_value = 0;
+  bool seen_digit = FALSE;
+  char token[64];
+
+  while (p < end && (' ' == *p || '\t' == *p || ',' == *p || '\r' == *p))
+    ++p;
+  start = p;
+
+  if (p < end && ('-' == *p || '+' == *p)) { negative = ('-' == *p); ++p; }
+
+  for (; p < end && *p >= '0' && *p <= '9'; p++)
+  { seen_digit = TRUE;
+    if (ndigits < 19)
+    { mantissa = 10*mantissa + (*p - '0');
+      if (mantissa) ++ndigits;
+    }
+    else
+    { ++exponent;
+      exact = FALSE;
+    }
+  }
+  if (p < end && '.' == *p)
+  { for (++p; p < end && *p >= '0' && *p <= '9'; p++)
+    { seen_digit = TRUE;
+      if (ndigits < 19)
+      { mantissa = 10*mantissa + (*p - '0');
+	if (mantissa) ++ndigits;
+	--exponent;
+      }
+      else
+      { exact = FALSE;
+      }
+    }
+  }
+
+/*
+ *	must have at least one digit, otherwise let strtod
+ *	sort out things like nan and inf
+ */
+  if (!seen_digit)
+  { exact = FALSE;
+  }
+  else if (p < end && ('e' == *p || 'E' == *p))
+  { ++p;
+    if (p < end && ('-' == *p || '+' == *p)) { exp_negative = ('-' == *p); ++p; }
+    if (p >= end || *p < '0' || *p > '9') return FALSE;
+    for (; p < end && *p >= '0' && *p <= '9'; p++)
+    { if (exp_value < 10000) exp_value = 10*exp_value + (*p - '0');
+    }
+    exponent += exp_negative ? -exp_value : exp_value;
+  }
+
+/*
+ *	fast path is correctly rounded when both the mantissa and the
+ *	power of ten are exactly representable
+ */
+  if (exact && mantissa <= (1ULL << 53)
+      && exponent >= -22 && exponent <= 22)
+  { *value = (double)mantissa;
+    if (exponent < 0) *value /= pow10_table[-exponent];
+    else *value *= pow10_table[exponent];
+    if (negative) *value = -*value;
+    *cp = p;
+    return TRUE;
+  }
+
+/*
+ *	slow path
+ */
+  if (!seen_digit)
+  { p = start;
+    while (p < end && p - start < (int)sizeof(token) - 1
+	   && ' ' != *p && '\t' != *p && ',' != *p && '\r' != *p && '\n' != *p)
+      ++p;
+  }
+  if (p == start || p - start >= (int)sizeof(token)) return FALSE;
+  memcpy(token, start, p - start);
+  token[p - start] = '\0';
+  {
+    char *tail;
+    *value = strtod(token, &tail);
+    if (tail == token) return FALSE;
+    *cp = start + (tail - token);
+  }
+  return TRUE;
+}
+
+/*------------------------------------------------------------------------
+ * fill_buffer - make sure at least need unread bytes are buffered
+ *
+ *	result: number of unread bytes available (may be less than need
+ *		at end of input)
+ *
+ *	note: reads return whatever is available, so this waits only
+ *	      for the bytes needed, not for a full buffer
+ *
+ *------------------------------------------------------------------------*/
+static size_t fill_buffer(point_io_class *this, size_t need)
+{ ssize_t nread;
+  size_t new_size;
+  byte1 *new_buf;
+
+  if (this->buf_len - this->pos >= need || this->eof)
+    return this->buf_len - this->pos;
+
+/*
+ *	shift unread bytes to the front, grow if necessary
+ */
+  memmove(this->buf, this->buf + this->pos, this->buf_len - this->pos);
+  this->buf_len -= this->pos;
+  this->pos = 0;
+
+  if (need > this->buf_size)
+  { new_size = 2*this->buf_size > need ? 2*this->buf_size : need;
+    new_buf = (byte1 *)realloc(this->buf, new_size);
+    if (!new_buf) { perror("point_io"); this->eof = TRUE; return this->buf_len; }
+    this->buf = new_buf;
+    this->buf_size = new_size;
+  }
+
+  while (this->buf_len < need && !this->eof)
+  { nread = read(fileno(this->fp), this->buf + this->buf_len,
+		 this->buf_size - this->buf_len);
+    if (nread < 0)
+    { if (EINTR == errno) continue;
+      perror(this->filename);
+      this->eof = TRUE;
+    }
+    else if (0 == nread)
+    { this->eof = TRUE;
+    }
+    else
+    { this->buf_len += nread;
+    }
+  }
+
+  return this->buf_len - this->pos;
+}
+
+/*------------------------------------------------------------------------
+ * next_line - locate the next ASCII line
+ *
+ *	output: line, end - first and one past last character
+ *
+ *	result: FALSE at end of input
+ *
+ *------------------------------------------------------------------------*/
+static bool next_line(point_io_class *this, const char **line,
+		      const char **end)
+{ byte1 *base, *nl;
+  size_t size, avail;
+
+  if (this->map)
+  { base = this->map;
+    size = this->map_size;
+  }
+  else
+  { avail = fill_buffer(this, 1);
+    if (0 == avail) return FALSE;
+    for (;;)
+    { nl = memchr(this->buf + this->pos, '\n', this->buf_len - this->pos);
+      if (nl || this->eof) break;
+      avail = this->buf_len - this->pos;
+      fill_buffer(this, avail + 1);
+    }
+    base = this->buf;
+    size = this->buf_len;
+  }
+
+  if (this->pos >= size) return FALSE;
+
+  *line = (const char *)(base + this->pos);
+  nl = memchr(base + this->pos, '\n', size - this->pos);
+  if (nl)
+  { *end = (const char *)nl;
+    this->pos = nl - base + 1;
+  }
+  else
+  { *end = (const char *)(base + size);
+    this->pos = size;
+  }
+
+  return TRUE;
+}
+
+/*------------------------------------------------------------------------
+ * next_record - locate the next binary record
+ *
+ *	result: pointer to record or NULL at end of input
+ *
+ *------------------------------------------------------------------------*/
+static byte1 *next_record(point_io_class *this)
+{ byte1 *bufp;
+
+  if (this->map)
+  { if (this->pos + this->record_size > this->map_size) return NULL;
+    bufp = this->map + this->pos;
+  }
+  else
+  { if (fill_buffer(this, this->record_size) < (size_t)this->record_size)
+      return NULL;
+    bufp = this->buf + this->pos;
+  }
+
+  this->pos += this->record_size;
+  return bufp;
+}
+
+/*------------------------------------------------------------------------
+ * get_field - copy one possibly unaligned binary field
+ *------------------------------------------------------------------------*/
+static void get_field(void *field, byte1 *bufp, int size, int flags)
+{
+#ifdef LSB1ST
+  int i;
+
+  if (flags & point_io_BIG_ENDIAN)
+  { for (i = 0; i < size; i++) ((byte1 *)field)[i] = bufp[size - 1 - i];
+    return;
+  }
+#endif
+  memcpy(field, bufp, size);
+}
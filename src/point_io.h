@@ -0,0 +1,55 @@
+/*======================================================================
+ * point_io - point list input
+ *
+ * National Snow & Ice Data Center, University of Colorado, Boulder
+ * Copyright (C) 2026 University of Colorado
+ *======================================================================*/
+#ifndef point_io_h_
+#define point_io_h_
+
+#include "define.h"
+
+#ifdef point_io_c_
+const char point_io_h_rcsid[]="$Id$";
+#endif
+
+/*
+ *	binary record layout, packed with no padding
+ *
+ *	  float64 lat, float64 lon		   (16 bytes, no value)
+ *	  float64 lat, float64 lon, float32 value  (20 bytes, with value)
+ *
+ *	in native byte order, or most significant byte first
+ *	if point_io_BIG_ENDIAN is set
+ */
+#define point_io_BINARY 1
+#define point_io_BIG_ENDIAN 2
+#define point_io_VALUE 4
+
+typedef struct
+{ int flags;
+  int record_size;
+  FILE *fp;
+  char *filename;
+  byte1 *map;			/* whole file when mapped, else NULL */
+  size_t map_size;
+  byte1 *buf;			/* read buffer when not mapped */
+  size_t buf_size, buf_len;
+  size_t pos;			/* next unread byte in map or buf */
+  bool eof;
+  int line_num;			/* ASCII lines (or records) read */
+} point_io_class;
+
+point_io_class *init_point_io(char *filename, int flags);
+
+int read_point_io(point_io_class *this,
+		  double *lat, double *lon, float *value);
+
+int read_points_io(point_io_class *this, int max_points,
+		   double *lat, double *lon, float *value);
+
+bool parse_double_point_io(const char **cp, const char *end, double *value);
+
+void close_point_io(point_io_class *this);
+
+#endif
@@ -0,0 +1,819 @@
+/*======================================================================
+ * raster - scan convert polylines and polygons into a grid
+ *
+ * National Snow & Ice Data Center, University of Colorado, Boulder
+ * Copyright (C) 2026 University of Colorado
+ *======================================================================*/
+static const char raster_c_rcsid[]="$Id$";
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "define.h"
+#include "matrix.h"
+#define raster_c_
+#include "raster.h"
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+/*
+ *	bands rendered per thread in each batch, a batch holds
+ *	raster_BAND_ROWS rows of every one of its bands, so memory
+ *	grows with the width and the thread count but every thread
+ *	has bands to work on however wide the grid is
+ */
+#ifndef raster_BATCH_BANDS
+#define raster_BATCH_BANDS 2
+#endif
+
+const char *id_raster(void)
+{
+  return raster_c_rcsid;
+}
+
+/*
+ *	edge prepared for the scanline fill
+ */
+typedef struct
+{ double ytop, ybot;		/* ytop < ybot */
+  double xtop, dxdy;
+  int dir;			/* +1 downward, -1 upward */
+} raster_scan_edge;
+
+typedef struct
+{ double x;
+  int dir;
+} raster_crossing;
+
+/*------------------------------------------------------------------------
+ * init_raster - create new raster_class
+ *
+ *	input : grid - grid to scan convert into
+ *		flags - any of raster_LINES, raster_ANTIALIAS, raster_FILL,
+ *			raster_WINDING, raster_COVERAGE (see raster.h)
+ *
+ *	result: new raster_class or NULL
+ *
+ *	note  : cylindrical projections are detected so that polylines
+ *		crossing the edge of the map can be unwrapped and drawn
+ *		on both sides, and rings around a pole can be closed
+ *
+ *------------------------------------------------------------------------*/
+raster_class *init_raster(grid_class *grid, int flags)
+{ raster_class *this;
+  double u0, v0, u1, v1, u2, v2, u3, v3, quarter;
+  mapx_class *mapx = grid->mapx;
+
+  this = (raster_class *)calloc(1, sizeof(raster_class));
+  if (!this) { perror("init_raster"); return NULL; }
+
+  this->grid = grid;
+  this->flags = flags;
+  this->subsamples = (flags & raster_COVERAGE) ? raster_SUBSAMPLES : 1;
+
+/*
+ *	in cylindrical projections x depends only on longitude
+ *	and is linear in longitude
+ */
+  this->period = 0;
+  this->north_up = TRUE;
+  if (0 == forward_mapx(mapx, 0.0, mapx->lon0, &u0, &v0)
+      && 0 == forward_mapx(mapx, 0.0, mapx->lon0 + 90, &u1, &v1)
+      && 0 == forward_mapx(mapx, 60.0, mapx->lon0 + 90, &u2, &v2)
+      && 0 == forward_mapx(mapx, 0.0, mapx->lon0 - 90, &u3, &v3))
+  { quarter = u1 - u0;
+    if (fabs(quarter) > 0
+	&& fabs(u2 - u1) < 1e-6*fabs(quarter)
+	&& fabs((u0 - u3) - quarter) < 1e-6*fabs(quarter))
+    { this->period = fabs(4 * quarter * grid->cols_per_map_unit);
+      this->north_up = (v2 - v1) * grid->rows_per_map_unit > 0;
+    }
+  }
+
+  return this;
+}
+
+/*------------------------------------------------------------------------
+ * free_raster - release resources allocated by init_raster
+ *
+ *	input : this - raster_class, the grid is not closed
+ *
+ *------------------------------------------------------------------------*/
+void free_raster(raster_class *this)
+{
+  if (!this) return;
+  if (this->line) free(this->line);
+  if (this->edge) free(this->edge);
+  if (this->x) free(this->x);
+  if (this->y) free(this->y);
+  if (this->status) free(this->status);
+  free(this);
+}
+
+/*------------------------------------------------------------------------
+ * append_edge - add an edge to a growable edge list
+ *
+ *	result: TRUE iff success
+ *
+ *------------------------------------------------------------------------*/
+static bool append_edge(raster_edge **list, int *count, int *max_count,
+			double x0, double y0, double x1, double y1)
+{ raster_edge *more;
+
+  if (*count >= *max_count)
+  { more = (raster_edge *)realloc(*list,
+				  (*max_count + 4096) * sizeof(raster_edge));
+    if (!more) { perror("raster edges"); return FALSE; }
+    *list = more;
+    *max_count += 4096;
+  }
+
+  (*list)[*count].x0 = x0;
+  (*list)[*count].y0 = y0;
+  (*list)[*count].x1 = x1;
+  (*list)[*count].y1 = y1;
+  ++*count;
+  return TRUE;
+}
+
+/*------------------------------------------------------------------------
+ * copy_range - copies one period apart that reach the grid
+ *
+ *	input : this - raster_class
+ *		xmin, xmax - extent of a line segment or a whole ring
+ *
+ *	output: kmin, kmax - copies kmin*period .. kmax*period, unless
+ *			the grid is cylindrical there is only copy 0
+ *			if it reaches the grid, kmin > kmax if none do
+ *
+ *	note  : a ring is copied whole, dropping just the edges of a
+ *		copy that lie off the grid would leave spans unclosed
+ *
+ *------------------------------------------------------------------------*/
+static void copy_range(raster_class *this, double xmin, double xmax,
+		       int *kmin, int *kmax)
+{ int width = this->grid->cols;
+
+  *kmin = *kmax = 0;
+  if (this->period <= 0)
+  { if (xmax < -1 || xmin > width + 1) *kmax = -1;
+    return;
+  }
+  *kmin = (int)ceil((-1 - xmax) / this->period);
+  *kmax = (int)floor((width + 1 - xmin) / this->period);
+}
+
+/*------------------------------------------------------------------------
+ * add_copies - add an edge and its copies one period apart
+ *
+ *	input : this - raster_class
+ *		line - TRUE for a line segment, else a polygon edge
+ *		x0,y0,x1,y1 - edge in cell edge coordinates
+ *		kmin, kmax - copies to add (see copy_range)
+ *
+ *	result: TRUE iff success
+ *
+ *------------------------------------------------------------------------*/
+static bool add_copies(raster_class *this, bool line,
+		       double x0, double y0, double x1, double y1,
+		       int kmin, int kmax)
+{ double shift;
+  int k, height = this->grid->rows;
+
+/*
+ *	scanlines only cross edges that reach into the grid rows
+ */
+  if (line)
+  { if ((y0 < -1 && y1 < -1) || (y0 > height+1 && y1 > height+1))
+      return TRUE;
+  }
+  else
+  { if (y0 == y1) return TRUE;
+    if ((y0 < 0 && y1 < 0) || (y0 > height && y1 > height)) return TRUE;
+  }
+
+  for (k = kmin; k <= kmax; k++)
+  { shift = k * this->period;
+    if (line)
+    { if (!append_edge(&this->line, &this->num_lines, &this->max_lines,
+		       x0+shift, y0, x1+shift, y1)) return FALSE;
+    }
+    else
+    { if (!append_edge(&this->edge, &this->num_edges, &this->max_edges,
+		       x0+shift, y0, x1+shift, y1)) return FALSE;
+    }
+  }
+
+  return TRUE;
+}
+
+/*------------------------------------------------------------------------
+ * add_polyline_raster - add a polyline to be scan converted
+ *
+ *	input : this - raster_class
+ *		npts - number of vertices
+ *		lat,lon - vertices in decimal degrees
+ *
+ *	result: 0 = success, -1 = error
+ *
+ *	note  : lines are broken at vertices that can not be projected
+ *		and, unless the grid is cylindrical, where consecutive
+ *		vertices are more than half the grid apart (the seam of
+ *		the projection); a closed polyline with any such break
+ *		is not filled
+ *
+ *------------------------------------------------------------------------*/
+int add_polyline_raster(raster_class *this, int npts,
+			double *lat, double *lon)
+{ int i, n, max_pts, kmin, kmax;
+  double u, v, dx, offset, x_first, x_last, y_pole, sum_lat;
+  double seam, xmin, xmax, ymin, ymax;
+  bool closed, broken, pole_small_y;
+  grid_class *grid = this->grid;
+
+  if (npts < 2) return 0;
+  ++this->num_polylines;
+
+/*
+ *	make room for the vertices plus two to close a polar ring
+ */
+  max_pts = npts + 2;
+  if (max_pts > this->max_pts)
+  { this->x = (double *)realloc(this->x, max_pts * sizeof(double));
+    this->y = (double *)realloc(this->y, max_pts * sizeof(double));
+    this->status = (int *)realloc(this->status, max_pts * sizeof(int));
+    if (!this->x || !this->y || !this->status)
+    { perror("add_polyline_raster"); return -1; }
+    this->max_pts = max_pts;
+  }
+
+/*
+ *	project into cell edge coordinates, unwrapping x across
+ *	the seam of cylindrical grids
+ */
+  seam = this->period > 0 ? this->period/2 : grid->cols/2.0;
+  offset = 0;
+  broken = FALSE;
+  for (i = 0; i < npts; i++)
+  { this->status[i] = (0 == forward_mapx(grid->mapx, lat[i], lon[i], &u, &v));
+    if (!this->status[i]) { broken = TRUE; continue; }
+    this->x[i] = grid->map_origin_col + u * grid->cols_per_map_unit + 0.5;
+    this->y[i] = grid->map_origin_row - v * grid->rows_per_map_unit + 0.5;
+    if (i > 0 && this->status[i-1])
+    { dx = this->x[i] + offset - this->x[i-1];
+      if (this->period > 0)
+      { while (dx > seam) { offset -= this->period; dx -= this->period; }
+	while (dx < -seam) { offset += this->period; dx += this->period; }
+      }
+      else if (fabs(dx) > seam)
+      { this->status[i-1] = -1; /* no segment from i-1 to i */
+	broken = TRUE;
+      }
+    }
+    this->x[i] += offset;
+  }
+
+/*
+ *	lines
+ */
+  if (this->flags & raster_LINES)
+  { for (i = 1; i < npts; i++)
+    { if (this->status[i-1] != 1 || !this->status[i]) continue;
+      xmin = this->x[i-1] < this->x[i] ? this->x[i-1] : this->x[i];
+      xmax = this->x[i-1] < this->x[i] ? this->x[i] : this->x[i-1];
+      copy_range(this, xmin, xmax, &kmin, &kmax);
+      if (!add_copies(this, TRUE, this->x[i-1], this->y[i-1],
+		      this->x[i], this->y[i], kmin, kmax)) return -1;
+    }
+  }
+
+  if (!(this->flags & raster_FILL)) return 0;
+
+/*
+ *	rings
+ */
+  closed = npts > 3 && lat[0] == lat[npts-1] 
+    && 0 == fmod(lon[npts-1] - lon[0], 360.);
+  if (!closed) { ++this->num_open; return 0; }
+  if (broken) { ++this->num_skipped; return 0; }
+
+  n = npts;
+  x_first = this->x[0];
+  x_last = this->x[npts-1];
+  if (fabs(x_last - x_first) > seam)
+  {
+/*
+ *	unwrapped ring goes once around the globe, so it encloses
+ *	a pole; close it off beyond the grid edge on the pole side
+ */
+    ymin = ymax = this->y[0];
+    sum_lat = 0;
+    for (i = 0; i < npts; i++)
+    { if (this->y[i] < ymin) ymin = this->y[i];
+      if (this->y[i] > ymax) ymax = this->y[i];
+      sum_lat += lat[i];
+    }
+    pole_small_y = (sum_lat > 0) == this->north_up;
+    if (pole_small_y)
+      y_pole = (ymin < 0 ? ymin : 0) - 1;
+    else
+      y_pole = (ymax > grid->rows ? ymax : grid->rows) + 1;
+    this->x[n] = x_last;
+    this->y[n] = y_pole;
+    ++n;
+    this->x[n] = x_first;
+    this->y[n] = y_pole;
+    ++n;
+  }
+
+  xmin = xmax = this->x[0];
+  for (i = 1; i < n; i++)
+  { if (this->x[i] < xmin) xmin = this->x[i];
+    if (this->x[i] > xmax) xmax = this->x[i];
+  }
+  copy_range(this, xmin, xmax, &kmin, &kmax);
+
+  for (i = 1; i < n; i++)
+  { if (!add_copies(this, FALSE, this->x[i-1], this->y[i-1],
+		    this->x[i], this->y[i], kmin, kmax)) return -1;
+  }
+  if (n > npts)
+  { if (!add_copies(this, FALSE, this->x[n-1], this->y[n-1],
+		    this->x[0], this->y[0], kmin, kmax)) return -1;
+  }
+
+  ++this->num_rings;
+  return 0;
+}
+
+/*------------------------------------------------------------------------
+ * add_cdb_raster - add all segments of a coastline database
+ *
+ *	input : this - raster_class
+ *		cdb - coastline database
+ *		tolerance - level of detail in kilometers (see draw_box_cdb)
+ *
+ *	result: 0 = success, -1 = error
+ *
+ *	note  : segments are the ones draw_box_polyline_cdb would draw
+ *		for the grid's map bounds, in the same order, but they
+ *		are fetched here so no callback needs the raster in a
+ *		global and several rasters can be filled at once
+ *
+ *------------------------------------------------------------------------*/
+int add_cdb_raster(raster_class *this, cdb_class *cdb, double tolerance)
+{ mapx_class *mapx = this->grid->mapx;
+  cdb_index_entry **found;
+  double *lat=NULL, *lon=NULL, *new_lat, *new_lon;
+  int ii, num_found, npts, max_pts=0, status=0;
+
+  cdb = select_lod_cdb(cdb, tolerance);
+  if (num_segments_cdb(cdb) <= 0) return 0;
+
+  found = (cdb_index_entry **)malloc(num_segments_cdb(cdb)
+				     * sizeof(cdb_index_entry *));
+  if (!found) { perror("add_cdb_raster"); return -1; }
+  num_found = find_box_cdb(cdb, mapx->south, mapx->north,
+			   mapx->west, mapx->east,
+			   found, num_segments_cdb(cdb));
+
+  for (ii = 0; ii < num_found && 0 == status; ii++)
+  { set_current_seg_cdb(cdb, found[ii]);
+    npts = get_current_seg_cdb(cdb, lat, lon, max_pts);
+    if (npts < 0)
+    { new_lat = (double *)realloc(lat, -npts * sizeof(double));
+      if (new_lat) lat = new_lat;
+      new_lon = (double *)realloc(lon, -npts * sizeof(double));
+      if (new_lon) lon = new_lon;
+      if (!new_lat || !new_lon) { perror("add_cdb_raster"); status = -1; }
+      else
+      { max_pts = -npts;
+	npts = get_current_seg_cdb(cdb, lat, lon, max_pts);
+      }
+    }
+    if (0 == status && npts <= 0) status = -1;
+    if (0 == status) status = add_polyline_raster(this, npts, lat, lon);
+  }
+
+  free(found);
+  free(lat);
+  free(lon);
+  return status;
+}
+
+/*------------------------------------------------------------------------
+ * bucket_edges - list the edges touching each band of rows
+ *
+ *	input : edge, count - edges
+ *		pad - extra rows above and below each edge
+ *		nbands - number of bands of raster_BAND_ROWS rows
+ *
+ *	output: first - first[b]..first[b+1]-1 index list for band b
+ *		list - edge numbers
+ *
+ *	result: TRUE iff success
+ *
+ *------------------------------------------------------------------------*/
+static bool bucket_edges(raster_edge *edge, int count, int pad, int nbands,
+			 int **first, int **list)
+{ int i, b, b0, b1, pass;
+  double ymin, ymax;
+
+  *first = (int *)calloc(nbands + 1, sizeof(int));
+  *list = NULL;
+  if (!*first) { perror("bucket_edges"); return FALSE; }
+
+  for (pass = 0; pass < 2; pass++)
+  { for (i = 0; i < count; i++)
+    { ymin = edge[i].y0 < edge[i].y1 ? edge[i].y0 : edge[i].y1;
+      ymax = edge[i].y0 < edge[i].y1 ? edge[i].y1 : edge[i].y0;
+      b0 = (int)floor((ymin - pad) / raster_BAND_ROWS);
+      b1 = (int)floor((ymax + pad) / raster_BAND_ROWS);
+      if (b0 < 0) b0 = 0;
+      if (b1 >= nbands) b1 = nbands - 1;
+      for (b = b0; b <= b1; b++)
+      { if (0 == pass) ++(*first)[b+1];
+	else (*list)[(*first)[b]++] = i;
+      }
+    }
+    if (0 == pass)
+    { for (b = 0; b < nbands; b++) (*first)[b+1] += (*first)[b];
+      *list = (int *)malloc(((*first)[nbands] + 1) * sizeof(int));
+      if (!*list) { perror("bucket_edges"); return FALSE; }
+    }
+    else
+    { for (b = nbands; b > 0; b--) (*first)[b] = (*first)[b-1];
+      (*first)[0] = 0;
+    }
+  }
+
+  return TRUE;
+}
+
+static int compare_scan_edge(const void *a, const void *b)
+{ double d = ((raster_scan_edge *)a)->ytop - ((raster_scan_edge *)b)->ytop;
+  return d < 0 ? -1 : d > 0 ? 1 : 0;
+}
+
+static int compare_crossing(const void *a, const void *b)
+{ double d = ((raster_crossing *)a)->x - ((raster_crossing *)b)->x;
+  return d < 0 ? -1 : d > 0 ? 1 : 0;
+}
+
+/*------------------------------------------------------------------------
+ * fill_band - scanline fill of one band of rows
+ *
+ *	input : this - raster_class
+ *		row0, nrows - rows in the band
+ *		list, count - edges touching the band
+ *
+ *	output: cover - nrows x cols fraction of each cell filled
+ *
+ *	result: TRUE iff success
+ *
+ *------------------------------------------------------------------------*/
+static bool fill_band(raster_class *this, int row0, int nrows,
+		      int *list, int count, float **cover)
+{ int i, k, j, row, nactive, ncross, next, winding, c0, c1;
+  int width = this->grid->cols, nsub = this->subsamples;
+  double y, xa, xb, weight, run;
+  raster_scan_edge *scan = NULL, *active = NULL;
+  raster_crossing *cross = NULL;
+  raster_edge *e;
+  double *diff = NULL;
+  bool coverage = (this->flags & raster_COVERAGE) != 0;
+  bool winding_rule = (this->flags & raster_WINDING) != 0;
+
+  for (k = 0; k < nrows; k++) memset(cover[k], 0, width * sizeof(float));
+  if (0 == count) return TRUE;
+
+  scan = (raster_scan_edge *)malloc(count * sizeof(raster_scan_edge));
+  active = (raster_scan_edge *)malloc(count * sizeof(raster_scan_edge));
+  cross = (raster_crossing *)malloc(count * sizeof(raster_crossing));
+  diff = (double *)malloc((width + 1) * sizeof(double));
+  if (!scan || !active || !cross || !diff)
+  { perror("fill_band");
+    if (scan) free(scan);
+    if (active) free(active);
+    if (cross) free(cross);
+    if (diff) free(diff);
+    return FALSE;
+  }
+
+/*
+ *	orient edges top to bottom and sort by top
+ */
+  for (i = 0; i < count; i++)
+  { e = this->edge + list[i];
+    if (e->y0 < e->y1)
+    { scan[i].ytop = e->y0; scan[i].ybot = e->y1;
+      scan[i].xtop = e->x0; scan[i].dir = 1;
+    }
+    else
+    { scan[i].ytop = e->y1; scan[i].ybot = e->y0;
+      scan[i].xtop = e->x1; scan[i].dir = -1;
+    }
+    scan[i].dxdy = (e->x1 - e->x0) / (e->y1 - e->y0);
+  }
+  qsort(scan, count, sizeof(raster_scan_edge), compare_scan_edge);
+
+  weight = 1.0 / nsub;
+  nactive = 0;
+  next = 0;
+  for (k = 0; k < nrows; k++)
+  { row = row0 + k;
+    memset(diff, 0, (width + 1) * sizeof(double));
+
+    for (j = 0; j < nsub; j++)
+    { y = row + (j + 0.5) / nsub;
+
+/*
+ *	update active edge list and find crossings, an edge
+ *	covers ytop <= y < ybot
+ */
+      while (next < count && scan[next].ytop <= y)
+	active[nactive++] = scan[next++];
+      ncross = 0;
+      for (i = 0; i < nactive; )
+      { if (active[i].ybot <= y) { active[i] = active[--nactive]; continue; }
+	cross[ncross].x = active[i].xtop + (y - active[i].ytop)*active[i].dxdy;
+	cross[ncross].dir = active[i].dir;
+	++ncross;
+	++i;
+      }
+      if (ncross < 2) continue;
+      qsort(cross, ncross, sizeof(raster_crossing), compare_crossing);
+
+/*
+ *	spans inside the polygons
+ */
+      winding = 0;
+      for (i = 0; i < ncross - 1; i++)
+      { if (winding_rule)
+	{ winding += cross[i].dir;
+	  if (0 == winding) continue;
+	}
+	else if (i % 2) continue;
+	xa = cross[i].x;
+	xb = cross[i+1].x;
+	if (xa < 0) xa = 0;
+	if (xb > width) xb = width;
+	if (xa >= xb) continue;
+
+	if (coverage)
+	{
+/*
+ *	partial cells at the ends, whole cells in between
+ */
+	  c0 = (int)xa;
+	  c1 = (int)xb;
+	  if (c0 == c1)
+	  { cover[k][c0] += (xb - xa) * weight;
+	    continue;
+	  }
+	  cover[k][c0] += (c0 + 1 - xa) * weight;
+	  if (c1 < width) cover[k][c1] += (xb - c1) * weight;
+	  diff[c0+1] += weight;
+	  diff[c1] -= weight;
+	}
+	else
+	{
+/*
+ *	cells with centers in the span
+ */
+	  c0 = (int)ceil(xa - 0.5);
+	  c1 = (int)ceil(xb - 0.5);
+	  if (c0 >= c1) continue;
+	  diff[c0] += 1;
+	  diff[c1] -= 1;
+	}
+      }
+    }
+
+    run = 0;
+    for (i = 0; i < width; i++)
+    { run += diff[i];
+      cover[k][i] += run;
+      if (cover[k][i] > 1) cover[k][i] = 1;
+      if (cover[k][i] < 0) cover[k][i] = 0;
+    }
+  }
+
+  free(scan);
+  free(active);
+  free(cross);
+  free(diff);
+  return TRUE;
+}
+
+/*------------------------------------------------------------------------
+ * line_band - draw line segments into one band of rows
+ *
+ *	input : this - raster_class
+ *		row0, nrows - rows in the band
+ *		list, count - line segments touching the band
+ *
+ *	output: ink - nrows x cols line intensity
+ *
+ *	note  : without raster_ANTIALIAS every cell a segment passes
+ *		through gets intensity 1, with it each cell within one
+ *		cell width of the segment gets 1 - distance from the
+ *		cell center to the segment
+ *
+ *------------------------------------------------------------------------*/
+static void line_band(raster_class *this, int row0, int nrows,
+		      int *list, int count, float **ink)
+{ int i, k, row, col, c0, c1, r0, r1;
+  int width = this->grid->cols;
+  double x0, y0, dx, dy, ta, tb, t, xa, xb, yc, xc, d, len2, px, py;
+  bool antialias = (this->flags & raster_ANTIALIAS) != 0;
+  raster_edge *e;
+
+  for (k = 0; k < nrows; k++) memset(ink[k], 0, width * sizeof(float));
+
+  for (i = 0; i < count; i++)
+  { e = this->line + list[i];
+    x0 = e->x0; y0 = e->y0;
+    dx = e->x1 - x0; dy = e->y1 - y0;
+    len2 = dx*dx + dy*dy;
+
+    r0 = (int)floor((dy < 0 ? e->y1 : y0) - (antialias ? 1 : 0));
+    r1 = (int)floor((dy < 0 ? y0 : e->y1) + (antialias ? 1 : 0));
+    if (r0 < row0) r0 = row0;
+    if (r1 > row0 + nrows - 1) r1 = row0 + nrows - 1;
+
+    for (row = r0; row <= r1; row++)
+    {
+/*
+ *	part of the segment within reach of this row
+ */
+      if (antialias) { ta = row - 0.5; tb = row + 1.5; }
+      else { ta = row; tb = row + 1; }
+      if (0 == dy)
+      { if (y0 < ta || y0 > tb) continue;
+	ta = 0; tb = 1;
+      }
+      else
+      { ta = (ta - y0) / dy;
+	tb = (tb - y0) / dy;
+	if (ta > tb) { t = ta; ta = tb; tb = t; }
+	if (ta < 0) ta = 0;
+	if (tb > 1) tb = 1;
+	if (ta > tb) continue;
+      }
+      xa = x0 + ta*dx;
+      xb = x0 + tb*dx;
+      if (xa > xb) { t = xa; xa = xb; xb = t; }
+
+      if (!antialias)
+      { c0 = (int)floor(xa);
+	c1 = (int)floor(xb);
+	if (c0 < 0) c0 = 0;
+	if (c1 > width - 1) c1 = width - 1;
+	for (col = c0; col <= c1; col++) ink[row-row0][col] = 1;
+	continue;
+      }
+
+      c0 = (int)floor(xa - 1);
+      c1 = (int)floor(xb + 1);
+      if (c0 < 0) c0 = 0;
+      if (c1 > width - 1) c1 = width - 1;
+      yc = row + 0.5;
+      for (col = c0; col <= c1; col++)
+      { xc = col + 0.5;
+	t = len2 > 0 ? ((xc - x0)*dx + (yc - y0)*dy) / len2 : 0;
+	if (t < 0) t = 0;
+	if (t > 1) t = 1;
+	px = x0 + t*dx - xc;
+	py = y0 + t*dy - yc;
+	d = 1 - sqrt(px*px + py*py);
+	if (d > ink[row-row0][col]) ink[row-row0][col] = d;
+      }
+    }
+  }
+}
+
+/*------------------------------------------------------------------------
+ * render_raster - scan convert everything added and write the grid
+ *
+ *	input : this - raster_class
+ *		out - grid_io_class the same size as the grid
+ *		background - value of empty cells
+ *		fill_value - value of cells inside polygons
+ *		line_value - value of cells on lines
+ *
+ *	result: number of cells filled or on lines, -1 on error
+ *
+ *	note  : a cell that is partly filled or partly on a line gets
+ *		a proportional mix of the values, lines are drawn over
+ *		the fill, integer output is rounded to nearest
+ *
+ *		bands of rows are rendered in parallel when compiled
+ *		with OpenMP, then written in order
+ *
+ *------------------------------------------------------------------------*/
+int render_raster(raster_class *this, grid_io_class *out,
+		  double background, double fill_value, double line_value)
+{ int width = this->grid->cols, height = this->grid->rows;
+  int nbands, batch, b0, nb, b, k, col, row, ncells = 0;
+  int *edge_first = NULL, *edge_list = NULL;
+  int *line_first = NULL, *line_list = NULL;
+  float **cover = NULL, **ink = NULL;
+  double *values = NULL, value;
+  bool do_fill = (this->flags & raster_FILL) != 0;
+  bool do_lines = (this->flags & raster_LINES) != 0;
+  bool ok = TRUE;
+
+  if (out->width != width || out->height != height)
+  { fprintf(stderr,"render_raster: output is %dx%d grid is %dx%d\n",
+	    out->width, out->height, width, height);
+    return -1;
+  }
+
+  nbands = (height + raster_BAND_ROWS - 1) / raster_BAND_ROWS;
+  batch = raster_BATCH_BANDS;
+#ifdef _OPENMP
+  batch *= omp_get_max_threads();
+#endif
+  if (batch > nbands) batch = nbands;
+
+  if (do_fill && !bucket_edges(this->edge, this->num_edges, 0, nbands,
+			       &edge_first, &edge_list)) goto cleanup;
+  if (do_lines && !bucket_edges(this->line, this->num_lines, 1, nbands,
+				&line_first, &line_list)) goto cleanup;
+
+  if (do_fill)
+  { cover = (float **)matrix(batch*raster_BAND_ROWS, width,
+			     sizeof(float), matrix_ZERO);
+    if (!cover) { perror("render_raster"); goto cleanup; }
+  }
+  if (do_lines)
+  { ink = (float **)matrix(batch*raster_BAND_ROWS, width,
+			   sizeof(float), matrix_ZERO);
+    if (!ink) { perror("render_raster"); goto cleanup; }
+  }
+  values = (double *)malloc(width * sizeof(double));
+  if (!values) { perror("render_raster"); goto cleanup; }
+
+  for (b0 = 0; b0 < nbands; b0 += batch)
+  { nb = nbands - b0 < batch ? nbands - b0 : batch;
+
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+    for (b = b0; b < b0 + nb; b++)
+    { int row0 = b * raster_BAND_ROWS;
+      int nrows = height - row0 < raster_BAND_ROWS
+	? height - row0 : raster_BAND_ROWS;
+      int slot = (b - b0) * raster_BAND_ROWS;
+
+      if (do_fill
+	  && !fill_band(this, row0, nrows, edge_list + edge_first[b],
+			edge_first[b+1] - edge_first[b], cover + slot))
+	ok = FALSE;
+      if (do_lines)
+	line_band(this, row0, nrows, line_list + line_first[b],
+		  line_first[b+1] - line_first[b], ink + slot);
+    }
+    if (!ok) goto cleanup;
+
+/*
+ *	mix the values and write the rows in order
+ */
+    for (k = 0; k < nb*raster_BAND_ROWS; k++)
+    { row = b0*raster_BAND_ROWS + k;
+      if (row >= height) break;
+      for (col = 0; col < width; col++)
+      { value = background;
+	if (do_fill && cover[k][col] > 0)
+	  value += cover[k][col] * (fill_value - value);
+	if (do_lines && ink[k][col] > 0)
+	  value += ink[k][col] * (line_value - value);
+	if ((do_fill && cover[k][col] > 0) || (do_lines && ink[k][col] > 0))
+	  ++ncells;
+	values[col] = out->real_data ? value : floor(value + 0.5);
+      }
+      if (!put_row_grid_io(out, row, values)) goto cleanup;
+    }
+  }
+
+  free(values);
+  free(edge_first); free(edge_list);
+  free(line_first); free(line_list);
+  if (cover) free(cover);
+  if (ink) free(ink);
+  return ncells;
+
+ cleanup:
+  if (values) free(values);
+  if (edge_first) free(edge_first);
+  if (edge_list) free(edge_list);
+  if (line_first) free(line_first);
+  if (line_list) free(line_list);
+  if (cover) free(cover);
+  if (ink) free(ink);
+  return -1;
+}
@@ -0,0 +1,85 @@
+/*======================================================================
+ * raster - scan convert polylines and polygons into a grid
+ *
+ * National Snow & Ice Data Center, University of Colorado, Boulder
+ * Copyright (C) 2026 University of Colorado
+ *======================================================================*/
+#ifndef raster_h_
+#define raster_h_
+
+#include "define.h"
+#include "grids.h"
+#include "grid_io.h"
+#include "cdb.h"
+
+#ifdef raster_c_
+const char raster_h_rcsid[]="$Id$";
+#endif
+
+/*
+ *	flags
+ *
+ *	raster_LINES - mark cells each polyline passes through
+ *	raster_ANTIALIAS - weight line cells by distance from the line
+ *	raster_FILL - fill closed polylines, first point == last point
+ *		      or 360 degrees of longitude away
+ *	raster_WINDING - fill by non-zero winding number, else even-odd
+ *	raster_COVERAGE - weight fill by fraction of the cell covered,
+ *			  else fill cells whose center is inside
+ */
+#define raster_LINES 1
+#define raster_ANTIALIAS 2
+#define raster_FILL 4
+#define raster_WINDING 8
+#define raster_COVERAGE 16
+
+/*
+ *	default sub-scanlines per row for raster_COVERAGE
+ */
+#define raster_SUBSAMPLES 4
+
+/*
+ *	rows per band, bands are rendered in parallel
+ */
+#define raster_BAND_ROWS 32
+
+/*
+ *	straight edge in grid cell edge coordinates,
+ *	cell row,col covers [col,col+1) x [row,row+1)
+ */
+typedef struct
+{ double x0, y0, x1, y1;
+} raster_edge;
+
+typedef struct
+{ grid_class *grid;
+  int flags;
+  int subsamples;		/* sub-scanlines per row for coverage */
+  double period;		/* columns per 360 degrees or 0 */
+  bool north_up;		/* north pole at smaller row numbers */
+  raster_edge *line;		/* line segments */
+  int num_lines, max_lines;
+  raster_edge *edge;		/* polygon edges */
+  int num_edges, max_edges;
+  int num_polylines;		/* polylines added */
+  int num_rings;		/* closed polylines filled */
+  int num_open;			/* polylines not closed, not filled */
+  int num_skipped;		/* closed but not projectable, not filled */
+  double *x, *y;		/* projection work space */
+  int *status;
+  int max_pts;
+} raster_class;
+
+raster_class *init_raster(grid_class *grid, int flags);
+
+int add_polyline_raster(raster_class *this, int npts,
+			double *lat, double *lon);
+
+int add_cdb_raster(raster_class *this, cdb_class *cdb, double tolerance);
+
+int render_raster(raster_class *this, grid_io_class *out,
+		  double background, double fill_value, double line_value);
+
+void free_raster(raster_class *this);
+
+#endif
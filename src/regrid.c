@@ -12,10 +12,13 @@ static const char regrid_c_rcsid[] = "$Id$";
 #include "mapx.h"
 #include "grids.h"
 #include "maps.h"
+#include "cubic.h"
+#include "surrogate.h"
 
 #define usage								   \
 "$Revision$\n"                                                             \
 "usage: regrid [-fwubslFv -i value -k kernel -p power -z beta_file] \n"	   \
+"              [-g tolerance -G model_file]\n"				   \
 "              from.gpd to.gpd from_data to_data\n"			   \
 "\n"									   \
 " input : from.gpd  - original grid parameters definition file\n"	   \
@@ -37,6 +40,11 @@ static const char regrid_c_rcsid[] = "$Id$";
 "         p power - 0=smooth, 6=sharp, 2=default (used with -fw only)\n"   \
 "         k kernel - force kernel size (rowsxcols) (used with -fw only)\n" \
 "         z beta_file - save/restore intermediate results\n"		   \
+"         g tolerance - locate cells with polynomial tile models fit\n"	   \
+"                       to tolerance cells RMS instead of projecting\n"	   \
+"                       each cell (default 0.01 with -G)\n"		   \
+"         G model_file - read tile models from model_file, or fit them\n"  \
+"                        and save them there if it doesn't exist\n"	   \
 "\n"									   \
 " note: -f and -w options select interpolation method as follows:\n"	   \
 "       default = nearest-neighbor\n"					   \
@@ -45,6 +53,9 @@ static const char regrid_c_rcsid[] = "$Id$";
 "       -f      = drop-in-the-bucket averaging\n"			   \
 "       -fw     = inverse distance weighted sum\n"			   \
 "                 -k and -p options only effect this method\n"		   \
+"\n"									   \
+"       -g and -G skip cells outside either map, a model file only\n"	   \
+"       works for the grids and -f setting it was made with\n"		   \
 "\n"
 
 /*------------------------------------------------------------------------
@@ -77,10 +88,18 @@ static const char regrid_c_rcsid[] = "$Id$";
 
 #define VV_INTERVAL 30
 
+/*
+ *	flags for the data grids, see matrix_aligned
+ */
+#define MATRIX_FLAGS (matrix_ZERO|matrix_PAD|matrix_HUGEPAGE|matrix_FIRST_TOUCH)
+
 static int fill, k_cols, k_rows;
 static int ignore_fill, verbose, preload_data;
 static bool modified_option;
 static double power;
+static surrogate_class *surrogate;
+static double *sur_r, *sur_s;
+static byte1 *sur_ok;
 
 int inv_dist(grid_class *, float **, grid_class *, float **, float **);
 int ditb_avg(grid_class *, float **, grid_class *, float **, float **);
@@ -210,6 +229,9 @@ int main(int argc, char *argv[])
   char beta_filename[FILENAME_MAX];
   FILE *from_file, *to_file, *beta_file;
   grid_class *from_grid, *to_grid;
+  double tolerance;
+  char *model_filename;
+  bool use_surrogate;
 
 /*
  *	set defaults
@@ -228,6 +250,9 @@ int main(int argc, char *argv[])
   ignore_fill = FALSE;
   fill = 0;
   verbose = 0;
+  use_surrogate = FALSE;
+  tolerance = 0;
+  model_filename = NULL;
 
 /* 
  *	get command line options
@@ -267,6 +292,18 @@ int main(int argc, char *argv[])
 	    if (!beta_file) { perror(beta_filename); error_exit(usage); }
 	  }
 	  break;
+	case 'g':
+	  ++argv; --argc;
+	  if (argc <= 0 || sscanf(*argv, "%lf", &tolerance) != 1
+	      || tolerance <= 0) error_exit(usage);
+	  use_surrogate = TRUE;
+	  break;
+	case 'G':
+	  ++argv; --argc;
+	  if (argc <= 0) error_exit(usage);
+	  model_filename = strdup(*argv);
+	  use_surrogate = TRUE;
+	  break;
 	case 'u':
 	  signed_data = FALSE;
 	  break;
@@ -349,21 +386,45 @@ int main(int argc, char *argv[])
     if (k_rows < 1) k_rows = 1;
   }
 
+/*
+ *	fit or read the tile models, forward methods locate from_grid
+ *	cells in to_grid, inverse methods to_grid cells in from_grid
+ */
+  if (use_surrogate)
+  { if (verbose >= 2) fprintf(stderr,">> fitting tile models...\n");
+    if (forward_resample)
+      surrogate = open_surrogate(from_grid, to_grid, tolerance,
+				 model_filename);
+    else
+      surrogate = open_surrogate(to_grid, from_grid, tolerance,
+				 model_filename);
+    if (!surrogate) exit(ABORT);
+    if (verbose) fprintf(stderr,"> %d tiles fit to %g cells, "
+			 "%d projected exactly\n", surrogate->num_fit,
+			 surrogate->tolerance, surrogate->num_exact);
+
+    i = surrogate->cell_grid->cols;
+    sur_r = (double *)malloc(i * sizeof(double));
+    sur_s = (double *)malloc(i * sizeof(double));
+    sur_ok = (byte1 *)malloc(i * sizeof(byte1));
+    if (!sur_r || !sur_s || !sur_ok) { perror("regrid"); exit(ABORT); }
+  }
+
 /*
  *	allocate storage for data grids
  */
   if (verbose >= 2) fprintf(stderr,">> allocating...\n");
 
-  from_data = (float **)matrix(from_grid->rows, from_grid->cols,
-				sizeof(float), TRUE);
+  from_data = (float **)matrix_aligned(from_grid->rows, from_grid->cols,
+				       sizeof(float), MATRIX_FLAGS);
   if (!from_data) { exit(ABORT); }
 
-  to_data = (float **)matrix(to_grid->rows, to_grid->cols,
-			      sizeof(float), TRUE);
+  to_data = (float **)matrix_aligned(to_grid->rows, to_grid->cols,
+				     sizeof(float), MATRIX_FLAGS);
   if (!to_data) { exit(ABORT); }
 
-  to_beta = (float **)matrix(to_grid->rows, to_grid->cols,
-			      sizeof(float), TRUE);
+  to_beta = (float **)matrix_aligned(to_grid->rows, to_grid->cols,
+				     sizeof(float), MATRIX_FLAGS);
   if (!to_beta) { exit(ABORT); }
 
 /*
@@ -400,8 +461,8 @@ int main(int argc, char *argv[])
     { fprintf(stderr,"> reading initial data from %s\n", to_filename); }
 
     if (beta_file) {
-      status = fread(to_beta[0], sizeof(float), 
-		     to_grid->cols*to_grid->rows, beta_file);
+      for (i = 0, status = 0; i < to_grid->rows; i++)
+	status += fread(to_beta[i], sizeof(float), to_grid->cols, beta_file);
       if (to_grid->cols*to_grid->rows != status) {
 	fprintf(stderr,"regrid: error reading initial weights: %s\n",
 		beta_filename); exit(ABORT); }
@@ -489,7 +550,8 @@ int main(int argc, char *argv[])
   if (beta_file)
   { if (verbose) fprintf(stderr,"> writing beta to %s\n", beta_filename);
     fseek(beta_file, 0, SEEK_SET);
-    fwrite(to_beta[0], sizeof(float), to_grid->cols*to_grid->rows, beta_file);
+    for (i = 0; i < to_grid->rows; i++)
+      fwrite(to_beta[i], sizeof(float), to_grid->cols, beta_file);
   }
 
   exit(EXIT_SUCCESS);
@@ -523,7 +585,9 @@ int inv_dist(grid_class *from_grid, float **from_data,
  *	map each from_grid value into the to_grid
  */
   for (i = 0; i < from_grid->rows; i++) 
-  { for (j = 0; j < from_grid->cols; j++)
+  { if (surrogate) locate_surrogate(surrogate, i, sur_r, sur_s, sur_ok);
+
+    for (j = 0; j < from_grid->cols; j++)
     {
 /*
  *	ignore cells with fill value
@@ -533,13 +597,21 @@ int inv_dist(grid_class *from_grid, float **from_data,
 /*
  *	project from_grid location into to_grid
  */
-      status = inverse_grid(from_grid, (double)j, (double)i, &lat, &lon);
-      if (!status) continue;
+      if (surrogate)
+      { if (!sur_ok[j]) continue;
+	r = sur_r[j];
+	s = sur_s[j];
+      }
+      else
+      { status = inverse_grid(from_grid, (double)j, (double)i, &lat, &lon);
+	if (!status) continue;
 
-      status = forward_grid(to_grid, lat, lon, &r, &s);
-      if (!status || !within_mapx(to_grid->mapx, lat, lon)) continue;
+	status = forward_grid(to_grid, lat, lon, &r, &s);
+	if (!status || !within_mapx(to_grid->mapx, lat, lon)) continue;
+      }
 
-      if (verbose >= 3 && 0 == i % VV_INTERVAL && 0 == j % VV_INTERVAL)
+      if (verbose >= 3 && !surrogate
+	  && 0 == i % VV_INTERVAL && 0 == j % VV_INTERVAL)
 	fprintf(stderr,">>> %4d %4d --> %7.2lf %7.2lf --> %4d %4d\n",
 		j, i, lat, lon, (int)(r + 0.5), (int)(s + 0.5));
 
@@ -592,7 +664,9 @@ int ditb_avg(grid_class *from_grid, float **from_data,
  *	map each from_grid value into the to_grid
  */
   for (i = 0; i < from_grid->rows; i++) 
-  { for (j = 0; j < from_grid->cols; j++)
+  { if (surrogate) locate_surrogate(surrogate, i, sur_r, sur_s, sur_ok);
+
+    for (j = 0; j < from_grid->cols; j++)
     {
 /*
  *	ignore cells with fill value
@@ -602,13 +676,21 @@ int ditb_avg(grid_class *from_grid, float **from_data,
 /*
  *	project from_grid location into to_grid
  */
-      status = inverse_grid(from_grid, (double)j, (double)i, &lat, &lon);
-      if (!status) continue;
+      if (surrogate)
+      { if (!sur_ok[j]) continue;
+	r = sur_r[j];
+	s = sur_s[j];
+      }
+      else
+      { status = inverse_grid(from_grid, (double)j, (double)i, &lat, &lon);
+	if (!status) continue;
 
-      status = forward_grid(to_grid, lat, lon, &r, &s);
-      if (!status) continue;
+	status = forward_grid(to_grid, lat, lon, &r, &s);
+	if (!status) continue;
+      }
 
-      if (verbose >= 3 && 0 == i % VV_INTERVAL && 0 == j % VV_INTERVAL)
+      if (verbose >= 3 && !surrogate
+	  && 0 == i % VV_INTERVAL && 0 == j % VV_INTERVAL)
 	fprintf(stderr,">>> %4d %4d --> %7.2lf %7.2lf --> %4d %4d\n",
 		j, i, lat, lon, (int)(r + 0.5), (int)(s + 0.5));
 
@@ -662,15 +744,25 @@ int bilinear(grid_class *from_grid, float **from_data,
  *	retrieve a value in the from_grid based on a to_grid location
  */
   for (i = 0; i < to_grid->rows; i++) 
-  { for (j = 0; j < to_grid->cols; j++)
+  { if (surrogate) locate_surrogate(surrogate, i, sur_r, sur_s, sur_ok);
+
+    for (j = 0; j < to_grid->cols; j++)
     {
-      status = inverse_grid(to_grid, (double)j, (double)i, &lat, &lon);
-      if (!status) continue;
+      if (surrogate)
+      { if (!sur_ok[j]) continue;
+	r = sur_r[j];
+	s = sur_s[j];
+      }
+      else
+      { status = inverse_grid(to_grid, (double)j, (double)i, &lat, &lon);
+	if (!status) continue;
 
-      status = forward_grid(from_grid, lat, lon, &r, &s);
-      if (!status) continue;
+	status = forward_grid(from_grid, lat, lon, &r, &s);
+	if (!status) continue;
+      }
 
-      if (verbose >= 3 && 0 == i % VV_INTERVAL && 0 == j % VV_INTERVAL)
+      if (verbose >= 3 && !surrogate
+	  && 0 == i % VV_INTERVAL && 0 == j % VV_INTERVAL)
 	fprintf(stderr,">>> %4d %4d --> %7.2lf %7.2lf --> %4d %4d\n",
 		j, i, lat, lon, (int)(r + 0.5), (int)(s + 0.5));
 
@@ -720,19 +812,29 @@ int nearestn(grid_class *from_grid, float **from_data,
  *	retrieve a value in the from_grid based on a to_grid location
  */
   for (i = 0; i < to_grid->rows; i++) 
-  { for (j = 0; j < to_grid->cols; j++)
+  { if (surrogate) locate_surrogate(surrogate, i, sur_r, sur_s, sur_ok);
+
+    for (j = 0; j < to_grid->cols; j++)
     {
-      status = inverse_grid(to_grid, (double)j, (double)i, &lat, &lon);
-      if (!status) continue;
+      if (surrogate)
+      { if (!sur_ok[j]) continue;
+	r = sur_r[j];
+	s = sur_s[j];
+      }
+      else
+      { status = inverse_grid(to_grid, (double)j, (double)i, &lat, &lon);
+	if (!status) continue;
 
-      status = forward_grid(from_grid, lat, lon, &r, &s);
-      if (!status) continue;
+	status = forward_grid(from_grid, lat, lon, &r, &s);
+	if (!status) continue;
+      }
 
       dr = nint(r) - r;
       ds = nint(s) - s; 
       dd = sqrt(dr*dr + ds*ds);
 
-      if (verbose >= 3 && 0 == i % VV_INTERVAL && 0 == j % VV_INTERVAL)
+      if (verbose >= 3 && !surrogate
+	  && 0 == i % VV_INTERVAL && 0 == j % VV_INTERVAL)
 	fprintf(stderr,">>> %4d %4d --> %7.2lf %7.2lf --> %4d %4d\n",
 		j, i, lat, lon, (int)(r + 0.5), (int)(s + 0.5));
 
@@ -785,66 +887,52 @@ int nearestn(grid_class *from_grid, float **from_data,
  *------------------------------------------------------------------------*/
 int cubiccon(grid_class *from_grid, float **from_data, 
 	     grid_class *to_grid, float **to_data, float **to_beta)
-{ register int i, j, col, row;
+{ register int i, j;
   double lat, lon, r, s;
-  double ccr[4], ccs[4], ccr_col, ccs_row, dr, ds, weight;
+  double value_sum, weight_sum;
+  cubic_mask mask;
   int npts=0, status;
 
   if (verbose) fprintf(stderr,"> cubic convolution\n");
 
+  mask.ignore_fill = ignore_fill;
+  mask.fill = fill;
+  mask.min_set = mask.max_set = FALSE;
+
 /*  
  *	retrieve a value in the from_grid based on a to_grid location
  */
   for (i = 0; i < to_grid->rows; i++) 
-  { for (j = 0; j < to_grid->cols; j++)
+  { if (surrogate) locate_surrogate(surrogate, i, sur_r, sur_s, sur_ok);
+
+    for (j = 0; j < to_grid->cols; j++)
     {
-      status = inverse_grid(to_grid, (double)j, (double)i, &lat, &lon);
-      if (!status) continue;
+      if (surrogate)
+      { if (!sur_ok[j]) continue;
+	r = sur_r[j];
+	s = sur_s[j];
+      }
+      else
+      { status = inverse_grid(to_grid, (double)j, (double)i, &lat, &lon);
+	if (!status) continue;
 
-      status = forward_grid(from_grid, lat, lon, &r, &s);
-      if (!status) continue;
+	status = forward_grid(from_grid, lat, lon, &r, &s);
+	if (!status) continue;
+      }
 
-      if (verbose >= 3 && 0 == i % VV_INTERVAL && 0 == j % VV_INTERVAL)
+      if (verbose >= 3 && !surrogate
+	  && 0 == i % VV_INTERVAL && 0 == j % VV_INTERVAL)
 	fprintf(stderr,">>> %4d %4d --> %7.2lf %7.2lf --> %4d %4d\n",
 		j, i, lat, lon, (int)(r + 0.5), (int)(s + 0.5));
 
-/*
- *	get cubic coefficients
- */
-      dr = r - (int)r;
-      ds = s - (int)s;
-
-      ccr[0] = -dr*(1-dr)*(1-dr);
-      ccr[1] = (1 - 2*dr*dr + dr*dr*dr);
-      ccr[2] = dr*(1 + dr - dr*dr);
-      ccr[3] = -dr*dr*(1-dr);
-
-      ccs[0] = -ds*(1-ds)*(1-ds);
-      ccs[1] = (1 - 2*ds*ds + ds*ds*ds);
-      ccs[2] = ds*(1 + ds - ds*ds);
-      ccs[3] = -ds*ds*(1-ds);
-
 /*
  *	interpolated value is weighted sum of sixteen surrounding samples
  */
-      for (row = (int)s-1; row <= (int)s+2; row++)
-      { if (row < 0 || row >= from_grid->rows) continue;
-
-	ccs_row = ccs[row - ((int)s-1)];
-
-	for (col = (int)r-1; col <= (int)r+2; col++)
-	{ if (col < 0 || col >= from_grid->cols) continue;
-	  if (ignore_fill && fill == from_data[row][col]) continue;
-
-	  ccr_col = ccr[col - ((int)r-1)];
+      sum_cubic(from_data, from_grid->rows, from_grid->cols, r, s, &mask,
+		&value_sum, &weight_sum);
 
-	  weight = ccs_row*ccr_col;
-
-	  to_data[i][j] += from_data[row][col]*weight;
-	  to_beta[i][j] += weight;
-
-	}
-      }
+      to_data[i][j] += value_sum;
+      to_beta[i][j] += weight_sum;
 
       ++npts;
 
@@ -8,11 +8,18 @@
 static const char resamp_c_rcsid[] = "$Id$";
 
 #include "define.h"
+#include "matrix.h"
 #include "grids.h"
 #include "grid_io.h"
+#include "surrogate.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 #define usage								\
-"usage: resamp [-vubslf -i fill -m mask -r factor -c method] \n"	\
+"usage: resamp [-vubslf -i fill -m mask -r factor -p levels -c method]\n"\
+"              [-g tolerance -G model_file]\n"				\
 "              from.gpd to.gpd from_data to_data\n"			\
 "\n"									\
 " input : from.gpd  - original grid parameters definition file\n"	\
@@ -35,6 +42,13 @@ static const char resamp_c_rcsid[] = "$Id$";
 "                  by a hyphen eg. 1-17 in which case a separate\n"\
 "                  file is output for each mask value\n"	\
 "         r factor - reduce resolution of to_grid by mfactor\n"		\
+"         p levels - build an overview pyramid of reductions by\n"	\
+"                    2, 4, ... 2^levels in one pass over from_data\n"	\
+"                    to.gpd must be the same as from.gpd\n"		\
+"                    to_data is used as a template, e.g. out.img\n"	\
+"                    produces out_r2.img and out_r2.gpd, etc.\n"	\
+"                    (not with -c, -r or -m range), at most as many\n"	\
+"                    levels as leave one row and column\n"		\
 "         c method - choose interpolation method\n"			\
 "                    N = nearest neighbor\n"				\
 "                    D = drop in the bucket\n"				\
@@ -42,6 +56,14 @@ static const char resamp_c_rcsid[] = "$Id$";
 "                    M = minification\n"				\
 "                    R = reduction\n"					\
 "                    (otherwise determined automatically)\n"		\
+"         g tolerance - locate cells with polynomial tile models fit\n"	\
+"                       to tolerance cells RMS instead of projecting\n"	\
+"                       each cell (default 0.01 with -G), used by\n"	\
+"                       methods N, D, B and -m ranges\n"			\
+"         G model_file - read tile models from model_file, or fit them\n"\
+"                        and save them there if it doesn't exist,\n"	\
+"                        the file only works for the grids and the\n"	\
+"                        kind of method (N, B or D, -m) it was made with\n"\
 "\n"
 
 static char possible_methods[] = "NDBMR";
@@ -64,6 +86,12 @@ static int reduction(grid_class *from_grid, grid_class *to_grid,
 static int distribution(grid_class *from_grid, grid_class *to_grid, 
 		 grid_io_class *from_data, grid_io_class *to_data);
 
+static int pyramid(grid_class *from_grid, grid_io_class *from_data,
+		   int nlevels, char *to_filename, int datum_size,
+		   bool signed_data, bool real_data);
+
+static int max_pyramid_levels(grid_class *grid);
+
 static double normalized_grid_scale(grid_class *this);
 
 static int (*method_function[])()  = { nearest_neighbor, 
@@ -76,11 +104,14 @@ static int (*method_function[])()  = { nearest_neighbor,
 static bool mask_only, ignore_fill;
 static int fill, mask, mask2, temp, verbose;
 static int report_interval = 100; /* rows */
+static surrogate_class *surrogate;
+static double *sur_r, *sur_s;
+static byte1 *sur_ok;
 
 #define INTERCHANGE(x, y) (temp = x, x = y, y = temp)
 
 main (int argc, char *argv[])
-{ int mfactor, status, nitems, npts;
+{ int mfactor, nlevels, status, nitems, npts;
   size_t datum_size;
   bool signed_data;
   bool real_data;
@@ -89,12 +120,16 @@ main (int argc, char *argv[])
   char *option=NULL, *position=NULL;
   char method;
   int (*resample)(grid_class*, grid_class*, grid_io_class*, grid_io_class*);
+  double tolerance;
+  char *model_filename;
+  bool use_surrogate;
 
 /*
  *	set defaults
  */
   status = EXIT_FAILURE;
   mfactor = 0;
+  nlevels = 0;
   mask_only = FALSE;
   ignore_fill = FALSE;
   verbose = 0;
@@ -103,6 +138,9 @@ main (int argc, char *argv[])
   real_data = FALSE;
   method = '\0';
   resample = NULL;
+  use_surrogate = FALSE;
+  tolerance = 0;
+  model_filename = NULL;
 
 /* 
  *	get command line options
@@ -138,6 +176,26 @@ main (int argc, char *argv[])
 	    error_exit(usage);
 	  }
 	  break;
+	case 'p':
+	  ++argv; --argc;
+	  if (sscanf(*argv, "%d", &nlevels) != 1) error_exit(usage);
+	  if (nlevels < 1) 
+	  { fprintf(stderr,"resamp: levels must be at least one\n");
+	    error_exit(usage);
+	  }
+	  break;
+	case 'g':
+	  ++argv; --argc;
+	  if (argc <= 0 || sscanf(*argv, "%lf", &tolerance) != 1
+	      || tolerance <= 0) error_exit(usage);
+	  use_surrogate = TRUE;
+	  break;
+	case 'G':
+	  ++argv; --argc;
+	  if (argc <= 0) error_exit(usage);
+	  model_filename = strdup(*argv);
+	  use_surrogate = TRUE;
+	  break;
 	case 'b':
 	  datum_size = 1;
 	  break;
@@ -218,6 +276,36 @@ main (int argc, char *argv[])
 		       from_data->filename, 
 		       from_data->width, from_data->height);
   ++argv; --argc;
+
+/*
+ *	pyramid mode writes its own set of output files
+ */
+  if (nlevels)
+  { if (!streq(from_grid->gpd_filename, to_grid->gpd_filename))
+    { fprintf(stderr,"resamp: to.gpd must be same as from.gpd to use -p\n");
+      goto cleanup;
+    }
+    if (mfactor > 1 || distribution == resample)
+    { fprintf(stderr,"resamp: -p can not be combined with -r or -m range\n");
+      goto cleanup;
+    }
+    if (method)
+    { fprintf(stderr,"resamp: -p always reduces, -c can not be used\n");
+      goto cleanup;
+    }
+    if (nlevels > max_pyramid_levels(from_grid))
+    { fprintf(stderr,"resamp: at most %d levels for a %dx%d grid\n",
+	      max_pyramid_levels(from_grid), from_grid->cols, from_grid->rows);
+      error_exit(usage);
+    }
+    npts = pyramid(from_grid, from_data, nlevels, *argv,
+		   mask_only ? 1 : datum_size, 
+		   mask_only ? TRUE : signed_data,
+		   mask_only ? FALSE : real_data);
+    if (npts > 0) status = EXIT_SUCCESS;
+    if (verbose) fprintf(stderr,"> resampled %d points\n", npts);
+    goto cleanup;
+  }
   
   to_data = init_grid_io(to_grid->cols, to_grid->rows,
 			 mask_only ? 1 : datum_size, 
@@ -289,6 +377,34 @@ main (int argc, char *argv[])
     }
   }
 
+/*
+ *	fit or read the tile models, forward methods locate from_grid
+ *	cells in to_grid, inverse methods to_grid cells in from_grid
+ */
+  if (use_surrogate)
+  { if (nearest_neighbor == resample || bilinear == resample)
+      surrogate = open_surrogate(to_grid, from_grid, tolerance,
+				 model_filename);
+    else if (drop_in_the_bucket == resample || distribution == resample)
+      surrogate = open_surrogate(from_grid, to_grid, tolerance,
+				 model_filename);
+    else
+      fprintf(stderr,"resamp: -g and -G are ignored by this method\n");
+
+    if (surrogate)
+    { if (verbose) fprintf(stderr,"> %d tiles fit to %g cells, "
+			   "%d projected exactly\n", surrogate->num_fit,
+			   surrogate->tolerance, surrogate->num_exact);
+      sur_r = (double *)calloc(surrogate->cell_grid->cols, sizeof(double));
+      sur_s = (double *)calloc(surrogate->cell_grid->cols, sizeof(double));
+      sur_ok = (byte1 *)calloc(surrogate->cell_grid->cols, sizeof(byte1));
+      if (!sur_r || !sur_s || !sur_ok) { perror("resamp"); goto cleanup; }
+    }
+    else if (minification != resample && reduction != resample)
+    { goto cleanup;
+    }
+  }
+
   npts = resample(from_grid, to_grid, from_data, to_data);
   if (npts > 0) status = EXIT_SUCCESS;
 
@@ -298,6 +414,10 @@ main (int argc, char *argv[])
  *	clean up
  */
  cleanup:
+  free_surrogate(surrogate);
+  if (sur_r) free(sur_r);
+  if (sur_s) free(sur_s);
+  if (sur_ok) free(sur_ok);
   close_grid(from_grid);
   close_grid(to_grid);
   close_grid_io(from_data);
@@ -317,158 +437,205 @@ main (int argc, char *argv[])
  *
  *	effect: to_data datum size is changed to 1 byte per bin
  *
+ *	note: the counts for every bin are kept in a single in-memory
+ *	      cube, count[row][col*nbins + bin], filled in one pass over
+ *	      the source. Source rows are read a band at a time and the
+ *	      band is projected in parallel (when compiled with OpenMP),
+ *	      then the counts are accumulated serially so the result
+ *	      does not depend on the number of threads.
+ *
  *------------------------------------------------------------------------*/
+#define DISTRIBUTION_BAND 64
+
 static int distribution(grid_class *from_grid, grid_class *to_grid, 
 		     grid_io_class *from_data, grid_io_class *to_data)
-{ int i, j, col, row, bin, nbins;
-  double lat, lon, r, s;
+{ int i, j, k, col, row, bin, nbins, band_rows;
   int npts=0, status;
   char *basename=NULL, *extension=NULL, filename[FILENAME_MAX];
-  grid_io_class *total=NULL, **count, *original;
-  double from_cell, to_cell, count_cell, total_cell;
+  grid_io_class **out=NULL, *original;
+  byte4 **count=NULL, **total=NULL;
+  double **band=NULL, *to_row=NULL, **band_r=NULL, **band_s=NULL;
+  byte1 **band_ok=NULL;
+  long **dest=NULL;
 
 
   if (verbose) fprintf(stderr,"> distribution for masks %d-%d\n", mask, mask2);
 
 /*
- *	create temporary grids to accumulate number of points 
- *	for each bin value as well as total points in each cell
+ *	allocate the count cube for every bin value
+ *	as well as total points in each cell
  */
   nbins = mask2 - mask + 1;
-  count = (grid_io_class **)calloc(nbins, sizeof(grid_io_class *));
+  count = (byte4 **)matrix(to_grid->rows, to_grid->cols*nbins,
+			   sizeof(byte4), matrix_ZERO);
   if (!count) { perror("distribution: count"); goto cleanup; }
-  for (bin = 0; bin < nbins; bin++)
-  { count[bin] = init_grid_io(to_grid->cols, to_grid->rows, 
-			      2, FALSE, FALSE, grid_io_TEMPORARY,
-			      "counttmpfile");
-    if (!count[bin]) { goto cleanup; }
 
-    fill_grid_io(count[bin], 0);
+  total = (byte4 **)matrix(to_grid->rows, to_grid->cols,
+			   sizeof(byte4), matrix_ZERO);
+  if (!total) { perror("distribution: total"); goto cleanup; }
+
+  band = (double **)matrix(DISTRIBUTION_BAND, from_grid->cols,
+			   sizeof(double), matrix_ZERO);
+  dest = (long **)matrix(DISTRIBUTION_BAND, from_grid->cols,
+			 sizeof(long), matrix_ZERO);
+  to_row = (double *)calloc(to_grid->cols, sizeof(double));
+  if (!band || !dest || !to_row) 
+  { perror("distribution: buffers"); goto cleanup; }
+
+  if (surrogate)
+  { band_r = (double **)matrix(DISTRIBUTION_BAND, from_grid->cols,
+			       sizeof(double), matrix_ZERO);
+    band_s = (double **)matrix(DISTRIBUTION_BAND, from_grid->cols,
+			       sizeof(double), matrix_ZERO);
+    band_ok = (byte1 **)matrix(DISTRIBUTION_BAND, from_grid->cols,
+			       sizeof(byte1), matrix_ZERO);
+    if (!band_r || !band_s || !band_ok)
+    { perror("distribution: buffers"); goto cleanup; }
   }
 
-  total = init_grid_io(to_grid->cols, to_grid->rows, 
-		     2, TRUE, FALSE, grid_io_TEMPORARY, "totaltmpfile");
-  if (!total) { goto cleanup; }
-
-  fill_grid_io(total, -1);
-
 /*
  *	map each from_grid value into the to_grid
  *	map i,j in from_grid to row,col in to_grid
  */
-  for (i = 0; i < from_grid->rows; i++) 
-  { if (verbose && i % report_interval == 0) 
+  for (i = 0; i < from_grid->rows; i += band_rows) 
+  { if (verbose && i % report_interval < DISTRIBUTION_BAND) 
       fprintf(stderr,"> %2.0f%%\015", 100.*i/from_grid->rows);
 
-    for (j = 0; j < from_grid->cols; j++)
-    {
-      status = get_element_grid_io(from_data, i, j, &from_cell);
-      if (!status) continue;
+    band_rows = from_grid->rows - i;
+    if (band_rows > DISTRIBUTION_BAND) band_rows = DISTRIBUTION_BAND;
+
+    for (k = 0; k < band_rows; k++)
+    { status = get_row_grid_io(from_data, i + k, band[k]);
+      if (!status) goto cleanup;
+    }
 
 /*
- *	ignore fill cells and cells outside range of interest
+ *	dest is the count cube offset for each source cell or -1
  */
-      if (ignore_fill && fill == from_cell) continue;
+#ifdef _OPENMP
+#pragma omp parallel for private(j, row, col, status) schedule(dynamic)
+#endif
+    for (k = 0; k < band_rows; k++)
+    { double lat, lon, r, s, from_cell;
+
+      if (surrogate)
+	locate_surrogate(surrogate, i + k, band_r[k], band_s[k], band_ok[k]);
 
-      if (from_cell < mask || from_cell > mask2) continue;
+      for (j = 0; j < from_grid->cols; j++)
+      { 
+	dest[k][j] = -1;
+	from_cell = band[k][j];
 
 /*
- *	project from_grid location into to_grid
+ *	ignore fill cells and cells outside range of interest
  */
-      status = inverse_grid(from_grid, (double)j, (double)i, &lat, &lon);
-      if (!status) continue;
-
-      if (!within_mapx(to_grid->mapx, lat, lon)
-	  || !within_mapx(from_grid->mapx, lat, lon)) continue;
+	if (ignore_fill && fill == from_cell) continue;
 
-      status = forward_grid(to_grid, lat, lon, &r, &s);
-      if (!status) continue;
+	if (from_cell < mask || from_cell > mask2) continue;
 
 /*
- *	drop from_grid value into appropriate to_grid cell
+ *	project from_grid location into to_grid
  */
-      row = (int)(s + 0.5); 
-      col = (int)(r + 0.5);
-      if (row < 0 || row >= to_grid->rows 
-	  || col < 0 || col >= to_grid->cols) continue;
+	if (surrogate)
+	{ if (!band_ok[k][j]) continue;
+	  r = band_r[k][j];
+	  s = band_s[k][j];
+	}
+	else
+	{ status = inverse_grid(from_grid, (double)j, (double)(i + k), 
+				&lat, &lon);
+	  if (!status) continue;
 
-      bin = from_cell - mask;
-      assert(0 <= bin && bin < nbins);
+	  if (!within_mapx(to_grid->mapx, lat, lon)
+	      || !within_mapx(from_grid->mapx, lat, lon)) continue;
 
-      status = get_element_grid_io(count[bin], row, col, &count_cell);
-      if (!status) continue;
-      status = get_element_grid_io(total, row, col, &total_cell);
-      if (!status) continue;
+	  status = forward_grid(to_grid, lat, lon, &r, &s);
+	  if (!status) continue;
+	}
 
-      assert(count_cell < INT2_MAX && total_cell < INT2_MAX);
-      count_cell += 1;
-      total_cell += 1;
-      ++npts;
+	row = (int)(s + 0.5); 
+	col = (int)(r + 0.5);
+	if (row < 0 || row >= to_grid->rows 
+	    || col < 0 || col >= to_grid->cols) continue;
 
-      status = put_element_grid_io(count[bin], row, col, count_cell);
-      if (!status) continue;
-      status = put_element_grid_io(total, row, col, total_cell);
-      if (!status) continue;
+	dest[k][j] = ((long)row*to_grid->cols + col)*nbins
+	  + (int)(from_cell - mask);
+      }
+    }
 
+/*
+ *	drop from_grid values into appropriate to_grid cells
+ */
+    for (k = 0; k < band_rows; k++)
+    { for (j = 0; j < from_grid->cols; j++)
+      { if (dest[k][j] < 0) continue;
+	++count[0][dest[k][j]];
+	++total[0][dest[k][j]/nbins];
+	++npts;
+      }
     }
   }
 
 /*
- *	write a to_grid for each bin
+ *	write a to_grid for each bin in one sweep over the rows
  */
   original = to_data;
   basename = strdup(original->filename);
   extension = strrchr(basename, '.');
   if (extension) { *extension = '\0'; extension += 1; }
 
+  out = (grid_io_class **)calloc(nbins, sizeof(grid_io_class *));
+  if (!out) { perror("distribution: out"); goto cleanup; }
+
   for (bin = 0; bin < nbins; bin++)
   { 
     sprintf(filename, extension ? "%s%2.2d.%s" : "%s%2.2d",
 	    basename, bin+mask, extension);
-    to_data = init_grid_io(original->width, original->height,
-			   original->datum_size, original->signed_data,
-			   original->real_data,
-			   grid_io_WRITE, filename);
-    if (!to_data) { goto cleanup; }
+    out[bin] = init_grid_io(original->width, original->height,
+			    original->datum_size, original->signed_data,
+			    original->real_data,
+			    grid_io_WRITE, filename);
+    if (!out[bin]) { goto cleanup; }
 
     if (verbose)
       fprintf(stderr,"> writing %s\n", filename);
+  }
 
-    for (row = 0; row < to_grid->rows; row++)
+  for (row = 0; row < to_grid->rows; row++)
+  { for (bin = 0; bin < nbins; bin++)
     { for (col = 0; col < to_grid->cols; col++)
       { 
-	status = get_element_grid_io(count[bin], row, col, &count_cell);
-        if (!status) continue;
-        status = get_element_grid_io(total, row, col, &total_cell);
-        if (!status) continue;
-
-	if (total_cell == -1)
-	{ to_cell = -1;
+	if (0 == total[row][col])
+	{ to_row[col] = -1;
 	}
 	else
-	{ total_cell += 1; /* because it was initialized with -1 */
-	  to_cell = count_cell ? nint(100*count_cell/total_cell) : 0;
+	{ to_row[col] = count[row][col*nbins + bin] 
+	    ? nint(100.*count[row][col*nbins + bin]/total[row][col]) : 0;
 	}
-
-        status = put_element_grid_io(to_data, row, col, to_cell);
-	if (!status) continue;
       }
+      status = put_row_grid_io(out[bin], row, to_row);
+      if (!status) goto cleanup;
     }
-
-    close_grid_io(to_data);
   }
 
  cleanup:
   if (basename) free(basename);
-  if (count)
-  { for (bin = 0; bin < nbins; bin++) close_grid_io(count[bin]);
-    free(count);
+  if (out)
+  { for (bin = 0; bin < nbins; bin++) close_grid_io(out[bin]);
+    free(out);
   }
-  close_grid_io(total);
+  if (count) free(count);
+  if (total) free(total);
+  if (band) free(band);
+  if (dest) free(dest);
+  if (to_row) free(to_row);
+  if (band_r) free(band_r);
+  if (band_s) free(band_s);
+  if (band_ok) free(band_ok);
 
   return npts;
 }
-
+
 /*------------------------------------------------------------------------
  * drop_in_the_bucket - average all data in cell
  *
@@ -525,6 +692,8 @@ static int drop_in_the_bucket(grid_class *from_grid, grid_class *to_grid,
   { if (verbose && i % report_interval == 0) 
       fprintf(stderr,"> %2.0f%%\015", 100.*i/from_grid->rows);
 
+    if (surrogate) locate_surrogate(surrogate, i, sur_r, sur_s, sur_ok);
+
     for (j = 0; j < from_grid->cols; j++)
     {
       status = get_element_grid_io(from_data, i, j, &from_cell);
@@ -538,14 +707,21 @@ static int drop_in_the_bucket(grid_class *from_grid, grid_class *to_grid,
 /*
  *	project from_grid location into to_grid
  */
-      status = inverse_grid(from_grid, (double)j, (double)i, &lat, &lon);
-      if (!status) continue;
+      if (surrogate)
+      { if (!sur_ok[j]) continue;
+	r = sur_r[j];
+	s = sur_s[j];
+      }
+      else
+      { status = inverse_grid(from_grid, (double)j, (double)i, &lat, &lon);
+	if (!status) continue;
 
-      if (!within_mapx(to_grid->mapx, lat, lon)
-	  || !within_mapx(from_grid->mapx, lat, lon)) continue;
+	if (!within_mapx(to_grid->mapx, lat, lon)
+	    || !within_mapx(from_grid->mapx, lat, lon)) continue;
 
-      status = forward_grid(to_grid, lat, lon, &r, &s);
-      if (!status) continue;
+	status = forward_grid(to_grid, lat, lon, &r, &s);
+	if (!status) continue;
+      }
 
 /*
  *	drop from_grid value into appropriate to_grid cell
@@ -625,16 +801,25 @@ static int bilinear(grid_class *from_grid, grid_class *to_grid,
   { if (verbose && i % report_interval == 0)
       fprintf(stderr,"> %2.0f%%\015", 100.*i/to_grid->rows);
 
+    if (surrogate) locate_surrogate(surrogate, i, sur_r, sur_s, sur_ok);
+
     for (j = 0; j < to_grid->cols; j++)
     {
-      status = inverse_grid(to_grid, (double)j, (double)i, &lat, &lon);
-      if (!status) continue;
+      if (surrogate)
+      { if (!sur_ok[j]) continue;
+	r = sur_r[j];
+	s = sur_s[j];
+      }
+      else
+      { status = inverse_grid(to_grid, (double)j, (double)i, &lat, &lon);
+	if (!status) continue;
 
-      if (!within_mapx(to_grid->mapx, lat, lon)
-	  || !within_mapx(from_grid->mapx, lat, lon)) continue;
+	if (!within_mapx(to_grid->mapx, lat, lon)
+	    || !within_mapx(from_grid->mapx, lat, lon)) continue;
 
-      status = forward_grid(from_grid, lat, lon, &r, &s);
-      if (!status) continue;
+	status = forward_grid(from_grid, lat, lon, &r, &s);
+	if (!status) continue;
+      }
 
       sum = norm = 0;
 
@@ -701,16 +886,25 @@ static int nearest_neighbor(grid_class *from_grid, grid_class *to_grid,
   { if (verbose && i % report_interval == 0)
       fprintf(stderr,"> %2.0f%%\015", 100.*i/to_grid->rows);
 
+    if (surrogate) locate_surrogate(surrogate, i, sur_r, sur_s, sur_ok);
+
     for (j = 0; j < to_grid->cols; j++)
     {
-      status = inverse_grid(to_grid, (double)j, (double)i, &lat, &lon);
-      if (!status) continue;
+      if (surrogate)
+      { if (!sur_ok[j]) continue;
+	r = sur_r[j];
+	s = sur_s[j];
+      }
+      else
+      { status = inverse_grid(to_grid, (double)j, (double)i, &lat, &lon);
+	if (!status) continue;
 
-      if (!within_mapx(to_grid->mapx, lat, lon)
-	  || !within_mapx(from_grid->mapx, lat, lon)) continue;
+	if (!within_mapx(to_grid->mapx, lat, lon)
+	    || !within_mapx(from_grid->mapx, lat, lon)) continue;
 
-      status = forward_grid(from_grid, lat, lon, &r, &s);
-      if (!status) continue;
+	status = forward_grid(from_grid, lat, lon, &r, &s);
+	if (!status) continue;
+      }
 
       row = (int)(s + 0.5);
       col = (int)(r + 0.5);
@@ -751,7 +945,7 @@ static int nearest_neighbor(grid_class *from_grid, grid_class *to_grid,
 static int minification(grid_class *from_grid, grid_class *to_grid, 
 			grid_io_class *from_data, grid_io_class *to_data)
 { int i, j, col, row, mfactor, npts=0, status;
-  double from_cell, to_cell;
+  double from_cell, *from_row=NULL, *to_row=NULL;
 
 /*
  *	get minification factor
@@ -762,6 +956,10 @@ static int minification(grid_class *from_grid, grid_class *to_grid,
 
   if (verbose) fprintf(stderr,"> minification, factor = %d\n", mfactor);
 
+  from_row = (double *)calloc(from_data->width, sizeof(double));
+  to_row = (double *)calloc(to_data->width, sizeof(double));
+  if (!from_row || !to_row) { perror("minification"); goto cleanup; }
+
 /*  
  *	each to_grid cell is center of mfactorXmfactor square in from_grid 
  *	i,j in to_grid, row,col in from_grid
@@ -772,28 +970,92 @@ static int minification(grid_class *from_grid, grid_class *to_grid,
 
     row = nint(mfactor*(i + .5));
 
+    status = get_row_grid_io(from_data, row, from_row);
+    if (!status) continue;
+
     for (j = 0; j < to_grid->cols; j++)
     {
       col = nint(mfactor*(j + .5));
 
-      status = get_element_grid_io(from_data, row, col, &from_cell);
-      if (!status) continue;
+      from_cell = from_row[col];
 
-      if (ignore_fill && fill == from_cell) continue;
+      if (ignore_fill && fill == from_cell) 
+      { to_row[j] = mask_only ? -1 : fill;
+	continue;
+      }
       if (mask_only) { from_cell = (mask == from_cell ? 100 : 0); }
 
-      to_cell = from_cell;
+      to_row[j] = from_cell;
       ++npts;
+    }
 
-      status = put_element_grid_io(to_data, i, j, to_cell);
-      if (!status) continue;
+    status = put_row_grid_io(to_data, i, to_row);
+    if (!status) continue;
+  }
+
+ cleanup:
+  if (from_row) free(from_row);
+  if (to_row) free(to_row);
 
+  return npts;
+}
+
+/*------------------------------------------------------------------------
+ * sum_span - sum valid values in a span of one row
+ *
+ *	input : v - first value
+ *		n - number of values
+ *
+ *	output: sum - sum of valid values
+ *
+ *	result: number of valid values
+ *
+ *	note: fill values are skipped when ignore_fill is set and
+ *	      values are converted to 100/0 when mask_only is set
+ *
+ *------------------------------------------------------------------------*/
+static int sum_span(double *v, int n, double *sum)
+{ int k=0, norm=0;
+  double acc=0, x;
+
+#ifdef __SSE2__
+  { __m128d vx, ok, vacc, vcnt, vfill, vmask, v100, one;
+    double out[2];
+
+    vacc = vcnt = _mm_setzero_pd();
+    vfill = _mm_set1_pd((double)fill);
+    vmask = _mm_set1_pd((double)mask);
+    v100 = _mm_set1_pd(100.);
+    one = _mm_set1_pd(1.);
+    ok = _mm_castsi128_pd(_mm_set1_epi32(-1));
+
+    for (k = 0; k + 1 < n; k += 2)
+    { vx = _mm_loadu_pd(v + k);
+      if (ignore_fill) ok = _mm_cmpneq_pd(vx, vfill);
+      if (mask_only) vx = _mm_and_pd(_mm_cmpeq_pd(vx, vmask), v100);
+      vacc = _mm_add_pd(vacc, _mm_and_pd(vx, ok));
+      vcnt = _mm_add_pd(vcnt, _mm_and_pd(one, ok));
     }
+
+    _mm_storeu_pd(out, vacc);
+    acc = out[0] + out[1];
+    _mm_storeu_pd(out, vcnt);
+    norm = (int)(out[0] + out[1]);
+  }
+#endif
+
+  for (; k < n; k++)
+  { x = v[k];
+    if (ignore_fill && fill == x) continue;
+    if (mask_only) { x = (mask == x ? 100 : 0); }
+    acc += x;
+    ++norm;
   }
 
-  return npts;
+  *sum = acc;
+  return norm;
 }
-
+
 /*------------------------------------------------------------------------
  * reduction - same projection and grid only smaller
  *             reduce entire from_data to to_data grid
@@ -804,11 +1066,22 @@ static int minification(grid_class *from_grid, grid_class *to_grid,
  *
  *	result: number of valid points resampled
  *
+ *	note: since the grids share geometry this is a pure block
+ *	      reduction. Source rows are read REDUCTION_BAND output
+ *	      rows at a time and the output rows of each band are
+ *	      reduced in parallel (when compiled with OpenMP).
+ *	      A source row that can't be read is reported and its
+ *	      cells are treated as missing, a to_data row that can't
+ *	      be written is reported and skipped.
+ *
  *------------------------------------------------------------------------*/
+#define REDUCTION_BAND 16
+
 static int reduction(grid_class *from_grid, grid_class *to_grid, 
 		     grid_io_class *from_data, grid_io_class *to_data)
-{ int i, j, col, row, mfactor, norm, npts=0, status;
-  double from_cell, to_cell;
+{ int i, k, mfactor, band_rows, npts=0, status;
+  double **band=NULL, **to_band=NULL;
+  bool *row_ok=NULL;
 
 /*
  *	get reduction factor
@@ -819,47 +1092,307 @@ static int reduction(grid_class *from_grid, grid_class *to_grid,
 
   if (verbose) fprintf(stderr,"> reduction, factor = %d\n", mfactor);
 
+  band = (double **)matrix(REDUCTION_BAND*mfactor, from_data->width,
+			   sizeof(double), matrix_ZERO);
+  to_band = (double **)matrix(REDUCTION_BAND, to_data->width,
+			      sizeof(double), matrix_ZERO);
+  row_ok = (bool *)calloc(REDUCTION_BAND*mfactor, sizeof(bool));
+  if (!band || !to_band || !row_ok) { perror("reduction"); goto cleanup; }
+
 /*  
  *	each to_grid cell is average of mfactorXmfactor square in from_grid 
  *	i,j in to_grid, row,col in from_grid
  */
-  for (i = 0; i < to_grid->rows; i++) 
-  { if (verbose && i % report_interval == 0) 
+  for (i = 0; i < to_grid->rows; i += band_rows) 
+  { if (verbose && i % report_interval < REDUCTION_BAND) 
       fprintf(stderr,"> %2.0f%%\015", 100.*i/to_grid->rows);
 
-    for (j = 0; j < to_grid->cols; j++)
-    { 
-      to_cell = norm = 0;
-
-      for (row = mfactor*i; row < mfactor*(i + 1); row++)
-      { for (col = mfactor*j; col < mfactor*(j + 1); col++)
-	{
-
-	  status = get_element_grid_io(from_data, row, col, &from_cell);
-	  if (!status) continue;
+    band_rows = to_grid->rows - i;
+    if (band_rows > REDUCTION_BAND) band_rows = REDUCTION_BAND;
 
-	  if (ignore_fill && fill == from_cell) continue;
+    for (k = 0; k < band_rows*mfactor; k++)
+    { row_ok[k] = get_row_grid_io(from_data, mfactor*i + k, band[k]);
+      if (!row_ok[k])
+	fprintf(stderr,"resamp: error reading row %d of %s\n",
+		mfactor*i + k, from_data->filename);
+    }
 
-	  if (mask_only) { from_cell = (mask == from_cell ? 100 : 0); }
+#ifdef _OPENMP
+#pragma omp parallel for reduction(+:npts)
+#endif
+    for (k = 0; k < band_rows; k++)
+    { int j, row, norm;
+      double sum, to_cell;
 
-	  to_cell += from_cell;
-	  norm += 1;
-	  ++npts;
+      for (j = 0; j < to_grid->cols; j++)
+      { 
+	to_cell = norm = 0;
 
+	for (row = mfactor*k; row < mfactor*(k + 1); row++)
+	{ if (!row_ok[row]) continue;
+	  norm += sum_span(band[row] + mfactor*j, mfactor, &sum);
+	  to_cell += sum;
 	}
+	npts += norm;
+
+	to_band[k][j] = (norm ? nint(to_cell/norm) : mask_only ? -1 : fill);
       }
+    }
 
-      to_cell = (norm ? nint(to_cell/norm) : mask_only ? -1 : fill);
+    for (k = 0; k < band_rows; k++)
+    { status = put_row_grid_io(to_data, i + k, to_band[k]);
+      if (!status)
+	fprintf(stderr,"resamp: error writing row %d of %s\n",
+		i + k, to_data->filename);
+    }
+  }
 
-      status = put_element_grid_io(to_data, i, j, to_cell);
-      if (!status) continue;
+ cleanup:
+  if (band) free(band);
+  if (to_band) free(to_band);
+  if (row_ok) free(row_ok);
+
+  return npts;
+}
 
+/*------------------------------------------------------------------------
+ * pyramid - build several reductions of from_data in one pass
+ *
+ *	input : from_grid, from_data
+ *		nlevels - number of levels, level k (from 0) is reduced
+ *			  by 2^(k+1)
+ *		to_filename - template for output file names
+ *		datum_size, signed_data, real_data - output data type
+ *
+ *	output: one flat file and one .gpd file per level
+ *
+ *	result: number of valid points resampled at the first level
+ *
+ *	note: each level keeps the unnormalized sums and counts for the
+ *	      pair of input rows it is currently accumulating. When a
+ *	      pair is complete the level writes its average row and
+ *	      passes the sums and counts on to the next level, so every
+ *	      level is identical to a direct reduction (-c R -r 2^(k+1))
+ *	      while only one row per level is held in memory.
+ *
+ *------------------------------------------------------------------------*/
+typedef struct
+{ int factor;		/* reduction relative to from_grid */
+  int cols, rows;
+  int row;		/* next output row */
+  int nacc;		/* input rows accumulated so far (0 or 1) */
+  double *sum, *norm;	/* accumulated sums and counts */
+  double *out;		/* output row */
+  grid_io_class *data;
+} pyramid_level;
+
+static bool write_level_gpd(grid_class *from_grid, pyramid_level *level,
+			    char *filename);
+
+static bool push_level(pyramid_level *level, int nlevels, int k,
+		       double *sum, double *norm);
+
+static int pyramid(grid_class *from_grid, grid_io_class *from_data,
+		   int nlevels, char *to_filename, int datum_size,
+		   bool signed_data, bool real_data)
+{ int i, j, k, npts=0, n, status;
+  double sum, *from_row=NULL, *sum_row=NULL, *norm_row=NULL;
+  char *basename=NULL, *extension=NULL, filename[FILENAME_MAX];
+  pyramid_level *level=NULL;
+
+  if (verbose) fprintf(stderr,"> pyramid, %d levels\n", nlevels);
+
+  if (nlevels < 1 || nlevels > max_pyramid_levels(from_grid))
+  { fprintf(stderr,"resamp: too many levels for a %dx%d grid\n",
+	    from_grid->cols, from_grid->rows);
+    return 0;
+  }
+
+  basename = strdup(to_filename);
+  extension = strrchr(basename, '.');
+  if (extension) { *extension = '\0'; extension += 1; }
+
+  level = (pyramid_level *)calloc(nlevels, sizeof(pyramid_level));
+  from_row = (double *)calloc(from_grid->cols, sizeof(double));
+  sum_row = (double *)calloc(from_grid->cols/2, sizeof(double));
+  norm_row = (double *)calloc(from_grid->cols/2, sizeof(double));
+  if (!level || !from_row || !sum_row || !norm_row) 
+  { perror("pyramid"); goto cleanup; }
+
+/*
+ *	set up each level and its output files
+ */
+  for (k = 0; k < nlevels; k++)
+  { level[k].factor = 2 << k;
+    level[k].cols = from_grid->cols / level[k].factor;
+    level[k].rows = from_grid->rows / level[k].factor;
+    level[k].sum = (double *)calloc(level[k].cols, sizeof(double));
+    level[k].norm = (double *)calloc(level[k].cols, sizeof(double));
+    level[k].out = (double *)calloc(level[k].cols, sizeof(double));
+    if (!level[k].sum || !level[k].norm || !level[k].out)
+    { perror("pyramid"); goto cleanup; }
+
+    sprintf(filename, extension ? "%s_r%d.%s" : "%s_r%d",
+	    basename, level[k].factor, extension);
+    level[k].data = init_grid_io(level[k].cols, level[k].rows,
+				 datum_size, signed_data, real_data,
+				 grid_io_WRITE, filename);
+    if (!level[k].data) goto cleanup;
+
+    if (verbose) fprintf(stderr,"> writing %s, %dx%d\n", filename,
+			 level[k].cols, level[k].rows);
+
+    sprintf(filename, "%s_r%d.gpd", basename, level[k].factor);
+    if (!write_level_gpd(from_grid, &level[k], filename)) goto cleanup;
+  }
+
+/*
+ *	stream source rows into the first level
+ *	any odd last row or column is dropped as in reduction
+ */
+  for (i = 0; i < level[0].rows*2; i++)
+  { if (verbose && i % report_interval == 0) 
+      fprintf(stderr,"> %2.0f%%\015", 100.*i/from_grid->rows);
+
+    status = get_row_grid_io(from_data, i, from_row);
+    if (!status) goto cleanup;
+
+    for (j = 0; j < level[0].cols; j++)
+    { n = sum_span(from_row + 2*j, 2, &sum);
+      sum_row[j] = sum;
+      norm_row[j] = n;
+      npts += n;
     }
+
+    if (!push_level(level, nlevels, 0, sum_row, norm_row)) goto cleanup;
   }
 
+ cleanup:
+  if (level)
+  { for (k = 0; k < nlevels; k++)
+    { close_grid_io(level[k].data);
+      if (level[k].sum) free(level[k].sum);
+      if (level[k].norm) free(level[k].norm);
+      if (level[k].out) free(level[k].out);
+    }
+    free(level);
+  }
+  if (basename) free(basename);
+  if (from_row) free(from_row);
+  if (sum_row) free(sum_row);
+  if (norm_row) free(norm_row);
+
   return npts;
 }
-
+
+/*------------------------------------------------------------------------
+ * max_pyramid_levels - most levels that leave a row and a column
+ *
+ *	input : grid - source grid
+ *
+ *	result: largest n with rows and cols both at least 2^n,
+ *		so every shift and factor in pyramid stays in range
+ *
+ *------------------------------------------------------------------------*/
+static int max_pyramid_levels(grid_class *grid)
+{ int n = 0;
+
+  while (n < 30 && (grid->rows >> (n+1)) >= 1 && (grid->cols >> (n+1)) >= 1)
+    ++n;
+  return n;
+}
+
+/*------------------------------------------------------------------------
+ * push_level - add one row of sums and counts to a pyramid level
+ *
+ *	input : level - all pyramid levels
+ *		nlevels - number of levels
+ *		k - level receiving the row
+ *		sum, norm - input row of sums and counts, already
+ *			    reduced horizontally to level[k].cols
+ *
+ *	result: TRUE iff success
+ *
+ *------------------------------------------------------------------------*/
+static bool push_level(pyramid_level *level, int nlevels, int k,
+		       double *sum, double *norm)
+{ int j;
+  pyramid_level *this = &level[k];
+
+  if (this->row >= this->rows) return TRUE;
+
+  for (j = 0; j < this->cols; j++)
+  { this->sum[j] += sum[j];
+    this->norm[j] += norm[j];
+  }
+
+  if (++this->nacc < 2) return TRUE;
+
+/*
+ *	pair of rows is complete - write the averages
+ */
+  for (j = 0; j < this->cols; j++)
+  { this->out[j] = (this->norm[j] ? nint(this->sum[j]/this->norm[j])
+		    : mask_only ? -1 : fill);
+  }
+  if (!put_row_grid_io(this->data, this->row, this->out)) return FALSE;
+
+/*
+ *	cascade the sums and counts into the next level
+ */
+  if (k + 1 < nlevels)
+  { for (j = 0; j < level[k+1].cols; j++)
+    { this->sum[j] = this->sum[2*j] + this->sum[2*j + 1];
+      this->norm[j] = this->norm[2*j] + this->norm[2*j + 1];
+    }
+    if (!push_level(level, nlevels, k + 1, this->sum, this->norm)) 
+      return FALSE;
+  }
+
+  for (j = 0; j < this->cols; j++) this->sum[j] = this->norm[j] = 0;
+  this->nacc = 0;
+  ++this->row;
+
+  return TRUE;
+}
+
+/*------------------------------------------------------------------------
+ * write_level_gpd - write grid parameters definition for a level
+ *
+ *	input : from_grid - full resolution grid
+ *		level - pyramid level
+ *		filename - name of .gpd file to create
+ *
+ *	result: TRUE iff success
+ *
+ *	note: the grid is scaled the same way as for -r factor
+ *
+ *------------------------------------------------------------------------*/
+static bool write_level_gpd(grid_class *from_grid, pyramid_level *level,
+			    char *filename)
+{ FILE *fp;
+
+  fp = fopen(filename, "w");
+  if (!fp) { perror(filename); return FALSE; }
+
+  fprintf(fp, "Grid MPP File: %s\n", from_grid->mapx->mpp_filename);
+  fprintf(fp, "Grid Width: %d\n", level->cols);
+  fprintf(fp, "Grid Height: %d\n", level->rows);
+  fprintf(fp, "Grid Map Origin Column: %.10g\n", 
+	  from_grid->map_origin_col/level->factor);
+  fprintf(fp, "Grid Map Origin Row: %.10g\n", 
+	  from_grid->map_origin_row/level->factor);
+  fprintf(fp, "Grid Columns per Map Unit: %.10g\n", 
+	  from_grid->cols_per_map_unit/level->factor);
+  fprintf(fp, "Grid Rows per Map Unit: %.10g\n", 
+	  from_grid->rows_per_map_unit/level->factor);
+
+  if (ferror(fp)) { perror(filename); fclose(fp); return FALSE; }
+  fclose(fp);
+
+  return TRUE;
+}
+
 /*------------------------------------------------------------------------
  * normalized_grid_scale - radians per grid cell
  *
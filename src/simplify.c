@@ -0,0 +1,301 @@
+/*======================================================================
+ * simplify - shape preserving polyline simplification
+ *
+ * National Snow & Ice Data Center, University of Colorado, Boulder
+ * Copyright (C) 2026 University of Colorado
+ *======================================================================*/
+static const char simplify_c_rcsid[]="$Id$";
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "define.h"
+#define simplify_c_
+#include "simplify.h"
+
+const char *id_simplify(void)
+{
+  return simplify_c_rcsid;
+}
+
+/*------------------------------------------------------------------------
+ * init_simplify - initialize polyline simplification
+ *
+ *	input : method - simplify_DOUGLAS_PEUCKER or simplify_VISVALINGAM
+ *		tolerance - largest distance from the simplified line
+ *			(douglas-peucker) or square root of the largest
+ *			effective area removed (visvalingam), in the
+ *			units of the points that will be simplified
+ *
+ *	result: pointer to new simplify_class or NULL on error
+ *
+ *	note  : work space grows with the longest polyline, use one
+ *		simplify_class per thread
+ *
+ *------------------------------------------------------------------------*/
+simplify_class *init_simplify(int method, double tolerance)
+{ simplify_class *this;
+
+  if (method != simplify_DOUGLAS_PEUCKER && method != simplify_VISVALINGAM)
+  { fprintf(stderr,"init_simplify: unknown method %d\n", method);
+    return NULL;
+  }
+
+  this = (simplify_class *)calloc(1, sizeof(simplify_class));
+  if (!this) { perror("init_simplify"); return NULL; }
+  this->method = method;
+  this->tolerance = tolerance;
+  return this;
+}
+
+/*------------------------------------------------------------------------
+ * free_simplify - free simplify_class and its work space
+ *------------------------------------------------------------------------*/
+void free_simplify(simplify_class *this)
+{
+  if (!this) return;
+  if (this->stack) free(this->stack);
+  if (this->heap) free(this->heap);
+  if (this->heap_pos) free(this->heap_pos);
+  if (this->prev) free(this->prev);
+  if (this->next) free(this->next);
+  if (this->area) free(this->area);
+  free(this);
+}
+
+/*
+ *	make sure the work space holds npts points, each buffer is
+ *	replaced only when its realloc succeeds so on failure all of
+ *	them still hold max_pts points
+ */
+static bool grow_simplify(simplify_class *this, int npts)
+{ int *new_int;
+  double *new_double;
+  bool ok = TRUE;
+
+  if (npts <= this->max_pts) return TRUE;
+
+  if (this->method == simplify_DOUGLAS_PEUCKER)
+  { new_int = (int *)realloc(this->stack, 2 * npts * sizeof(int));
+    if (new_int) this->stack = new_int; else ok = FALSE;
+  }
+  else
+  { new_int = (int *)realloc(this->heap, npts * sizeof(int));
+    if (new_int) this->heap = new_int; else ok = FALSE;
+    new_int = (int *)realloc(this->heap_pos, npts * sizeof(int));
+    if (new_int) this->heap_pos = new_int; else ok = FALSE;
+    new_int = (int *)realloc(this->prev, npts * sizeof(int));
+    if (new_int) this->prev = new_int; else ok = FALSE;
+    new_int = (int *)realloc(this->next, npts * sizeof(int));
+    if (new_int) this->next = new_int; else ok = FALSE;
+    new_double = (double *)realloc(this->area, npts * sizeof(double));
+    if (new_double) this->area = new_double; else ok = FALSE;
+  }
+  if (!ok) { perror("simplify_polyline"); return FALSE; }
+  this->max_pts = npts;
+  return TRUE;
+}
+
+/*------------------------------------------------------------------------
+ * douglas_peucker - keep points farther than tolerance from the chord
+ *
+ *	an explicit stack of first,last pairs replaces the recursion,
+ *	intervals on the stack never overlap so it holds at most npts
+ *	pairs, distance is to the chord segment so closed rings whose
+ *	ends coincide work
+ *
+ *------------------------------------------------------------------------*/
+static int douglas_peucker(simplify_class *this, int npts,
+			   double *x, double *y, int *keep)
+{ int first, last, i, imax, top, nkeep;
+  double tol2, dx, dy, len2, px, py, t, d2, dmax;
+  int *stack = this->stack;
+
+  tol2 = this->tolerance * this->tolerance;
+  for (i = 1; i < npts-1; i++) keep[i] = FALSE;
+  keep[0] = keep[npts-1] = TRUE;
+  nkeep = 2;
+
+  top = 0;
+  stack[top++] = 0;
+  stack[top++] = npts-1;
+  while (top > 0)
+  { last = stack[--top];
+    first = stack[--top];
+
+    dx = x[last] - x[first];
+    dy = y[last] - y[first];
+    len2 = dx*dx + dy*dy;
+    dmax = -1;
+    imax = first;
+    for (i = first+1; i < last; i++)
+    { px = x[i] - x[first];
+      py = y[i] - y[first];
+      if (len2 > 0)
+      { t = (px*dx + py*dy) / len2;
+	if (t < 0) t = 0;
+	else if (t > 1) t = 1;
+	px -= t*dx;
+	py -= t*dy;
+      }
+      d2 = px*px + py*py;
+      if (d2 > dmax) { dmax = d2; imax = i; }
+    }
+
+    if (dmax > tol2)
+    { keep[imax] = TRUE;
+      ++nkeep;
+      if (last - imax > 1) { stack[top++] = imax; stack[top++] = last; }
+      if (imax - first > 1) { stack[top++] = first; stack[top++] = imax; }
+    }
+  }
+
+  return nkeep;
+}
+
+/*
+ *	visvalingam heap, smallest area on top, ties by point order
+ */
+#define simplify_LESS(a,b) (area[a] < area[b] \
+			    || (area[a] == area[b] && (a) < (b)))
+
+static void sift_up(simplify_class *this, int pos)
+{ int *heap = this->heap, *heap_pos = this->heap_pos;
+  double *area = this->area;
+  int i = heap[pos], parent;
+
+  while (pos > 0)
+  { parent = (pos - 1) / 2;
+    if (!simplify_LESS(i, heap[parent])) break;
+    heap[pos] = heap[parent];
+    heap_pos[heap[pos]] = pos;
+    pos = parent;
+  }
+  heap[pos] = i;
+  heap_pos[i] = pos;
+}
+
+static void sift_down(simplify_class *this, int pos, int size)
+{ int *heap = this->heap, *heap_pos = this->heap_pos;
+  double *area = this->area;
+  int i = heap[pos], child;
+
+  while ((child = 2*pos + 1) < size)
+  { if (child + 1 < size && simplify_LESS(heap[child+1], heap[child]))
+      ++child;
+    if (!simplify_LESS(heap[child], i)) break;
+    heap[pos] = heap[child];
+    heap_pos[heap[pos]] = pos;
+    pos = child;
+  }
+  heap[pos] = i;
+  heap_pos[i] = pos;
+}
+
+static double triangle_area(double *x, double *y, int a, int b, int c)
+{
+  return 0.5 * fabs((x[a] - x[b]) * (y[c] - y[b])
+		    - (x[c] - x[b]) * (y[a] - y[b]));
+}
+
+/*------------------------------------------------------------------------
+ * visvalingam - drop points with the smallest effective area
+ *
+ *	each interior point's area is the triangle it makes with its
+ *	kept neighbors, a neighbor's new area is never less than the
+ *	area just removed so points leave in order of significance
+ *
+ *------------------------------------------------------------------------*/
+static int visvalingam(simplify_class *this, int npts,
+		       double *x, double *y, int *keep)
+{ int i, p, n, q, k, size, nkeep;
+  double threshold, a, removed;
+  int *prev = this->prev, *next = this->next;
+  int *heap = this->heap, *heap_pos = this->heap_pos;
+  double *area = this->area;
+
+  threshold = this->tolerance * this->tolerance;
+  for (i = 0; i < npts; i++)
+  { keep[i] = TRUE;
+    prev[i] = i - 1;
+    next[i] = i + 1;
+    heap_pos[i] = -1;
+  }
+  nkeep = npts;
+
+  size = 0;
+  for (i = 1; i < npts-1; i++)
+  { area[i] = triangle_area(x, y, i-1, i, i+1);
+    heap[size] = i;
+    heap_pos[i] = size++;
+  }
+  for (k = size/2 - 1; k >= 0; k--) sift_down(this, k, size);
+
+  while (size > 0)
+  { i = heap[0];
+    removed = area[i];
+    if (removed >= threshold) break;
+
+    heap_pos[i] = -1;
+    if (--size > 0)
+    { heap[0] = heap[size];
+      heap_pos[heap[0]] = 0;
+      sift_down(this, 0, size);
+    }
+    keep[i] = FALSE;
+    --nkeep;
+
+    p = prev[i];
+    n = next[i];
+    next[p] = n;
+    prev[n] = p;
+
+    for (k = 0; k < 2; k++)
+    { q = k ? n : p;
+      if (heap_pos[q] < 0) continue;
+      a = triangle_area(x, y, prev[q], q, next[q]);
+      if (a < removed) a = removed;
+      if (a < area[q])
+      { area[q] = a;
+	sift_up(this, heap_pos[q]);
+      }
+      else
+      { area[q] = a;
+	sift_down(this, heap_pos[q], size);
+      }
+    }
+  }
+
+  return nkeep;
+}
+
+/*------------------------------------------------------------------------
+ * simplify_polyline - pick the points that keep the shape of a polyline
+ *
+ *	input : this - pointer to simplify_class (returned by init_simplify)
+ *		npts - number of points
+ *		x,y - points in the units of the tolerance, usually
+ *		      grid cells so the tolerance is in output pixels
+ *
+ *	output: keep - TRUE for each point kept, the first and last
+ *		       points are always kept
+ *
+ *	result: number of points kept, -1 on error
+ *
+ *------------------------------------------------------------------------*/
+int simplify_polyline(simplify_class *this, int npts,
+		      double *x, double *y, int *keep)
+{ int i;
+
+  if (npts <= 2)
+  { for (i = 0; i < npts; i++) keep[i] = TRUE;
+    return npts;
+  }
+
+  if (!grow_simplify(this, npts)) return -1;
+
+  if (this->method == simplify_DOUGLAS_PEUCKER)
+    return douglas_peucker(this, npts, x, y, keep);
+  else
+    return visvalingam(this, npts, x, y, keep);
+}
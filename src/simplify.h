@@ -0,0 +1,46 @@
+/*======================================================================
+ * simplify - shape preserving polyline simplification
+ *
+ * National Snow & Ice Data Center, University of Colorado, Boulder
+ * Copyright (C) 2026 University of Colorado
+ *======================================================================*/
+#ifndef simplify_h_
+#define simplify_h_
+
+#include "define.h"
+
+#ifdef simplify_c_
+const char simplify_h_rcsid[]="$Id$";
+#endif
+
+/*
+ *	methods
+ *
+ *	simplify_DOUGLAS_PEUCKER - keep the point farthest from the chord
+ *		while it is more than tolerance away, then split there
+ *	simplify_VISVALINGAM - drop the point with the smallest
+ *		effective triangle area while that area is less than
+ *		tolerance squared
+ */
+#define simplify_DOUGLAS_PEUCKER 1
+#define simplify_VISVALINGAM 2
+
+typedef struct
+{ int method;
+  double tolerance;		/* same units as x,y */
+  int *stack;			/* douglas-peucker first,last pairs */
+  int *heap;			/* visvalingam points by area */
+  int *heap_pos;		/* heap position of each point or -1 */
+  int *prev, *next;		/* neighbors still kept */
+  double *area;			/* effective area of each point */
+  int max_pts;
+} simplify_class;
+
+simplify_class *init_simplify(int method, double tolerance);
+
+int simplify_polyline(simplify_class *this, int npts,
+		      double *x, double *y, int *keep);
+
+void free_simplify(simplify_class *this);
+
+#endif
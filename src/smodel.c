@@ -19,6 +19,8 @@ static const char smodel_c_rcsid[] = "$Id$";
 static smodel *new_smodel(int n);
 static double linearize(double lon1, double lon2, int topo);
 static double normalize(double lon, int topo);
+static int find_interval(smodel *this, double x, int i);
+static double eval_interval(smodel *this, double x, int i);
 
 const char *id_smodel(void)
 {
@@ -178,42 +180,52 @@ smodel *init_smodel(int n, double *x, double *y, int topo)
  *
  *------------------------------------------------------------------------*/
 double eval_smodel(smodel *this, double x)
-{ register int i,j,k;
-  register double dx, y;
+{ register int i;
 
 /*
- *	find proper interval
  *	start with interval of previous evaluation
- *	then try next interval after that 
- *	then use binary search
  */
-  i = this->I;
-  if (x >= this->X[i] && x < this->X[i+1])
-  { this->I = i;
-  }
-  else if (x >= this->X[i+1] && x < this->X[i+2])
-  { this->I = ++i;
-  }
-  else 
-  { i = 0;
-    j = this->N;
-    do
-    { k = (i+j)/2;
-      if (x < this->X[k]) j = k;
-      if (x >= this->X[k]) i = k;
-    } while (j > i+1);
-    this->I = i;
-  }
+  i = find_interval(this, x, this->I);
+  this->I = i;
 
-/*
- *	evaluate spline using Horner's rule
- */
-  dx = x - this->X[i];
-  y = this->Y[i] + dx*(this->B[i] + dx*(this->C[i] + dx*this->D[i]));
+  return eval_interval(this, x, i);
+}
 
-  return normalize(y, this->topo);
+/*------------------------------------------------------------------------
+ * eval_smodel_array - evaluate cubic spline at many points
+ *
+ *	input : this - pointer to smodel
+ *		npts - number of points
+ *		x - abscissas at which the spline is to be evaluated,
+ *		    sorted or not
+ *		cursor - interval to start searching from or NULL
+ *
+ *	output: y - ordinate value at each x
+ *		cursor - interval of the last point
+ *
+ *	note :	the smodel is not changed, so threads can share one
+ *		smodel as long as each has its own cursor. Sorted
+ *		input finds each interval in a step or two, unsorted
+ *		input costs at most a binary search per point.
+ *		The same note on extrapolation as eval_smodel applies.
+ *
+ *------------------------------------------------------------------------*/
+void eval_smodel_array(smodel *this, int npts, double *x, double *y,
+		       int *cursor)
+{ register int i, ipt;
+
+  i = NULL == cursor ? 0 : *cursor;
+  if (i < 0) i = 0;
+  if (i > this->N - 1) i = this->N - 1;
+
+  for (ipt = 0; ipt < npts; ipt++)
+  { i = find_interval(this, x[ipt], i);
+    y[ipt] = eval_interval(this, x[ipt], i);
+  }
+
+  if (NULL != cursor) *cursor = i;
 }
-
+
 /*------------------------------------------------------------------------
  * write_smodel - save smodel to file
  *
@@ -363,6 +375,69 @@ static smodel *new_smodel(int n)
   return this;
 }
 
+/*------------------------------------------------------------------------
+ * find_interval - find the knot interval containing a point
+ *
+ *	input : this - pointer to smodel
+ *		x - abscissa to look for
+ *		i - interval to start from (0 <= i < N)
+ *
+ *	result: i such that X[i] <= x < X[i+1], 0 if x is before the
+ *		first knot, N-1 if x is after the last knot
+ *
+ *	try the starting interval, then gallop forward or back from
+ *	it and finish with a binary search
+ *
+ *------------------------------------------------------------------------*/
+static int find_interval(smodel *this, double x, int i)
+{ register int lo, hi, k, step;
+  register double *X = this->X;
+
+  if (x >= X[i] && x < X[i+1]) return i;
+
+  step = 1;
+  if (x >= X[i+1])
+  { lo = i+1;
+    hi = lo+1;
+    while (hi < this->N && x >= X[hi])
+    { lo = hi;
+      step *= 2;
+      hi = lo + step;
+    }
+    if (hi > this->N) hi = this->N;
+  }
+  else
+  { hi = i;
+    lo = hi-1;
+    while (lo > 0 && x < X[lo])
+    { hi = lo;
+      step *= 2;
+      lo = hi - step;
+    }
+    if (lo < 0) lo = 0;
+  }
+
+  while (hi > lo+1)
+  { k = (lo+hi)/2;
+    if (x < X[k]) hi = k;
+    else lo = k;
+  }
+
+  return lo < this->N ? lo : this->N - 1;
+}
+
+/*------------------------------------------------------------------------
+ * eval_interval - evaluate cubic spline using Horner's rule
+ *------------------------------------------------------------------------*/
+static double eval_interval(smodel *this, double x, int i)
+{ register double dx, y;
+
+  dx = x - this->X[i];
+  y = this->Y[i] + dx*(this->B[i] + dx*(this->C[i] + dx*this->D[i]));
+
+  return normalize(y, this->topo);
+}
+
 /*------------------------------------------------------------------------
  * linearize - convert circular topology to linear
  *
@@ -466,3 +541,117 @@ main()
   exit(0);
 }
 #endif
+
+/*------------------------------------------------------------------------
+ * main - regression test of interval search
+ *
+ *	compile with -DSMTEST
+ *
+ *	find_interval from every starting interval is checked against
+ *	a plain bisection over all knots, at each knot, just either side
+ *	of it, between knots and beyond both ends. eval_smodel_array is
+ *	checked against eval_smodel. Any difference is reported and the
+ *	exit status is failure.
+ *
+ *------------------------------------------------------------------------*/
+#ifdef SMTEST
+#include <stdlib.h>
+#include <math.h>
+
+#define SMTEST_MAX_KNOTS 40
+
+/*
+ *	interval search of eval_smodel before the galloping search
+ */
+static int bisect_interval(smodel *this, double x)
+{ register int i, j, k;
+
+  i = 0;
+  j = this->N;
+  do
+  { k = (i+j)/2;
+    if (x < this->X[k]) j = k;
+    if (x >= this->X[k]) i = k;
+  } while (j > i+1);
+  return i;
+}
+
+static int check_smodel(smodel *this)
+{ int i, k, n, start, found, errors = 0;
+  int cursor;
+  double x[4*SMTEST_MAX_KNOTS+4], y[4*SMTEST_MAX_KNOTS+4], single, swap;
+
+  n = 0;
+  x[n++] = -DBL_MAX;
+  x[n++] = this->X[0] - 1;
+  for (k = 0; k < this->N; k++)
+  { x[n++] = nextafter(this->X[k], -DBL_MAX);
+    x[n++] = this->X[k];
+    x[n++] = nextafter(this->X[k], DBL_MAX);
+    if (k < this->N-1) x[n++] = (this->X[k] + this->X[k+1])/2;
+  }
+  x[n++] = this->X[this->N-1] + 1;
+  x[n++] = DBL_MAX;
+
+  for (i = 0; i < n; i++)
+  { for (start = 0; start < this->N; start++)
+    { found = find_interval(this, x[i], start);
+      if (found != bisect_interval(this, x[i]))
+      { fprintf(stderr,"smtest: N=%d x=%.17g from %d found %d, "
+		"bisection %d\n", this->N, x[i], start, found,
+		bisect_interval(this, x[i]));
+	++errors;
+      }
+    }
+  }
+
+/*
+ *	sorted then shuffled
+ */
+  for (k = 0; k < 2; k++)
+  { if (1 == k)
+    { for (i = n-1; i > 0; i--)
+      { start = rand() % (i+1);
+	swap = x[i]; x[i] = x[start]; x[start] = swap;
+      }
+    }
+    cursor = 0;
+    eval_smodel_array(this, n, x, y, &cursor);
+    for (i = 0; i < n; i++)
+    { single = eval_smodel(this, x[i]);
+      if (y[i] != single && !(isnan(y[i]) && isnan(single)))
+      { fprintf(stderr,"smtest: N=%d x=%.17g array %.17g, single %.17g\n",
+		this->N, x[i], y[i], single);
+	++errors;
+      }
+    }
+  }
+
+  return errors;
+}
+
+int main(void)
+{ double x[SMTEST_MAX_KNOTS], y[SMTEST_MAX_KNOTS];
+  int i, n, spacing, errors = 0;
+  smodel *this;
+
+  for (n = 2; n <= SMTEST_MAX_KNOTS; n++)
+  { for (spacing = 0; spacing < 2; spacing++)
+    { x[0] = -n/3.;
+      y[0] = 0;
+      for (i = 1; i < n; i++)
+      { x[i] = x[i-1] 
+	  + (0 == spacing ? 0.5 : 1e-6 + rand() / (double)RAND_MAX);
+	y[i] = y[i-1] + rand() / (double)RAND_MAX - 0.5;
+      }
+      this = init_smodel(n, x, y, FLAT_smodel);
+      if (NULL == this) error_exit("smtest: init_smodel failed");
+      errors += check_smodel(this);
+      free_smodel(this);
+    }
+  }
+
+  fprintf(stderr,"%d errors\n", errors);
+  return errors > 0 ? ABORT : 0;
+}
+#endif
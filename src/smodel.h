@@ -12,6 +12,10 @@
 const char smodel_h_rcsid[] = "$Id$";
 #endif
 
+/*
+ *	I is the interval of the last eval_smodel call, use
+ *	eval_smodel_array with a cursor per thread to share an smodel
+ */
 typedef struct {
   double *X, *Y, *B, *C, *D;
   int N, I, topo;
@@ -32,6 +36,8 @@ typedef struct {
 smodel *init_smodel(int n, double *x, double *y, int topo);
 void free_smodel(smodel *this);
 double eval_smodel(smodel *this, double x);
+void eval_smodel_array(smodel *this, int npts, double *x, double *y,
+		       int *cursor);
 int write_smodel(smodel *this, FILE *fp);
 int read_smodel(smodel *this, FILE *fp);
 
@@ -0,0 +1,720 @@
+/*======================================================================
+ * surrogate - polynomial tile models of one grid's cells in another
+ *
+ *	the cell grid is cut into tiles, in each tile the target grid
+ *	r and s of a cell are modeled as Chebyshev fit polynomials
+ *	(pmodel) of the cell's col and row, fit to exact projections
+ *	at Chebyshev points of the tile
+ *
+ *	each fit is tested against exact projections on a lattice
+ *	across the tile and at every cell on the tile's edges, so a
+ *	discontinuity (e.g. a map seam or interruption) that crosses
+ *	the tile shows up in the test, a tile whose RMS error is more
+ *	than the tolerance is split and its children are fit, tiles
+ *	that are still too large at the minimum size, or that have
+ *	points off either map, are projected exactly
+ *
+ *	locating a row of cells then costs order+1 multiply-adds per
+ *	cell in fit tiles instead of an inverse and forward projection
+ *
+ * National Snow & Ice Data Center, University of Colorado, Boulder
+ * Copyright (C) 2026 University of Colorado
+ *======================================================================*/
+static const char surrogate_c_rcsid[]="$Id$";
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <math.h>
+#include "define.h"
+#include "grids.h"
+#include "pmodel.h"
+#define surrogate_c_
+#include "surrogate.h"
+
+const char *id_surrogate(void)
+{
+  return surrogate_c_rcsid;
+}
+
+/*
+ *	a model file is checked against the grids at the center of up
+ *	to this many fit tiles, each must agree to this many times the
+ *	tolerance
+ */
+#define surrogate_CHECK_TILES 16
+#define surrogate_CHECK_FACTOR 10
+
+/*
+ *	model file layout, in native byte order
+ *
+ *	  char magic[16], int version, int byte_order
+ *	  int cell cols, rows, target cols, rows, order, tile_size,
+ *	      min_tile, num_tiles
+ *	  double tolerance
+ *	  num_tiles x { int col0, row0, cols, rows, kind, child, nchild
+ *			[double r coef[nvars], s coef[nvars] if FIT] }
+ */
+#define surrogate_MAGIC "mapx surrogate\n"
+#define surrogate_VERSION 1
+#define surrogate_BYTE_ORDER 0x01020304
+#define surrogate_MAX_ORDER 16
+
+/*------------------------------------------------------------------------
+ * exact - project a cell grid location into the target grid
+ *
+ *	input : this - surrogate_class
+ *		col,row - cell grid location
+ *
+ *	output: r,s - target grid location, may be off the target grid
+ *
+ *	result: TRUE if the location is within both maps
+ *
+ *------------------------------------------------------------------------*/
+static bool exact(surrogate_class *this, double col, double row,
+		  double *r, double *s)
+{ double lat, lon;
+
+  if (!inverse_grid(this->cell_grid, col, row, &lat, &lon)) return FALSE;
+  if (!within_mapx(this->target_grid->mapx, lat, lon)) return FALSE;
+
+/*
+ *	forward_grid only sets r,s when the projection succeeds,
+ *	its status also says whether r,s are on the grid
+ */
+  *r = HUGE_VAL;
+  forward_grid(this->target_grid, lat, lon, r, s);
+  return HUGE_VAL != *r;
+}
+
+static bool on_target(surrogate_class *this, double r, double s)
+{
+  return r >= -0.5 && r < this->target_grid->cols - 0.5
+    && s >= -0.5 && s < this->target_grid->rows - 0.5;
+}
+
+/*
+ *	a fit within the tolerance outside the target's edges is put
+ *	on the edge, cells that project exactly onto an edge (e.g.
+ *	along a map seam) would otherwise come and go with rounding
+ */
+static double snap_edge(double r, int cols, double tolerance)
+{
+  if (r < -0.5 && r >= -0.5 - tolerance) return -0.5;
+  if (r >= cols - 0.5 && r < cols - 0.5 + tolerance)
+    return nextafter(cols - 0.5, 0.);
+  return r;
+}
+
+/*
+ *	tile col,row to the normalized interval [-1,1]
+ */
+static double center(int x0, int n) { return x0 + (n - 1) / 2.; }
+static double half_width(int n) { return n > 1 ? (n - 1) / 2. : 1.; }
+
+/*------------------------------------------------------------------------
+ * fit_tile - fit and test r and s models for one tile
+ *
+ *	input : this - surrogate_class
+ *		tile - tile to fit, cols and rows set
+ *
+ *	output: tile - r and s set if the result is TRUE
+ *
+ *	result: TRUE if every point projected and the fit is within
+ *		the tolerance
+ *
+ *------------------------------------------------------------------------*/
+static bool fit_tile(surrogate_class *this, surrogate_tile *tile)
+{ int i, j, k, n, m, npts, nedge;
+  double xc, yc, hx, hy, SSE_r, SSE_s, R2;
+  double *x = NULL, *y = NULL, *r = NULL, *s = NULL;
+  bool ok = FALSE;
+
+  tile->r = tile->s = NULL;
+  n = 2*this->order + 2;
+  m = 2*this->order + 3;
+  nedge = 2*(tile->cols + tile->rows);
+  npts = m*m + nedge > n*n ? m*m + nedge : n*n;
+  x = (double *)malloc(npts * sizeof(double));
+  y = (double *)malloc(npts * sizeof(double));
+  r = (double *)malloc(npts * sizeof(double));
+  s = (double *)malloc(npts * sizeof(double));
+  if (!x || !y || !r || !s) { perror("surrogate"); goto done; }
+
+  xc = center(tile->col0, tile->cols);
+  yc = center(tile->row0, tile->rows);
+  hx = half_width(tile->cols);
+  hy = half_width(tile->rows);
+
+/*
+ *	fit to n x n Chebyshev points
+ */
+  for (i = 0, k = 0; i < n; i++)
+  { for (j = 0; j < n; j++, k++)
+    { x[k] = chebyshev(j, n-1, -1., 1.);
+      y[k] = chebyshev(i, n-1, -1., 1.);
+      if (!exact(this, xc + x[k]*hx, yc + y[k]*hy, r+k, s+k)) goto done;
+    }
+  }
+
+  tile->r = init_pmodel(2, this->order, 0, n*n, x, y, r);
+  tile->s = init_pmodel(2, this->order, 0, n*n, x, y, s);
+  if (!tile->r || !tile->s) goto done;
+
+/*
+ *	test on an m x m lattice from edge to edge
+ *	and at the cells around the edges
+ */
+  for (i = 0, k = 0; i < m; i++)
+  { for (j = 0; j < m; j++, k++)
+    { x[k] = -1. + 2.*j/(m-1);
+      y[k] = -1. + 2.*i/(m-1);
+    }
+  }
+  for (j = 0; j < tile->cols; j++, k += 2)
+  { x[k] = x[k+1] = (tile->col0 + j - xc) / hx;
+    y[k] = (tile->row0 - yc) / hy;
+    y[k+1] = (tile->row0 + tile->rows - 1 - yc) / hy;
+  }
+  for (i = 0; i < tile->rows; i++, k += 2)
+  { x[k] = (tile->col0 - xc) / hx;
+    x[k+1] = (tile->col0 + tile->cols - 1 - xc) / hx;
+    y[k] = y[k+1] = (tile->row0 + i - yc) / hy;
+  }
+  for (k = 0; k < m*m + nedge; k++)
+  { if (!exact(this, xc + x[k]*hx, yc + y[k]*hy, r+k, s+k)) goto done;
+  }
+
+  test_pmodel(tile->r, m*m + nedge, x, y, r, &SSE_r, &R2);
+  test_pmodel(tile->s, m*m + nedge, x, y, s, &SSE_s, &R2);
+  ok = sqrt((SSE_r + SSE_s) / (m*m + nedge)) <= this->tolerance;
+
+ done:
+  if (!ok)
+  { free_pmodel(tile->r);
+    free_pmodel(tile->s);
+    tile->r = tile->s = NULL;
+  }
+  if (x) free(x);
+  if (y) free(y);
+  if (r) free(r);
+  if (s) free(s);
+  return ok;
+}
+
+static bool add_tile(surrogate_class *this, int col0, int row0,
+		     int cols, int rows)
+{ surrogate_tile *tile;
+
+  if (this->num_tiles >= this->max_tiles)
+  { this->max_tiles = 2 * this->max_tiles + 64;
+    this->tile = (surrogate_tile *)realloc(this->tile, this->max_tiles
+					   * sizeof(surrogate_tile));
+    if (!this->tile) { perror("surrogate"); return FALSE; }
+  }
+
+  tile = this->tile + this->num_tiles++;
+  memset(tile, 0, sizeof(surrogate_tile));
+  tile->col0 = col0;
+  tile->row0 = row0;
+  tile->cols = cols;
+  tile->rows = rows;
+  return TRUE;
+}
+
+static surrogate_class *new_surrogate(grid_class *cell_grid,
+				      grid_class *target_grid,
+				      int order, double tolerance,
+				      int tile_size, int min_tile)
+{ surrogate_class *this;
+
+  this = (surrogate_class *)calloc(1, sizeof(surrogate_class));
+  if (!this) { perror("surrogate"); return NULL; }
+  this->cell_grid = cell_grid;
+  this->target_grid = target_grid;
+  this->order = order;
+  this->tolerance = tolerance;
+  this->tile_size = tile_size;
+  this->min_tile = min_tile;
+  this->tile_cols = (cell_grid->cols + tile_size - 1) / tile_size;
+  this->tile_rows = (cell_grid->rows + tile_size - 1) / tile_size;
+  return this;
+}
+
+/*------------------------------------------------------------------------
+ * init_surrogate - fit tile models of cell_grid cells in target_grid
+ *
+ *	input : cell_grid - grid whose cells are located
+ *		target_grid - grid they are located in
+ *		order - polynomial order (e.g. surrogate_ORDER)
+ *		tolerance - RMS error allowed in target grid cells
+ *		tile_size - first tile size in cells
+ *		min_tile - smallest tile size to split
+ *
+ *	result: new surrogate_class or NULL
+ *
+ *	note: the tiles of each level are fit in parallel when
+ *	      compiled with OpenMP, tiles that fail are split in
+ *	      order so the result doesn't depend on the thread count
+ *
+ *------------------------------------------------------------------------*/
+surrogate_class *init_surrogate(grid_class *cell_grid,
+				grid_class *target_grid,
+				int order, double tolerance,
+				int tile_size, int min_tile)
+{ int i, j, k, first, last, cols, rows, c1, r1;
+  surrogate_tile *tile;
+  surrogate_class *this;
+
+  if (order < 1 || tolerance <= 0 || min_tile < 1 || tile_size < min_tile)
+  { fprintf(stderr,"surrogate: bad order %d, tolerance %g or tile sizes "
+	    "%d, %d\n", order, tolerance, tile_size, min_tile);
+    return NULL;
+  }
+
+  this = new_surrogate(cell_grid, target_grid, order, tolerance,
+		       tile_size, min_tile);
+  if (!this) return NULL;
+
+  for (i = 0; i < this->tile_rows; i++)
+  { for (j = 0; j < this->tile_cols; j++)
+    { rows = cell_grid->rows - i*tile_size;
+      cols = cell_grid->cols - j*tile_size;
+      if (!add_tile(this, j*tile_size, i*tile_size,
+		    cols < tile_size ? cols : tile_size,
+		    rows < tile_size ? rows : tile_size))
+      { free_surrogate(this); return NULL; }
+    }
+  }
+
+/*
+ *	fit a level of tiles, then split the failures into the next
+ */
+  for (first = 0; first < this->num_tiles; first = last)
+  { last = this->num_tiles;
+
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+    for (k = first; k < last; k++)
+    { this->tile[k].kind = fit_tile(this, this->tile + k)
+	? surrogate_FIT : surrogate_SPLIT;
+    }
+
+    for (k = first; k < last; k++)
+    { tile = this->tile + k;
+      if (surrogate_FIT == tile->kind)
+      { ++this->num_fit;
+	continue;
+      }
+      if (tile->cols <= min_tile && tile->rows <= min_tile)
+      { tile->kind = surrogate_EXACT;
+	++this->num_exact;
+	continue;
+      }
+
+      c1 = tile->cols > min_tile ? (tile->cols + 1) / 2 : tile->cols;
+      r1 = tile->rows > min_tile ? (tile->rows + 1) / 2 : tile->rows;
+      tile->child = this->num_tiles;
+      for (i = 0; i < 2; i++)
+      { rows = 0 == i ? r1 : this->tile[k].rows - r1;
+	for (j = 0; j < 2; j++)
+	{ cols = 0 == j ? c1 : this->tile[k].cols - c1;
+	  if (rows <= 0 || cols <= 0) continue;
+	  if (!add_tile(this, this->tile[k].col0 + (j ? c1 : 0),
+			this->tile[k].row0 + (i ? r1 : 0), cols, rows))
+	  { free_surrogate(this); return NULL; }
+	}
+      }
+      this->tile[k].nchild = this->num_tiles - this->tile[k].child;
+    }
+  }
+
+  return this;
+}
+
+/*------------------------------------------------------------------------
+ * free_surrogate - release resources allocated by init_surrogate
+ *------------------------------------------------------------------------*/
+void free_surrogate(surrogate_class *this)
+{ int k;
+
+  if (!this) return;
+  for (k = 0; k < this->num_tiles; k++)
+  { free_pmodel(this->tile[k].r);
+    free_pmodel(this->tile[k].s);
+  }
+  if (this->tile) free(this->tile);
+  free(this);
+}
+
+static int locate_tile(surrogate_class *this, int k, int row,
+		       double *r, double *s, byte1 *ok, double *x)
+{ int col, i, count;
+  double y, *rp, *sp;
+  surrogate_tile *tile = this->tile + k;
+
+  if (row < tile->row0 || row >= tile->row0 + tile->rows) return 0;
+
+  count = 0;
+  switch (tile->kind)
+  { case surrogate_SPLIT:
+      for (i = 0; i < tile->nchild; i++)
+	count += locate_tile(this, tile->child + i, row, r, s, ok, x);
+      break;
+
+    case surrogate_FIT:
+      for (col = tile->col0; col < tile->col0 + tile->cols; col++)
+	x[col] = (col - center(tile->col0, tile->cols))
+	  / half_width(tile->cols);
+      y = (row - center(tile->row0, tile->rows)) / half_width(tile->rows);
+      rp = r + tile->col0;
+      sp = s + tile->col0;
+      eval_pmodel_grid(tile->r, tile->cols, x + tile->col0, 1, &y, &rp);
+      eval_pmodel_grid(tile->s, tile->cols, x + tile->col0, 1, &y, &sp);
+      for (col = tile->col0; col < tile->col0 + tile->cols; col++)
+      { r[col] = snap_edge(r[col], this->target_grid->cols,
+			    this->tolerance);
+	s[col] = snap_edge(s[col], this->target_grid->rows,
+			    this->tolerance);
+	ok[col] = on_target(this, r[col], s[col]);
+	count += ok[col];
+      }
+      break;
+
+    default:
+      for (col = tile->col0; col < tile->col0 + tile->cols; col++)
+      { ok[col] = exact(this, col, row, r + col, s + col)
+	  && on_target(this, r[col], s[col]);
+	count += ok[col];
+      }
+  }
+
+  return count;
+}
+
+/*------------------------------------------------------------------------
+ * locate_surrogate - target grid location of a row of cells
+ *
+ *	input : this - surrogate_class
+ *		row - cell grid row
+ *
+ *	output: r,s - target grid location of each cell in the row
+ *		ok - TRUE where r,s is on the target grid, the same test
+ *		     as forward_grid
+ *
+ *	result: number of cells on the target grid or -1 on error
+ *
+ *	note: this is not changed, rows can be located in parallel
+ *
+ *------------------------------------------------------------------------*/
+int locate_surrogate(surrogate_class *this, int row,
+		     double *r, double *s, byte1 *ok)
+{ int j, count;
+  double *x;
+
+  if (row < 0 || row >= this->cell_grid->rows) return -1;
+
+  x = (double *)malloc(this->cell_grid->cols * sizeof(double));
+  if (!x) { perror("locate_surrogate"); return -1; }
+
+  count = 0;
+  for (j = 0; j < this->tile_cols; j++)
+  { count += locate_tile(this, (row / this->tile_size) * this->tile_cols + j,
+			 row, r, s, ok, x);
+  }
+
+  free(x);
+  return count;
+}
+
+/*------------------------------------------------------------------------
+ * write_surrogate - save tile models to file
+ *
+ *	input : this - surrogate_class
+ *		fp - file pointer opened for write access
+ *
+ *	result: success status, 0 = failed, 1 = success
+ *
+ *------------------------------------------------------------------------*/
+int write_surrogate(surrogate_class *this, FILE *fp)
+{ int k, head[8], item[7], preamble[2];
+  size_t nvars;
+  char magic[16];
+  surrogate_tile *tile;
+
+  memset(magic, 0, sizeof(magic));
+  memcpy(magic, surrogate_MAGIC, sizeof(surrogate_MAGIC));
+  preamble[0] = surrogate_VERSION;
+  preamble[1] = surrogate_BYTE_ORDER;
+  if (fwrite(magic, sizeof(magic), 1, fp) != 1
+      || fwrite(preamble, sizeof(int), 2, fp) != 2)
+  { perror("surrogate"); return 0; }
+
+  head[0] = this->cell_grid->cols;
+  head[1] = this->cell_grid->rows;
+  head[2] = this->target_grid->cols;
+  head[3] = this->target_grid->rows;
+  head[4] = this->order;
+  head[5] = this->tile_size;
+  head[6] = this->min_tile;
+  head[7] = this->num_tiles;
+  if (fwrite(head, sizeof(int), 8, fp) != 8
+      || fwrite(&this->tolerance, sizeof(double), 1, fp) != 1)
+  { perror("surrogate"); return 0; }
+
+  nvars = (size_t)(this->order + 1) * (this->order + 1);
+  for (k = 0; k < this->num_tiles; k++)
+  { tile = this->tile + k;
+    item[0] = tile->col0;
+    item[1] = tile->row0;
+    item[2] = tile->cols;
+    item[3] = tile->rows;
+    item[4] = tile->kind;
+    item[5] = tile->child;
+    item[6] = tile->nchild;
+    if (fwrite(item, sizeof(int), 7, fp) != 7)
+    { perror("surrogate"); return 0; }
+    if (surrogate_FIT != tile->kind) continue;
+    if (fwrite(tile->r->coef, sizeof(double), nvars, fp) != nvars
+	|| fwrite(tile->s->coef, sizeof(double), nvars, fp) != nvars)
+    { perror("surrogate"); return 0; }
+  }
+
+  return 1;
+}
+
+static void read_error(FILE *fp)
+{
+  if (ferror(fp)) perror("surrogate");
+  else fprintf(stderr,"surrogate: model file is too short\n");
+}
+
+static Polynomial *read_pmodel(int order, FILE *fp)
+{ size_t nvars;
+  Polynomial *P;
+
+  nvars = (size_t)(order + 1) * (order + 1);
+  P = (Polynomial *)calloc(1, sizeof(Polynomial));
+  if (!P) { perror("surrogate"); return NULL; }
+  P->dim = 2;
+  P->order = order;
+  P->tcode = 0;
+  P->coef = (double *)malloc(nvars * sizeof(double));
+  if (!P->coef) { perror("surrogate"); free_pmodel(P); return NULL; }
+  if (fread(P->coef, sizeof(double), nvars, fp) != nvars)
+  { read_error(fp); free_pmodel(P); return NULL; }
+  return P;
+}
+
+/*------------------------------------------------------------------------
+ * check_tiles - is a tile layout read from a file one init_surrogate
+ *		 could have made
+ *
+ *	result: TRUE if first level tile k is at (k % tile_cols,
+ *		k / tile_cols) * tile_size with the same size as
+ *		init_surrogate gives it, every tile is inside the cell
+ *		grid, and a split tile has 1 to 4 later children that
+ *		are inside it
+ *
+ *------------------------------------------------------------------------*/
+static bool check_tiles(surrogate_class *this)
+{ int i, k, first, cols, rows;
+  surrogate_tile *tile, *child;
+
+  first = this->tile_cols * this->tile_rows;
+  if (this->num_tiles < first) return FALSE;
+
+  for (k = 0; k < this->num_tiles; k++)
+  { tile = this->tile + k;
+    if (tile->cols < 1 || tile->rows < 1
+	|| tile->col0 < 0 || tile->col0 > this->cell_grid->cols - tile->cols
+	|| tile->row0 < 0 || tile->row0 > this->cell_grid->rows - tile->rows)
+      return FALSE;
+
+    if (k < first)
+    { cols = this->cell_grid->cols - (k % this->tile_cols) * this->tile_size;
+      rows = this->cell_grid->rows - (k / this->tile_cols) * this->tile_size;
+      if (tile->col0 != (k % this->tile_cols) * this->tile_size
+	  || tile->row0 != (k / this->tile_cols) * this->tile_size
+	  || tile->cols != (cols < this->tile_size ? cols : this->tile_size)
+	  || tile->rows != (rows < this->tile_size ? rows : this->tile_size))
+	return FALSE;
+    }
+
+    if (surrogate_SPLIT != tile->kind) continue;
+    if (tile->child <= k || tile->nchild < 1 || tile->nchild > 4
+	|| tile->child > this->num_tiles - tile->nchild)
+      return FALSE;
+    for (i = 0; i < tile->nchild; i++)
+    { child = this->tile + tile->child + i;
+      if (child->col0 < tile->col0 || child->row0 < tile->row0
+	  || child->col0 + child->cols > tile->col0 + tile->cols
+	  || child->row0 + child->rows > tile->row0 + tile->rows)
+	return FALSE;
+    }
+  }
+
+  return TRUE;
+}
+
+/*------------------------------------------------------------------------
+ * read_surrogate - retrieve tile models from file
+ *
+ *	input : cell_grid, target_grid - grids the models were fit to
+ *		fp - file pointer opened for read access
+ *
+ *	result: surrogate_class or NULL if the file can't be read or
+ *		wasn't made for these grids
+ *
+ *	note: the tile layout is checked before use (see check_tiles),
+ *	      locate_surrogate trusts it to stay inside the cell grid
+ *
+ *------------------------------------------------------------------------*/
+surrogate_class *read_surrogate(grid_class *cell_grid,
+				grid_class *target_grid, FILE *fp)
+{ int k, step, head[8], item[7], preamble[2];
+  char magic[16];
+  double tolerance, r, s, r1, s1, col, row;
+  surrogate_tile *tile;
+  surrogate_class *this;
+
+  if (fread(magic, sizeof(magic), 1, fp) != 1
+      || fread(preamble, sizeof(int), 2, fp) != 2)
+  { fprintf(stderr,"surrogate: not a model file\n");
+    return NULL;
+  }
+  if (memcmp(magic, surrogate_MAGIC, sizeof(surrogate_MAGIC)) != 0
+      || surrogate_VERSION != preamble[0])
+  { fprintf(stderr,"surrogate: not a version %d model file\n",
+	    surrogate_VERSION);
+    return NULL;
+  }
+  if (surrogate_BYTE_ORDER != preamble[1])
+  { fprintf(stderr,"surrogate: model file was written with the other "
+	    "byte order\n");
+    return NULL;
+  }
+
+  if (fread(head, sizeof(int), 8, fp) != 8
+      || fread(&tolerance, sizeof(double), 1, fp) != 1)
+  { read_error(fp); return NULL; }
+
+  if (head[0] != cell_grid->cols || head[1] != cell_grid->rows
+      || head[2] != target_grid->cols || head[3] != target_grid->rows
+      || head[4] < 1 || head[4] > surrogate_MAX_ORDER
+      || head[6] < 1 || head[5] < head[6] || head[7] < 0
+      || head[5] > INT_MAX - head[0] || head[5] > INT_MAX - head[1]
+      || !(tolerance > 0) || tolerance > HUGE_VAL)
+  { fprintf(stderr,"surrogate: model file does not match grids\n");
+    return NULL;
+  }
+
+  this = new_surrogate(cell_grid, target_grid, head[4], tolerance,
+		       head[5], head[6]);
+  if (!this) return NULL;
+
+  for (k = 0; k < head[7]; k++)
+  { if (fread(item, sizeof(int), 7, fp) != 7)
+    { read_error(fp); free_surrogate(this); return NULL; }
+    if (!add_tile(this, item[0], item[1], item[2], item[3]))
+    { free_surrogate(this); return NULL; }
+    tile = this->tile + k;
+    tile->kind = item[4];
+    tile->child = item[5];
+    tile->nchild = item[6];
+    if (tile->kind < surrogate_SPLIT || tile->kind > surrogate_EXACT)
+      break;
+    if (surrogate_FIT == tile->kind)
+    { ++this->num_fit;
+      tile->r = read_pmodel(this->order, fp);
+      if (tile->r) tile->s = read_pmodel(this->order, fp);
+      if (!tile->r || !tile->s) { free_surrogate(this); return NULL; }
+    }
+    else if (surrogate_EXACT == tile->kind)
+    { ++this->num_exact;
+    }
+  }
+  if (k < head[7] || !check_tiles(this))
+  { fprintf(stderr,"surrogate: model file does not match grids\n");
+    free_surrogate(this);
+    return NULL;
+  }
+
+/*
+ *	spot check fit tiles against exact projections
+ */
+  step = this->num_fit / surrogate_CHECK_TILES + 1;
+  for (k = 0; k < this->num_tiles; k += step)
+  { while (k < this->num_tiles && surrogate_FIT != this->tile[k].kind) k++;
+    if (k >= this->num_tiles) break;
+    tile = this->tile + k;
+    col = tile->col0 + tile->cols / 2;
+    row = tile->row0 + tile->rows / 2;
+    r1 = eval_pmodel(tile->r, (col - center(tile->col0, tile->cols))
+		     / half_width(tile->cols),
+		     (row - center(tile->row0, tile->rows))
+		     / half_width(tile->rows));
+    s1 = eval_pmodel(tile->s, (col - center(tile->col0, tile->cols))
+		     / half_width(tile->cols),
+		     (row - center(tile->row0, tile->rows))
+		     / half_width(tile->rows));
+    if (!exact(this, col, row, &r, &s)
+	|| hypot(r - r1, s - s1) > surrogate_CHECK_FACTOR * tolerance)
+    { fprintf(stderr,"surrogate: model file does not match grids\n");
+      free_surrogate(this);
+      return NULL;
+    }
+  }
+
+  return this;
+}
+
+/*------------------------------------------------------------------------
+ * open_surrogate - read tile models from a file or fit and save them
+ *
+ *	input : cell_grid - grid whose cells are located
+ *		target_grid - grid they are located in
+ *		tolerance - RMS error allowed in target grid cells,
+ *			    0 for surrogate_TOLERANCE
+ *		filename - model file or NULL to fit without saving
+ *
+ *	result: surrogate_class or NULL
+ *
+ *	note: an existing model file is used as is, whatever its
+ *	      tolerance, so a model set is fit once and reused
+ *
+ *------------------------------------------------------------------------*/
+surrogate_class *open_surrogate(grid_class *cell_grid,
+				grid_class *target_grid,
+				double tolerance, char *filename)
+{ FILE *fp;
+  surrogate_class *this;
+
+  if (filename)
+  { fp = fopen(filename, "rb");
+    if (fp)
+    { this = read_surrogate(cell_grid, target_grid, fp);
+      fclose(fp);
+      if (!this) fprintf(stderr,"surrogate: error reading %s\n", filename);
+      return this;
+    }
+  }
+
+  this = init_surrogate(cell_grid, target_grid, surrogate_ORDER,
+			tolerance > 0 ? tolerance : surrogate_TOLERANCE,
+			surrogate_TILE, surrogate_MIN_TILE);
+  if (!this || !filename) return this;
+
+  fp = fopen(filename, "wb");
+  if (!fp || !write_surrogate(this, fp))
+  { perror(filename);
+    if (fp) fclose(fp);
+    free_surrogate(this);
+    return NULL;
+  }
+  if (fclose(fp)) { perror(filename); free_surrogate(this); return NULL; }
+
+  return this;
+}
@@ -0,0 +1,78 @@
+/*======================================================================
+ * surrogate - polynomial tile models of one grid's cells in another
+ *
+ * National Snow & Ice Data Center, University of Colorado, Boulder
+ * Copyright (C) 2026 University of Colorado
+ *======================================================================*/
+#ifndef surrogate_h_
+#define surrogate_h_
+
+#include "define.h"
+#include "grids.h"
+#include "pmodel.h"
+
+#ifdef surrogate_c_
+const char surrogate_h_rcsid[]="$Id$";
+#endif
+
+/*
+ *	defaults
+ *
+ *	surrogate_ORDER - polynomial order in each of col and row
+ *	surrogate_TOLERANCE - RMS error allowed, in target grid cells
+ *	surrogate_TILE - first tile size in cells
+ *	surrogate_MIN_TILE - tiles this small are not split again,
+ *			     if they still don't fit they are
+ *			     projected exactly
+ */
+#define surrogate_ORDER 3
+#define surrogate_TOLERANCE 0.01
+#define surrogate_TILE 64
+#define surrogate_MIN_TILE 8
+
+/*
+ *	tile kinds
+ */
+#define surrogate_SPLIT 0	/* split into the children */
+#define surrogate_FIT 1		/* r and s models fit */
+#define surrogate_EXACT 2	/* projected exactly */
+
+typedef struct
+{ int col0, row0, cols, rows;	/* cells of the tile in the cell grid */
+  int kind;
+  int child, nchild;		/* children of a split tile */
+  Polynomial *r, *s;		/* target r,s at normalized col,row */
+} surrogate_tile;
+
+typedef struct
+{ grid_class *cell_grid;	/* grid whose cells are modeled */
+  grid_class *target_grid;	/* grid whose r,s are modeled */
+  int order;
+  double tolerance;
+  int tile_size, min_tile;
+  int tile_cols, tile_rows;	/* first level tiles, row by row */
+  surrogate_tile *tile;		/* first level tiles then children */
+  int num_tiles, max_tiles;
+  int num_fit, num_exact;	/* leaf tiles of each kind */
+} surrogate_class;
+
+surrogate_class *init_surrogate(grid_class *cell_grid,
+				grid_class *target_grid,
+				int order, double tolerance,
+				int tile_size, int min_tile);
+
+int locate_surrogate(surrogate_class *this, int row,
+		     double *r, double *s, byte1 *ok);
+
+int write_surrogate(surrogate_class *this, FILE *fp);
+
+surrogate_class *read_surrogate(grid_class *cell_grid,
+				grid_class *target_grid, FILE *fp);
+
+surrogate_class *open_surrogate(grid_class *cell_grid,
+				grid_class *target_grid,
+				double tolerance, char *filename);
+
+void free_surrogate(surrogate_class *this);
+
+#endif
@@ -7,16 +7,30 @@
  *========================================================================*/
 static const char ungrid_c_rcsid[] = "$Id$";
 
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <signal.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
 #include "define.h"
 #include "matrix.h"
 #include "grids.h"
+#include "cubic.h"
+#include "point_io.h"
 
 #define usage									\
-"usage: ungrid [-v] [-V] [-b] [-e] [-i fill] [-n min_value] [-x max_value]\n"	\
+"usage: ungrid [-v] [-V] [-b] [-E] [-e] [-i fill] [-n min_value] [-x max_value]\n"	\
 "              [-B] [-U] [-S] [-L] [-F]\n"                                      \
 "              [-c method] [-r radius] [-p power]\n"				\
-"              [-C] [-I] [-R lat_min lat_max lon_min lon_max]\n"                \
-"              from_gpd from_data\n"						\
+"              [-C] [-I] [-R lat_min lat_max lon_min lon_max] [-P npts]\n"     \
+"              [-Q socket_path] from_gpd from_data\n"			\
+"       ungrid [-v] -s socket_path\n"						\
 "\n"										\
 " input : from.gpd  - source grid parameters definition file\n"			\
 "         from_data - source gridded data file (4 byte floats)\n"		\
@@ -28,10 +42,12 @@ static const char ungrid_c_rcsid[] = "$Id$";
 " option: v - verbose\n"							\
 "         V - print version information to stderr\n"                            \
 "         b - binary float stdin and stdout (default is ASCII) \n"		\
+"             Each input point is a float64 lat and float64 lon.\n"		\
 "             Note: the input grid (from_data) is always binary.\n"		\
 "             If binary is set, the location is not echoed to\n"		\
 "             the output but the data values are written in the\n"		\
 "             same order as the input points.\n"			\
+"         E - binary input points are big-endian (default is native)\n"	\
 "         e - If binary is not set, then output ASCII in exponential (%15.8e)\n"\
 "             format (default is %f). If binary is set, then -e is ignored.\n"  \
 "         i fill - fill value for missing data (default = 0)\n"			\
@@ -58,10 +74,101 @@ static const char ungrid_c_rcsid[] = "$Id$";
 "         R lat_min lat_max lon_min lon_max - specifies latitude and longitude\n"\
 "           ranges for which output is desired.\n"                              \
 "           Note: If -C is not specified, then -R is ignored.\n"                \
+"         P npts - batch mode: read up to npts points at a time, sample them\n"  \
+"           in the order of their source cells and write the results in\n"     \
+"           the original input order.\n"                                    \
+"           Note: If -C is specified, then -P is ignored.\n"                   \
+"         Q socket_path - send the points to the ungrid server listening\n"  \
+"           on socket_path instead of loading the grid here. All other\n"    \
+"           options have their usual meaning, except -C.\n"                  \
+"         s socket_path - server mode: listen on the Unix domain socket\n"   \
+"           socket_path and answer ungrid -Q queries. Grids stay loaded\n"   \
+"           until their .gpd or data file changes, up to 8 grids,\n"       \
+"           dropping the least recently used. One client per processor\n" \
+"           is served at a time, idle connections close after 60 s.\n"    \
 "\n"
 
 static int verbose = 0;
 
+/*
+ * server protocol, native byte order over a Unix domain socket
+ *
+ *   client -> server: struct serve_request, npts x (float64 lat, lon)
+ *   server -> client: struct serve_reply, npts x float32 value
+ *
+ * a connection may carry any number of requests
+ */
+#define SERVE_MAGIC 0x556e6772
+#define SERVE_CHUNK 65536
+#define SERVE_MAX_POINTS (1<<24)
+#define SERVE_MAX_THREADS 64
+#define SERVE_MAX_GRIDS 8
+#define SERVE_IDLE_SECONDS 60
+
+/*
+ * flags for the source grid, rows are read in order and sampled
+ * by any thread so first touch placement doesn't help
+ */
+#define MATRIX_FLAGS (matrix_ZERO|matrix_PAD|matrix_HUGEPAGE)
+
+struct serve_request {
+  int magic;
+  int npts;
+  int method;
+  int bytes_per_cell;
+  int unsigned_data;
+  int float_data;
+  int min_set;
+  int max_set;
+  float min_value;
+  float max_value;
+  float fill_value;
+  float shell_radius;
+  float power;
+  char gpd_filename[FILENAME_MAX];
+  char data_filename[FILENAME_MAX];
+};
+
+struct serve_reply {
+  int magic;
+  int status;
+  int npts;
+  char message[MAX_STRING];
+};
+
+/*
+ * server grid cache entry, shared by all requests for the same
+ * files and data format
+ */
+struct grid_cache {
+  char gpd_filename[FILENAME_MAX];
+  char data_filename[FILENAME_MAX];
+  struct stat gpd_stat;
+  struct stat data_stat;
+  bool float_data;
+  int bytes_per_cell;
+  bool unsigned_data;
+  grid_class *grid;
+  float **from_data;
+  int refs;
+  unsigned long last_used;
+  bool loading;
+  bool stale;
+  struct grid_cache *next;
+};
+
+static struct grid_cache *cache_list = NULL;
+static pthread_mutex_t cache_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t cache_loaded = PTHREAD_COND_INITIALIZER;
+static unsigned long cache_clock = 0;
+
+/*
+ * init_grid and close_grid are not reentrant (mapx keeps the
+ * standardized projection name in a static buffer)
+ */
+static pthread_mutex_t grid_init_lock = PTHREAD_MUTEX_INITIALIZER;
+static int listen_fd = -1;
+
 struct interp_control {
   grid_class *grid;
   bool do_binary;
@@ -82,6 +189,16 @@ struct interp_control {
   float lat_max;
   float lon_min;
   float lon_max;
+  int batch_size;
+  point_io_class *points;
+};
+
+/*
+ * batch mode sort record, source cell key and input position
+ */
+struct sample_order {
+  NSIDCbyte8 key;
+  int index;
 };
 
 static int cubic(float *value, float **from_data, double r, double s, 
@@ -96,10 +213,37 @@ static int distance(float *value, float **from_data, double r, double s,
 		    struct interp_control *control);
 static int read_row(float *row_from_data, FILE *from_file, void *row_buf,
 		    struct interp_control *control);
+static void convert_row(float *row_from_data, void *row_buf,
+			struct interp_control *control);
 static int process_row_use_center(float *row_from_data, int row,
 				  struct interp_control *control);
 static int write_point(double to_lat, double to_lon, float value,
 		       struct interp_control *control);
+static int process_batch(float **from_data, int (*interpolate)(),
+			 char method, struct interp_control *control);
+static int sample_points(float **from_data, int (*interpolate)(),
+			 char method, struct interp_control *control,
+			 int npts, double *lat, double *lon, float *value);
+static NSIDCbyte8 morton_key(int col, int row);
+static int serve(char *socket_path);
+static void *serve_worker(void *arg);
+static int answer_request(int fd);
+static struct grid_cache *get_grid_cache(struct serve_request *request,
+					 char *message);
+static int load_grid_cache(struct grid_cache *entry, char *message);
+static bool same_file_version(struct stat *a, struct stat *b);
+static void release_grid_cache(struct grid_cache *entry);
+static void free_grid_cache(struct grid_cache *entry);
+static void trim_grid_cache(void);
+static int query_server(char *socket_path, char *gpd_filename,
+			char *data_filename, char method,
+			struct interp_control *control);
+static int connect_server(char *socket_path);
+static int exchange_request(int fd, struct serve_request *request,
+			    double *pair, struct serve_reply *reply);
+static int read_full(int fd, void *buf, size_t n);
+static int write_full(int fd, void *buf, size_t n);
+static int compare_sample_order(const void *a, const void *b);
 static char possible_methods[] = "NDBCI";
 
 static int (*method_function[])()  = { nearest,
@@ -116,14 +260,13 @@ static char *method_string[] = { "nearest-neighbor",
 
 
 int main(int argc, char *argv[]) { 
-  int io_err, status, method_number, line_num, row;
+  int io_err, status, method_number, line_num, row, point_flags;
   double to_lat, to_lon;
   double from_r, from_s;
   float **from_data;
   float value;
   char *option, *position;
   char method;
-  char readln[MAX_STRING];
   char from_filename[FILENAME_MAX];
   FILE *from_file;
   int (*interpolate)();
@@ -132,6 +275,7 @@ int main(int argc, char *argv[]) {
   int row_to_store;
   int points_processed;
   void *row_buf;
+  char *serve_path, *query_path;
 
 /*
  * set defaults
@@ -152,6 +296,10 @@ int main(int argc, char *argv[]) {
   control.lon_max = 180;
   control.do_binary = FALSE;
   control.do_exponential = FALSE;
+  control.batch_size = 0;
+  point_flags = 0;
+  serve_path = NULL;
+  query_path = NULL;
   method = 'N';
 
 /* 
@@ -166,6 +314,19 @@ int main(int argc, char *argv[]) {
 	case 'b':
 	  control.do_binary = TRUE;
 	  break;
+	case 'E':
+	  point_flags |= point_io_BIG_ENDIAN;
+	  break;
+	case 's':
+	  ++argv; --argc;
+	  if (argc <= 0) error_exit(usage);
+	  serve_path = *argv;
+	  break;
+	case 'Q':
+	  ++argv; --argc;
+	  if (argc <= 0) error_exit(usage);
+	  query_path = *argv;
+	  break;
         case 'e':
           control.do_exponential = TRUE;
           break;
@@ -232,6 +393,11 @@ int main(int argc, char *argv[]) {
 	  ++argv; --argc;
 	  if (sscanf(*argv, "%f", &(control.lon_max)) != 1) error_exit(usage);
 	  break;
+        case 'P':
+	  ++argv; --argc;
+	  if (sscanf(*argv, "%d", &(control.batch_size)) != 1) error_exit(usage);
+	  if (control.batch_size < 1) error_exit(usage);
+	  break;
 	default:
 	  fprintf(stderr,"invalid option %c\n", *option);
 	  error_exit(usage);
@@ -276,11 +442,34 @@ int main(int argc, char *argv[]) {
   method_number = position - possible_methods;
   interpolate = method_function[method_number];
 
+/*
+ * server mode
+ */
+  if (serve_path) {
+    if (argc != 0) error_exit(usage);
+    exit(serve(serve_path));
+  }
+
 /*
  * get command line arguments
  */
   if (argc != 2) error_exit(usage);
 
+/*
+ * client mode
+ */
+  if (query_path) {
+    if (control.use_center) error_exit("ungrid: -C can not be used with -Q");
+    if (control.do_binary) point_flags |= point_io_BINARY;
+    control.points = init_point_io(NULL, point_flags);
+    if (!control.points) error_exit("ungrid: ABORTING");
+    points_processed = query_server(query_path, argv[0], argv[1],
+				    method, &control);
+    if (points_processed < 0) error_exit("ungrid: ABORTING");
+    if (verbose) fprintf(stderr,"> %d points processed\n", points_processed);
+    exit(EXIT_SUCCESS);
+  }
+
   control.grid = init_grid(*argv);
   if (!control.grid) error_exit("ungrid: ABORTING");
   ++argv; --argc;
@@ -327,8 +516,8 @@ int main(int argc, char *argv[]) {
   if (!row_buf) { error_exit("ungrid: ABORTING"); }
 
   rows_in_from_data = control.use_center ? 1 : control.grid->rows;
-  from_data = (float **)matrix(rows_in_from_data, control.grid->cols,
-			       sizeof(float), TRUE);
+  from_data = (float **)matrix_aligned(rows_in_from_data, control.grid->cols,
+				       sizeof(float), MATRIX_FLAGS);
   if (!from_data) { error_exit("ungrid: ABORTING"); }
 
   points_processed = 0;
@@ -337,7 +526,7 @@ int main(int argc, char *argv[]) {
     status = read_row(from_data[row_to_store], from_file, row_buf, &control);
     if (status != control.grid->cols) {
       perror(from_filename);
-      free(from_data);
+      free_matrix_aligned((void **)from_data);
       error_exit("ungrid: ABORTING");
     }
     /*
@@ -349,31 +538,39 @@ int main(int argc, char *argv[]) {
 	process_row_use_center(from_data[row_to_store], row, &control);
   }
 
+  if (!control.use_center) {
+    if (control.do_binary) point_flags |= point_io_BINARY;
+    control.points = init_point_io(NULL, point_flags);
+    if (!control.points) error_exit("ungrid: ABORTING");
+  }
+
+/*
+ * batch mode
+ */
+  if (!control.use_center && control.batch_size > 0) {
+    if (verbose) fprintf(stderr,"> Batch size:\t%d\n", control.batch_size);
+    points_processed = process_batch(from_data, interpolate, method, &control);
+    if (verbose) fprintf(stderr,"> %d points processed\n", points_processed);
+    exit(EXIT_SUCCESS);
+  }
+
 /*
  * loop through input points
  */
-  for (line_num = 1; !control.use_center && !feof(stdin); line_num++) {
+  while (!control.use_center) {
 
 /*
  * read a point
  */
-    if (control.do_binary) {
-      fread(&to_lat, sizeof(to_lat), 1, from_file);
-      fread(&to_lon, sizeof(to_lon), 1, from_file);
-      io_err = ferror(from_file);
-    } else {
-      fgets(readln, MAX_STRING, stdin);
-      io_err = (sscanf(readln, "%lf %lf", &to_lat, &to_lon) != 2);
-    }
+    status = read_point_io(control.points, &to_lat, &to_lon, NULL);
+    if (0 == status) break;
+    line_num = control.points->line_num;
 
-    if (io_err != 0) { 
+    if (status < 0) { 
       fprintf(stderr, "ungrid: error reading lat/lon at line %i\n", line_num);
-      if (control.do_binary) error_exit("ungrid: ABORTING");
       continue;
     }
 
-    if (feof(stdin)) break;
-
 /*
  * extract data from grid
  */
@@ -406,83 +603,244 @@ int main(int argc, char *argv[]) {
     points_processed++;
   }
 
+  if (!control.use_center) close_point_io(control.points);
+
   if (verbose) fprintf(stderr,"> %d points processed\n", points_processed);
 
   exit(EXIT_SUCCESS);
 }
 
 /*------------------------------------------------------------------------
- * cubic - cubic convolution
+ * process_batch - sample input points a chunk at a time
  *
  *	input : from_data - pointer to input data array
- *              r, s - column, row coordinates within input grid
+ *              interpolate - interpolation method function
+ *              method - interpolation method letter
  *              control - control parameter structure
  *
- *	output: value - data value interpolated to r,s
+ *	output: none.
  *
- *	result: number of valid points sampled
+ *	result: number of points processed
  *
  *------------------------------------------------------------------------*/
-static int cubic(float *value, float **from_data, double r, double s, 
-		 struct interp_control *control) {
-  int col, row, npts;
-  double dr, ds, ccr[4], ccs[4], ccr_col, ccs_row;
-  double weight, value_sum, weight_sum;
- 
-/*
- * get cubic coefficients
- */
-  dr = r - (int)r;
-  ds = s - (int)s;
+static int process_batch(float **from_data, int (*interpolate)(),
+			 char method, struct interp_control *control) {
+  int i, npts, io_err;
+  int points_processed = 0;
+  int chunk = control->batch_size;
+  double *lat, *lon;
+  float *value;
+
+  lat = (double *)calloc(chunk, sizeof(double));
+  lon = (double *)calloc(chunk, sizeof(double));
+  value = (float *)calloc(chunk, sizeof(float));
+  if (!lat || !lon || !value) {
+    perror("process_batch");
+    error_exit("ungrid: ABORTING");
+  }
 
-  ccr[0] = -dr*(1-dr)*(1-dr);
-  ccr[1] = (1 - 2*dr*dr + dr*dr*dr);
-  ccr[2] = dr*(1 + dr - dr*dr);
-  ccr[3] = -dr*dr*(1-dr);
+  while ((npts = read_points_io(control->points, chunk, lat, lon, NULL)) > 0) {
 
-  ccs[0] = -ds*(1-ds)*(1-ds);
-  ccs[1] = (1 - 2*ds*ds + ds*ds*ds);
-  ccs[2] = ds*(1 + ds - ds*ds);
-  ccs[3] = -ds*ds*(1-ds);
+    if (sample_points(from_data, interpolate, method, control,
+		      npts, lat, lon, value) < 0)
+      error_exit("ungrid: ABORTING");
 
-  value_sum = 0.;
-  weight_sum = 0.;
-  npts = 0;
+    for (i = 0; i < npts; i++) {
+      io_err = write_point(lat[i], lon[i], value[i], control);
+      if (io_err != 0) {
+	perror("writing to stdout");
+	fprintf(stderr, "ungrid: point %d\n", points_processed + 1);
+      }
+      points_processed++;
+    }
+  }
+
+  free(lat); free(lon); free(value);
+
+  return points_processed;
+}
+
+/*------------------------------------------------------------------------
+ * sample_points - interpolate the grid at an array of points
+ *
+ *	input : from_data - pointer to input data array
+ *              interpolate - interpolation method function
+ *              method - interpolation method letter
+ *              control - control parameter structure
+ *              npts - number of points
+ *              lat, lon - point locations
+ *
+ *	output: value - interpolated value for each point, fill value
+ *                      for points off the grid
+ *
+ *	result: npts or -1 if out of memory
+ *
+ *      note: the points are projected with forward_grid_array, then
+ *            sorted by the Morton order of the nearest source cell so
+ *            that neighboring points touch neighboring memory. The
+ *            samples are taken in that order (in parallel when compiled
+ *            with OpenMP) and scattered back to input order.
+ *
+ *------------------------------------------------------------------------*/
+static int sample_points(float **from_data, int (*interpolate)(),
+			 char method, struct interp_control *control,
+			 int npts, double *lat, double *lon, float *value) {
+  int i, k, nsort, status;
+  double *r, *s, *sorted_r, *sorted_s;
+  float *sorted_value;
+  int *on_grid;
+  struct sample_order *order;
+
+  if (npts < 1) return 0;
+
+  r = (double *)calloc(npts, sizeof(double));
+  s = (double *)calloc(npts, sizeof(double));
+  sorted_r = (double *)calloc(npts, sizeof(double));
+  sorted_s = (double *)calloc(npts, sizeof(double));
+  sorted_value = (float *)calloc(npts, sizeof(float));
+  on_grid = (int *)calloc(npts, sizeof(int));
+  order = (struct sample_order *)calloc(npts, sizeof(struct sample_order));
+  if (!r || !s || !sorted_r || !sorted_s
+      || !sorted_value || !on_grid || !order) {
+    perror("sample_points");
+    status = -1;
+    goto done;
+  }
 
 /*
- * interpolated value is weighted sum of sixteen surrounding samples
+ * project the whole array and sort the on-grid points by source cell
  */
-  for (row = (int)s - 1; row <= (int)s + 2; row++) {
-    if (row < 0 || row >= control->grid->rows ) continue;
+  forward_grid_array(control->grid, npts, lat, lon, r, s, on_grid);
 
-    ccs_row = ccs[row - ((int)s - 1)];
+  for (i = 0, nsort = 0; i < npts; i++) {
+    value[i] = control->fill_value;
+    if (!on_grid[i]) {
+      if (verbose >= 2) 
+	fprintf(stderr,">> lat/lon %f %f is off the grid\n", lat[i], lon[i]);
+      continue;
+    }
+    order[nsort].key = morton_key(nint(r[i]), nint(s[i]));
+    order[nsort].index = i;
+    ++nsort;
+  }
 
-    for (col = (int)r - 1; col <= (int)r + 2; col++) {
-      if (col < 0 || col >= control->grid->cols) continue;
+  qsort(order, nsort, sizeof(struct sample_order), compare_sample_order);
 
-      if (control->max_set && control->max_value < from_data[row][col]) continue;
-      if (control->min_set && control->min_value > from_data[row][col]) continue;
+  for (k = 0; k < nsort; k++) {
+    sorted_r[k] = r[order[k].index];
+    sorted_s[k] = s[order[k].index];
+  }
 
-      ccr_col = ccr[col - ((int)r - 1)];
+/*
+ * sample in sorted order
+ */
+  if ('C' == method) {
+    cubic_mask mask;
 
-      weight = ccs_row*ccr_col;
+    mask.ignore_fill = FALSE;
+    mask.min_set = control->min_set;
+    mask.min_value = control->min_value;
+    mask.max_set = control->max_set;
+    mask.max_value = control->max_value;
 
-      value_sum += weight*from_data[row][col];
-      weight_sum += weight;
-      ++npts;
-    }
-  }
+    eval_cubic_array(from_data, control->grid->rows, control->grid->cols,
+		     nsort, sorted_r, sorted_s, &mask,
+		     control->fill_value, sorted_value, NULL);
 
-  if (npts > 0) {
-    *value = value_sum;
-    if (weight_sum != 0) *value /= weight_sum;
   } else {
-    *value = control->fill_value;
+
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+    for (k = 0; k < nsort; k++) {
+      interpolate(&sorted_value[k], from_data, sorted_r[k], sorted_s[k],
+		  control);
+    }
   }
 
-  return npts;
+/*
+ * scatter back to input order
+ */
+  for (k = 0; k < nsort; k++)
+    value[order[k].index] = sorted_value[k];
+
+  status = npts;
+
+ done:
+  free(r); free(s);
+  free(sorted_r); free(sorted_s);
+  free(sorted_value);
+  free(on_grid); free(order);
+
+  return status;
 }
-
+
+/*------------------------------------------------------------------------
+ * morton_key - interleave the bits of a column and row
+ *
+ *	input : col, row - source cell
+ *
+ *	result: Z-order key, cells close together in the grid have
+ *              keys close together
+ *
+ *------------------------------------------------------------------------*/
+static NSIDCbyte8 spread_bits(NSIDCbyte8 x) {
+  x &= 0xffffffffULL;
+  x = (x | (x << 16)) & 0x0000ffff0000ffffULL;
+  x = (x | (x << 8))  & 0x00ff00ff00ff00ffULL;
+  x = (x | (x << 4))  & 0x0f0f0f0f0f0f0f0fULL;
+  x = (x | (x << 2))  & 0x3333333333333333ULL;
+  x = (x | (x << 1))  & 0x5555555555555555ULL;
+  return x;
+}
+
+static NSIDCbyte8 morton_key(int col, int row) {
+  if (col < 0) col = 0;
+  if (row < 0) row = 0;
+  return spread_bits((NSIDCbyte8)col) | (spread_bits((NSIDCbyte8)row) << 1);
+}
+
+/*------------------------------------------------------------------------
+ * compare_sample_order - qsort comparison on source cell key
+ *                        ties keep input order
+ *------------------------------------------------------------------------*/
+static int compare_sample_order(const void *a, const void *b) {
+  const struct sample_order *pa = a, *pb = b;
+
+  if (pa->key < pb->key) return -1;
+  if (pa->key > pb->key) return 1;
+  return pa->index - pb->index;
+}
+
+/*------------------------------------------------------------------------
+ * cubic - cubic convolution
+ *
+ *	input : from_data - pointer to input data array
+ *              r, s - column, row coordinates within input grid
+ *              control - control parameter structure
+ *
+ *	output: value - data value interpolated to r,s
+ *
+ *	result: number of valid points sampled
+ *
+ *------------------------------------------------------------------------*/
+static int cubic(float *value, float **from_data, double r, double s, 
+		 struct interp_control *control) {
+  cubic_mask mask;
+
+  mask.ignore_fill = FALSE;
+  mask.min_set = control->min_set;
+  mask.min_value = control->min_value;
+  mask.max_set = control->max_set;
+  mask.max_value = control->max_value;
+
+/*
+ * interpolated value is weighted sum of sixteen surrounding samples
+ */
+  return eval_cubic(from_data, control->grid->rows, control->grid->cols,
+		    r, s, &mask, control->fill_value, value);
+}
+
 /*------------------------------------------------------------------------
  * average - weighted average within a radius
  *
@@ -701,10 +1059,27 @@ static int distance(float *value, float **from_data, double r, double s,
 static int read_row(float *row_from_data, FILE *from_file, void *row_buf,
 		    struct interp_control *control) {
   int status;
-  int col;
 
   status = fread(row_buf, control->bytes_per_cell,
 		 control->grid->cols, from_file);
+  convert_row(row_from_data, row_buf, control);
+
+  return status;
+}
+
+/*------------------------------------------------------------------------
+ * convert_row - convert a row of input data to floating-point
+ *
+ *	input : row_buf - row of input data as stored in the file
+ *              control - control parameter structure
+ *
+ *	output: row_from_data - row of float data
+ *
+ *------------------------------------------------------------------------*/
+static void convert_row(float *row_from_data, void *row_buf,
+			struct interp_control *control) {
+  int col;
+
   for (col = 0; col < control->grid->cols; col++) {
     if (control->float_data) {
       row_from_data[col] = ((float *)(row_buf))[col];
@@ -728,8 +1103,6 @@ static int read_row(float *row_from_data, FILE *from_file, void *row_buf,
       }
     }
   }
-
-  return status;
 }
 
 /*------------------------------------------------------------------------
@@ -814,3 +1187,687 @@ static int write_point(double to_lat, double to_lon, float value,
 
   return io_err;
 }
+
+/*------------------------------------------------------------------------
+ * read_full, write_full - transfer exactly n bytes on a socket
+ *
+ *	result: 0 on success, -1 on error or end of file
+ *
+ *      note: a closed peer is an error, not SIGPIPE, so a client
+ *            can reconnect after the server drops an idle connection
+ *
+ *------------------------------------------------------------------------*/
+static int read_full(int fd, void *buf, size_t n) {
+  ssize_t nread;
+  char *bufp = (char *)buf;
+
+  while (n > 0) {
+    nread = read(fd, bufp, n);
+    if (nread < 0 && EINTR == errno) continue;
+    if (nread <= 0) return -1;
+    bufp += nread;
+    n -= nread;
+  }
+  return 0;
+}
+
+static int write_full(int fd, void *buf, size_t n) {
+  ssize_t nwritten;
+  char *bufp = (char *)buf;
+
+  while (n > 0) {
+    nwritten = send(fd, bufp, n, MSG_NOSIGNAL);
+    if (nwritten < 0 && EINTR == errno) continue;
+    if (nwritten <= 0) return -1;
+    bufp += nwritten;
+    n -= nwritten;
+  }
+  return 0;
+}
+
+/*------------------------------------------------------------------------
+ * serve - answer batch queries on a Unix domain socket
+ *
+ *	input : socket_path - name of socket to create
+ *
+ *	result: EXIT_FAILURE if the socket could not be set up,
+ *              otherwise runs until killed
+ *
+ *      note: one worker thread per processor accepts connections and
+ *            answers requests on them until the client closes or is
+ *            idle for SERVE_IDLE_SECONDS, so at most that many clients
+ *            are served at once. Grids are loaded on first use and
+ *            shared by all workers, at most SERVE_MAX_GRIDS are kept
+ *            and the least recently used unreferenced grid is dropped
+ *            to make room.
+ *
+ *------------------------------------------------------------------------*/
+static int serve(char *socket_path) {
+  int i, nthreads;
+  struct sockaddr_un addr;
+  struct stat socket_stat;
+  pthread_t thread[SERVE_MAX_THREADS];
+
+  if (strlen(socket_path) >= sizeof(addr.sun_path)) {
+    fprintf(stderr, "ungrid: socket path %s is too long\n", socket_path);
+    return EXIT_FAILURE;
+  }
+
+  signal(SIGPIPE, SIG_IGN);
+
+  listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (listen_fd < 0) { perror("socket"); return EXIT_FAILURE; }
+
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  strcpy(addr.sun_path, socket_path);
+
+/*
+ *	only replace a stale socket, never some other file
+ */
+  if (lstat(socket_path, &socket_stat) == 0) {
+    if (!S_ISSOCK(socket_stat.st_mode)) {
+      fprintf(stderr, "ungrid: %s exists and is not a socket\n",
+	      socket_path);
+      close(listen_fd);
+      return EXIT_FAILURE;
+    }
+    unlink(socket_path);
+  }
+
+  if (bind(listen_fd, (struct sockaddr *)&addr, sizeof(addr)) != 0
+      || listen(listen_fd, SOMAXCONN) != 0) {
+    perror(socket_path);
+    close(listen_fd);
+    return EXIT_FAILURE;
+  }
+
+  nthreads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+  if (nthreads < 1) nthreads = 1;
+  if (nthreads > SERVE_MAX_THREADS) nthreads = SERVE_MAX_THREADS;
+
+  if (verbose) {
+    fprintf(stderr,"> Socket:\t%s\n", socket_path);
+    fprintf(stderr,"> Workers:\t%d\n", nthreads);
+  }
+
+  for (i = 0; i < nthreads; i++) {
+    if (pthread_create(&thread[i], NULL, serve_worker, NULL) != 0) {
+      perror("pthread_create");
+      if (0 == i) return EXIT_FAILURE;
+      nthreads = i;
+      break;
+    }
+  }
+
+  for (i = 0; i < nthreads; i++) pthread_join(thread[i], NULL);
+
+  close(listen_fd);
+  unlink(socket_path);
+
+  return EXIT_SUCCESS;
+}
+
+/*------------------------------------------------------------------------
+ * serve_worker - accept connections and answer their requests
+ *------------------------------------------------------------------------*/
+static void *serve_worker(void *arg) {
+  int fd;
+  struct timeval idle;
+
+  for (;;) {
+    fd = accept(listen_fd, NULL, NULL);
+    if (fd < 0) {
+      if (EINTR == errno || ECONNABORTED == errno) continue;
+      perror("accept");
+      break;
+    }
+    idle.tv_sec = SERVE_IDLE_SECONDS;
+    idle.tv_usec = 0;
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &idle, sizeof(idle));
+    while (0 == answer_request(fd))
+      ;
+    close(fd);
+  }
+
+  return NULL;
+}
+
+/*------------------------------------------------------------------------
+ * answer_request - read one request from a client and reply to it
+ *
+ *	input : fd - connected socket
+ *
+ *	result: 0 if the connection can take another request,
+ *              -1 at end of file or on a protocol error
+ *
+ *------------------------------------------------------------------------*/
+static int answer_request(int fd) {
+  int i, method_number, status;
+  char *position;
+  double *pair, *lat, *lon;
+  float *value;
+  struct serve_request request;
+  struct serve_reply reply;
+  struct interp_control control;
+  struct grid_cache *entry;
+
+  if (read_full(fd, &request, sizeof(request)) != 0) return -1;
+  if (SERVE_MAGIC != request.magic
+      || request.npts < 0 || request.npts > SERVE_MAX_POINTS) {
+    if (verbose) fprintf(stderr,"> bad request header\n");
+    return -1;
+  }
+  request.gpd_filename[FILENAME_MAX-1] = '\0';
+  request.data_filename[FILENAME_MAX-1] = '\0';
+
+  memset(&reply, 0, sizeof(reply));
+  reply.magic = SERVE_MAGIC;
+  reply.npts = request.npts;
+
+  pair = (double *)malloc(2*request.npts*sizeof(double) + 1);
+  lat = (double *)malloc(request.npts*sizeof(double) + 1);
+  lon = (double *)malloc(request.npts*sizeof(double) + 1);
+  value = (float *)malloc(request.npts*sizeof(float) + 1);
+  if (!pair || !lat || !lon || !value) {
+    free(pair); free(lat); free(lon); free(value);
+    perror("answer_request");
+    return -1;
+  }
+
+  if (read_full(fd, pair, 2*request.npts*sizeof(double)) != 0) {
+    free(pair); free(lat); free(lon); free(value);
+    return -1;
+  }
+
+  if (verbose >= 2)
+    fprintf(stderr,">> %d points from %s\n",
+	    request.npts, request.data_filename);
+
+  entry = NULL;
+  position = strchr(possible_methods, request.method);
+  if (0 == request.method || !position) {
+    reply.status = 1;
+    sprintf(reply.message, "method %c not in [%s]",
+	    request.method, possible_methods);
+  } else {
+    entry = get_grid_cache(&request, reply.message);
+    if (!entry) reply.status = 1;
+  }
+
+  if (entry) {
+    memset(&control, 0, sizeof(control));
+    control.grid = entry->grid;
+    control.min_set = request.min_set;
+    control.min_value = request.min_value;
+    control.max_set = request.max_set;
+    control.max_value = request.max_value;
+    control.fill_value = request.fill_value;
+    control.shell_radius = request.shell_radius;
+    control.power = request.power;
+
+    for (i = 0; i < request.npts; i++) {
+      lat[i] = pair[2*i];
+      lon[i] = pair[2*i+1];
+    }
+
+    method_number = position - possible_methods;
+    status = sample_points(entry->from_data, method_function[method_number],
+			   (char)request.method, &control,
+			   request.npts, lat, lon, value);
+    if (status < 0) {
+      reply.status = 1;
+      strcpy(reply.message, "server out of memory");
+    }
+    release_grid_cache(entry);
+  }
+
+  if (0 != reply.status) reply.npts = 0;
+  status = write_full(fd, &reply, sizeof(reply));
+  if (0 == status && reply.npts > 0)
+    status = write_full(fd, value, reply.npts*sizeof(float));
+
+  free(pair); free(lat); free(lon); free(value);
+
+  return status;
+}
+
+/*------------------------------------------------------------------------
+ * get_grid_cache - find or load the grid named in a request
+ *
+ *	input : request - client request
+ *
+ *	output: message - reason for failure
+ *
+ *	result: cache entry, held until release_grid_cache,
+ *              or NULL on failure
+ *
+ *      note: an entry is reused while both files are unchanged, see
+ *            same_file_version. A new entry is put in the list marked
+ *            loading and loaded without the lock, so other grids can
+ *            be served meanwhile, requests for the same grid wait for
+ *            the load to finish.
+ *
+ *------------------------------------------------------------------------*/
+static struct grid_cache *get_grid_cache(struct serve_request *request,
+					 char *message) {
+  struct stat gpd_stat, data_stat;
+  struct grid_cache *entry, **link;
+  bool float_data = request->float_data;
+  int bytes_per_cell = float_data ? 4 : request->bytes_per_cell;
+  bool unsigned_data = float_data ? FALSE : request->unsigned_data;
+
+  if (stat(request->gpd_filename, &gpd_stat) != 0
+      || stat(request->data_filename, &data_stat) != 0) {
+    sprintf(message, "can't stat %.100s or %.100s",
+	    request->gpd_filename, request->data_filename);
+    return NULL;
+  }
+
+  if (1 != bytes_per_cell && 2 != bytes_per_cell && 4 != bytes_per_cell) {
+    sprintf(message, "bad bytes per cell %d", bytes_per_cell);
+    return NULL;
+  }
+
+  pthread_mutex_lock(&cache_lock);
+
+ search:
+  for (link = &cache_list; *link; ) {
+    entry = *link;
+    if (!streq(entry->gpd_filename, request->gpd_filename)
+	|| !streq(entry->data_filename, request->data_filename)
+	|| entry->float_data != float_data
+	|| entry->bytes_per_cell != bytes_per_cell
+	|| entry->unsigned_data != unsigned_data) {
+      link = &entry->next;
+      continue;
+    }
+    if (same_file_version(&entry->gpd_stat, &gpd_stat)
+	&& same_file_version(&entry->data_stat, &data_stat)) {
+
+/*
+ * wait for another worker's load, then look again since the
+ * entry may have failed and been dropped
+ */
+      if (entry->loading) {
+	pthread_cond_wait(&cache_loaded, &cache_lock);
+	goto search;
+      }
+      ++entry->refs;
+      entry->last_used = ++cache_clock;
+      pthread_mutex_unlock(&cache_lock);
+      return entry;
+    }
+
+/*
+ * file changed, drop the old entry once nobody is using it
+ */
+    *link = entry->next;
+    entry->stale = TRUE;
+    if (0 == entry->refs) free_grid_cache(entry);
+  }
+
+  entry = (struct grid_cache *)calloc(1, sizeof(struct grid_cache));
+  if (!entry) {
+    pthread_mutex_unlock(&cache_lock);
+    strcpy(message, "server out of memory");
+    return NULL;
+  }
+  strcpy(entry->gpd_filename, request->gpd_filename);
+  strcpy(entry->data_filename, request->data_filename);
+  entry->gpd_stat = gpd_stat;
+  entry->data_stat = data_stat;
+  entry->float_data = float_data;
+  entry->bytes_per_cell = bytes_per_cell;
+  entry->unsigned_data = unsigned_data;
+  entry->refs = 1;
+  entry->last_used = ++cache_clock;
+  entry->loading = TRUE;
+  entry->next = cache_list;
+  cache_list = entry;
+  trim_grid_cache();
+  pthread_mutex_unlock(&cache_lock);
+
+  if (0 != load_grid_cache(entry, message)) {
+    pthread_mutex_lock(&cache_lock);
+    if (!entry->stale) {
+      for (link = &cache_list; *link != entry; link = &(*link)->next)
+	;
+      *link = entry->next;
+    }
+    free_grid_cache(entry);
+    pthread_cond_broadcast(&cache_loaded);
+    pthread_mutex_unlock(&cache_lock);
+    return NULL;
+  }
+
+  if (verbose)
+    fprintf(stderr,"> Loaded:\t%s %s\n",
+	    entry->gpd_filename, entry->data_filename);
+
+  pthread_mutex_lock(&cache_lock);
+  entry->loading = FALSE;
+  pthread_cond_broadcast(&cache_loaded);
+  pthread_mutex_unlock(&cache_lock);
+  return entry;
+}
+
+/*------------------------------------------------------------------------
+ * load_grid_cache - read the grid and data of a new cache entry
+ *
+ *	input : entry - new entry, file names and data format set
+ *
+ *	output: entry - grid and from_data
+ *              message - reason for failure
+ *
+ *	result: 0 on success, -1 on failure
+ *
+ *      note: the data are copied into a float matrix, nothing stays
+ *            mapped, so a file rewritten or truncated while it is
+ *            cached can't fault the server. The file read must be the
+ *            one that was stat'ed for the cache key.
+ *
+ *------------------------------------------------------------------------*/
+static int load_grid_cache(struct grid_cache *entry, char *message) {
+  int row, status;
+  size_t row_bytes;
+  void *row_buf;
+  FILE *data_file;
+  struct stat open_stat;
+  struct interp_control control;
+
+  pthread_mutex_lock(&grid_init_lock);
+  entry->grid = init_grid(entry->gpd_filename);
+  pthread_mutex_unlock(&grid_init_lock);
+  if (!entry->grid) {
+    sprintf(message, "can't initialize %.200s", entry->gpd_filename);
+    return -1;
+  }
+
+  row_bytes = (size_t)entry->grid->cols*entry->bytes_per_cell;
+  data_file = fopen(entry->data_filename, "rb");
+  if (!data_file) {
+    sprintf(message, "can't open %.200s", entry->data_filename);
+    return -1;
+  }
+  if (fstat(fileno(data_file), &open_stat) != 0
+      || !same_file_version(&open_stat, &entry->data_stat)) {
+    sprintf(message, "%.200s changed while loading", entry->data_filename);
+    fclose(data_file);
+    return -1;
+  }
+  if ((size_t)open_stat.st_size < row_bytes*entry->grid->rows) {
+    sprintf(message, "%.100s is too short for %.100s",
+	    entry->data_filename, entry->gpd_filename);
+    fclose(data_file);
+    return -1;
+  }
+
+  entry->from_data = (float **)matrix_aligned(entry->grid->rows,
+					      entry->grid->cols, sizeof(float),
+					      MATRIX_FLAGS & ~matrix_ZERO);
+  row_buf = malloc(row_bytes);
+  if (!entry->from_data || !row_buf) {
+    strcpy(message, "server out of memory");
+    if (row_buf) free(row_buf);
+    fclose(data_file);
+    return -1;
+  }
+
+  memset(&control, 0, sizeof(control));
+  control.grid = entry->grid;
+  control.float_data = entry->float_data;
+  control.bytes_per_cell = entry->bytes_per_cell;
+  control.unsigned_data = entry->unsigned_data;
+  status = 0;
+  for (row = 0; row < entry->grid->rows && 0 == status; row++)
+    if (read_row(entry->from_data[row], data_file, row_buf, &control)
+	!= entry->grid->cols) status = -1;
+  free(row_buf);
+  fclose(data_file);
+
+  if (0 != status)
+    sprintf(message, "error reading %.200s", entry->data_filename);
+  return status;
+}
+
+/*------------------------------------------------------------------------
+ * same_file_version - has a file not changed between two stats
+ *
+ *      note: the modification time is compared to the nanosecond,
+ *            with size and inode to catch rewrites within the clock
+ *            resolution and files replaced by rename
+ *
+ *------------------------------------------------------------------------*/
+static bool same_file_version(struct stat *a, struct stat *b) {
+  return a->st_dev == b->st_dev
+    && a->st_ino == b->st_ino
+    && a->st_size == b->st_size
+    && a->st_mtim.tv_sec == b->st_mtim.tv_sec
+    && a->st_mtim.tv_nsec == b->st_mtim.tv_nsec;
+}
+
+/*------------------------------------------------------------------------
+ * release_grid_cache - done with a cache entry
+ *------------------------------------------------------------------------*/
+static void release_grid_cache(struct grid_cache *entry) {
+  pthread_mutex_lock(&cache_lock);
+  --entry->refs;
+  if (entry->stale && 0 == entry->refs) free_grid_cache(entry);
+  pthread_mutex_unlock(&cache_lock);
+}
+
+/*------------------------------------------------------------------------
+ * free_grid_cache - release the storage of a cache entry
+ *------------------------------------------------------------------------*/
+static void free_grid_cache(struct grid_cache *entry) {
+  if (entry->from_data) free_matrix_aligned((void **)entry->from_data);
+  if (entry->grid) {
+    pthread_mutex_lock(&grid_init_lock);
+    close_grid(entry->grid);
+    pthread_mutex_unlock(&grid_init_lock);
+  }
+  free(entry);
+}
+
+/*------------------------------------------------------------------------
+ * trim_grid_cache - drop least recently used grids over SERVE_MAX_GRIDS
+ *
+ *      note: called with cache_lock held, entries in use or loading
+ *            are kept so the list may stay over the limit for a while
+ *
+ *------------------------------------------------------------------------*/
+static void trim_grid_cache(void) {
+  int count;
+  struct grid_cache *entry, **link, **oldest;
+
+  for (;;) {
+    count = 0;
+    oldest = NULL;
+    for (link = &cache_list; *link; link = &(*link)->next) {
+      entry = *link;
+      ++count;
+      if (0 == entry->refs && !entry->loading
+	  && (!oldest || entry->last_used < (*oldest)->last_used))
+	oldest = link;
+    }
+    if (count <= SERVE_MAX_GRIDS || !oldest) return;
+    entry = *oldest;
+    *oldest = entry->next;
+    if (verbose)
+      fprintf(stderr,"> Dropped:\t%s %s\n",
+	      entry->gpd_filename, entry->data_filename);
+    free_grid_cache(entry);
+  }
+}
+
+/*------------------------------------------------------------------------
+ * query_server - sample a grid through an ungrid server
+ *
+ *	input : socket_path - server socket
+ *              gpd_filename, data_filename - grid to sample
+ *              method - interpolation method letter
+ *              control - control parameter structure, points are
+ *                        read from control->points
+ *
+ *	output: none.
+ *
+ *	result: number of points processed, or -1 on failure
+ *
+ *------------------------------------------------------------------------*/
+static int query_server(char *socket_path, char *gpd_filename,
+			char *data_filename, char method,
+			struct interp_control *control) {
+  int fd, i, npts, io_err, status;
+  int points_processed = 0;
+  int chunk = control->batch_size > 0 ? control->batch_size : SERVE_CHUNK;
+  double *pair, *lat, *lon;
+  float *value;
+  char path[PATH_MAX];
+  struct serve_request request;
+  struct serve_reply reply;
+
+/*
+ * the server rejects larger requests, so -P above that only sets
+ * how many points are sent at a time up to the limit
+ */
+  if (chunk > SERVE_MAX_POINTS) chunk = SERVE_MAX_POINTS;
+
+/*
+ * send absolute names so the server finds the same files
+ */
+  memset(&request, 0, sizeof(request));
+  request.magic = SERVE_MAGIC;
+  if (!realpath(gpd_filename, path) || strlen(path) >= FILENAME_MAX) {
+    perror(gpd_filename);
+    return -1;
+  }
+  strcpy(request.gpd_filename, path);
+  if (!realpath(data_filename, path) || strlen(path) >= FILENAME_MAX) {
+    perror(data_filename);
+    return -1;
+  }
+  strcpy(request.data_filename, path);
+  request.method = method;
+  request.bytes_per_cell = control->bytes_per_cell;
+  request.unsigned_data = control->unsigned_data;
+  request.float_data = control->float_data;
+  request.min_set = control->min_set;
+  request.min_value = control->min_value;
+  request.max_set = control->max_set;
+  request.max_value = control->max_value;
+  request.fill_value = control->fill_value;
+  request.shell_radius = control->shell_radius;
+  request.power = control->power;
+
+  fd = connect_server(socket_path);
+  if (fd < 0) return -1;
+
+  pair = (double *)calloc(2*chunk, sizeof(double));
+  lat = (double *)calloc(chunk, sizeof(double));
+  lon = (double *)calloc(chunk, sizeof(double));
+  value = (float *)calloc(chunk, sizeof(float));
+  if (!pair || !lat || !lon || !value) {
+    perror("query_server");
+    error_exit("ungrid: ABORTING");
+  }
+
+  while ((npts = read_points_io(control->points, chunk, lat, lon, NULL)) > 0) {
+    for (i = 0; i < npts; i++) {
+      pair[2*i] = lat[i];
+      pair[2*i+1] = lon[i];
+    }
+    request.npts = npts;
+    status = exchange_request(fd, &request, pair, &reply);
+
+/*
+ * the server drops connections idle for SERVE_IDLE_SECONDS,
+ * queries have no side effects so reconnect and ask again once
+ */
+    if (0 != status) {
+      close(fd);
+      fd = connect_server(socket_path);
+      if (fd >= 0) status = exchange_request(fd, &request, pair, &reply);
+    }
+    if (0 != status) {
+      fprintf(stderr, "ungrid: lost connection to %s\n", socket_path);
+      points_processed = -1;
+      break;
+    }
+    if (0 != reply.status || reply.npts != npts) {
+      reply.message[MAX_STRING-1] = '\0';
+      fprintf(stderr, "ungrid: server: %s\n", reply.message);
+      points_processed = -1;
+      break;
+    }
+    if (read_full(fd, value, npts*sizeof(float)) != 0) {
+      fprintf(stderr, "ungrid: lost connection to %s\n", socket_path);
+      points_processed = -1;
+      break;
+    }
+
+    for (i = 0; i < npts; i++) {
+      io_err = write_point(lat[i], lon[i], value[i], control);
+      if (io_err != 0) {
+	perror("writing to stdout");
+	fprintf(stderr, "ungrid: point %d\n", points_processed + 1);
+      }
+      points_processed++;
+    }
+  }
+
+  if (fd >= 0) close(fd);
+  free(pair); free(lat); free(lon); free(value);
+
+  return points_processed;
+}
+
+/*------------------------------------------------------------------------
+ * connect_server - open a connection to an ungrid server
+ *
+ *	input : socket_path - server socket
+ *
+ *	result: connected socket, or -1 on failure
+ *
+ *------------------------------------------------------------------------*/
+static int connect_server(char *socket_path) {
+  int fd;
+  struct sockaddr_un addr;
+
+  if (strlen(socket_path) >= sizeof(addr.sun_path)) {
+    fprintf(stderr, "ungrid: socket path %s is too long\n", socket_path);
+    return -1;
+  }
+  fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0) { perror("socket"); return -1; }
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  strcpy(addr.sun_path, socket_path);
+  if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+    perror(socket_path);
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+/*------------------------------------------------------------------------
+ * exchange_request - send a request and read the reply header
+ *
+ *	input : fd - connected socket
+ *              request - request header, npts set
+ *              pair - npts lat,lon pairs
+ *
+ *	output: reply - reply header
+ *
+ *	result: 0 on success, -1 if the connection failed
+ *
+ *------------------------------------------------------------------------*/
+static int exchange_request(int fd, struct serve_request *request,
+			    double *pair, struct serve_reply *reply) {
+  if (write_full(fd, request, sizeof(*request)) != 0
+      || write_full(fd, pair, 2*request->npts*sizeof(double)) != 0
+      || read_full(fd, reply, sizeof(*reply)) != 0
+      || SERVE_MAGIC != reply->magic) return -1;
+  return 0;
+}
@@ -0,0 +1,41 @@
+/*======================================================================
+ * wdbplt - read compressed WDB II and WVS coastline files
+ *
+ *	see wdbpltc.c for the file format and the original authors
+ *
+ * National Snow & Ice Data Center, University of Colorado, Boulder
+ * Copyright (C) 2026 University of Colorado
+ *======================================================================*/
+#ifndef wdbplt_h_
+#define wdbplt_h_
+
+/*
+ *	called once per line, lat,lon in degrees, count points
+ */
+typedef void (*wdbplt_curve)(void *curve_data, float *lon, float *lat,
+			     short count, char color);
+
+/*
+ *	all of the reader's state, one per file being read so that
+ *	several files can be read at once
+ */
+typedef struct
+{ wdbplt_curve curve;
+  void *curve_data;
+  unsigned char *bytbuf, *celbuf;	/* physical records */
+  short lunfil, logrec, lperp, offset, level;
+  long index, addr, paddr, curpos, fulrec;
+  long caddr, pcaddr;			/* cell map record */
+  char first;				/* cell map not read yet */
+  float slatdd, nlatdd, wlondd, elondd;
+  float *latray, *lonray;		/* one line, up to 512 points */
+  char color, flag;			/* pltpro state */
+  short npts, prank, count;
+  float savlat, savlon;
+} wdbplt_class;
+
+int wdbplt(char *file, float slatd, float slatm, float nlatd, float nlatm,
+	   float wlond, float wlonm, float elond, float elonm,
+	   char ranks[], char gapin, wdbplt_curve curve, void *curve_data);
+
+#endif
@@ -24,41 +24,39 @@
 	       hopefully, these routines will be good enough to get the job
 	       done.  (JCD)
 
-	Global variable definitions :
+	State variable definitions (wdbplt_class, see wdbplt.h, these
+	were globals, now there is one set per file being read so that
+	several files can be read at once) :
 
 	PHYSIZ    - size of a physical record in the direct access file,
 		    in bytes.
-	g_bytbuf  - char array of 'PHYSIZ' length for i/o to the direct
+	bytbuf    - char array of 'PHYSIZ' length for i/o to the direct
 		    access file.
-	g_celbuf  - char array of 'PHYSIZ' length for i/o to the
+	celbuf    - char array of 'PHYSIZ' length for i/o to the
 		    direct access file (used to retrieve cell map).
-	g_lunfil  - file handle for the direct access file.
-	g_logrec  - length of a logical record in bytes.
-	g_lperp   - logical records per physical record.
-	g_offset  - number of logical records needed to store the bit
+	lunfil    - file handle for the direct access file.
+	logrec    - length of a logical record in bytes.
+	lperp     - logical records per physical record.
+	offset    - number of logical records needed to store the bit
 		    cell map + 1 .
-	g_level   - wdbplt software and data file version.
-	g_proj    - projection (6 chars + \000).
-	g_stflag  - initialization flag for 'projct' and 'curve'.
-	g_index   - cell index number for algorithm addressing, g_index =
+	level     - wdbplt software and data file version.
+	index     - cell index number for algorithm addressing, index =
 		    integer (lat degrees + 90) * 360 + integer lon
 		    degrees + 180 + 1 ; this is the logical record
 		    address of the first data segment in any cell.
-	g_addr    - current physical record address in bytes from beginning
+	addr      - current physical record address in bytes from beginning
 		    of the file.
-	g_paddr   - previous physical record address.
-	g_lstat   - seek and read status variable.
-	g_curpos  - current byte position within the physical record.
-	g_fulrec  - full record value (g_logrec-4).
-	g_slatdd  - latitude of southern boundary of area (degrees).
-	g_nlatdd  - latitude of northern boundary of area (degrees).
-	g_wlondd  - longitude of western boundary of area (degrees).
-	g_elondd  - longitude of eastern boundary of area (degrees).
-	g_scal    - scale factor.
-	g_width   - width of area.
-	g_height  - height of area.
+	paddr     - previous physical record address.
+	curpos    - current byte position within the physical record.
+	fulrec    - full record value (logrec-4).
+	slatdd    - latitude of southern boundary of area (degrees).
+	nlatdd    - latitude of northern boundary of area (degrees).
+	wlondd    - longitude of western boundary of area (degrees).
+	elondd    - longitude of eastern boundary of area (degrees).
 	latray[512] - latitudes in degrees for one segment.
 	lonray[512] - longitudes in degrees for one segment.
+	curve     - called with each line, curve_data is its first
+		    argument.
 
 	Local variable definitions :
 
@@ -104,57 +102,61 @@
 	wlonm  - longitude minutes of western boundary of area.
 	elond  - longitude degrees of eastern boundary of area.
 	elonm  - longitude minutes of eastern boundary of area.
-	scale  - scale factor in inches/degree.
 	prjctn - 7 characters, 6 character projection id & \000.
 	ranks  - char array containing color numbers for each rank.
 	gapin  - every 'gapin'th point will be plotted; largest allowed
 		 value for gapin is 45.
+	curve  - function called with each line.
+	curve_data - first argument to curve.
+
+	Returns 0, or -1 if the file can not be read.
 
 *****************************************************************************
 */
 #include <stdlib.h>
 #include <fcntl.h>
+#include <unistd.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <stdio.h>
 #include <errno.h>
 #include <math.h>
+#include "wdbplt.h"
 
 #define PHYSIZ 3072
 
 #define SIGN_OF(x) ((x)<0.0 ? -1 : 1)
 
-float *ufmatrix(); /* allocates memory for float matrix */
-unsigned char *ucmatrix(); /* allocates memory for character matrix */
-void wdbpltc_free(); /* frees all buffers */
+float *ufmatrix(int, int); /* allocates memory for float matrix */
+unsigned char *ucmatrix(int, int); /* allocates memory for character matrix */
+int ufree(char *);
+int uabort(void);
+int gstat(char *);
+static void wdbpltc_free(wdbplt_class *); /* frees all buffers */
+static unsigned char celchk(wdbplt_class *);
+static unsigned char test_bit(unsigned char, short);
+static void movpos(wdbplt_class *);
+static void nxtrec(wdbplt_class *);
+static void pltpro(wdbplt_class *, float, float, short, short *, char, short);
+static void simple(wdbplt_class *, short *, short);
 #ifdef DEBUG
-int debug=1;
+static int debug=1;
 #else
-int debug=0;
+static int debug=0;
 #endif
-unsigned char *g_bytbuf,*g_celbuf;
-short g_lunfil,g_logrec,g_lperp,g_offset,g_level;
-char g_proj[6+1], g_stflag;
-long g_index,g_addr,g_paddr,g_lstat,g_curpos,g_fulrec;
-float g_slatdd,g_nlatdd,g_wlondd,g_elondd,g_scal,g_height,g_width;
-float *latray,*lonray;
-
-void wdbplt(file, slatd, slatm, nlatd, nlatm, wlond, wlonm, elond, elonm,
-	  scale, ranks, gapin)
-char file[], ranks[], gapin;
-float slatd, slatm, nlatd, nlatm, wlond, wlonm, elond, elonm, scale;
-{
-  unsigned char celchk();
-  void nxtrec(), movpos(), pltpro();
 
+int wdbplt(char *file, float slatd, float slatm, float nlatd, float nlatm,
+	   float wlond, float wlonm, float elond, float elonm,
+	   char ranks[], char gapin, wdbplt_curve curve, void *curve_data)
+{
+  wdbplt_class state, *this = &state;
   short ioff, i, j, col, go, stop, inc, slat, nlat, wlon, elon, segcnt,
     rank, cont, cnt, gap, latsec, lonsec;
     long latoff, lonoff, conbyt;
-  char eflag, first, *dirfil;
+  char eflag;
   float todeg, lat=0., lon=0.;
   double dummy;
   int ii,jj;
-  char filspc[40];
 
   if(debug)
   {
@@ -169,35 +171,44 @@ float slatd, slatm, nlatd, nlatm, wlond, wlonm, elond, elonm, scale;
     printf("\n");
   }
 /* get memory for working arrays */
-  lonray=ufmatrix(1,512);
-  latray=ufmatrix(1,512);
-  g_bytbuf = ucmatrix(1,PHYSIZ);
-  if((g_celbuf=ucmatrix(1,PHYSIZ))==NULL)
+  this->curve = curve;
+  this->curve_data = curve_data;
+  this->lunfil = -1;
+  this->lonray=ufmatrix(1,512);
+  this->latray=ufmatrix(1,512);
+  this->bytbuf = ucmatrix(1,PHYSIZ);
+  this->celbuf = ucmatrix(1,PHYSIZ);
+  if(this->lonray==NULL || this->latray==NULL || this->bytbuf==NULL
+     || this->celbuf==NULL)
   {
     gstat("Error allocating memory in WDBPLTC");
-    return;
+    wdbpltc_free(this);
+    return -1;
   }
 /*Initialize variables, open file and read first record*/
-  first = 1;
+  this->first = 1;
+  this->paddr = this->pcaddr = 0;
+  this->color = 0;
+  this->flag = 1;
+  this->npts = -1;
+  this->prank = 0;
   eflag = 0;
-  g_stflag = 1;
-  g_scal=scale;
-  g_lunfil = open(file,O_RDONLY);
-  if (g_lunfil==-1)
+  this->lunfil = open(file,O_RDONLY);
+  if (this->lunfil==-1)
   {
     gstat("Coastline file not found");
-    wdbpltc_free();
-    return;
+    wdbpltc_free(this);
+    return -1;
   }
-  g_lstat = lseek(g_lunfil,0L,0);
-  g_lstat = read(g_lunfil,g_bytbuf,PHYSIZ);
-  g_logrec = g_bytbuf[3];
-  g_fulrec = g_logrec - 4;
-  g_level = g_bytbuf[4];
-  ioff = g_bytbuf[5];
+  lseek(this->lunfil,0L,0);
+  read(this->lunfil,this->bytbuf,PHYSIZ);
+  this->logrec = this->bytbuf[3];
+  this->fulrec = this->logrec - 4;
+  this->level = this->bytbuf[4];
+  ioff = this->bytbuf[5];
   todeg = 3600.0 * ioff;
-  g_offset = 64799 / (g_logrec*8) + 2;
-  g_lperp = PHYSIZ / g_logrec;
+  this->offset = 64799 / (this->logrec*8) + 2;
+  this->lperp = PHYSIZ / this->logrec;
 /*Adjust gapin if neccessary*/
   gap = gapin;
   if (gap>45)
@@ -213,22 +224,22 @@ float slatd, slatm, nlatd, nlatm, wlond, wlonm, elond, elonm, scale;
     gap = 1;
   }
 /*Compute latitude and longitude in degrees and adjust for 180 crossing*/
-  g_slatdd = slatd+(slatm/60.0)*SIGN_OF(slatd);
-  g_nlatdd = nlatd+(nlatm/60.0)*SIGN_OF(nlatd);
-  g_wlondd = wlond+(wlonm/60.0)*SIGN_OF(wlond);
-  g_elondd = elond+(elonm/60.0)*SIGN_OF(elond);
-  if (g_elondd<=g_wlondd) g_elondd = g_elondd + 360.0;
+  this->slatdd = slatd+(slatm/60.0)*SIGN_OF(slatd);
+  this->nlatdd = nlatd+(nlatm/60.0)*SIGN_OF(nlatd);
+  this->wlondd = wlond+(wlonm/60.0)*SIGN_OF(wlond);
+  this->elondd = elond+(elonm/60.0)*SIGN_OF(elond);
+  if (this->elondd<=this->wlondd) this->elondd = this->elondd + 360.0;
 /*Compute start and end integer values for retrieval loop and adjust
 if neccessary*/
-  slat = g_slatdd + 90.0;
-  nlat = g_nlatdd + 90.0;
-  wlon = g_wlondd;
-  elon = g_elondd;
-
-  if (modf((double)g_nlatdd,&dummy)==0.0) nlat--;
-  if (modf((double)g_elondd,&dummy)==0.0) elon--;
-  if (g_wlondd<0.0 && modf((double)g_wlondd,&dummy)!=0.0) wlon--;
-  if (g_elondd<0.0 && modf((double)g_elondd,&dummy)!=0.0) elon--;
+  slat = this->slatdd + 90.0;
+  nlat = this->nlatdd + 90.0;
+  wlon = this->wlondd;
+  elon = this->elondd;
+
+  if (modf((double)this->nlatdd,&dummy)==0.0) nlat--;
+  if (modf((double)this->elondd,&dummy)==0.0) elon--;
+  if (this->wlondd<0.0 && modf((double)this->wlondd,&dummy)!=0.0) wlon--;
+  if (this->elondd<0.0 && modf((double)this->elondd,&dummy)!=0.0) elon--;
 /*Latitude loop*/
   for (i=slat; i<=nlat; i++)
   {
@@ -255,33 +266,33 @@ direct access data base */
       if (col<-180) col = col + 360;
       if (col>=180) col = col - 360;
       col = col +181;
-      g_index = i*360L + col + g_offset;
-/*Check cell map to see if data is available in 'g_index' cell*/
-      if (celchk(&first))
+      this->index = i*360L + col + this->offset;
+/*Check cell map to see if data is available in 'index' cell*/
+      if (celchk(this))
       {
 /*Compute physical record address, read record and save as previous address*/
 	eflag = 0;
-	g_addr = ((g_index-1)/g_lperp)*PHYSIZ;
-	if (g_addr!=g_paddr)
+	this->addr = ((this->index-1)/this->lperp)*PHYSIZ;
+	if (this->addr!=this->paddr)
 	{
-	  g_lstat = lseek(g_lunfil,g_addr,SEEK_SET);
-	  g_lstat = read(g_lunfil,g_bytbuf,PHYSIZ);
+	  lseek(this->lunfil,this->addr,SEEK_SET);
+	  read(this->lunfil,this->bytbuf,PHYSIZ);
 	}
-	g_paddr = g_addr;
+	this->paddr = this->addr;
 /*Compute byte position within physical record*/
-	g_curpos = ((g_index-1)%g_lperp)*g_logrec;
+	this->curpos = ((this->index-1)%this->lperp)*this->logrec;
 /*If not at end of segment, process the record*/
 	while (!eflag)
 	{
 /*Get first two bytes of header and break out count and
 continuation bit.*/
-	  segcnt = (g_bytbuf[g_curpos]%128)*4 + g_bytbuf[g_curpos+1]/64 + 1;
-	  cont = g_bytbuf[g_curpos]/128;
+	  segcnt = (this->bytbuf[this->curpos]%128)*4 + this->bytbuf[this->curpos+1]/64 + 1;
+	  cont = this->bytbuf[this->curpos]/128;
 /*If this is a continuation record get offsets from the second byte.*/
 	  if (cont)
 	  {
-	    latoff = ((g_bytbuf[g_curpos+1]%64)/8)*65536L;
-	    lonoff = (g_bytbuf[g_curpos+1]%8)*65536L;
+	    latoff = ((this->bytbuf[this->curpos+1]%64)/8)*65536L;
+	    lonoff = (this->bytbuf[this->curpos+1]%8)*65536L;
 	  }
 /*If this is an initial record set the offsets to zero and
 get the rank from the second byte.*/
@@ -289,15 +300,15 @@ get the rank from the second byte.*/
 	  {
 	    latoff = 0;
 	    lonoff = 0;
-	    rank = g_bytbuf[g_curpos+1]%64;
+	    rank = this->bytbuf[this->curpos+1]%64;
 	  }
 /*Update the current byte position and get a new record if neccessary.*/
-	  movpos();
+	  movpos(this);
 /*Compute the rest of the latitude offset.*/
-	  latoff += g_bytbuf[g_curpos]*256L + g_bytbuf[g_curpos+1];
-	  movpos();
+	  latoff += this->bytbuf[this->curpos]*256L + this->bytbuf[this->curpos+1];
+	  movpos(this);
 /*Compute the rest of the longitude offset.*/
-	  lonoff += g_bytbuf[g_curpos]*256L + g_bytbuf[g_curpos+1];
+	  lonoff += this->bytbuf[this->curpos]*256L + this->bytbuf[this->curpos+1];
 /*If this is a continuation record, bias the lat and lon offsets
 and compute the position.*/
 	  if (cont)
@@ -314,42 +325,42 @@ and compute the position.*/
 	    lon = (float)j + (float)lonoff/todeg;
 	  }
 /*Update the current byte position.*/
-	  g_curpos += 2;
+	  this->curpos += 2;
 /*Get the continuation pointer.*/
-	  conbyt = ((g_index-1)%g_lperp)*g_logrec+g_fulrec;
+	  conbyt = ((this->index-1)%this->lperp)*this->logrec+this->fulrec;
 /*If there is no continuation pointer or the byte position
 is not at the position pointed to by the continuation pointer,
 process the segment data.*/
-	  if (g_bytbuf[conbyt]==0 || (g_curpos+1)%g_logrec<=
-	    g_bytbuf[conbyt])
+	  if (this->bytbuf[conbyt]==0 || (this->curpos+1)%this->logrec<=
+	    this->bytbuf[conbyt])
 	  {
 /*If at the end of the logical record, get the next record in the chain.*/
-	    if (g_curpos%g_logrec==g_fulrec && g_bytbuf[conbyt]==0)
-	      nxtrec();
+	    if (this->curpos%this->logrec==this->fulrec && this->bytbuf[conbyt]==0)
+	      nxtrec(this);
 /*If the rank is to be plotted call the plot routine.*/
-	    if (ranks[rank]) pltpro(lat,lon,rank,&cont,ranks[rank],gap);
+	    if (ranks[rank]) pltpro(this,lat,lon,rank,&cont,ranks[rank],gap);
 /*If the end of the segment has been reached, set the endflag */
-	    if((g_curpos+1)%g_logrec==g_bytbuf[conbyt]) eflag=1;
+	    if((this->curpos+1)%this->logrec==this->bytbuf[conbyt]) eflag=1;
 /*Process the segment.*/
 	    for (cnt=2; cnt<=segcnt; cnt++)
 	    {
 /*Compute the position from the delta record.*/
-	      latsec = g_bytbuf[g_curpos] - 128;
+	      latsec = this->bytbuf[this->curpos] - 128;
 	      lat += (float)latsec/todeg;
-	      lonsec = g_bytbuf[g_curpos+1] - 128;
+	      lonsec = this->bytbuf[this->curpos+1] - 128;
 	      lon += (float)lonsec/todeg;
 /*Call the plotting routine.*/
-	      if (ranks[rank]) pltpro(lat,lon,rank,&cont,ranks[rank],gap);
-	      g_curpos += 2;
-	      conbyt = ((g_index-1)%g_lperp)*g_logrec+g_fulrec;
+	      if (ranks[rank]) pltpro(this,lat,lon,rank,&cont,ranks[rank],gap);
+	      this->curpos += 2;
+	      conbyt = ((this->index-1)%this->lperp)*this->logrec+this->fulrec;
 /*If the end of the segment has been reached, set the end flag
 and break out of for loop.*/
-	      if ((g_curpos+1)%g_logrec==g_bytbuf[conbyt])
+	      if ((this->curpos+1)%this->logrec==this->bytbuf[conbyt])
 	      {
 		eflag = 1;
 		break;
 	      }
-	      else if (g_curpos%g_logrec==g_fulrec) nxtrec();
+	      else if (this->curpos%this->logrec==this->fulrec) nxtrec(this);
 	    }
 	  }
 /*break out of while loop if at the end of the segment.*/
@@ -360,30 +371,29 @@ and break out of for loop.*/
       if(uabort())
       {
 /*Call the plot routine to flush the buffers.*/
-	pltpro(999.0,999.0,64,&cont,1,gap);
-	wdbpltc_free();
-	first=1;
-	return;
+	pltpro(this,999.0,999.0,64,&cont,1,gap);
+	wdbpltc_free(this);
+	return 0;
       }
     } /* end for */
   }  /* end for */
 /*Call the plot routine to flush the buffers.*/
-  pltpro(999.0,999.0,64,&cont,1,gap);
+  pltpro(this,999.0,999.0,64,&cont,1,gap);
 /* free local working memory */
-  wdbpltc_free();
-  first=1;
-  return;
+  wdbpltc_free(this);
+  return 0;
 }
 /**************************************************************************/
 /* WDBPLTC_FREE- frees buffers                                            */
 /**************************************************************************/
-void wdbpltc_free()
+static void wdbpltc_free(wdbplt_class *this)
 {
 
-  ufree((char*)lonray);
-  ufree((char*)latray);
-  ufree(g_bytbuf);
-  ufree(g_celbuf);
+  if (this->lunfil!=-1) close(this->lunfil);
+  ufree((char*)this->lonray);
+  ufree((char*)this->latray);
+  ufree((char*)this->bytbuf);
+  ufree((char*)this->celbuf);
   return;
 }
 /*
@@ -399,47 +409,43 @@ void wdbpltc_free()
 		 of the file (cell map address).
 	pcaddr - previous physical record address (cell map address).
 	ndxpos - bit position within the 64800 bit cell map for the cell
-		 pointed to by 'g_index'.
-	bytpos - byte position within the cell map of the 'g_index' cell.
-	bitpos - bit position within the 'bytpos' byte of the 'g_index' cell
+		 pointed to by 'index'.
+	bytpos - byte position within the cell map of the 'index' cell.
+	bitpos - bit position within the 'bytpos' byte of the 'index' cell
 		 bit.
 	chk    - logical value returned (true if there is data in the
-		 'g_index' cell).
+		 'index' cell).
 
 	Arguments:
 
-	first  - logical value that is set true the first time the cell map
-		 is accessed.
+	this   - reader state, this->first is set true the first time
+		 the cell map is accessed.
 
 */
-unsigned char celchk(first)
-short *first;
+static unsigned char celchk(wdbplt_class *this)
 {
-  unsigned char test_bit();
-
-  static long caddr, pcaddr = 0;
   long ndxpos;
   short bytpos, bitpos;
   unsigned char chk;
-/*Compute the physical address of the 'g_index' cell bit.*/
-  caddr = (((g_index+g_logrec*8)-(g_offset+1))/(PHYSIZ*8))*PHYSIZ;
+/*Compute the physical address of the 'index' cell bit.*/
+  this->caddr = (((this->index+this->logrec*8)-(this->offset+1))/(PHYSIZ*8))*PHYSIZ;
 /*If this is the first access or the physical address has changed since
 the last access, read a new physical record.*/
-  if (*first || pcaddr!=caddr)
+  if (this->first || this->pcaddr!=this->caddr)
   {
-    g_lstat = lseek(g_lunfil,caddr,SEEK_SET);
-    g_lstat = read(g_lunfil,g_celbuf,PHYSIZ);
+    lseek(this->lunfil,this->caddr,SEEK_SET);
+    read(this->lunfil,this->celbuf,PHYSIZ);
   }
 /*Set the previous address to the current one, set 'first' false.*/
-  pcaddr = caddr;
-  *first = 0;
-/*Compute the 'g_index' position within the physical record.*/
-  ndxpos = ((g_index+g_logrec*8)-(g_offset+1))%(PHYSIZ*8);
+  this->pcaddr = this->caddr;
+  this->first = 0;
+/*Compute the 'index' position within the physical record.*/
+  ndxpos = ((this->index+this->logrec*8)-(this->offset+1))%(PHYSIZ*8);
 /*Compute the byte and bit positions.*/
   bytpos = ndxpos/8;
   bitpos = 7-ndxpos%8;
-/*Test the 'g_index' bit and return.*/
-  chk = test_bit(g_celbuf[bytpos],bitpos);
+/*Test the 'index' bit and return.*/
+  chk = test_bit(this->celbuf[bytpos],bitpos);
   return (chk);
 }
 
@@ -454,9 +460,7 @@ the last access, read a new physical record.*/
 	mask  - char array of bit masks
 
 */
-unsigned char test_bit(byte, bitpos)
-unsigned char byte;
-short bitpos;
+static unsigned char test_bit(unsigned char byte, short bitpos)
 {
   static unsigned char mask[9] = {0x1,0x2,0x4,0x8,0x10,0x20,0x40,0x80};
   return (byte&mask[bitpos]);
@@ -469,11 +473,10 @@ short bitpos;
 	Updates current position pointer and checks for end of record.
 
 */
-void movpos(void)
+static void movpos(wdbplt_class *this)
 {
-  void nxtrec();
-  g_curpos += 2;
-  if (g_curpos%g_logrec==g_fulrec) nxtrec();
+  this->curpos += 2;
+  if (this->curpos%this->logrec==this->fulrec) nxtrec(this);
   return ;
 }
 
@@ -484,23 +487,23 @@ void movpos(void)
 	Reads next record in overflow chain.
 
 */
-void nxtrec(void)
+static void nxtrec(wdbplt_class *this)
 {
 /*Compute the index number for the next logical record in the chain.*/
-  g_index = g_bytbuf[g_curpos+1]*65536L + g_bytbuf[g_curpos+2]*256L +
-  g_bytbuf[g_curpos+3];
-  g_addr = ((g_index-1)/g_lperp)*PHYSIZ;
+  this->index = this->bytbuf[this->curpos+1]*65536L + this->bytbuf[this->curpos+2]*256L +
+  this->bytbuf[this->curpos+3];
+  this->addr = ((this->index-1)/this->lperp)*PHYSIZ;
 /*If the physical record has changed since the last access, read a new
 physical record.*/
-  if (g_addr!=g_paddr)
+  if (this->addr!=this->paddr)
   {
-    g_lstat = lseek(g_lunfil,g_addr,SEEK_SET);
-    g_lstat = read(g_lunfil,g_bytbuf,PHYSIZ);
+    lseek(this->lunfil,this->addr,SEEK_SET);
+    read(this->lunfil,this->bytbuf,PHYSIZ);
   }
 /*Set the previous physical address to the current one, and compute the
 current byte position for the new record.*/
-  g_paddr = g_addr;
-  g_curpos = ((g_index-1)%g_lperp)*g_logrec;
+  this->paddr = this->addr;
+  this->curpos = ((this->index-1)%this->lperp)*this->logrec;
   return ;
 }
 
@@ -529,6 +532,7 @@ current byte position for the new record.*/
 
 	Arguments:
 
+	this   - reader state, the variables above are kept there
 	lat    - latitude of current point (degrees +90.0)
 	lon    - longitude of current point (degrees)
 	rank   - rank of data point.
@@ -538,16 +542,9 @@ current byte position for the new record.*/
 		 value for gap is 45
 
 */
-void pltpro(lat, lon, rank, cont, penclr, gap)
-float lat, lon;
-short rank, *cont, gap;
-char penclr;
+static void pltpro(wdbplt_class *this, float lat, float lon, short rank,
+		   short *cont, char penclr, short gap)
 {
-  void simple(), projct(), curve();
-
-  static char color, flag = 1;
-  static short npts = -1, prank = 0, count;
-  static float savlat, savlon;
   char ipen;
   float ylat;
   if(debug) printf("PLTPRO:lat %f lon %f rank %hd gap %hd cont %hd\n",
@@ -555,54 +552,52 @@ char penclr;
 /*Adjust latitude back to -90 to +90 range.*/
   ylat = lat - 90.0;
 /*Check for beginning of line.*/
-  if (flag && *cont) ipen = 2;
+  if (this->flag && *cont) ipen = 2;
   else ipen = 3;
 /*If this is beginning of a line or rank has changed or 512 points have
 been stored, plot the line.*/
-  if (ipen==3 || rank!=prank || npts==511)
+  if (ipen==3 || rank!=this->prank || this->npts==511)
   {
 /*Make sure there are at least two points in the arrays.*/
-    if (npts>0)
+    if (this->npts>0)
     {
 /*Store the count and simplify the arrays if requested.*/
-      count = npts;
-      simple(&count,gap);
+      this->count = this->npts;
+      simple(this,&this->count,gap);
 /*Save the last lat and lon if the segment is larger than 512 points.*/
-      if (npts==511)
+      if (this->npts==511)
       {
-	savlat = latray[511];
-	savlon = lonray[511];
+	this->savlat = this->latray[511];
+	this->savlon = this->lonray[511];
       }
 /*Plot the data points.*/
-      curve(lonray,latray,count,color);
+      this->curve(this->curve_data,this->lonray,this->latray,this->count,
+		  this->color);
     }
 /*If rank has changed, change colors*/
-    if(rank != prank) color = penclr;
+    if(rank != this->prank) this->color = penclr;
 /*For line larger than 512 points, store the 512th point in the
 beginning of the next line and set the counter.*/
-    if(npts==511 && *cont)
+    if(this->npts==511 && *cont)
     {
-      latray[0] = savlat;
-      lonray[0] = savlon;
-      npts = 0;
+      this->latray[0] = this->savlat;
+      this->lonray[0] = this->savlon;
+      this->npts = 0;
     }
-    else npts = -1;
+    else this->npts = -1;
   }
 /*If the current point is within the area, store it and set the flag.*/
-  if (ylat>=g_slatdd && ylat<=g_nlatdd && lon>=g_wlondd &&
-    lon<=g_elondd)
+  if (ylat>=this->slatdd && ylat<=this->nlatdd && lon>=this->wlondd &&
+    lon<=this->elondd)
   {
-    npts++;
-    latray[npts] = ylat;
-    lonray[npts] = lon;
-    flag = 1;
+    this->npts++;
+    this->latray[this->npts] = ylat;
+    this->lonray[this->npts] = lon;
+    this->flag = 1;
   }
-  else flag = 0;
+  else this->flag = 0;
   *cont = -1;
-  prank = rank;
-/*If this is the last point read for this area, reset the 'projct'
-initialization flag.*/
-  if (rank==64) g_stflag = 1;
+  this->prank = rank;
   return ;
 }
 
@@ -625,8 +620,7 @@ initialization flag.*/
 
 *****************************************************************************
 */
-void simple(count, gap)
-short *count, gap;
+static void simple(wdbplt_class *this, short *count, short gap)
 {
   register short i, ndx;
 /*If the increment is not 1 and the number of points in the arrays
@@ -635,11 +629,11 @@ is greater than 10, simplify the arrays.*/
   {
     for (i=ndx=0; i<=*count; i+=gap, ndx++)
     {
-      latray[ndx] = latray[i];
-      lonray[ndx] = lonray[i];
+      this->latray[ndx] = this->latray[i];
+      this->lonray[ndx] = this->lonray[i];
     }
-    latray[ndx] = latray[*count];
-    lonray[ndx] = lonray[*count];
+    this->latray[ndx] = this->latray[*count];
+    this->lonray[ndx] = this->lonray[*count];
 /*Set the count to the new count.*/
     *count = ndx;
   }
@@ -20,6 +20,21 @@ static const char wdbtocdb_c_rcsid[] = "$Id$";
 #include "mapx.h"
 #include "cdb.h"
 #include "cdb_byteswap.h"
+#include "wdbplt.h"
+
+/*------------------------------------------------------------------------
+ * segments decoded from one source file, index addr is the offset
+ * of the segment's first point in data until the batch is written
+ *------------------------------------------------------------------------*/
+typedef struct
+{ cdb_index_entry *index;
+  int seg_count, max_index_entries;
+  cdb_seg_data *data;
+  long npoints, max_data_points;	/* all segments */
+  int seg_points;			/* current segment */
+  int max_seg_size;
+  float lat1, lon1;			/* last point added */
+} wdb_batch;
 
 /*------------------------------------------------------------------------
  * globals
@@ -28,13 +43,11 @@ static char *cdb_filename;
 static FILE *cdb_file;
 static cdb_file_header header;
 static cdb_index_entry *seg_index = NULL;
-static cdb_seg_data *data = NULL;
 static int seg_count = 0;
-static int npoints = 0;
+static long data_addr = CDB_FILE_HEADER_SIZE;
 static int max_seg_size = 0;
 static int ilat_extent = 0, ilon_extent = 0;
 static int max_index_entries = 0;
-static int max_data_points = 0;
 static int verbose = FALSE;
 static int very_verbose = FALSE;
 static int very_very_verbose = FALSE;
@@ -44,15 +57,20 @@ static int very_very_verbose = FALSE;
 /*------------------------------------------------------------------------
  * function prototypes
  *------------------------------------------------------------------------*/
-void move_pu(float, float);
-void draw_pd(float, float);
-void write_segment_data(int);
+static wdb_batch *decode_source(char *, float, float, float, float,
+				char *, int);
+static void curve(void *, float *, float *, short, char);
+static void move_pu(wdb_batch *, float, float);
+static void draw_pd(wdb_batch *, float, float);
+static void end_segment(wdb_batch *);
+static void write_batch(wdb_batch *);
+static void sort_index(cdb_index_sort);
 
 /*------------------------------------------------------------------------
  * usage
  *------------------------------------------------------------------------*/
 #define usage "\n"\
-"usage: wdbtocdb [-tdnsewpmlv] output_filename source_filename ...\n"\
+"usage: wdbtocdb [-tdnsewpqmlv] output_filename source_filename ...\n"\
 "\n"\
 " input : World Data Bank 2 and/or World Vector Shoreline sources\n"\
 "\n"\
@@ -66,7 +84,14 @@ void write_segment_data(int);
 "         e east - eastern bound (default 180)\n"\
 "         w west - western bound (default -180)\n"\
 "         h label - file header text (max 31 chars)\n"\
+"         p parallels_min - sort index by lat_min (cancels -m, -q, -l)\n"\
+"         q parallels_max - sort index by lat_max (cancels -m, -l, -p)\n"\
+"         l meridians_min - sort index by lon_min (cancels -p, -q, -m)\n"\
+"         m meridians_max - sort index by lon_max (cancels -p, -q, -l)\n"\
 "         v - verbose diagnostic messages (may be repeated)\n"\
+"\n"\
+" Sources are decoded in parallel when compiled with OpenMP, the\n"\
+" output is the same as decoding them one at a time in order.\n"\
 "\n"
 
 /*------------------------------------------------------------------------
@@ -86,6 +111,7 @@ int main(int argc, char *argv[])
   int thin = 1;
   char rank[MAX_RANKS+1], rank_string[MAX_STRING] = "";
   char label[MAX_STRING] = "wdbtocdb";
+  cdb_index_sort order = CDB_INDEX_SEG_ID;
 
 /*
  *	get command line options
@@ -125,6 +151,18 @@ int main(int argc, char *argv[])
 	  argc--; argv++;
 	  strncpy(label, *argv, MAX_STRING);
 	  break;
+	case 'p':
+	  order = CDB_INDEX_LAT_MIN;
+	  break;
+	case 'q':
+	  order = CDB_INDEX_LAT_MAX;
+	  break;
+	case 'l':
+	  order = CDB_INDEX_LON_MIN;
+	  break;
+	case 'm':
+	  order = CDB_INDEX_LON_MAX;
+	  break;
         case 'v':
 	  if (very_verbose) very_very_verbose = TRUE;
 	  if (verbose) very_verbose = TRUE;
@@ -176,19 +214,24 @@ int main(int argc, char *argv[])
   }
 
 /*
- *	record segment data and create index
+ *	decode sources in parallel, write their segments in order
+ *	and create index, each thread holds at most one decoded
+ *	source waiting for its turn to write
  */
-  for (; argc > 0; argc--, argv++)
-  { if (verbose) fprintf(stderr,">processing %s...\n", *argv);
-    wdbplt(*argv, south, 0., north, 0., west, 0., east, 0., 0., rank,
-	   (char)thin);
+#ifdef _OPENMP
+#pragma omp parallel for ordered schedule(dynamic,1)
+#endif
+  for (i = 0; i < argc; i++)
+  { wdb_batch *batch;
+
+    if (verbose) fprintf(stderr,">processing %s...\n", argv[i]);
+    batch = decode_source(argv[i], south, north, west, east, rank, thin);
+#ifdef _OPENMP
+#pragma omp ordered
+#endif
+    write_batch(batch);
   }
 
-/*
- *	flush segment data buffer
- */
-  if (npoints > 0) write_segment_data(seg_count-1);
-
 /*
  *	get maximum lat,lon extent
  */
@@ -200,6 +243,11 @@ int main(int argc, char *argv[])
     if (ilon_extent < extent) ilon_extent = extent;
   }
 
+/*
+ *	sort index
+ */
+  sort_index(order);
+
 /*
  *	update header information
  */
@@ -207,9 +255,9 @@ int main(int argc, char *argv[])
   header.max_seg_size = max_seg_size;
   header.segment_rank = detail;
   strncpy(header.text, label, 31);
-  header.index_addr = ftell(cdb_file);
+  header.index_addr = data_addr;
   header.index_size = seg_count*sizeof(cdb_index_entry);
-  header.index_order = CDB_INDEX_SEG_ID;
+  header.index_order = order;
   header.ilat_max = nint(north/CDB_LAT_SCALE);
   header.ilon_max = nint(east/CDB_LON_SCALE);
   header.ilat_min = nint(south/CDB_LAT_SCALE);
@@ -249,75 +297,104 @@ int main(int argc, char *argv[])
   exit(EXIT_SUCCESS);
 }
 
+/*------------------------------------------------------------------------
+ * decode_source - decode one WDB2 or WVS file into a batch of segments
+ *
+ *	result: new batch (empty if the file can not be read),
+ *		free it with write_batch
+ *
+ *------------------------------------------------------------------------*/
+static wdb_batch *decode_source(char *filename, float south, float north,
+				float west, float east, char *rank, int thin)
+{
+  wdb_batch *batch;
+
+  batch = (wdb_batch *)calloc(1, sizeof(wdb_batch));
+  assert(batch != NULL);
+
+  wdbplt(filename, south, 0., north, 0., west, 0., east, 0.,
+	 rank, (char)thin, curve, batch);
+  end_segment(batch);
+
+  if (very_verbose) fprintf(stderr,">>%s: %d segments, %ld points.\n",
+			    filename, batch->seg_count, batch->npoints);
+  return batch;
+}
+
 /*------------------------------------------------------------------------
  * move_pu - first point of next segment
  *------------------------------------------------------------------------*/
-void move_pu(float lat, float lon)
+static void move_pu(wdb_batch *batch, float lat, float lon)
 {
+  cdb_index_entry *seg;
   float nlon;
 
 /*
- *	write current segment
+ *	finish current segment
  */
-  if (npoints > 0) write_segment_data(seg_count-1);
+  end_segment(batch);
 
 /*
  *	make sure index is big enough
  */
-  if (seg_count >= max_index_entries)
-  { max_index_entries += 1000;
-    seg_index = (cdb_index_entry *)
-      realloc(seg_index,sizeof(cdb_index_entry)*max_index_entries);
-    assert(seg_index != NULL);
-    if (verbose) fprintf(stderr,">allocating %d index entries.\n",
-			 max_index_entries);
+  if (batch->seg_count >= batch->max_index_entries)
+  { batch->max_index_entries += 1000;
+    batch->index = (cdb_index_entry *)
+      realloc(batch->index,sizeof(cdb_index_entry)*batch->max_index_entries);
+    assert(batch->index != NULL);
+    if (very_verbose) fprintf(stderr,">>allocating %d index entries.\n",
+			      batch->max_index_entries);
   }
 
 /*
  *	start a new segment
  */
-  seg_index[seg_count].ID = seg_count;
-  seg_index[seg_count].ilat0 = nint(lat/CDB_LAT_SCALE);
+  seg = batch->index + batch->seg_count;
+  seg->ID = batch->seg_count;
+  seg->ilat0 = nint(lat/CDB_LAT_SCALE);
   nlon = lon;
   NORMALIZE(nlon);
-  seg_index[seg_count].ilon0 = nint(nlon/CDB_LON_SCALE);
-  seg_index[seg_count].ilat_max = seg_index[seg_count].ilat0;
-  seg_index[seg_count].ilon_max = seg_index[seg_count].ilon0;
-  seg_index[seg_count].ilat_min = seg_index[seg_count].ilat0;
-  seg_index[seg_count].ilon_min = seg_index[seg_count].ilon0;
-  ++seg_count;
-  npoints = 0;
+  seg->ilon0 = nint(nlon/CDB_LON_SCALE);
+  seg->ilat_max = seg->ilat0;
+  seg->ilon_max = seg->ilon0;
+  seg->ilat_min = seg->ilat0;
+  seg->ilon_min = seg->ilon0;
+  seg->addr = batch->npoints;
+  seg->size = 0;
+  ++batch->seg_count;
+  batch->seg_points = 0;
 
 }
 
 /*------------------------------------------------------------------------
  * draw_pd - add a point to the current segment
  *------------------------------------------------------------------------*/
-void draw_pd(float lat, float lon)
+static void draw_pd(wdb_batch *batch, float lat, float lon)
 {
   register int split = 0, ilat, ilon;
-  static float lat1,lon1;
   auto float lat2,lon2, lat3,lon3;
+  cdb_index_entry *seg = batch->index + batch->seg_count - 1;
 
 /*
- *	make sure segment is big enough
+ *	make sure data buffer is big enough
  */
-  if (npoints >= max_data_points)
-  { max_data_points += 1000;
-    data = (cdb_seg_data *)
-      realloc(data,sizeof(cdb_seg_data)*max_data_points);
-    assert(data != NULL);
-    if (verbose) fprintf(stderr,">allocating %d data points.\n",
-			 max_data_points);
+  if (batch->npoints >= batch->max_data_points)
+  { batch->max_data_points = 2 * batch->max_data_points + 1000;
+    batch->data = (cdb_seg_data *)
+      realloc(batch->data,sizeof(cdb_seg_data)*batch->max_data_points);
+    assert(batch->data != NULL);
+    if (very_verbose) fprintf(stderr,">>allocating %ld data points.\n",
+			      batch->max_data_points);
   }
 
 /*
  *	check for start of new segment
  */
-  if (npoints == 0)
-  { lat1 = seg_index[seg_count-1].ilat0 * CDB_LAT_SCALE;
-    lon1 = seg_index[seg_count-1].ilon0 * CDB_LON_SCALE;
-    if (very_verbose)fprintf(stderr,">>new segment: %f %f.\n",lat1,lon1);
+  if (batch->seg_points == 0)
+  { batch->lat1 = seg->ilat0 * CDB_LAT_SCALE;
+    batch->lon1 = seg->ilon0 * CDB_LON_SCALE;
+    if (very_verbose)fprintf(stderr,">>new segment: %f %f.\n",
+			     batch->lat1,batch->lon1);
   }
 
 /*
@@ -330,25 +407,27 @@ void draw_pd(float lat, float lon)
   lat3 = lat;
   lon3 = lon;
   NORMALIZE(lon3);
-  if (lon1 > 90 && lon3 < -90)
+  if (batch->lon1 > 90 && lon3 < -90)
     split = 1;
-  else if (lon1 < -90 && lon3 > 90)
+  else if (batch->lon1 < -90 && lon3 > 90)
     split = -1;
 
   if (split)
-  { while (lon1 < 0) lon1 += 360;
+  { while (batch->lon1 < 0) batch->lon1 += 360;
     while (lon3 < 0) lon3 += 360;
     lon2 = 180;
-    lat2 = (lon2-lon1) * (lat3-lat1)/(lon3-lon1) + lat1;
-    NORMALIZE(lon1);
+    lat2 = (lon2-batch->lon1) * (lat3-batch->lat1)/(lon3-batch->lon1) 
+      + batch->lat1;
+    NORMALIZE(batch->lon1);
     NORMALIZE(lon3);
     if (very_verbose)fprintf(stderr,">>split %d %f %f, %f %f, %f %f\n",
-				  split, lat1,lon1, lat2,lon2, lat3,lon3);
+			     split, batch->lat1,batch->lon1, lat2,lon2,
+			     lat3,lon3);
     lon2 = split*180;
-    draw_pd(lat2, lon2);
+    draw_pd(batch, lat2, lon2);
     lon2 = -split*180;
-    move_pu(lat2, lon2);
-    draw_pd(lat3, lon3);
+    move_pu(batch, lat2, lon2);
+    draw_pd(batch, lat3, lon3);
   }
 
 
@@ -358,67 +437,130 @@ void draw_pd(float lat, float lon)
   else
   { ilat = nint(lat3/CDB_LAT_SCALE);
     ilon = nint(lon3/CDB_LON_SCALE);
-    data[npoints].dlat = nint((lat3 - lat1)/CDB_LAT_SCALE);
-    data[npoints].dlon = nint((lon3 - lon1)/CDB_LON_SCALE);
-    lat1 = lat3;
-    lon1 = lon3;
-    ++npoints;
-    if (max_seg_size < npoints*sizeof(cdb_seg_data))
-      max_seg_size = npoints*sizeof(cdb_seg_data);
+    batch->data[batch->npoints].dlat = nint((lat3 - batch->lat1)/CDB_LAT_SCALE);
+    batch->data[batch->npoints].dlon = nint((lon3 - batch->lon1)/CDB_LON_SCALE);
+    batch->lat1 = lat3;
+    batch->lon1 = lon3;
+    ++batch->npoints;
+    ++batch->seg_points;
     if (very_very_verbose)fprintf(stderr,">>>add point %f %f.\n",lat3,lon3);
 
 /*
  *	update index entry
  */
-    if (seg_index[seg_count-1].ilat_max < ilat)
-      seg_index[seg_count-1].ilat_max = ilat;
-    if (seg_index[seg_count-1].ilon_max < ilon)
-      seg_index[seg_count-1].ilon_max = ilon;
-    if (seg_index[seg_count-1].ilat_min > ilat)
-      seg_index[seg_count-1].ilat_min = ilat;
-    if (seg_index[seg_count-1].ilon_min > ilon)
-      seg_index[seg_count-1].ilon_min = ilon;
+    if (seg->ilat_max < ilat) seg->ilat_max = ilat;
+    if (seg->ilon_max < ilon) seg->ilon_max = ilon;
+    if (seg->ilat_min > ilat) seg->ilat_min = ilat;
+    if (seg->ilon_min > ilon) seg->ilon_min = ilon;
   }
 }
 
 /*------------------------------------------------------------------------
  * curve - called by wdbplt to plot each segment
  *------------------------------------------------------------------------*/
-void curve(float *lon, float *lat, short count, char color)
+static void curve(void *curve_data, float *lon, float *lat, short count,
+		  char color)
 { register int ipt;
+  wdb_batch *batch = (wdb_batch *)curve_data;
 
   if (count <= 0) return;
 
   if (count > 1)
-  { move_pu(lat[0], lon[0]);
+  { move_pu(batch, lat[0], lon[0]);
 
     for (ipt = 1; ipt < count; ipt++)
-    { draw_pd(lat[ipt], lon[ipt]);
+    { draw_pd(batch, lat[ipt], lon[ipt]);
     }
   }
   else
-  { move_pu(lat[0], lon[0]);
-    draw_pd(lat[0], lon[0]);
+  { move_pu(batch, lat[0], lon[0]);
+    draw_pd(batch, lat[0], lon[0]);
   }
 }
 
 /*------------------------------------------------------------------------
- * write_segment_data - and get segment address and size
+ * end_segment - record size of current segment
  *------------------------------------------------------------------------*/
-void write_segment_data(int seg)
+static void end_segment(wdb_batch *batch)
 {
-  register int ios;
-
-  seg_index[seg].addr = ftell(cdb_file);
-  seg_index[seg].size = npoints*sizeof(cdb_seg_data);
-  cdb_byteswap_data_buffer(data, npoints);
-  ios = fwrite(data, sizeof(cdb_seg_data), npoints, cdb_file);
-  if (very_verbose) fprintf(stderr,">>wrote %d points of segment %d.\n",
-	 ios, seg_index[seg].ID);
-  if (ios != npoints)
-  { fprintf(stderr,"wdbtocdb: error writing data segment %d.\n",
-     seg_index[seg].ID);
+  int size;
+
+  if (batch->seg_count <= 0) return;
+  size = batch->seg_points*sizeof(cdb_seg_data);
+  batch->index[batch->seg_count-1].size = size;
+  if (batch->max_seg_size < size) batch->max_seg_size = size;
+}
+
+/*------------------------------------------------------------------------
+ * write_batch - write segment data, add segments to the index
+ *		 and free the batch
+ *
+ *	note  : batches must be written in order, segment IDs and
+ *		addresses continue from the previous batch
+ *
+ *------------------------------------------------------------------------*/
+static void write_batch(wdb_batch *batch)
+{
+  register int iseg;
+  long ios;
+  cdb_index_entry *seg;
+
+/*
+ *	make sure index is big enough
+ */
+  if (seg_count + batch->seg_count > max_index_entries)
+  { max_index_entries = seg_count + batch->seg_count + 1000;
+    seg_index = (cdb_index_entry *)
+      realloc(seg_index,sizeof(cdb_index_entry)*max_index_entries);
+    assert(seg_index != NULL);
+    if (verbose) fprintf(stderr,">allocating %d index entries.\n",
+			 max_index_entries);
+  }
+
+/*
+ *	renumber segments and point them at the output file
+ */
+  for (iseg = 0; iseg < batch->seg_count; iseg++)
+  { seg = seg_index + seg_count + iseg;
+    *seg = batch->index[iseg];
+    seg->ID += seg_count;
+    seg->addr = data_addr + seg->addr*sizeof(cdb_seg_data);
+    if (very_verbose) fprintf(stderr,">>wrote %ld points of segment %d.\n",
+			      (long)(seg->size/sizeof(cdb_seg_data)), seg->ID);
+  }
+  seg_count += batch->seg_count;
+  if (max_seg_size < batch->max_seg_size) max_seg_size = batch->max_seg_size;
+
+  cdb_byteswap_data_buffer(batch->data, batch->npoints);
+  ios = fwrite(batch->data, sizeof(cdb_seg_data), batch->npoints, cdb_file);
+  if (ios != batch->npoints)
+  { fprintf(stderr,"wdbtocdb: error writing data segments %d to %d.\n",
+	    seg_count - batch->seg_count, seg_count - 1);
     perror(cdb_filename);
     exit(ABORT);
   }
+  data_addr += batch->npoints*sizeof(cdb_seg_data);
+
+  if (batch->index) free(batch->index);
+  if (batch->data) free(batch->data);
+  free(batch);
+}
+
+/*------------------------------------------------------------------------
+ * sort_index - sort the finished index
+ *------------------------------------------------------------------------*/
+static void sort_index(cdb_index_sort order)
+{
+  cdb_class *cdb;
+
+  if (CDB_INDEX_SEG_ID == order) return;
+
+  cdb = new_cdb();
+  assert(cdb != NULL);
+  cdb->index = seg_index;
+  cdb->seg_count = seg_count;
+  cdb->index_order = CDB_INDEX_SEG_ID;
+  sort_index_cdb(cdb, order);
+  cdb->index = NULL;
+  free_cdb(cdb);
 }